@@ -0,0 +1,287 @@
+// adiv5_dap.cpp
+// Pipelined ARM ADIv5 JTAG-DP / MEM-AP transactions
+
+#include <cstdio>
+#include "adiv5_dap.h"
+#include "digilent_jtag_mock.h"
+
+// Clean transactions after which one fewer idle cycle is tried again
+#define DAP_IDLE_DECAY_OPS 256
+
+Adiv5Dap::Adiv5Dap(int hif, int initial_idle_cycles)
+    : hif(hif), idle_cycles(initial_idle_cycles), max_idle_cycles(64),
+      scans(0), wait_retries(0), batches(0), select_value(0), select_valid(false), clean_ops(0) {}
+
+// Execute the compiled program; it starts from the TAP's tracked state and
+// ends in Run-Test/Idle
+int Adiv5Dap::run_program() {
+    program.goto_state(RUN_TEST_IDLE);
+    tdo.assign((program.bit_count + 7) / 8, 0);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count);
+}
+
+int Adiv5Dap::read_idcode(uint32_t* idcode) {
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program.shift_ir(ADIV5_IR_IDCODE, ADIV5_IR_WIDTH);
+    int field = program.shift_dr((uint64_t)0, 32);
+    if (!run_program()) {
+        return FALSE;
+    }
+    const ScanField& f = program.fields[field];
+    *idcode = (uint32_t)scan_extract_bits(tdo.data(), f.offset, f.length);
+    return TRUE;
+}
+
+int Adiv5Dap::abort(uint32_t flags) {
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program.shift_ir(ADIV5_IR_ABORT, ADIV5_IR_WIDTH);
+    program.shift_dr((uint64_t)flags << 3, ADIV5_ACCESS_BITS);
+    return run_program();
+}
+
+// Request debug and system power-up and wait for both acknowledges
+int Adiv5Dap::power_up() {
+    uint32_t ctrl_stat = 0;
+    if (!dp_write(DP_CTRL_STAT, CTRL_STAT_CDBGPWRUPREQ | CTRL_STAT_CSYSPWRUPREQ | CTRL_STAT_STICKYERR) ||
+        !dp_read(DP_CTRL_STAT, &ctrl_stat)) {
+        return FALSE;
+    }
+    uint32_t acks = CTRL_STAT_CDBGPWRUPACK | CTRL_STAT_CSYSPWRUPACK;
+    if ((ctrl_stat & acks) != acks) {
+        printf("MOCK: DAP power-up not acknowledged (CTRL/STAT 0x%08X)\n", ctrl_stat);
+        fflush(stdout);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void Adiv5Dap::queue_dp_read(uint32_t addr, uint32_t* result) {
+    DapOp op = {false, true, addr, 0, result};
+    queue.push_back(op);
+}
+
+void Adiv5Dap::queue_dp_write(uint32_t addr, uint32_t data) {
+    DapOp op = {false, false, addr, data, nullptr};
+    queue.push_back(op);
+    if (addr == DP_SELECT) {
+        select_value = data;
+        select_valid = true;
+    }
+}
+
+// Queue a SELECT write if the AP register is in another bank
+void Adiv5Dap::select_bank(uint32_t addr) {
+    uint32_t bank = addr & 0xF0;
+    if (!select_valid || select_value != bank) {
+        queue_dp_write(DP_SELECT, bank);
+    }
+}
+
+void Adiv5Dap::queue_ap_read(uint32_t addr, uint32_t* result) {
+    select_bank(addr);
+    DapOp op = {true, true, addr, 0, result};
+    queue.push_back(op);
+}
+
+void Adiv5Dap::queue_ap_write(uint32_t addr, uint32_t data) {
+    select_bank(addr);
+    DapOp op = {true, false, addr, data, nullptr};
+    queue.push_back(op);
+}
+
+// Run transactions [first, first + DAP_BATCH_MAX) and a trailing RDBUFF read
+// that collects the last result. Scan k captures the result of transaction
+// first + k - 1. On WAIT, *stopped is the first transaction whose result was
+// not collected: it has executed, the one after it was dropped, and the
+// rest ran out of order.
+DapBatchStatus Adiv5Dap::run_batch(size_t first, size_t* stopped) {
+    size_t end = first + DAP_BATCH_MAX;
+    if (end > queue.size()) {
+        end = queue.size();
+    }
+
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    response_fields.clear();
+    int ir = -1;
+    for (size_t i = first; i <= end; i++) {
+        bool ap = false;
+        bool read = true;
+        uint32_t addr = DP_RDBUFF;
+        uint32_t data = 0;
+        if (i < end) {
+            ap = queue[i].ap;
+            read = queue[i].read;
+            addr = queue[i].addr;
+            data = queue[i].data;
+        }
+        if (i > first && idle_cycles > 0) {
+            program.idle(idle_cycles);
+        }
+        int want = ap ? ADIV5_IR_APACC : ADIV5_IR_DPACC;
+        if (want != ir) {
+            program.shift_ir(want, ADIV5_IR_WIDTH);
+            ir = want;
+        }
+        uint64_t request = ((uint64_t)data << 3) | (((addr >> 2) & 0x3) << 1) | (read ? 1 : 0);
+        response_fields.push_back(program.shift_dr(request, ADIV5_ACCESS_BITS));
+    }
+
+    batches++;
+    scans += response_fields.size();
+    if (!run_program()) {
+        *stopped = first;
+        return DAP_BATCH_ERROR;
+    }
+
+    for (size_t k = 0; k < response_fields.size(); k++) {
+        const ScanField& f = program.fields[response_fields[k]];
+        uint64_t response = scan_extract_bits(tdo.data(), f.offset, f.length);
+        uint32_t ack = response & 0x7;
+        size_t op_index = k == 0 ? first : first + k - 1;
+        if (ack == ADIV5_ACK_WAIT) {
+            *stopped = op_index;
+            return DAP_BATCH_WAIT;
+        }
+        if (ack != ADIV5_ACK_OK) {
+            printf("MOCK: DAP transaction %zu returned ACK 0x%X\n", op_index, ack);
+            fflush(stdout);
+            *stopped = op_index;
+            return DAP_BATCH_ERROR;
+        }
+        if (k > 0 && queue[op_index].result) {
+            *queue[op_index].result = (uint32_t)(response >> 3);
+        }
+    }
+    *stopped = end;
+    return DAP_BATCH_OK;
+}
+
+// Run batches over the whole queue until it completes or one is not OK;
+// *stopped is a queue index as in run_batch
+DapBatchStatus Adiv5Dap::run_queue(size_t* stopped) {
+    size_t next = 0;
+    while (next < queue.size()) {
+        DapBatchStatus status = run_batch(next, stopped);
+        if (status != DAP_BATCH_OK) {
+            return status;
+        }
+        adapt_after_success(*stopped - next);
+        next = *stopped;
+    }
+    *stopped = next;
+    return DAP_BATCH_OK;
+}
+
+void Adiv5Dap::adapt_after_wait() {
+    wait_retries++;
+    clean_ops = 0;
+    idle_cycles = idle_cycles == 0 ? 1 : idle_cycles * 2;
+    if (idle_cycles > max_idle_cycles) {
+        idle_cycles = max_idle_cycles;
+    }
+}
+
+void Adiv5Dap::adapt_after_success(size_t ops) {
+    clean_ops += ops;
+    if (clean_ops >= DAP_IDLE_DECAY_OPS && idle_cycles > 0) {
+        idle_cycles--;
+        clean_ops = 0;
+    }
+}
+
+// Execute the whole queue, repeating from the transaction whose result was
+// lost after a WAIT. Transactions after the dropped one may already have run
+// once, so the queue should only hold accesses that are safe to repeat
+// (block transfers use read_block/write_block instead).
+int Adiv5Dap::flush() {
+    size_t next = 0;
+    while (next < queue.size()) {
+        size_t stopped = next;
+        DapBatchStatus status = run_batch(next, &stopped);
+        if (status == DAP_BATCH_OK) {
+            adapt_after_success(stopped - next);
+        } else if (status == DAP_BATCH_WAIT) {
+            adapt_after_wait();
+        } else {
+            queue.clear();
+            select_valid = false;
+            return FALSE;
+        }
+        next = stopped;
+    }
+    queue.clear();
+    return TRUE;
+}
+
+int Adiv5Dap::dp_read(uint32_t addr, uint32_t* value) {
+    queue_dp_read(addr, value);
+    return flush();
+}
+
+int Adiv5Dap::dp_write(uint32_t addr, uint32_t data) {
+    queue_dp_write(addr, data);
+    return flush();
+}
+
+int Adiv5Dap::ap_read(uint32_t addr, uint32_t* value) {
+    queue_ap_read(addr, value);
+    return flush();
+}
+
+int Adiv5Dap::ap_write(uint32_t addr, uint32_t data) {
+    queue_ap_write(addr, data);
+    return flush();
+}
+
+// DRW accesses auto-increment TAR and must not run out of order, so every
+// chunk starts by writing TAR, and after a WAIT the chunk restarts at the
+// first word whose transaction was not confirmed. Chunks stop at the 1KB
+// auto-increment boundary.
+int Adiv5Dap::transfer_block(uint32_t address, uint32_t* read_words, const uint32_t* write_words, int count) {
+    if (!ap_write(AP_CSW, CSW_ADDRINC_SINGLE | CSW_SIZE_32)) {
+        return FALSE;
+    }
+
+    int done = 0;
+    while (done < count) {
+        uint32_t chunk_address = address + 4 * done;
+        int chunk = (int)((MEM_AP_AUTOINC_BOUNDARY - (chunk_address % MEM_AP_AUTOINC_BOUNDARY)) / 4);
+        if (chunk > count - done) {
+            chunk = count - done;
+        }
+
+        queue_ap_write(AP_TAR, chunk_address);
+        size_t data_start = queue.size();
+        for (int i = done; i < done + chunk; i++) {
+            if (read_words) {
+                queue_ap_read(AP_DRW, &read_words[i]);
+            } else {
+                queue_ap_write(AP_DRW, write_words[i]);
+            }
+        }
+
+        size_t stopped = 0;
+        DapBatchStatus status = run_queue(&stopped);
+        queue.clear();
+        if (status == DAP_BATCH_OK) {
+            done += chunk;
+        } else if (status == DAP_BATCH_WAIT) {
+            adapt_after_wait();
+            if (stopped > data_start) {
+                done += (int)(stopped - data_start);
+            }
+        } else {
+            select_valid = false;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+int Adiv5Dap::read_block(uint32_t address, uint32_t* words, int count) {
+    return transfer_block(address, words, nullptr, count);
+}
+
+int Adiv5Dap::write_block(uint32_t address, const uint32_t* words, int count) {
+    return transfer_block(address, nullptr, words, count);
+}
@@ -0,0 +1,130 @@
+// adiv5_dap.h
+// Pipelined ARM ADIv5 JTAG-DP / MEM-AP transactions
+
+#ifndef ADIV5_DAP_H
+#define ADIV5_DAP_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_scan_program.h"
+
+// JTAG-DP instructions (jtag_instruction_register.sv)
+#define ADIV5_IR_WIDTH   4
+#define ADIV5_IR_ABORT   0x8
+#define ADIV5_IR_DPACC   0xA
+#define ADIV5_IR_APACC   0xB
+#define ADIV5_IR_IDCODE  0xE
+
+// Scan chain: {data[31:0], A[3:2], RnW} in, {data[31:0], ACK[2:0]} out
+#define ADIV5_ACCESS_BITS  35
+#define ADIV5_ACK_OK       0x2
+#define ADIV5_ACK_WAIT     0x1
+
+// DP registers
+#define DP_CTRL_STAT  0x4
+#define DP_SELECT     0x8
+#define DP_RDBUFF     0xC
+
+// CTRL/STAT fields
+#define CTRL_STAT_STICKYERR     (1u << 5)
+#define CTRL_STAT_CDBGPWRUPREQ  (1u << 28)
+#define CTRL_STAT_CDBGPWRUPACK  (1u << 29)
+#define CTRL_STAT_CSYSPWRUPREQ  (1u << 30)
+#define CTRL_STAT_CSYSPWRUPACK  (1u << 31)
+
+// ABORT fields
+#define ABORT_DAPABORT   (1u << 0)
+#define ABORT_STKERRCLR  (1u << 2)
+
+// MEM-AP registers (APBANKSEL in bits [7:4])
+#define AP_CSW  0x00
+#define AP_TAR  0x04
+#define AP_DRW  0x0C
+#define AP_BD0  0x10
+#define AP_IDR  0xFC
+
+// CSW fields
+#define CSW_SIZE_32          0x2
+#define CSW_ADDRINC_SINGLE   (1u << 4)
+
+// TAR auto-increment wraps within this boundary
+#define MEM_AP_AUTOINC_BOUNDARY 1024
+
+// Transactions per compiled program
+#define DAP_BATCH_MAX 64
+
+// One queued DP or AP transaction; result receives the data of a read
+struct DapOp {
+    bool ap;
+    bool read;
+    uint32_t addr;
+    uint32_t data;
+    uint32_t* result;
+};
+
+enum DapBatchStatus {
+    DAP_BATCH_OK,
+    DAP_BATCH_WAIT,     // A transaction was dropped with WAIT; see the stop index
+    DAP_BATCH_ERROR     // Bad ACK or the scan itself could not be executed
+};
+
+// Adiv5Dap class
+// Queues DPACC/APACC transactions and executes them as one scan program per
+// batch. The IR is only rescanned when switching between DPACC and APACC,
+// and each DR scan captures the result of the transaction before it, so a
+// block read is N APACC reads plus one RDBUFF read. A WAIT drops the
+// request of that scan while later ones still run, so the batch resumes
+// from the last transaction whose result was not collected, with more
+// Run-Test/Idle cycles between scans.
+class Adiv5Dap {
+public:
+    int hif;
+    int idle_cycles;        // Run-Test/Idle cycles between scans; 0 chains directly
+    int max_idle_cycles;
+    uint64_t scans;
+    uint64_t wait_retries;
+    uint64_t batches;
+
+    explicit Adiv5Dap(int hif, int initial_idle_cycles = 0);
+
+    int read_idcode(uint32_t* idcode);
+    int power_up();
+    int abort(uint32_t flags);
+
+    // Queued access; results are valid after flush() returns TRUE. AP
+    // addresses include APBANKSEL; SELECT is written when the bank changes.
+    void queue_dp_read(uint32_t addr, uint32_t* result);
+    void queue_dp_write(uint32_t addr, uint32_t data);
+    void queue_ap_read(uint32_t addr, uint32_t* result);
+    void queue_ap_write(uint32_t addr, uint32_t data);
+    int flush();
+
+    // Single access (queue + flush)
+    int dp_read(uint32_t addr, uint32_t* value);
+    int dp_write(uint32_t addr, uint32_t data);
+    int ap_read(uint32_t addr, uint32_t* value);
+    int ap_write(uint32_t addr, uint32_t data);
+
+    // Block transfers through DRW with TAR auto-increment
+    int read_block(uint32_t address, uint32_t* words, int count);
+    int write_block(uint32_t address, const uint32_t* words, int count);
+
+private:
+    std::vector<DapOp> queue;
+    ScanProgram program;
+    std::vector<uint8_t> tdo;
+    std::vector<int> response_fields;
+    uint32_t select_value;
+    bool select_valid;
+    uint64_t clean_ops;
+
+    void select_bank(uint32_t addr);
+    int run_program();
+    DapBatchStatus run_batch(size_t first, size_t* stopped);
+    DapBatchStatus run_queue(size_t* stopped);
+    void adapt_after_wait();
+    void adapt_after_success(size_t ops);
+    int transfer_block(uint32_t address, uint32_t* read_words, const uint32_t* write_words, int count);
+};
+
+#endif // ADIV5_DAP_H
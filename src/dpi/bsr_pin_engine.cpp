@@ -0,0 +1,166 @@
+// bsr_pin_engine.cpp
+// Timed pin waveforms on boundary scan cells, compiled into EXTEST scans
+
+#include <algorithm>
+#include "bsr_pin_engine.h"
+#include "digilent_jtag_mock.h"
+
+// Instructions (jtag_instruction_register.sv)
+#define PIN_IR_EXTEST  0x0
+#define PIN_IR_SAMPLE  0x2
+#define PIN_IR_WIDTH   4
+
+// PinWaveform implementation
+PinWaveform::PinWaveform() : sample_count(0) {}
+
+void PinWaveform::clear() {
+    events.clear();
+    sample_count = 0;
+}
+
+void PinWaveform::drive(uint32_t time, int cell, bool level) {
+    drive_cells(time, 1u << cell, level ? (1u << cell) : 0);
+}
+
+void PinWaveform::drive_cells(uint32_t time, uint32_t mask, uint32_t value) {
+    Event event = { time, mask, value & mask, 0, -1 };
+    events.push_back(event);
+}
+
+int PinWaveform::sample(uint32_t time, int cell) {
+    Event event = { time, 0, 0, 1u << cell, sample_count };
+    events.push_back(event);
+    return sample_count++;
+}
+
+// BsrPinEngine implementation
+BsrPinEngine::BsrPinEngine(int hif, uint32_t initial_value, int bsr_width)
+    : hif(hif), bsr_width(bsr_width), value(initial_value),
+      updates(0), dropped_slots(0), fused_captures(0), extra_captures(0), pad_cycles(0),
+      compiled_value(initial_value), last_update_bit(-1), scan_gap(0) {}
+
+// Execute the compiled program; it starts from the TAP's tracked state and
+// ends in Run-Test/Idle
+int BsrPinEngine::run_program() {
+    program_.goto_state(RUN_TEST_IDLE);
+    tdo.assign((program_.bit_count + 7) / 8, 0);
+    return djtg_shift_bits(hif, program_.tms.data(), program_.tdi.data(), tdo.data(), program_.bit_count);
+}
+
+int BsrPinEngine::begin() {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program_.shift_ir(PIN_IR_SAMPLE, PIN_IR_WIDTH);
+    program_.shift_dr((uint64_t)value, bsr_width);
+    program_.shift_ir(PIN_IR_EXTEST, PIN_IR_WIDTH);
+    return run_program();
+}
+
+int BsrPinEngine::end() {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program_.shift_ir(PIN_IR_SAMPLE, PIN_IR_WIDTH);
+    return run_program();
+}
+
+// Take the pending scan through Update-DR no earlier than scan_gap cycles
+// after the previous update. Exit1-DR -> Update-DR is one TCK; a longer
+// hold goes through Pause-DR, which costs two extra cycles.
+void BsrPinEngine::finish_update() {
+    if (program_.state != EXIT1_DR) {
+        return;
+    }
+    int min_bit = last_update_bit < 0 ? 0 : last_update_bit + (int)scan_gap;
+    if (program_.bit_count + 1 < min_bit) {
+        program_.append_bit(false, false);               // Pause-DR
+        int hold = min_bit - (program_.bit_count + 2);   // Leaves via Exit2-DR
+        for (int i = 0; i < hold; i++) {
+            program_.append_bit(false, false);
+        }
+        pad_cycles += hold > 0 ? hold + 2 : 2;
+    }
+    program_.goto_state(UPDATE_DR);
+    last_update_bit = program_.bit_count;
+}
+
+// One DR scan: its capture resolves the pending samples, its update
+// applies next_value
+void BsrPinEngine::emit_scan(uint32_t next_value, uint32_t gap) {
+    finish_update();
+    int field = program_.shift_dr((uint64_t)next_value, bsr_width);
+    for (size_t i = 0; i < pending.size(); i++) {
+        SampleSlot slot = { field, pending[i].mask, pending[i].index };
+        slots.push_back(slot);
+    }
+    pending.clear();
+    scan_gap = gap;
+    compiled_value = next_value;
+}
+
+void BsrPinEngine::compile(const PinWaveform& waveform) {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    slots.clear();
+    pending.clear();
+    compiled_value = value;
+    last_update_bit = -1;
+    scan_gap = 0;
+
+    sorted = waveform.events;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const PinWaveform::Event& a, const PinWaveform::Event& b) { return a.time < b.time; });
+
+    uint32_t last_time = 0;
+    bool first = true;
+    size_t i = 0;
+    while (i < sorted.size()) {
+        uint32_t time = sorted[i].time;
+        uint32_t next_value = compiled_value;
+        uint32_t driven = 0;
+        size_t end = i;
+        for (; end < sorted.size() && sorted[end].time == time; end++) {
+            const PinWaveform::Event& e = sorted[end];
+            if (e.sample_mask) {
+                PendingSample sample = { e.sample_mask, e.sample_index };
+                pending.push_back(sample);
+            }
+            next_value = (next_value & ~e.drive_mask) | e.drive_value;
+            driven |= e.drive_mask;
+        }
+        i = end;
+
+        // Cells that do not change need no update; samples wait for the
+        // next scan, whose capture sees the same levels
+        uint32_t changed = next_value ^ compiled_value;
+        if (!changed) {
+            if (driven) {
+                dropped_slots++;
+            }
+            continue;
+        }
+        fused_captures += pending.size();
+        emit_scan(next_value, first ? 0 : time - last_time);
+        updates++;
+        last_time = time;
+        first = false;
+    }
+
+    // Samples after the last change: capture-only scan of the same values
+    if (!pending.empty()) {
+        extra_captures += pending.size();
+        emit_scan(compiled_value, 0);
+    }
+    finish_update();
+}
+
+int BsrPinEngine::run(const PinWaveform& waveform) {
+    compile(waveform);
+    if (!run_program()) {
+        return FALSE;
+    }
+    samples.assign(waveform.sample_count, 0);
+    for (size_t i = 0; i < slots.size(); i++) {
+        const ScanField& f = program_.fields[slots[i].field];
+        uint64_t captured = scan_extract_bits(tdo.data(), f.offset, f.length);
+        samples[slots[i].index] = (captured & slots[i].mask) ? 1 : 0;
+    }
+    value = compiled_value;
+    return TRUE;
+}
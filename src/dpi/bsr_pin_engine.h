@@ -0,0 +1,102 @@
+// bsr_pin_engine.h
+// Timed pin waveforms on boundary scan cells, compiled into EXTEST scans
+
+#ifndef BSR_PIN_ENGINE_H
+#define BSR_PIN_ENGINE_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_scan_program.h"
+#include "jtag_bsr_layout.h"
+
+// PinWaveform class
+// Drive and sample events on BSR cells. Times are in TCK cycles from the
+// start of the waveform and act as lower bounds: the chain cannot move a
+// pin faster than one DR scan. A sample at time t observes the pins just
+// before the drives at time t take effect, like a flip-flop at a clock edge.
+class PinWaveform {
+public:
+    struct Event {
+        uint32_t time;
+        uint32_t drive_mask;     // Cells driven by this event
+        uint32_t drive_value;
+        uint32_t sample_mask;    // Single cell sampled, or 0
+        int sample_index;
+    };
+
+    std::vector<Event> events;
+    int sample_count;
+
+    PinWaveform();
+
+    void clear();
+    void drive(uint32_t time, int cell, bool level);
+    void drive_cells(uint32_t time, uint32_t mask, uint32_t value);
+
+    // Returns the index of the sample in BsrPinEngine::samples
+    int sample(uint32_t time, int cell);
+};
+
+// BsrPinEngine class
+// Compiles a PinWaveform into the minimal sequence of EXTEST DR scans and
+// runs it as one bulk transfer. Events at the same time collapse into one
+// update, time slots that change no cell are dropped, and each sample rides
+// on the capture of the scan that applies the next change (consecutive
+// scans chain Update-DR -> Select-DR -> Capture-DR). Only a sample after
+// the last change needs a scan of its own. Gaps longer than a scan are
+// padded in Pause-DR, which holds the pins without an extra update.
+class BsrPinEngine {
+public:
+    int hif;
+    int bsr_width;
+    uint32_t value;          // Cells as last updated (preloaded by begin())
+
+    // Results of the last run, one entry (0/1) per waveform sample
+    std::vector<uint8_t> samples;
+
+    // Statistics
+    uint64_t updates;
+    uint64_t dropped_slots;
+    uint64_t fused_captures;
+    uint64_t extra_captures;
+    uint64_t pad_cycles;
+
+    BsrPinEngine(int hif, uint32_t initial_value, int bsr_width = BSR_WIDTH);
+
+    // PRELOAD the initial cell values and switch to EXTEST; end() returns to SAMPLE
+    int begin();
+    int end();
+
+    // Compile without running (program size and statistics only)
+    void compile(const PinWaveform& waveform);
+
+    int run(const PinWaveform& waveform);
+
+    const ScanProgram& program() const { return program_; }
+
+private:
+    struct PendingSample {
+        uint32_t mask;
+        int index;
+    };
+    struct SampleSlot {
+        int field;           // Scan whose capture resolves the sample
+        uint32_t mask;
+        int index;
+    };
+
+    ScanProgram program_;
+    std::vector<uint8_t> tdo;
+    std::vector<PinWaveform::Event> sorted;
+    std::vector<PendingSample> pending;
+    std::vector<SampleSlot> slots;
+    uint32_t compiled_value;
+    int last_update_bit;     // Program bit of the previous Update-DR, -1 before the first
+    uint32_t scan_gap;       // Minimum TCK cycles between the previous update and this one
+
+    void emit_scan(uint32_t next_value, uint32_t gap);
+    void finish_update();
+    int run_program();
+};
+
+#endif // BSR_PIN_ENGINE_H
@@ -0,0 +1,117 @@
+// bsr_shadow.cpp
+// Write-combining host shadow of the boundary scan update register
+
+#include "bsr_shadow.h"
+#include "digilent_jtag_mock.h"
+
+// Instructions (jtag_instruction_register.sv)
+#define SHADOW_IR_EXTEST  0x0
+#define SHADOW_IR_SAMPLE  0x2
+#define SHADOW_IR_WIDTH   4
+
+static const int field_cells[BSR_FIELD_COUNT_OF] = {
+    BSR_UP_DOWN_CELL, BSR_COUNT_DATA_CELL, BSR_COUNT_OE_CELL, BSR_SPI_CS_N_CELL,
+    BSR_SPI_SCK_CELL, BSR_SPI_MOSI_CELL, BSR_SPI_MISO_CELL
+};
+
+static const int field_widths[BSR_FIELD_COUNT_OF] = { 1, BSR_COUNTER_N, BSR_COUNTER_N, 1, 1, 1, 1 };
+
+int bsr_field_cell(BsrField field) {
+    return field_cells[field];
+}
+
+int bsr_field_width(BsrField field) {
+    return field_widths[field];
+}
+
+uint32_t bsr_field_mask(BsrField field) {
+    return ((1u << field_widths[field]) - 1) << field_cells[field];
+}
+
+BsrShadow::BsrShadow(int hif, uint32_t initial_value)
+    : hif(hif), value(initial_value), committed(initial_value), writes(0), commits(0), scans(0),
+      empty_commits(0), pending_writes(0) {
+}
+
+// Programs start from the tracked state of the TAP the HIF is wired to
+void BsrShadow::start_program() {
+    int tap = jtag_device_tap(hif);
+    program.clear(jtag_tracked_state(tap < 0 ? 0 : tap));
+}
+
+int BsrShadow::run_program() {
+    program.goto_state(RUN_TEST_IDLE);
+    tdo.assign((program.bit_count + 7) / 8, 0);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count);
+}
+
+int BsrShadow::begin() {
+    start_program();
+    program.shift_ir(SHADOW_IR_SAMPLE, SHADOW_IR_WIDTH);
+    program.shift_dr(value, BSR_WIDTH);
+    program.shift_ir(SHADOW_IR_EXTEST, SHADOW_IR_WIDTH);
+    committed = value;
+    pending_writes = 0;
+    return run_program();
+}
+
+int BsrShadow::end() {
+    if (!commit()) {
+        return FALSE;
+    }
+    start_program();
+    program.shift_ir(SHADOW_IR_SAMPLE, SHADOW_IR_WIDTH);
+    return run_program();
+}
+
+void BsrShadow::write(BsrField field, uint32_t field_value) {
+    write_cells(bsr_field_mask(field), field_value << field_cells[field]);
+}
+
+void BsrShadow::write_cell(int cell, bool level) {
+    write_cells(1u << cell, (level ? 1u : 0u) << cell);
+}
+
+void BsrShadow::write_cells(uint32_t mask, uint32_t cells) {
+    value = (value & ~mask) | (cells & mask);
+    writes++;
+    pending_writes++;
+}
+
+int BsrShadow::commit() {
+    if (!dirty()) {
+        if (pending_writes > 0) {
+            empty_commits++;
+            pending_writes = 0;
+        }
+        return TRUE;
+    }
+    start_program();
+    program.shift_dr(value, BSR_WIDTH);
+    commits++;
+    scans++;
+    committed = value;
+    pending_writes = 0;
+    return run_program();
+}
+
+// Pending writes and the capture go out as two chained scans in one call:
+// the first updates the cells, the second captures the pins they drive
+int BsrShadow::read(BsrField field, uint32_t* field_value) {
+    start_program();
+    if (dirty()) {
+        program.shift_dr(value, BSR_WIDTH);
+        commits++;
+        scans++;
+        committed = value;
+    }
+    pending_writes = 0;
+    int capture = program.shift_dr(value, BSR_WIDTH);
+    scans++;
+    if (!run_program()) {
+        return FALSE;
+    }
+    uint32_t cells = (uint32_t)scan_extract_bits(tdo.data(), program.fields[capture].offset, BSR_WIDTH);
+    *field_value = (cells & bsr_field_mask(field)) >> field_cells[field];
+    return TRUE;
+}
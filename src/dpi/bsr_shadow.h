@@ -0,0 +1,75 @@
+// bsr_shadow.h
+// Write-combining host shadow of the boundary scan update register
+
+#ifndef BSR_SHADOW_H
+#define BSR_SHADOW_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_scan_program.h"
+#include "jtag_bsr_layout.h"
+
+// Pin fields of the BSR, each a run of cells (jtag_bsr_layout.h)
+enum BsrField {
+    BSR_FIELD_UP_DOWN,
+    BSR_FIELD_COUNT,
+    BSR_FIELD_COUNT_OE,
+    BSR_FIELD_SPI_CS_N,
+    BSR_FIELD_SPI_SCK,
+    BSR_FIELD_SPI_MOSI,
+    BSR_FIELD_SPI_MISO,
+    BSR_FIELD_COUNT_OF
+};
+
+int bsr_field_cell(BsrField field);
+int bsr_field_width(BsrField field);
+uint32_t bsr_field_mask(BsrField field);
+
+// BsrShadow class
+// Host copy of update_register for EXTEST pin control. Writes only change
+// the shadow; commit() drives all of them with a single DR scan, and skips
+// the scan when they left the cells as they were. read() is a barrier: it
+// commits pending writes and captures the pins behind them in the same
+// transfer, so a read always sees every earlier write.
+//
+// In EXTEST the up_down and SPI cells capture the driven pins and MISO the
+// flash output; the count and enable cells capture the counter and a fixed
+// 1, so reads of those fields return core values rather than the drive.
+class BsrShadow {
+public:
+    int hif;
+    uint32_t value;          // Shadow including pending writes
+    uint32_t committed;      // Cells as last updated on the chain
+
+    // Statistics
+    uint64_t writes;
+    uint64_t commits;        // commit() calls that had pending writes
+    uint64_t scans;          // DR scans issued
+    uint64_t empty_commits;  // Writes that restored the committed value
+
+    BsrShadow(int hif, uint32_t initial_value);
+
+    // PRELOAD the initial value and switch to EXTEST; end() returns to SAMPLE
+    int begin();
+    int end();
+
+    void write(BsrField field, uint32_t field_value);
+    void write_cell(int cell, bool level);
+    void write_cells(uint32_t mask, uint32_t cells);
+
+    bool dirty() const { return value != committed; }
+    int commit();
+
+    // Field value as captured after all earlier writes took effect
+    int read(BsrField field, uint32_t* field_value);
+
+private:
+    ScanProgram program;
+    std::vector<uint8_t> tdo;
+    uint64_t pending_writes;     // Writes since the last update
+
+    void start_program();
+    int run_program();
+};
+
+#endif // BSR_SHADOW_H
@@ -8,12 +8,19 @@
 #include <thread>
 #include <bitset>
 #include <random>
+#include <algorithm>
 #include <cstdio>
 #include "digilent_jtag_mock.h"
 #include "svdpi.h"
 
 // Device registry
-static std::map<HIF, JtagDevice> device_registry;
+// Map nodes come from a dedicated arena so enable/disable cycles do not hit
+// the heap once a HIF has been seen.
+typedef std::map<HIF, JtagDevice, std::less<HIF>,
+                 ArenaAllocator<std::pair<const HIF, JtagDevice>>> DeviceRegistry;
+static SessionArena registry_arena(4096);
+static DeviceRegistry device_registry{DeviceRegistry::allocator_type(&registry_arena)};
+static UsbAdapterModel usb_model;
 static std::random_device rd;
 static std::mt19937 gen(rd());
 
@@ -21,11 +28,13 @@ static std::mt19937 gen(rd());
 JtagDevice::JtagDevice() : enabled(false), clock_freq(1000000),
                            tck_state(false), tms_state(false),
                            tdi_state(false), tdo_state(false),
-                           device_id(0x12345678), timeout_ms(1000) {}
+                           device_id(0x12345678), timeout_ms(1000),
+                           tap(0) {}
 
 // Utility functions
 std::vector<bool> bytes_to_bits(const std::vector<uint8_t>& bytes, int bit_count) {
     std::vector<bool> bits;
+    bits.reserve(bit_count);
     for (int i = 0; i < bit_count; i++) {
         bool bit_val = (bytes[i/8] >> (i % 8)) & 1;
         bits.push_back(bit_val);
@@ -52,11 +61,245 @@ bool simulate_timeout(int operation_time_ms, int timeout_ms) {
     return operation_time_ms > timeout_ms;
 }
 
+int count_set_bits(uint64_t value) {
+    int count = 0;
+    for (; value; value &= value - 1) {
+        count++;
+    }
+    return count;
+}
+
+int lowest_set_bit(uint64_t value) {
+    if (!value) {
+        return -1;
+    }
+    int bit = 0;
+    for (; !(value & 1); value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+// Step observers and the host-side TAP state tracker. The tracker starts in
+// Test-Logic-Reset and is exact after any five TMS=1 steps (tap_reset).
+static std::vector<JtagStepObserver*> step_observers;
+static TapState tracked_state = TEST_LOGIC_RESET;
+static bool tracked_tck = false;
+
+// Instances other than 0: tracked state and the HIF assignments
+static TapState tracked_states[JTAG_MAX_TAPS];
+static std::map<HIF, int> tap_assignments;
+
+// Instruction register of every instance as seen from the steps: the
+// Capture-IR pattern and shifted TDI bits, latched at Update-IR
+#define IR_CAPTURE_PATTERN 0x5
+static int loaded_instructions[JTAG_MAX_TAPS] = { -1, -1, -1, -1, -1, -1, -1, -1,
+                                                  -1, -1, -1, -1, -1, -1, -1, -1 };
+static uint32_t ir_windows[JTAG_MAX_TAPS];
+static JtagIrCacheStats ir_cache_stats;
+
+static void track_instruction(int tap, TapState from, bool tms, bool tdi) {
+    switch (from) {
+    case CAPTURE_IR:
+        ir_windows[tap] = IR_CAPTURE_PATTERN;
+        break;
+    case SHIFT_IR:
+        ir_windows[tap] = (ir_windows[tap] >> 1) | ((uint32_t)tdi << (JTAG_IR_LENGTH - 1));
+        break;
+    case UPDATE_IR:
+        loaded_instructions[tap] = (int)ir_windows[tap];
+        break;
+    default:
+        break;
+    }
+    if (tap_next_state(from, tms) == TEST_LOGIC_RESET) {
+        loaded_instructions[tap] = -1;
+    }
+}
+
+// A fixed-TMS run settles within five cycles and a held Shift-IR fills the
+// window within JTAG_IR_LENGTH, so the first 16 cycles decide the result
+static void track_instruction_clock(int tap, TapState from, bool tms, bool tdi, int count) {
+    for (int i = 0; i < count && i < 16; i++) {
+        track_instruction(tap, from, tms, tdi);
+        from = tap_next_state(from, tms);
+    }
+}
+
+void jtag_add_step_observer(JtagStepObserver* observer) {
+    step_observers.push_back(observer);
+}
+
+void jtag_remove_step_observer(JtagStepObserver* observer) {
+    for (size_t i = 0; i < step_observers.size(); i++) {
+        if (step_observers[i] == observer) {
+            step_observers.erase(step_observers.begin() + i);
+            return;
+        }
+    }
+}
+
+TapState jtag_tracked_state(int tap) {
+    return tap > 0 && tap < JTAG_MAX_TAPS ? tracked_states[tap] : tracked_state;
+}
+
+static void notify_step(bool tms, bool tdi, bool tdo) {
+    TapState from = tracked_state;
+    tracked_state = tap_next_state(from, tms);
+    track_instruction(0, from, tms, tdi);
+    for (size_t i = 0; i < step_observers.size(); i++) {
+        step_observers[i]->on_step(from, tms, tdi, tdo);
+    }
+}
+
+static void notify_unobserved(bool tms, bool tdi) {
+    TapState from = tracked_state;
+    tracked_state = tap_next_state(from, tms);
+    track_instruction(0, from, tms, tdi);
+    for (size_t i = 0; i < step_observers.size(); i++) {
+        step_observers[i]->on_unobserved(from, tms, tdi);
+    }
+}
+
+void jtag_step(svBit tms, svBit tdi, svBit is_last, svBit* tdo) {
+    sv_jtag_step(tms, tdi, is_last, tdo);
+    notify_step(tms, tdi, *tdo);
+}
+
+void jtag_clock(svBit tms, svBit tdi, int count) {
+    sv_jtag_clock(tms, tdi, count);
+    TapState from = tracked_state;
+    track_instruction_clock(0, from, tms, tdi, count);
+    // With TMS held the state settles within five cycles
+    for (int i = 0; i < count && i < 8; i++) {
+        tracked_state = tap_next_state(tracked_state, tms);
+    }
+    for (size_t i = 0; i < step_observers.size(); i++) {
+        step_observers[i]->on_clock(from, tms, tdi, count);
+    }
+}
+
+static JtagBulkBackend* bulk_backend = nullptr;
+
+void jtag_set_bulk_backend(JtagBulkBackend* backend) {
+    bulk_backend = backend;
+}
+
+JtagBulkBackend* jtag_bulk_backend() {
+    return bulk_backend;
+}
+
+int jtag_tap_count() {
+    int count = sv_get_tap_count();
+    return count < JTAG_MAX_TAPS ? count : JTAG_MAX_TAPS;
+}
+
+// Takes effect at the next djtg_enable of the HIF
+int jtag_assign_tap(int hif, int tap) {
+    if (tap < 0 || tap >= jtag_tap_count()) {
+        printf("MOCK: TAP instance %d out of range (%d instances)\n", tap, jtag_tap_count());
+        fflush(stdout);
+        return FALSE;
+    }
+    tap_assignments[hif] = tap;
+    return TRUE;
+}
+
+int jtag_device_tap(int hif) {
+    auto it = device_registry.find(hif);
+    if (it == device_registry.end() || !it->second.enabled) {
+        return -1;
+    }
+    return it->second.tap;
+}
+
+void jtag_load_tracked_state(int tap, TapState state, uint32_t instruction) {
+    loaded_instructions[tap] = (int)instruction;
+    if (tap != 0) {
+        tracked_states[tap] = state;
+        return;
+    }
+    tracked_state = state;
+    for (size_t i = 0; i < step_observers.size(); i++) {
+        step_observers[i]->on_state_load(state, instruction);
+    }
+}
+
+int jtag_loaded_instruction(int tap) {
+    return loaded_instructions[tap];
+}
+
+int jtag_load_instruction(int hif, uint32_t instruction, bool force) {
+    int tap = jtag_device_tap(hif);
+    if (tap < 0) {
+        printf("MOCK: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    TapState state = jtag_tracked_state(tap);
+    bool cached = !force && loaded_instructions[tap] == (int)instruction;
+    if (cached) {
+        ir_cache_stats.skips++;
+        if (state == RUN_TEST_IDLE) {
+            return TRUE;
+        }
+    } else {
+        ir_cache_stats.loads++;
+    }
+    ScanProgram& program = device_registry.find(hif)->second.ir_program;
+    program.clear(state);
+    if (!cached) {
+        program.shift_ir(instruction, JTAG_IR_LENGTH);
+    }
+    program.goto_state(RUN_TEST_IDLE);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), nullptr, program.bit_count);
+}
+
+void jtag_ir_cache_invalidate(int hif) {
+    int tap = jtag_device_tap(hif);
+    if (tap >= 0) {
+        loaded_instructions[tap] = -1;
+    }
+}
+
+const JtagIrCacheStats& jtag_ir_cache_stats() {
+    return ir_cache_stats;
+}
+
+void jtag_step_on(int tap, svBit tms, svBit tdi, svBit is_last, svBit* tdo) {
+    if (tap == 0) {
+        jtag_step(tms, tdi, is_last, tdo);
+        return;
+    }
+    sv_jtag_step_idx(tap, tms, tdi, is_last, tdo);
+    track_instruction(tap, tracked_states[tap], tms, tdi);
+    tracked_states[tap] = tap_next_state(tracked_states[tap], tms);
+}
+
+void jtag_clock_on(int tap, svBit tms, svBit tdi, int count) {
+    if (tap == 0) {
+        jtag_clock(tms, tdi, count);
+        return;
+    }
+    sv_jtag_clock_idx(tap, tms, tdi, count);
+    track_instruction_clock(tap, tracked_states[tap], tms, tdi, count);
+    for (int i = 0; i < count && i < 8; i++) {
+        tracked_states[tap] = tap_next_state(tracked_states[tap], tms);
+    }
+}
+
 // Direct signal access functions
 void drive_jtag_pins(svBit tck_val, svBit tms_val, svBit tdi_val) {
     printf("C++ DEBUG: drive_jtag_pins - TCK=%d, TMS=%d, TDI=%d\n", (int)tck_val, (int)tms_val, (int)tdi_val);
     fflush(stdout);
+    // A rising edge is a step: TDO is the value presented before the edge
+    bool rising = tck_val && !tracked_tck;
+    bool tdo = rising && !step_observers.empty() ? sv_get_tdo() : false;
     sv_drive_jtag_pins(tck_val, tms_val, tdi_val);
+    tracked_tck = tck_val;
+    if (rising) {
+        notify_step(tms_val, tdi_val, tdo);
+    }
 }
 
 void read_jtag_pins(svBit* tdo_val) {
@@ -71,6 +314,11 @@ void wait_cycles(int cycles) {
     sv_wait_cycles(cycles);
 }
 
+// Simulation time as reported by the backend (ModelSim or native model)
+long long jtag_sim_time_ps() {
+    return sv_get_time_ps();
+}
+
 // TAP navigation helpers
 void tap_reset() {
     printf("TAP_RESET: Starting TAP reset sequence\n");
@@ -78,12 +326,12 @@ void tap_reset() {
     // Send 5 TMS=1 to ensure Test-Logic-Reset state
     for (int i = 0; i < 5; i++) {
         svBit tdo_bit = 0;
-        sv_jtag_step(1, 0, 0, &tdo_bit);  // TMS=1, TDI=0
+        jtag_step(1, 0, 0, &tdo_bit);  // TMS=1, TDI=0
     }
     
     // Go to Run-Test-Idle
     svBit tdo_bit = 0;
-    sv_jtag_step(0, 0, 0, &tdo_bit);  // TMS=0, TDI=0
+    jtag_step(0, 0, 0, &tdo_bit);  // TMS=0, TDI=0
     printf("TAP_RESET: Reset sequence completed\n");
     fflush(stdout);
 }
@@ -92,11 +340,11 @@ void navigate_to_shift_ir() {
     printf("NAV_IR: Navigating to Shift-IR\n");
     fflush(stdout);
     // From Run-Test-Idle to Shift-IR: TMS sequence = 1,1,0,0
-    std::vector<bool> tms_sequence = {1, 1, 0, 0};
+    static const svBit tms_sequence[] = {1, 1, 0, 0};
     
-    for (bool tms_val : tms_sequence) {
+    for (svBit tms_val : tms_sequence) {
         svBit tdo_bit = 0;
-        sv_jtag_step(tms_val, 0, 0, &tdo_bit);
+        jtag_step(tms_val, 0, 0, &tdo_bit);
     }
     printf("NAV_IR: Shift-IR navigation completed\n");
     fflush(stdout);
@@ -106,11 +354,11 @@ void navigate_to_shift_dr() {
     printf("NAV_DR: Navigating to Shift-DR\n");
     fflush(stdout);
     // From Run-Test-Idle to Shift-DR: TMS sequence = 1,0,0
-    std::vector<bool> tms_sequence = {1, 0, 0};
+    static const svBit tms_sequence[] = {1, 0, 0};
     
-    for (bool tms_val : tms_sequence) {
+    for (svBit tms_val : tms_sequence) {
         svBit tdo_bit = 0;
-        sv_jtag_step(tms_val, 0, 0, &tdo_bit);
+        jtag_step(tms_val, 0, 0, &tdo_bit);
     }
     printf("NAV_DR: Shift-DR navigation completed\n");
     fflush(stdout);
@@ -123,12 +371,12 @@ void navigate_to_shift_dr_with_idle() {
     // From Run-Test-Idle: TMS=1 -> Select-DR-Scan -> TMS=1 -> Capture-DR -> TMS=0 -> Shift-DR
     // But first, ensure we're in Run-Test-Idle with one extra cycle for IR to settle
     svBit tdo_bit = 0;
-    sv_jtag_step(0, 0, 0, &tdo_bit);  // Extra idle cycle after Update-IR
+    jtag_step(0, 0, 0, &tdo_bit);  // Extra idle cycle after Update-IR
     
-    std::vector<bool> tms_sequence = {1, 0, 0};
+    static const svBit tms_sequence[] = {1, 0, 0};
     
-    for (bool tms_val : tms_sequence) {
-        sv_jtag_step(tms_val, 0, 0, &tdo_bit);
+    for (svBit tms_val : tms_sequence) {
+        jtag_step(tms_val, 0, 0, &tdo_bit);
     }
     printf("NAV_DR_IDLE: Shift-DR navigation with idle completed\n");
     fflush(stdout);
@@ -139,12 +387,508 @@ void exit_to_run_test_idle() {
     fflush(stdout);
     // From Exit1-* -> Update-* (TMS=1), then -> Run-Test/Idle (TMS=0)
     svBit tdo_bit = 0;
-    sv_jtag_step(1, 0, 0, &tdo_bit);
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     printf("EXIT_IDLE: Exit to Run-Test-Idle completed\n");
     fflush(stdout);
 }
 
+UsbAdapterModel& djtg_usb_model() {
+    return usb_model;
+}
+
+// Buffers of the djtg_shift_expect, djtg_shift_capture or sv_jtag_run call
+// in progress. For a capture the mask words come from the windows instead
+// of a buffer; captured words land at packed_offset.
+struct JtagExpectJob {
+    const uint8_t* tms;
+    const uint8_t* tdi;
+    const uint8_t* expected;
+    const uint8_t* mask;
+    int cbit;
+    JtagExpectResult* result;
+    const JtagCaptureWindow* windows;
+    int window_count;
+    int window_cursor;
+    uint8_t* packed;
+    int packed_offset;
+    int packed_bits;
+};
+// Instance 0's testbench tasks call back with only a word index, so its job
+// sits in this one slot. Instance 0 has a single session at a time (the
+// main suite; the forked sessions drive instances 1..N), and a transfer
+// that finds the slot taken is refused. Other instances pass their job to
+// the C loops directly.
+static JtagExpectJob* expect_job = nullptr;
+
+static bool claim_expect_job(JtagExpectJob* job) {
+    if (expect_job) {
+        printf("MOCK: Instance 0 is busy with another bulk transfer\n");
+        fflush(stdout);
+        return false;
+    }
+    expect_job = job;
+    return true;
+}
+
+static int run_min_bits = -1;
+static JtagRunStats run_stats;
+static JtagPathModel path_model;
+static JtagShiftPath forced_path = JTAG_PATH_AUTO;
+
+void jtag_set_run_min_bits(int min_bits) {
+    run_min_bits = min_bits;
+}
+
+int jtag_run_min_bits() {
+    return run_min_bits < 0 ? path_model.run_threshold(JTAG_RUN_MIN_BITS_DEFAULT) : run_min_bits;
+}
+
+void jtag_set_shift_path(JtagShiftPath path) {
+    forced_path = path;
+}
+
+JtagPathModel& jtag_path_model() {
+    return path_model;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+const JtagRunStats& jtag_run_stats() {
+    return run_stats;
+}
+
+// Cycles from start on with TMS and TDI equal to their values at start.
+// Whole bytes are compared at once once the scan is byte-aligned.
+static int constant_run_length(const uint8_t* tms, const uint8_t* tdi, int start, int cbit) {
+    bool tms_val = (tms[start / 8] >> (start % 8)) & 1;
+    bool tdi_val = (tdi[start / 8] >> (start % 8)) & 1;
+    uint8_t tms_byte = tms_val ? 0xFF : 0x00;
+    uint8_t tdi_byte = tdi_val ? 0xFF : 0x00;
+    int i = start;
+    while (i < cbit) {
+        if (i % 8 == 0 && i + 8 <= cbit) {
+            if (tms[i / 8] == tms_byte && tdi[i / 8] == tdi_byte) {
+                i += 8;
+                continue;
+            }
+        }
+        if (((tms[i / 8] >> (i % 8)) & 1) != tms_val || ((tdi[i / 8] >> (i % 8)) & 1) != tdi_val) {
+            break;
+        }
+        i++;
+    }
+    return i - start;
+}
+
+// One constant stretch of instance 0 through sv_jtag_run; TDO comes back
+// into tdo (may be null) at offset
+static bool jtag_run(const uint8_t* tms, const uint8_t* tdi, int offset, int count, uint8_t* tdo) {
+    bool tms_val = (tms[offset / 8] >> (offset % 8)) & 1;
+    bool tdi_val = (tdi[offset / 8] >> (offset % 8)) & 1;
+    JtagExpectJob job = { tms, tdi, nullptr, nullptr, offset + count, nullptr, nullptr, 0, 0, tdo, offset, count };
+    if (!claim_expect_job(&job)) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    sv_jtag_run(tms_val, tdi_val, count, tdo != nullptr);
+    path_model.record(JTAG_PATH_RUN, count, elapsed_us(start));
+    expect_job = nullptr;
+    run_stats.runs++;
+    run_stats.run_bits += count;
+    for (int i = offset; i < offset + count; i++) {
+        notify_step(tms_val, tdi_val, tdo && ((tdo[i / 8] >> (i % 8)) & 1));
+    }
+    return true;
+}
+
+SessionArena* session_arena(int hif) {
+    auto it = device_registry.find(hif);
+    if (it == device_registry.end() || !it->second.enabled) {
+        return nullptr;
+    }
+    return it->second.arena.get();
+}
+
+// Bulk shift over raw packed buffers
+// Shared by djtg_put_tms_tdi_bits and host-side scan programs. Buffers are
+// packed LSB-first within each byte; tdo may be null when the caller does
+// not need the shifted-out data.
+int djtg_shift_bits(int hif, const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit) {
+    auto it = device_registry.find(hif);
+    if (it == device_registry.end() || !it->second.enabled) {
+        printf("MOCK: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    
+    // Simulate timeout for very large operations
+    int operation_time = cbit / 1000;  // Rough time estimate
+    if (simulate_timeout(operation_time, it->second.timeout_ms)) {
+        printf("MOCK: Timeout during %d bit operation\n", cbit);
+        fflush(stdout);
+        return FALSE;
+    }
+    
+    printf("MOCK: Processing %d JTAG bits\n", cbit);
+    fflush(stdout);
+    int tap = it->second.tap;
+    usb_model.shift(cbit, tdo != nullptr, it->second.clock_freq);
+    
+    // Clear TDO data array
+    int byte_count = (cbit + 7) / 8;
+    if (tdo) {
+        for (int i = 0; i < byte_count; i++) {
+            tdo[i] = 0;
+        }
+    }
+    
+    // Other instances are always stepped
+    if (tap != 0) {
+        for (int bit_idx = 0; bit_idx < cbit; bit_idx++) {
+            int byte_idx = bit_idx / 8;
+            int bit_pos = bit_idx % 8;
+            svBit tdo_bit = 0;
+            jtag_step_on(tap, (tms[byte_idx] >> bit_pos) & 1, (tdi[byte_idx] >> bit_pos) & 1,
+                         bit_idx == cbit - 1, &tdo_bit);
+            if (tdo && tdo_bit) {
+                tdo[byte_idx] |= (1 << bit_pos);
+            }
+        }
+        return TRUE;
+    }
+
+    // Every path gives the same TDO and simulated time, so the choice only
+    // affects wall time; each transfer's time refines the path model
+    unsigned available = (1u << JTAG_PATH_STEP) | (1u << JTAG_PATH_VECTOR) | (bulk_backend ? 1u << JTAG_PATH_BULK : 0);
+    JtagShiftPath path = forced_path != JTAG_PATH_AUTO && ((available >> forced_path) & 1) ?
+                         forced_path : path_model.choose(cbit, available);
+    std::vector<uint8_t>& scratch = it->second.scratch;
+    uint8_t* out = tdo;
+    if (!out && (path == JTAG_PATH_VECTOR || !step_observers.empty())) {
+        scratch.assign(byte_count, 0);
+        out = scratch.data();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // Whole-buffer execution, then the same per-step notifications
+    if (path == JTAG_PATH_BULK || path == JTAG_PATH_VECTOR) {
+        if (path == JTAG_PATH_BULK) {
+            bulk_backend->shift(tms, tdi, out, cbit);
+        } else {
+            JtagCaptureWindow all = { 0, cbit };
+            JtagExpectJob job = { tms, tdi, nullptr, nullptr, cbit, nullptr, &all, 1, 0, out, 0, cbit };
+            if (!claim_expect_job(&job)) {
+                return FALSE;
+            }
+            sv_jtag_shift_capture(cbit);
+            expect_job = nullptr;
+        }
+        path_model.record(path, cbit, elapsed_us(start));
+        for (int bit_idx = 0; bit_idx < cbit; bit_idx++) {
+            int byte_idx = bit_idx / 8;
+            int bit_pos = bit_idx % 8;
+            notify_step((tms[byte_idx] >> bit_pos) & 1, (tdi[byte_idx] >> bit_pos) & 1,
+                        out && ((out[byte_idx] >> bit_pos) & 1));
+        }
+        return TRUE;
+    }
+
+    // Process each bit via single SV step for correct timing, except
+    // constant stretches, which go to the backend as runs
+    int min_run = jtag_run_min_bits();
+    int stepped = 0;
+    double run_us = 0;
+    int bit_idx = 0;
+    while (bit_idx < cbit) {
+        int run = min_run > 0 ? constant_run_length(tms, tdi, bit_idx, cbit) : 1;
+        if (min_run > 0 && run >= min_run) {
+            auto run_start = std::chrono::steady_clock::now();
+            if (!jtag_run(tms, tdi, bit_idx, run, out)) {
+                return FALSE;
+            }
+            run_us += elapsed_us(run_start);
+            bit_idx += run;
+            continue;
+        }
+        // A stretch too short for a run is stepped whole
+        for (int end = bit_idx + run; bit_idx < end; bit_idx++) {
+            int byte_idx = bit_idx / 8;
+            int bit_pos = bit_idx % 8;
+            svBit tms_bit = (tms[byte_idx] >> bit_pos) & 1;
+            svBit tdi_bit = (tdi[byte_idx] >> bit_pos) & 1;
+            svBit is_last = (bit_idx == cbit - 1) ? 1 : 0;
+            svBit tdo_bit = 0;
+            jtag_step_on(tap, tms_bit, tdi_bit, is_last, &tdo_bit);
+            if (tdo && tdo_bit) {
+                tdo[byte_idx] |= (1 << bit_pos);
+            }
+        }
+        stepped += run;
+    }
+    if (stepped > 0) {
+        path_model.record(JTAG_PATH_STEP, stepped, elapsed_us(start) - run_us);
+    }
+    
+    return TRUE;
+}
+
+static int expect_word(const uint8_t* buf, int index, int cbit) {
+    return buf ? (int)scan_extract_bits(buf, index * 32, std::min(32, cbit - index * 32)) : 0;
+}
+
+// Chunks are fetched in order, so the cursor only moves forward
+static int capture_mask_word(JtagExpectJob* job, int index) {
+    int start = index * 32;
+    uint32_t mask = 0;
+    while (job->window_cursor < job->window_count &&
+           job->windows[job->window_cursor].offset + job->windows[job->window_cursor].length <= start) {
+        job->window_cursor++;
+    }
+    for (int w = job->window_cursor; w < job->window_count && job->windows[w].offset < start + 32; w++) {
+        int from = std::max(job->windows[w].offset, start) - start;
+        int to = std::min(job->windows[w].offset + job->windows[w].length, start + 32) - start;
+        mask |= (uint32_t)(((1ull << to) - 1) & ~((1ull << from) - 1));
+    }
+    return (int)mask;
+}
+
+static void expect_chunk(JtagExpectJob* job, int index, int* tms, int* tdi, int* expected, int* mask) {
+    *tms = expect_word(job->tms, index, job->cbit);
+    *tdi = expect_word(job->tdi, index, job->cbit);
+    *expected = expect_word(job->expected, index, job->cbit);
+    if (job->windows) {
+        *mask = capture_mask_word(job, index);
+    } else {
+        *mask = job->mask ? expect_word(job->mask, index, job->cbit) : -1;
+    }
+}
+
+static void capture_word(JtagExpectJob* job, int index, int word) {
+    int length = std::min(32, job->packed_bits - index * 32);
+    if (length > 0) {
+        scan_deposit_bits(job->packed, job->packed_offset + index * 32, (uint32_t)word, length);
+    }
+}
+
+static void expect_window_bit(JtagExpectJob* job, int offset, svBit tdo) {
+    JtagExpectResult* result = job->result;
+    if (offset < JTAG_EXPECT_WINDOW_MAX) {
+        result->window |= (uint64_t)(tdo & 1) << offset;
+        result->window_bits = offset + 1;
+    }
+}
+
+void jtag_expect_chunk(int index, int* tms, int* tdi, int* expected, int* mask) {
+    expect_chunk(expect_job, index, tms, tdi, expected, mask);
+}
+
+void jtag_capture_word(int index, int word) {
+    capture_word(expect_job, index, word);
+}
+
+void jtag_expect_window_bit(int offset, svBit tdo) {
+    expect_window_bit(expect_job, offset, tdo);
+}
+
+// Same loop as sv_jtag_shift_expect in the testbench
+static void expect_run(JtagExpectJob* job, const std::function<bool(bool tms, bool tdi)>& step, int cbit,
+                       bool abort_on_mismatch, int window_bits, int* first_mismatch, int* mismatches, int* steps) {
+    int tms = 0, tdi = 0, expected = 0, mask = 0;
+    int stop = cbit;
+    *first_mismatch = -1;
+    *mismatches = 0;
+    for (int i = 0; i < stop; i++) {
+        int b = i % 32;
+        if (b == 0) {
+            expect_chunk(job, i / 32, &tms, &tdi, &expected, &mask);
+        }
+        bool tdo = step((tms >> b) & 1, (tdi >> b) & 1);
+        if (((mask >> b) & 1) && tdo != (bool)((expected >> b) & 1)) {
+            if (*first_mismatch < 0) {
+                *first_mismatch = i;
+                if (abort_on_mismatch) {
+                    stop = std::min(cbit, i + std::max(window_bits, 1));
+                }
+            }
+            (*mismatches)++;
+        }
+        if (*first_mismatch >= 0 && i < *first_mismatch + window_bits) {
+            expect_window_bit(job, i - *first_mismatch, tdo);
+        }
+    }
+    *steps = stop;
+}
+
+void jtag_expect_run(const std::function<bool(bool tms, bool tdi)>& step, int cbit, bool abort_on_mismatch,
+                     int window_bits, int* first_mismatch, int* mismatches, int* steps) {
+    expect_run(expect_job, step, cbit, abort_on_mismatch, window_bits, first_mismatch, mismatches, steps);
+}
+
+// Same loop as sv_jtag_shift_capture in the testbench
+static void capture_run(JtagExpectJob* job, const std::function<bool(bool tms, bool tdi)>& step, int cbit) {
+    int tms = 0, tdi = 0, expected = 0, mask = 0;
+    uint32_t packed = 0;
+    int captured = 0;
+    for (int i = 0; i < cbit; i++) {
+        int b = i % 32;
+        if (b == 0) {
+            expect_chunk(job, i / 32, &tms, &tdi, &expected, &mask);
+        }
+        bool tdo = step((tms >> b) & 1, (tdi >> b) & 1);
+        if ((mask >> b) & 1) {
+            packed |= (uint32_t)tdo << (captured % 32);
+            captured++;
+            if (captured % 32 == 0) {
+                capture_word(job, captured / 32 - 1, (int)packed);
+                packed = 0;
+            }
+        }
+    }
+    if (captured % 32) {
+        capture_word(job, captured / 32, (int)packed);
+    }
+}
+
+void jtag_capture_run(const std::function<bool(bool tms, bool tdi)>& step, int cbit) {
+    capture_run(expect_job, step, cbit);
+}
+
+// Bulk shift with sparse TDO capture
+// The backend samples TDO only inside the windows and hands back packed
+// words; the adapter model returns the packed bytes instead of cbit bits.
+int djtg_shift_capture(int hif, const uint8_t* tms, const uint8_t* tdi, int cbit,
+                       const JtagCaptureWindow* windows, int window_count, uint8_t* packed) {
+    auto it = device_registry.find(hif);
+    if (it == device_registry.end() || !it->second.enabled) {
+        printf("MOCK: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    int packed_bits = 0;
+    for (int w = 0; w < window_count; w++) {
+        int end = w == 0 ? 0 : windows[w - 1].offset + windows[w - 1].length;
+        if (windows[w].length <= 0 || windows[w].offset < end || windows[w].offset + windows[w].length > cbit) {
+            printf("MOCK: Invalid capture window %d (%d bits at %d)\n", w, windows[w].length, windows[w].offset);
+            fflush(stdout);
+            return FALSE;
+        }
+        packed_bits += windows[w].length;
+    }
+    printf("MOCK: Processing %d JTAG bits, capturing %d\n", cbit, packed_bits);
+    fflush(stdout);
+    int tap = it->second.tap;
+    usb_model.shift_sparse(cbit, packed_bits, it->second.clock_freq);
+    for (int i = 0; i < (packed_bits + 7) / 8; i++) {
+        packed[i] = 0;
+    }
+
+    JtagExpectJob job = { tms, tdi, nullptr, nullptr, cbit, nullptr, windows, window_count, 0, packed, 0, packed_bits };
+    if (tap == 0) {
+        if (!claim_expect_job(&job)) {
+            return FALSE;
+        }
+        sv_jtag_shift_capture(cbit);
+        expect_job = nullptr;
+    } else {
+        capture_run(&job, [tap](bool tms_bit, bool tdi_bit) {
+            svBit tdo_bit = 0;
+            jtag_step_on(tap, tms_bit, tdi_bit, 0, &tdo_bit);
+            return tdo_bit != 0;
+        }, cbit);
+    }
+
+    if (tap == 0) {
+        int w = 0, packed_idx = 0;
+        for (int bit_idx = 0; bit_idx < cbit; bit_idx++) {
+            int byte_idx = bit_idx / 8;
+            int bit_pos = bit_idx % 8;
+            while (w < window_count && bit_idx >= windows[w].offset + windows[w].length) {
+                w++;
+            }
+            bool tms_bit = (tms[byte_idx] >> bit_pos) & 1;
+            bool tdi_bit = (tdi[byte_idx] >> bit_pos) & 1;
+            if (w < window_count && bit_idx >= windows[w].offset) {
+                notify_step(tms_bit, tdi_bit, (packed[packed_idx / 8] >> (packed_idx % 8)) & 1);
+                packed_idx++;
+            } else {
+                notify_unobserved(tms_bit, tdi_bit);
+            }
+        }
+    }
+    return TRUE;
+}
+
+// Bulk shift with the TDO compare in the backend
+// Only status goes back over the adapter. TAP 0 runs sv_jtag_shift_expect
+// (the testbench task, or the native model's loop); other TAPs compare in
+// the per-bit loop here.
+int djtg_shift_expect(int hif, const uint8_t* tms, const uint8_t* tdi, const uint8_t* expected,
+                      const uint8_t* mask, int cbit, int flags, int window_bits, JtagExpectResult* result) {
+    auto it = device_registry.find(hif);
+    if (it == device_registry.end() || !it->second.enabled) {
+        printf("MOCK: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    if (window_bits > JTAG_EXPECT_WINDOW_MAX) {
+        window_bits = JTAG_EXPECT_WINDOW_MAX;
+    }
+    printf("MOCK: Processing %d JTAG bits with expected TDO\n", cbit);
+    fflush(stdout);
+    int tap = it->second.tap;
+    bool abort_on_mismatch = (flags & JTAG_EXPECT_ABORT) != 0;
+    usb_model.shift(cbit, false, it->second.clock_freq);
+
+    result->window = 0;
+    result->window_bits = 0;
+    JtagExpectJob job = { tms, tdi, expected, mask, cbit, result, nullptr, 0, 0, nullptr, 0, 0 };
+    int first_mismatch, mismatches, steps;
+    if (tap == 0) {
+        if (!claim_expect_job(&job)) {
+            return FALSE;
+        }
+        sv_jtag_shift_expect(cbit, abort_on_mismatch, window_bits, &first_mismatch, &mismatches, &steps);
+        expect_job = nullptr;
+    } else {
+        expect_run(&job, [tap](bool tms_bit, bool tdi_bit) {
+            svBit tdo_bit = 0;
+            jtag_step_on(tap, tms_bit, tdi_bit, 0, &tdo_bit);
+            return tdo_bit != 0;
+        }, cbit, abort_on_mismatch, window_bits, &first_mismatch, &mismatches, &steps);
+    }
+
+    // Observers only learn what the compare established: the actual window
+    // from the first mismatch, and the expected value on compared bits that
+    // matched (all of them before the first mismatch, and after it too when
+    // it was the only one). Every other bit is unobserved.
+    if (tap == 0) {
+        for (int bit_idx = 0; bit_idx < steps; bit_idx++) {
+            int byte_idx = bit_idx / 8;
+            int bit_pos = bit_idx % 8;
+            bool tms_bit = (tms[byte_idx] >> bit_pos) & 1;
+            bool tdi_bit = (tdi[byte_idx] >> bit_pos) & 1;
+            int window_offset = bit_idx - first_mismatch;
+            bool compared = !mask || ((mask[byte_idx] >> bit_pos) & 1);
+            if (first_mismatch >= 0 && window_offset >= 0 && window_offset < result->window_bits) {
+                notify_step(tms_bit, tdi_bit, (result->window >> window_offset) & 1);
+            } else if (compared && (first_mismatch < 0 || bit_idx < first_mismatch || mismatches == 1)) {
+                notify_step(tms_bit, tdi_bit, (expected[byte_idx] >> bit_pos) & 1);
+            } else {
+                notify_unobserved(tms_bit, tdi_bit);
+            }
+        }
+    }
+
+    result->pass = mismatches == 0 ? TRUE : FALSE;
+    result->first_mismatch = first_mismatch;
+    result->mismatches = mismatches;
+    result->bits_shifted = steps;
+    return TRUE;
+}
+
 // Core Digilent JTAG API implementation
 extern "C" {
 
@@ -155,10 +899,16 @@ int djtg_enable(int hif) {
         return FALSE;
     }
     
-    device_registry[hif] = JtagDevice();
-    device_registry[hif].enabled = true;
+    JtagDevice& device = device_registry[hif];
+    device = JtagDevice();
+    device.arena.reset(new SessionArena());
+    device.enabled = true;
+    auto assigned = tap_assignments.find(hif);
+    if (assigned != tap_assignments.end()) {
+        device.tap = assigned->second;
+    }
     
-    printf("MOCK: Device %d enabled successfully\n", hif);
+    printf("MOCK: Device %d enabled successfully (TAP %d)\n", hif, device.tap);
     fflush(stdout);
     return TRUE;
 }
@@ -172,6 +922,7 @@ int djtg_disable(int hif) {
     }
     
     it->second.enabled = false;
+    it->second.arena.reset();
     printf("MOCK: Device %d disabled\n", hif);
     fflush(stdout);
     return TRUE;
@@ -181,56 +932,55 @@ int djtg_put_tms_tdi_bits(int hif, const svOpenArrayHandle tms_data,
                           const svOpenArrayHandle tdi_data,
                           const svOpenArrayHandle tdo_data,
                           int cbit, svBit overlap) {
+    return djtg_shift_bits(hif, (const uint8_t*)svGetArrayPtr(tms_data),
+                           (const uint8_t*)svGetArrayPtr(tdi_data),
+                           (uint8_t*)svGetArrayPtr(tdo_data), cbit);
+}
+
+// Windows are passed as (offset, length) int pairs; tdo_data receives the
+// packed capture
+int djtg_put_tms_tdi_bits_windows(int hif, const svOpenArrayHandle tms_data,
+                                  const svOpenArrayHandle tdi_data,
+                                  const svOpenArrayHandle window_data, int window_count,
+                                  const svOpenArrayHandle tdo_data, int cbit) {
+    return djtg_shift_capture(hif, (const uint8_t*)svGetArrayPtr(tms_data),
+                              (const uint8_t*)svGetArrayPtr(tdi_data), cbit,
+                              (const JtagCaptureWindow*)svGetArrayPtr(window_data), window_count,
+                              (uint8_t*)svGetArrayPtr(tdo_data));
+}
+
+int djtg_get_tms_tdi_tdo_bits(int hif, const svOpenArrayHandle tms_data,
+                              const svOpenArrayHandle tdi_data,
+                              const svOpenArrayHandle tdo_data,
+                              int cbit, svBit overlap) {
+    // For this mock, get and put operations are identical
+    return djtg_put_tms_tdi_bits(hif, tms_data, tdi_data, tdo_data, cbit, overlap);
+}
+
+// Clock TCK cckt times with fixed TMS/TDI (DjtgClockTck). Used for RUNTEST
+// idle periods; the whole run is a single call into the backend.
+int djtg_clock_tck(int hif, svBit tms, svBit tdi, int cckt, svBit overlap) {
     auto it = device_registry.find(hif);
     if (it == device_registry.end() || !it->second.enabled) {
         printf("MOCK: Device %d not enabled\n", hif);
         fflush(stdout);
         return FALSE;
     }
-    
-    // Simulate timeout for very large operations
-    int operation_time = cbit / 1000;  // Rough time estimate
-    if (simulate_timeout(operation_time, it->second.timeout_ms)) {
-        printf("MOCK: Timeout during %d bit operation\n", cbit);
-        fflush(stdout);
-        return FALSE;
+    if (cckt <= 0) {
+        return TRUE;
     }
     
-    printf("MOCK: Processing %d JTAG bits\n", cbit);
+    printf("MOCK: Clocking TCK %d times (TMS=%d, TDI=%d)\n", cckt, (int)tms, (int)tdi);
     fflush(stdout);
+    jtag_clock_on(it->second.tap, tms, tdi, cckt);
+    usb_model.clock(cckt, it->second.clock_freq);
     
-    // Clear TDO data array
-    int byte_count = (cbit + 7) / 8;
-    char* tdo_ptr = (char*)svGetArrayPtr(tdo_data);
-    for (int i = 0; i < byte_count; i++) {
-        tdo_ptr[i] = 0;
-    }
-    
-    // Process each bit via single SV step for correct timing
-    for (int bit_idx = 0; bit_idx < cbit; bit_idx++) {
-        int byte_idx = bit_idx / 8;
-        int bit_pos = bit_idx % 8;
-        svBit tms_bit = (((char*)svGetArrayPtr(tms_data))[byte_idx] >> bit_pos) & 1;
-        svBit tdi_bit = (((char*)svGetArrayPtr(tdi_data))[byte_idx] >> bit_pos) & 1;
-        svBit is_last = (bit_idx == cbit - 1) ? 1 : 0;
-        svBit tdo_bit = 0;
-        sv_jtag_step(tms_bit, tdi_bit, is_last, &tdo_bit);
-        if (tdo_bit) {
-            tdo_ptr[byte_idx] |= (1 << bit_pos);
-        }
-    }
-    
+    it->second.tms_state = tms;
+    it->second.tdi_state = tdi;
+    it->second.tck_state = 0;
     return TRUE;
 }
 
-int djtg_get_tms_tdi_tdo_bits(int hif, const svOpenArrayHandle tms_data,
-                              const svOpenArrayHandle tdi_data,
-                              const svOpenArrayHandle tdo_data,
-                              int cbit, svBit overlap) {
-    // For this mock, get and put operations are identical
-    return djtg_put_tms_tdi_bits(hif, tms_data, tdi_data, tdo_data, cbit, overlap);
-}
-
 int djtg_set_tms_tdi_tck(int hif, svBit tms, svBit tdi, svBit tck) {
     auto it = device_registry.find(hif);
     if (it == device_registry.end() || !it->second.enabled) {
@@ -240,9 +990,14 @@ int djtg_set_tms_tdi_tck(int hif, svBit tms, svBit tdi, svBit tck) {
     it->second.tms_state = tms;
     it->second.tdi_state = tdi;
     it->second.tck_state = tck;
+    usb_model.pin_access();
     
     // Drive RTL directly
-    drive_jtag_pins(tck, tms, tdi);
+    if (it->second.tap == 0) {
+        drive_jtag_pins(tck, tms, tdi);
+    } else {
+        sv_drive_jtag_pins_idx(it->second.tap, tck, tms, tdi);
+    }
     
     return TRUE;
 }
@@ -256,9 +1011,14 @@ int djtg_get_tms_tdi_tdo_tck(int hif, svBit* tms, svBit* tdi, svBit* tdo, svBit*
     *tms = it->second.tms_state;
     *tdi = it->second.tdi_state;
     *tck = it->second.tck_state;
+    usb_model.pin_access();
     
     // Read TDO from RTL
-    read_jtag_pins(tdo);
+    if (it->second.tap == 0) {
+        read_jtag_pins(tdo);
+    } else {
+        *tdo = sv_get_tdo_idx(it->second.tap);
+    }
     it->second.tdo_state = *tdo;
     
     return TRUE;
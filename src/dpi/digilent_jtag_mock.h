@@ -11,9 +11,15 @@
 #include <thread>
 #include <bitset>
 #include <random>
+#include <functional>
+#include <memory>
 
 // DPI-C includes
 #include "svdpi.h"
+#include "jtag_session_arena.h"
+#include "jtag_scan_program.h"
+#include "jtag_usb_model.h"
+#include "jtag_path_model.h"
 
 // Cross-platform export macro
 #ifdef _WIN32
@@ -37,6 +43,12 @@ public:
     bool tck_state, tms_state, tdi_state, tdo_state;
     uint32_t device_id;
     int timeout_ms;
+    int tap;               // TAP instance the HIF is wired to
+    std::unique_ptr<SessionArena> arena;   // Scan buffers and command objects, released on disable
+    // Per HIF rather than function statics: forked sessions interleave
+    // whenever a shift consumes simulated time
+    ScanProgram ir_program;                // jtag_load_instruction's scan
+    std::vector<uint8_t> scratch;          // TDO for shifts whose caller passed none
     
     JtagDevice();
 };
@@ -46,6 +58,9 @@ std::vector<bool> bytes_to_bits(const std::vector<uint8_t>& bytes, int bit_count
 std::vector<uint8_t> bits_to_bytes(const std::vector<bool>& bits);
 bool simulate_communication_error(double failure_rate = 0.01);
 bool simulate_timeout(int operation_time_ms, int timeout_ms);
+// Portable bit counting (no compiler builtins, for MSVC builds)
+int count_set_bits(uint64_t value);
+int lowest_set_bit(uint64_t value);     // -1 when value is 0
 
 // TAP navigation helpers
 void tap_reset();
@@ -58,6 +73,157 @@ void exit_to_run_test_idle();
 void drive_jtag_pins(svBit tck_val, svBit tms_val, svBit tdi_val);
 void read_jtag_pins(svBit* tdo_val);
 void wait_cycles(int cycles);
+long long jtag_sim_time_ps();
+
+// Per-session arena of an enabled device (null if not enabled)
+SessionArena* session_arena(int hif);
+
+// JtagStepObserver class
+// Sees every TCK step issued through the mock (jtag_step, jtag_clock and
+// rising TCK edges from drive_jtag_pins) together with the TAP state the
+// step was taken from, as tracked on the host. Observers run on the
+// simulator thread and must not block.
+class JtagStepObserver {
+public:
+    virtual ~JtagStepObserver() {}
+    virtual void on_step(TapState state, bool tms, bool tdi, bool tdo) = 0;
+    // count TCK cycles with fixed TMS/TDI; TDO is not sampled
+    virtual void on_clock(TapState state, bool tms, bool tdi, int count) {}
+    // TAP state and instruction written by backdoor (hybrid handoff)
+    virtual void on_state_load(TapState state, uint32_t instruction) {}
+    // A step whose TDO the backend did not report (masked out of a compare);
+    // observers that only follow the state can treat it as a step
+    virtual void on_unobserved(TapState state, bool tms, bool tdi) { on_step(state, tms, tdi, false); }
+};
+
+void jtag_add_step_observer(JtagStepObserver* observer);
+void jtag_remove_step_observer(JtagStepObserver* observer);
+// Instance 0's state for an out-of-range tap (jtag_device_tap of a disabled
+// HIF), whose shifts fail anyway
+TapState jtag_tracked_state(int tap = 0);
+
+// Single TCK step / fixed-TMS clock run through the backend and observers.
+// All mock and test code steps the TAP through these.
+void jtag_step(svBit tms, svBit tdi, svBit is_last, svBit* tdo);
+void jtag_clock(svBit tms, svBit tdi, int count);
+
+// Multiple TAP instances. Each HIF is wired to one instance (0 unless
+// assigned before djtg_enable); the djtg_* calls route to it. Instance 0 is
+// the primary TAP and the only one step observers see; the others have their
+// own tracked state.
+#define JTAG_MAX_TAPS 16
+int jtag_tap_count();
+int jtag_assign_tap(int hif, int tap);
+void jtag_step_on(int tap, svBit tms, svBit tdi, svBit is_last, svBit* tdo);
+// Instance an enabled HIF is wired to, or -1
+int jtag_device_tap(int hif);
+// Re-sync the tracked state after a backdoor load of the instance
+void jtag_load_tracked_state(int tap, TapState state, uint32_t instruction);
+void jtag_clock_on(int tap, svBit tms, svBit tdi, int count);
+
+// Instruction register cache. The mock follows every step to each TAP
+// instance's instruction register, so the loaded instruction is known
+// whichever way it was shifted in; it becomes unknown (-1) in
+// Test-Logic-Reset. jtag_load_instruction loads an instruction with one
+// bulk scan ending in Run-Test/Idle, or only returns to Run-Test/Idle when
+// it is already loaded, unless force is set. Resets the mock cannot see
+// (TRST, power cycles) must call jtag_ir_cache_invalidate.
+#define JTAG_IR_LENGTH 4
+struct JtagIrCacheStats {
+    uint64_t loads;
+    uint64_t skips;
+};
+int jtag_loaded_instruction(int tap);
+int jtag_load_instruction(int hif, uint32_t instruction, bool force = false);
+void jtag_ir_cache_invalidate(int hif);
+const JtagIrCacheStats& jtag_ir_cache_stats();
+
+// Bulk shift over raw packed TMS/TDI/TDO buffers (LSB-first per byte)
+int djtg_shift_bits(int hif, const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit);
+
+// JtagBulkBackend class
+// Optional transaction-level executor for whole djtg_shift_bits calls on
+// instance 0. shift() fills tdo (pre-cleared) with the bits the TAP shifts
+// out; the mock then replays the buffers to the tracked state and the step
+// observers, which see the same steps as with per-TCK stepping.
+class JtagBulkBackend {
+public:
+    uint64_t word_bits;     // TCK cycles executed as word-level register scans
+    uint64_t idle_bits;     // TCK cycles skipped in Run-Test/Idle or Pause
+    uint64_t step_bits;     // TCK cycles stepped individually
+
+    JtagBulkBackend() : word_bits(0), idle_bits(0), step_bits(0) {}
+    virtual ~JtagBulkBackend() {}
+    virtual void shift(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit) = 0;
+};
+
+// Null restores per-TCK stepping through jtag_step
+void jtag_set_bulk_backend(JtagBulkBackend* backend);
+JtagBulkBackend* jtag_bulk_backend();
+
+// Run-length path of per-TCK stepping on instance 0: stretches of at least
+// min_bits cycles with TMS and TDI both constant go to sv_jtag_run as one
+// call, which clocks them without per-bit inputs and returns TDO packed.
+// 0 disables the detection; -1 (the default) takes the threshold from the
+// path model, JTAG_RUN_MIN_BITS_DEFAULT until it has measured both paths.
+#define JTAG_RUN_MIN_BITS_DEFAULT 32
+struct JtagRunStats {
+    uint64_t runs;
+    uint64_t run_bits;
+};
+void jtag_set_run_min_bits(int min_bits);
+int jtag_run_min_bits();
+const JtagRunStats& jtag_run_stats();
+
+// Execution path of djtg_shift_bits on instance 0. JTAG_PATH_AUTO (the
+// default) lets the path model pick per transfer; STEP, VECTOR or BULK
+// pins one (BULK only while a backend is set).
+void jtag_set_shift_path(JtagShiftPath path);
+JtagPathModel& jtag_path_model();
+
+// Bulk shift with in-backend TDO compare. Masked bits are compared against
+// expected where TDO is produced (in the testbench, or in the native
+// model's stepping loop); only the outcome comes back, never the TDO
+// stream. With JTAG_EXPECT_ABORT the shift stops window_bits (at least one)
+// after the first mismatch and the TAP stays in the state reached, so the
+// caller has to navigate out of it. Step observers see expected TDO on
+// masked bits (inverted at the first mismatch) and 0 elsewhere.
+#define JTAG_EXPECT_ABORT       1
+#define JTAG_EXPECT_WINDOW_MAX  64
+struct JtagExpectResult {
+    int pass;                // TRUE when every compared bit matched
+    int first_mismatch;      // Bit index, -1 when none
+    int mismatches;          // Differing bits among those shifted
+    int bits_shifted;        // cbit unless aborted
+    int window_bits;         // Actual TDO from first_mismatch on
+    uint64_t window;
+};
+int djtg_shift_expect(int hif, const uint8_t* tms, const uint8_t* tdi, const uint8_t* expected,
+                      const uint8_t* mask, int cbit, int flags, int window_bits, JtagExpectResult* result);
+
+// Compare loop of djtg_shift_expect for backends without a testbench task;
+// step clocks one TCK and returns TDO. Like the task, it serves the
+// transfer in progress on instance 0.
+void jtag_expect_run(const std::function<bool(bool tms, bool tdi)>& step, int cbit, bool abort_on_mismatch,
+                     int window_bits, int* first_mismatch, int* mismatches, int* steps);
+
+// Bulk shift returning only the TDO bits inside the capture windows, packed
+// LSB-first one window after another. Windows must be sorted, must not
+// overlap and must lie within cbit. Bits outside the windows reach step
+// observers as unobserved.
+struct JtagCaptureWindow {
+    int offset;
+    int length;
+};
+int djtg_shift_capture(int hif, const uint8_t* tms, const uint8_t* tdi, int cbit,
+                       const JtagCaptureWindow* windows, int window_count, uint8_t* packed);
+
+// Capture loop of djtg_shift_capture for backends without a testbench task
+// (instance 0's transfer in progress)
+void jtag_capture_run(const std::function<bool(bool tms, bool tdi)>& step, int cbit);
+
+// Adapter/USB cost model fed by every djtg_* call that reaches the adapter
+UsbAdapterModel& djtg_usb_model();
 
 // SV-exported DPI functions/tasks implemented in SystemVerilog TB
 extern "C" {
@@ -65,6 +231,17 @@ extern "C" {
     svBit sv_get_tdo();
     void sv_wait_cycles(int cycles);
     void sv_jtag_step(svBit tms, svBit tdi, svBit is_last, svBit* tdo_out);
+    void sv_jtag_clock(svBit tms, svBit tdi, int count);
+    long long sv_get_time_ps();
+    int sv_get_tap_count();
+    svBit sv_get_tdo_idx(int tap);
+    void sv_drive_jtag_pins_idx(int tap, svBit tck_val, svBit tms_val, svBit tdi_val);
+    void sv_jtag_step_idx(int tap, svBit tms, svBit tdi, svBit is_last, svBit* tdo_out);
+    void sv_jtag_clock_idx(int tap, svBit tms, svBit tdi, int count);
+    void sv_jtag_shift_expect(int cbit, svBit abort_on_mismatch, int window_bits, int* first_mismatch,
+                              int* mismatches, int* steps);
+    void sv_jtag_shift_capture(int cbit);
+    void sv_jtag_run(svBit tms, svBit tdi, int count, svBit sample_tdo);
 }
 
 // Core Digilent JTAG API implementation
@@ -79,10 +256,21 @@ extern "C" {
                               const svOpenArrayHandle tdi_data,
                               const svOpenArrayHandle tdo_data,
                               int cbit, svBit overlap);
+    DJTG_EXPORT int djtg_clock_tck(int hif, svBit tms, svBit tdi, int cckt, svBit overlap);
     DJTG_EXPORT int djtg_set_tms_tdi_tck(int hif, svBit tms, svBit tdi, svBit tck);
     DJTG_EXPORT int djtg_get_tms_tdi_tdo_tck(int hif, svBit* tms, svBit* tdi, svBit* tdo, svBit* tck);
     DJTG_EXPORT int djtg_set_speed(int hif, int freq_req, int* freq_set);
     DJTG_EXPORT int djtg_get_speed(int hif, int* freq_cur);
+    DJTG_EXPORT int djtg_put_tms_tdi_bits_windows(int hif, const svOpenArrayHandle tms_data,
+                                  const svOpenArrayHandle tdi_data,
+                                  const svOpenArrayHandle window_data, int window_count,
+                                  const svOpenArrayHandle tdo_data, int cbit);
+
+    // Stimulus words, failure window and packed capture for sv_jtag_shift_expect
+    // and sv_jtag_shift_capture
+    DJTG_EXPORT void jtag_expect_chunk(int index, int* tms, int* tdi, int* expected, int* mask);
+    DJTG_EXPORT void jtag_expect_window_bit(int offset, svBit tdo);
+    DJTG_EXPORT void jtag_capture_word(int index, int word);
 	
 	// Tests
     DJTG_EXPORT int test_counter_idcode(int hif);
@@ -94,9 +282,42 @@ extern "C" {
     DJTG_EXPORT int test_instruction_register_capture(int hif);
     DJTG_EXPORT int test_complex_instruction_sequence(int hif);
     DJTG_EXPORT int test_tap_state_transitions(int hif);
+    DJTG_EXPORT int test_scan_program_cache(int hif);
+    DJTG_EXPORT int test_steady_state_allocations(int hif);
+    DJTG_EXPORT int test_scan_pipeline(int hif);
+    DJTG_EXPORT int test_runtest_idle_clocking(int hif);
+    DJTG_EXPORT int test_riscv_dmi(int hif);
+    DJTG_EXPORT int test_adiv5_dap(int hif);
+    DJTG_EXPORT int test_spi_flash(int hif);
+    DJTG_EXPORT int test_pin_waveform(int hif);
+    DJTG_EXPORT int test_stapl_player(int hif);
+    DJTG_EXPORT int test_tdo_hash(int hif);
+    DJTG_EXPORT int test_functional_coverage(int hif);
+    DJTG_EXPORT int test_coverage_generation(int hif);
+    DJTG_EXPORT int test_multi_tap(int hif);
+    DJTG_EXPORT int test_usb_adapter_model(int hif);
+    DJTG_EXPORT int test_tlm_backend(int hif);
+    DJTG_EXPORT int test_hybrid_handoff(int hif);
+    DJTG_EXPORT int test_ir_cache(int hif);
+    DJTG_EXPORT int test_access_reordering(int hif);
+    DJTG_EXPORT int test_bsr_shadow(int hif);
+    DJTG_EXPORT int test_shift_expect(int hif);
+    DJTG_EXPORT int test_sparse_capture(int hif);
+    DJTG_EXPORT int test_streaming(int hif);
+    DJTG_EXPORT int test_run_length(int hif);
+    DJTG_EXPORT int test_path_crossover(int hif);
     
     // Main test runner
     DJTG_EXPORT void run_counter_jtag_tests();
+    
+    // Session on an additional TAP instance (one concurrent call per instance)
+    DJTG_EXPORT void run_tap_session(int tap);
 }
 
+// Failed test count from the last run_counter_jtag_tests call
+int counter_jtag_tests_failed();
+
+// Failed run_tap_session calls so far
+int tap_sessions_failed();
+
 #endif // DIGILENT_JTAG_MOCK_H
@@ -0,0 +1,168 @@
+// jtag_access_batch.cpp
+// Reordering of independent register accesses into one fused scan program
+
+#include <cstdio>
+#include "jtag_access_batch.h"
+
+AccessBatch::AccessBatch()
+    : ir_loads(0), program_bits(0), in_order_ir_loads(0), in_order_bits(0) {
+}
+
+void AccessBatch::clear() {
+    accesses.clear();
+    schedule.clear();
+}
+
+int AccessBatch::add(uint32_t instruction, uint64_t value, int bits, const std::vector<int>& after) {
+    JtagAccess access;
+    access.instruction = instruction;
+    access.value = value;
+    access.bits = bits;
+    access.after = after;
+    access.result = 0;
+    access.order = -1;
+    accesses.push_back(access);
+    return (int)accesses.size() - 1;
+}
+
+// Accesses under the instruction of start that could run back to back from
+// start once it is loaded, given what is already done
+int AccessBatch::chain_length(int start, const std::vector<bool>& done) const {
+    std::vector<bool> trial = done;
+    int length = 0;
+    for (int i = start; i < (int)accesses.size(); i++) {
+        if (trial[i] || accesses[i].instruction != accesses[start].instruction) {
+            continue;
+        }
+        for (size_t d = 0; d < accesses[i].after.size(); d++) {
+            if (!trial[accesses[i].after[d]]) {
+                return length;
+            }
+        }
+        trial[i] = true;
+        length++;
+    }
+    return length;
+}
+
+// List scheduling: stay on the loaded instruction while it has ready
+// accesses, otherwise switch to the instruction whose pending accesses can
+// run the longest without another IR load (earliest access on a tie)
+void AccessBatch::plan(int loaded) {
+    int count = (int)accesses.size();
+    std::vector<bool> done(count, false);
+    std::vector<int> last_same(count, -1);
+    for (int i = 0; i < count; i++) {
+        for (int j = i - 1; j >= 0; j--) {
+            if (accesses[j].instruction == accesses[i].instruction) {
+                last_same[i] = j;
+                break;
+            }
+        }
+    }
+
+    schedule.clear();
+    int current = loaded;
+    while ((int)schedule.size() < count) {
+        std::vector<int> ready;
+        for (int i = 0; i < count; i++) {
+            if (done[i] || (last_same[i] >= 0 && !done[last_same[i]])) {
+                continue;
+            }
+            bool blocked = false;
+            for (size_t d = 0; d < accesses[i].after.size() && !blocked; d++) {
+                blocked = !done[accesses[i].after[d]];
+            }
+            if (!blocked) {
+                ready.push_back(i);
+            }
+        }
+
+        int pick = -1;
+        for (size_t r = 0; r < ready.size() && pick < 0; r++) {
+            if ((int)accesses[ready[r]].instruction == current) {
+                pick = ready[r];
+            }
+        }
+        if (pick < 0) {
+            int best = 0;
+            for (size_t r = 0; r < ready.size(); r++) {
+                int length = chain_length(ready[r], done);
+                if (length > best) {
+                    best = length;
+                    pick = ready[r];
+                }
+            }
+        }
+        done[pick] = true;
+        current = (int)accesses[pick].instruction;
+        schedule.push_back(pick);
+    }
+}
+
+// Returns the number of IR loads; record keeps the DR field of each access
+int AccessBatch::compile(const std::vector<int>& sequence, int loaded, TapState start, bool record) {
+    program.clear(start);
+    fields.assign(accesses.size(), -1);
+    int loads = 0;
+    int current = loaded;
+    for (size_t s = 0; s < sequence.size(); s++) {
+        const JtagAccess& access = accesses[sequence[s]];
+        if ((int)access.instruction != current) {
+            program.shift_ir(access.instruction, JTAG_IR_LENGTH);
+            current = (int)access.instruction;
+            loads++;
+        }
+        int field = program.shift_dr(access.value, access.bits);
+        if (record) {
+            fields[sequence[s]] = field;
+        }
+    }
+    program.goto_state(RUN_TEST_IDLE);
+    return loads;
+}
+
+int AccessBatch::run(int hif) {
+    for (size_t i = 0; i < accesses.size(); i++) {
+        for (size_t d = 0; d < accesses[i].after.size(); d++) {
+            if (accesses[i].after[d] < 0 || accesses[i].after[d] >= (int)i) {
+                printf("ACCESS_BATCH: Access %d depends on %d, which is not earlier\n", (int)i,
+                       accesses[i].after[d]);
+                fflush(stdout);
+                return FALSE;
+            }
+        }
+    }
+    int tap = jtag_device_tap(hif);
+    if (tap < 0) {
+        printf("ACCESS_BATCH: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    int loaded = jtag_loaded_instruction(tap);
+    TapState start = jtag_tracked_state(tap);
+
+    // Host order, for the statistics only
+    std::vector<int> in_order(accesses.size());
+    for (size_t i = 0; i < accesses.size(); i++) {
+        in_order[i] = (int)i;
+    }
+    in_order_ir_loads = compile(in_order, loaded, start, false);
+    in_order_bits = program.bit_count;
+
+    plan(loaded);
+    ir_loads = compile(schedule, loaded, start, true);
+    program_bits = program.bit_count;
+
+    tdo.assign((program.bit_count + 7) / 8, 0);
+    if (!djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count)) {
+        return FALSE;
+    }
+    for (size_t s = 0; s < schedule.size(); s++) {
+        JtagAccess& access = accesses[schedule[s]];
+        const ScanField& field = program.fields[fields[schedule[s]]];
+        access.result = scan_extract_bits(tdo.data(), field.offset, field.length);
+        access.order = (int)s;
+    }
+    return TRUE;
+}
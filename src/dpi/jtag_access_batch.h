@@ -0,0 +1,67 @@
+// jtag_access_batch.h
+// Reordering of independent register accesses into one fused scan program
+
+#ifndef JTAG_ACCESS_BATCH_H
+#define JTAG_ACCESS_BATCH_H
+
+#include <vector>
+#include <cstdint>
+#include "digilent_jtag_mock.h"
+
+// One DR access: bits of value shifted in under instruction, the captured
+// bits returned in result
+struct JtagAccess {
+    uint32_t instruction;
+    uint64_t value;
+    int bits;                    // 1..64
+    std::vector<int> after;      // Accesses that must complete first
+    uint64_t result;
+    int order;                   // Position in the executed program
+};
+
+// AccessBatch class
+// Collects DR accesses in host order and executes them as one scan program
+// ordered to minimize IR reloads: accesses under the loaded instruction go
+// first, then the instruction whose pending accesses can run the longest
+// without another IR load is loaded next.
+// An access runs only after everything it lists in `after` and after every
+// earlier access under the same instruction, so sequences on one register
+// (a PRELOAD followed by a capture) keep their meaning. Consecutive DR scans
+// chain Exit1-DR -> Update-DR -> Select-DR-Scan without visiting
+// Run-Test/Idle; the program ends there.
+//
+// Accesses must be independent apart from the declared dependencies:
+// reordering is only correct when no access relies on a side effect of an
+// earlier one under another instruction that it does not list.
+class AccessBatch {
+public:
+    std::vector<JtagAccess> accesses;
+
+    // Statistics of the last run()
+    int ir_loads;
+    int program_bits;
+    int in_order_ir_loads;       // The same accesses in host order
+    int in_order_bits;
+
+    AccessBatch();
+
+    void clear();
+
+    // Returns the access index; after lists earlier indices only
+    int add(uint32_t instruction, uint64_t value, int bits, const std::vector<int>& after = std::vector<int>());
+
+    // Schedules, executes with a single djtg_shift_bits and fills results
+    int run(int hif);
+
+private:
+    ScanProgram program;
+    std::vector<uint8_t> tdo;
+    std::vector<int> schedule;
+    std::vector<int> fields;
+
+    void plan(int loaded);
+    int chain_length(int start, const std::vector<bool>& done) const;
+    int compile(const std::vector<int>& sequence, int loaded, TapState start, bool record);
+};
+
+#endif // JTAG_ACCESS_BATCH_H
@@ -0,0 +1,25 @@
+// jtag_bsr_layout.h
+// Boundary scan cell positions of jtag_boundary_scan_register.sv (N = 4)
+
+#ifndef JTAG_BSR_LAYOUT_H
+#define JTAG_BSR_LAYOUT_H
+
+#define BSR_COUNTER_N         4
+
+// Cell 0: up_down input (drives the counter direction in EXTEST)
+#define BSR_UP_DOWN_CELL      0
+// Cells 1..N: count output data, N+1..2N: count output enables
+#define BSR_COUNT_DATA_CELL   1
+#define BSR_COUNT_OE_CELL     (1 + BSR_COUNTER_N)
+// Cells 2N+1..2N+4: SPI flash pins
+#define BSR_SPI_CS_N_CELL     (1 + 2 * BSR_COUNTER_N)
+#define BSR_SPI_SCK_CELL      (BSR_SPI_CS_N_CELL + 1)
+#define BSR_SPI_MOSI_CELL     (BSR_SPI_CS_N_CELL + 2)
+#define BSR_SPI_MISO_CELL     (BSR_SPI_CS_N_CELL + 3)
+
+#define BSR_WIDTH             (BSR_SPI_CS_N_CELL + 4)
+
+#define BSR_COUNT_MASK        (((1u << BSR_COUNTER_N) - 1) << BSR_COUNT_DATA_CELL)
+#define BSR_COUNT_OE_MASK     (((1u << BSR_COUNTER_N) - 1) << BSR_COUNT_OE_CELL)
+
+#endif // JTAG_BSR_LAYOUT_H
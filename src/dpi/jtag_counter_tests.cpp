@@ -5,7 +5,26 @@
 #include <vector>
 #include <bitset>
 #include <cstdio>
+#include <random>
+#include <cstdlib>
+#include <cstring>
 #include "digilent_jtag_mock.h"
+#include "jtag_scan_cache.h"
+#include "jtag_scan_pipeline.h"
+#include "riscv_dmi.h"
+#include "adiv5_dap.h"
+#include "spi_flash_programmer.h"
+#include "jtag_bsr_layout.h"
+#include "bsr_pin_engine.h"
+#include "stapl_player.h"
+#include "jtag_tdo_hash.h"
+#include "jtag_coverage.h"
+#include "jtag_coverage_gen.h"
+#include "jtag_native_tlm.h"
+#include "jtag_hybrid.h"
+#include "jtag_access_batch.h"
+#include "bsr_shadow.h"
+#include "jtag_stream.h"
 #include "svdpi.h"
 
 // Helper function to shift data through a register (LSB-first)
@@ -28,7 +47,7 @@ uint32_t shift_data_register(int hif, uint32_t data, int bit_count, bool is_inst
         
         // Perform a full JTAG step inside SV for timing
         svBit tdo_bit = 0;
-        sv_jtag_step(is_last ? 1 : 0, bit_val, is_last, &tdo_bit);
+        jtag_step(is_last ? 1 : 0, bit_val, is_last, &tdo_bit);
         
         if (tdo_bit) {
             result |= (1 << i);
@@ -63,7 +82,7 @@ uint32_t shift_data_register_msb_first(int hif, uint32_t data, int bit_count) {
         
         // Perform a full JTAG step inside SV for timing
         svBit tdo_bit = 0;
-        sv_jtag_step(is_last ? 1 : 0, bit_val, is_last, &tdo_bit);
+        jtag_step(is_last ? 1 : 0, bit_val, is_last, &tdo_bit);
         
         if (tdo_bit) {
             result |= (1 << (bit_count - 1 - i));
@@ -165,12 +184,12 @@ int test_boundary_scan_sample(int hif) {
     // Navigate to Shift-DR
     navigate_to_shift_dr();
     
-    // Shift out Boundary Scan Register (9 bits)
-    uint32_t bsr_data = shift_data_register(hif, 0, 9);
+    // Shift out Boundary Scan Register (BSR_WIDTH bits)
+    uint32_t bsr_data = shift_data_register(hif, 0, BSR_WIDTH);
     
     // Display BSR contents
     printf("Boundary Scan Register (LSB first): ");
-    for (int i = 0; i < 9; i++) {
+    for (int i = 0; i < BSR_WIDTH; i++) {
         printf("%d", ((bsr_data >> i) & 1));
     }
     printf("\n");
@@ -185,6 +204,9 @@ int test_boundary_scan_sample(int hif) {
     printf("  up_down input (bit 0): %d\n", up_down);
     printf("  count outputs (bits 1-4): %04x\n", count);
     printf("  count output enables (bits 5-8): %04x\n", count_oe);
+    printf("  SPI cs_n/sck/mosi/miso (bits 9-12): %d%d%d%d\n",
+           (bsr_data >> BSR_SPI_CS_N_CELL) & 1, (bsr_data >> BSR_SPI_SCK_CELL) & 1,
+           (bsr_data >> BSR_SPI_MOSI_CELL) & 1, (bsr_data >> BSR_SPI_MISO_CELL) & 1);
     fflush(stdout);
     
     // Exit to Run-Test-Idle
@@ -220,7 +242,7 @@ int test_boundary_scan_sample(int hif) {
 // This test:
 // 1. Loads a test pattern into the BSR via EXTEST instruction
 // 2. Updates the BSR to drive external pins with the test pattern
-// 3. Switches to SAMPLE mode to read back the driven pin states
+// 3. Captures the BSR again under EXTEST to read back the driven pin states
 // 4. Validates that the BSR correctly drove the external pins
 int test_boundary_scan_extest(int hif) {
     printf("\n=== Testing Boundary Scan EXTEST ===\n");
@@ -241,16 +263,18 @@ int test_boundary_scan_extest(int hif) {
     // Navigate to Shift-DR
     navigate_to_shift_dr();
     
-    // Load test pattern into BSR (correct bit mapping: bit0=up_down, bits1-4=count, bits5-8=count_oe)
-    uint32_t test_pattern = 0x1AF; // 110101111 binary (count_oe=1101, count=0111, up_down=1)
+    // Load test pattern into BSR (correct bit mapping: bit0=up_down, bits1-4=count, bits5-8=count_oe,
+    // bits 9-12=SPI pins). MOSI is driven high with the flash kept deselected,
+    // so the readback can tell the driven value from the idle one.
+    uint32_t test_pattern = 0x1AF | (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_MOSI_CELL); // count_oe=1101, count=0111, up_down=1
     printf("Loading test pattern into BSR: ");
-    for (int i = 0; i < 9; i++) {
+    for (int i = 0; i < BSR_WIDTH; i++) {
         printf("%d", ((test_pattern >> i) & 1));
     }
     printf("\n");
     fflush(stdout);
     
-    shift_data_register(hif, test_pattern, 9);
+    shift_data_register(hif, test_pattern, BSR_WIDTH);
     
     // Exit to Run-Test-Idle
     exit_to_run_test_idle();
@@ -269,68 +293,69 @@ int test_boundary_scan_extest(int hif) {
     // Wait a few cycles for BSR update to propagate to pins
     wait_cycles(5);
     
-    // In EXTEST mode, we need to verify that the BSR update actually drives the external pins
-    // We can do this by switching back to SAMPLE mode and reading the BSR again
-    printf("Verifying EXTEST by switching to SAMPLE mode and reading BSR...\n");
+    // Read the BSR back while EXTEST is still selected: Capture-DR samples the
+    // driven up_down pin and SPI outputs, so those cells show the update
+    // register. The count cells capture the core counter and the enable cells
+    // a constant 1, so they do not depend on the pattern. The counter is read
+    // by backdoor on both sides of Capture-DR: at most one count edge falls
+    // in between, so the captured count is one of the two. Shifting the
+    // pattern back in keeps the pins where they are on the next Update-DR.
+    printf("Verifying EXTEST by capturing the driven pins...\n");
     fflush(stdout);
-    
-    // Switch to SAMPLE mode to read back the pin states
-    navigate_to_shift_ir();
-    instruction = 0x2; // SAMPLE
-    printf("Shifting SAMPLE instruction: 0x%x\n", instruction);
-    fflush(stdout);
-    shift_data_register(hif, instruction, 4, true);
-    exit_to_run_test_idle();
-    
-    // Navigate to Shift-DR to read BSR
+    int tap = jtag_device_tap(hif);
+    JtagTapSnapshot before_capture, after_capture;
+    bool counter_read = jtag_backdoor_read(tap, &before_capture) == TRUE;
     navigate_to_shift_dr();
-    uint32_t bsr_readback_raw = shift_data_register(hif, 0, 9);
-    printf("DEBUG: bsr_readback_raw = 0x%x\n", bsr_readback_raw);
-    // Reverse bits since BSR shifts MSB-first but shift_data_register reads LSB-first
-    uint32_t bsr_readback = 0;
-    for (int i = 0; i < 9; i++) {
-        if (bsr_readback_raw & (1 << i)) {
-            bsr_readback |= (1 << (8 - i));
-        }
-    }
-    printf("DEBUG: bsr_readback (after reversal) = 0x%x\n", bsr_readback);
+    counter_read = jtag_backdoor_read(tap, &after_capture) && counter_read;
+    uint32_t bsr_readback = shift_data_register(hif, test_pattern, BSR_WIDTH);
     exit_to_run_test_idle();
     
-    // Decode readback BSR contents (correct bit mapping)
-    bool readback_up_down = bsr_readback & 0x1;         // Bit 0
-    int readback_count = (bsr_readback >> 1) & 0xF;     // Bits 1-4
-    int readback_count_oe = (bsr_readback >> 5) & 0xF;  // Bits 5-8
+    // Decode readback BSR contents (cell layout from jtag_bsr_layout.h, LSB first)
+    bool readback_up_down = (bsr_readback >> BSR_UP_DOWN_CELL) & 1;
+    int readback_count = (bsr_readback & BSR_COUNT_MASK) >> BSR_COUNT_DATA_CELL;
+    int readback_count_oe = (bsr_readback & BSR_COUNT_OE_MASK) >> BSR_COUNT_OE_CELL;
+    uint32_t spi_outputs = (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_SCK_CELL) | (1u << BSR_SPI_MOSI_CELL);
     
     printf("BSR readback after EXTEST:\n");
-    printf("  Raw BSR data: 0x%x (binary: ", bsr_readback);
-    for (int i = 8; i >= 0; i--) {
+    printf("  Raw BSR data: 0x%x (LSB first: ", bsr_readback);
+    for (int i = 0; i < BSR_WIDTH; i++) {
         printf("%d", (bsr_readback >> i) & 1);
     }
     printf(")\n");
-    printf("  up_down = %d (expected %d)\n", readback_up_down, (test_pattern & 1));
-    printf("  count = 0x%x (expected 0x%x)\n", readback_count, ((test_pattern >> 1) & 0xF));
-    printf("  count_oe = 0x%x (expected 0x%x)\n", readback_count_oe, ((test_pattern >> 5) & 0xF));
+    printf("  up_down = %d (expected %d)\n", readback_up_down, (test_pattern >> BSR_UP_DOWN_CELL) & 1);
+    printf("  count = 0x%x (core counter 0x%x..0x%x)\n", readback_count, before_capture.count, after_capture.count);
+    printf("  count_oe = 0x%x (expected 0x%x)\n", readback_count_oe, BSR_COUNT_OE_MASK >> BSR_COUNT_OE_CELL);
+    printf("  SPI cs_n/sck/mosi = %d%d%d (expected %d%d%d)\n",
+           (bsr_readback >> BSR_SPI_CS_N_CELL) & 1, (bsr_readback >> BSR_SPI_SCK_CELL) & 1,
+           (bsr_readback >> BSR_SPI_MOSI_CELL) & 1, (test_pattern >> BSR_SPI_CS_N_CELL) & 1,
+           (test_pattern >> BSR_SPI_SCK_CELL) & 1, (test_pattern >> BSR_SPI_MOSI_CELL) & 1);
     printf("  Test pattern was: 0x%x\n", test_pattern);
     fflush(stdout);
     
     // Validate EXTEST results
     bool test_passed = true;
-    bool expected_up_down = test_pattern & 1;
-    int expected_count = (test_pattern >> 1) & 0xF;
-    int expected_count_oe = (test_pattern >> 5) & 0xF;
+    bool expected_up_down = (test_pattern >> BSR_UP_DOWN_CELL) & 1;
     
     if (readback_up_down != expected_up_down) {
         printf("FAIL: EXTEST test FAILED - up_down mismatch: expected %d, got %d\n", expected_up_down, readback_up_down);
         test_passed = false;
     }
     
-    if (readback_count != expected_count) {
-        printf("FAIL: EXTEST test FAILED - count mismatch: expected 0x%x, got 0x%x\n", expected_count, readback_count);
+    if (!counter_read || ((uint32_t)readback_count != before_capture.count &&
+                          (uint32_t)readback_count != after_capture.count)) {
+        printf("FAIL: EXTEST test FAILED - count cells should capture the core counter (0x%x or 0x%x), got 0x%x\n",
+               before_capture.count, after_capture.count, readback_count);
         test_passed = false;
     }
     
-    if (readback_count_oe != expected_count_oe) {
-        printf("FAIL: EXTEST test FAILED - count_oe mismatch: expected 0x%x, got 0x%x\n", expected_count_oe, readback_count_oe);
+    if ((uint32_t)readback_count_oe != BSR_COUNT_OE_MASK >> BSR_COUNT_OE_CELL) {
+        printf("FAIL: EXTEST test FAILED - count_oe capture should be all ones, got 0x%x\n", readback_count_oe);
+        test_passed = false;
+    }
+    
+    if ((bsr_readback & spi_outputs) != (test_pattern & spi_outputs)) {
+        printf("FAIL: EXTEST test FAILED - SPI outputs mismatch: expected 0x%x, got 0x%x\n",
+               (test_pattern & spi_outputs) >> BSR_SPI_CS_N_CELL, (bsr_readback & spi_outputs) >> BSR_SPI_CS_N_CELL);
         test_passed = false;
     }
     
@@ -389,7 +414,7 @@ int test_bypass(int hif) {
     for (int i = 0; i < 8; i++) {
         svBit tdo_bit = 0;
         bool tdi_bit = (test_pattern >> (7 - i)) & 1;  // MSB-first
-        sv_jtag_step(0, tdi_bit, 0, &tdo_bit);
+        jtag_step(0, tdi_bit, 0, &tdo_bit);
         received_data |= (tdo_bit ? 1 : 0) << (7 - i);  // MSB-first result
         
         printf("Bit %d: TDI=%d, TDO=%d\n", i, tdi_bit, tdo_bit);
@@ -453,15 +478,15 @@ int test_preload_instruction(int hif) {
     
     // Load test data into BSR (PRELOAD function)
     // Use MSB-first shifting to match RTL BSR implementation
-    uint32_t test_data = 0x1A5; // 110100101 - test pattern
-    printf("Loading test data into BSR: 0x%03X\n", test_data);
+    uint32_t test_data = 0x1A5 | (1u << BSR_SPI_CS_N_CELL); // 110100101 - test pattern, flash deselected
+    printf("Loading test data into BSR: 0x%04X\n", test_data);
     fflush(stdout);
     
     // Shift data MSB-first to match RTL BSR shifting
-    for (int i = 0; i < 9; i++) {
+    for (int i = 0; i < BSR_WIDTH; i++) {
         svBit tdo_bit = 0;
-        bool tdi_bit = (test_data >> (8 - i)) & 1;  // MSB-first
-        sv_jtag_step(0, tdi_bit, 0, &tdo_bit);
+        bool tdi_bit = (test_data >> (BSR_WIDTH - 1 - i)) & 1;  // MSB-first
+        jtag_step(0, tdi_bit, 0, &tdo_bit);
     }
     
     // Exit to Run-Test-Idle (this should update the BSR)
@@ -516,7 +541,7 @@ int test_unknown_instruction(int hif) {
     for (int i = 0; i < 8; i++) {
         svBit tdo_bit = 0;
         bool tdi_bit = (test_pattern >> (7 - i)) & 1;  // MSB-first
-        sv_jtag_step(0, tdi_bit, 0, &tdo_bit);
+        jtag_step(0, tdi_bit, 0, &tdo_bit);
         received_data |= (tdo_bit ? 1 : 0) << (7 - i);  // MSB-first result
     }
     
@@ -554,7 +579,7 @@ int test_instruction_register_capture(int hif) {
     uint32_t captured_ir = 0;
     for (int i = 0; i < 4; i++) {
         svBit tdo_bit = 0;
-        sv_jtag_step(0, 0, 0, &tdo_bit);
+        jtag_step(0, 0, 0, &tdo_bit);
         captured_ir |= (tdo_bit ? 1 : 0) << (3 - i);  // MSB-first result
     }
     
@@ -611,7 +636,7 @@ int test_complex_instruction_sequence(int hif) {
     shift_data_register(hif, 0x2, 4, true); // SAMPLE
     exit_to_run_test_idle();
     navigate_to_shift_dr();
-    uint32_t sample_data = shift_data_register(hif, 0, 9);
+    uint32_t sample_data = shift_data_register(hif, 0, BSR_WIDTH);
     exit_to_run_test_idle();
     
     if ((sample_data & 0x1) == 1 && ((sample_data >> 5) & 0xF) == 0xF) {
@@ -626,7 +651,7 @@ int test_complex_instruction_sequence(int hif) {
     shift_data_register(hif, 0x0, 4, true); // EXTEST
     exit_to_run_test_idle();
     navigate_to_shift_dr();
-    shift_data_register(hif, 0x1AF, 9); // Load test pattern
+    shift_data_register(hif, 0x1AF | (1u << BSR_SPI_CS_N_CELL), BSR_WIDTH); // Load test pattern
     exit_to_run_test_idle();
     printf("  EXTEST: Data loaded\n");
     sequence_passed++;
@@ -639,7 +664,7 @@ int test_complex_instruction_sequence(int hif) {
     uint32_t bypass_data = 0;
     for (int i = 0; i < 4; i++) {
         svBit tdo_bit = 0;
-        sv_jtag_step(0, 1, 0, &tdo_bit);
+        jtag_step(0, 1, 0, &tdo_bit);
         bypass_data |= (tdo_bit ? 1 : 0) << i;
     }
     exit_to_run_test_idle();
@@ -676,25 +701,25 @@ int test_tap_state_transitions(int hif) {
     // Send 5 TMS=1 to ensure reset
     for (int i = 0; i < 5; i++) {
         svBit tdo_bit = 0;
-        sv_jtag_step(1, 0, 0, &tdo_bit);  // TMS=1, TDI=0
+        jtag_step(1, 0, 0, &tdo_bit);  // TMS=1, TDI=0
     }
     
     // Go to Run-Test-Idle (TMS=0)
     svBit tdo_bit = 0;
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     
     // Test Shift-IR sequence
     printf("Testing Shift-IR sequence...\n");
     fflush(stdout);
     
     // Run-Test-Idle -> Select-DR-Scan (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Select-DR-Scan -> Select-IR-Scan (TMS=1)  
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Select-IR-Scan -> Capture-IR (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     // Capture-IR -> Shift-IR (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     
     // Now we should be in Shift-IR state
     printf("Shift-IR state reached\n");
@@ -705,18 +730,18 @@ int test_tap_state_transitions(int hif) {
     fflush(stdout);
     
     // Exit Shift-IR -> Exit1-IR (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Exit1-IR -> Update-IR (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Update-IR -> Run-Test-Idle (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     
     // Run-Test-Idle -> Select-DR-Scan (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Select-DR-Scan -> Capture-DR (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     // Capture-DR -> Shift-DR (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     
     // Now we should be in Shift-DR state
     printf("Shift-DR state reached\n");
@@ -724,23 +749,1876 @@ int test_tap_state_transitions(int hif) {
     
     // Return to Run-Test-Idle
     // Exit Shift-DR -> Exit1-DR (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Exit1-DR -> Update-DR (TMS=1)
-    sv_jtag_step(1, 0, 0, &tdo_bit);
+    jtag_step(1, 0, 0, &tdo_bit);
     // Update-DR -> Run-Test-Idle (TMS=0)
-    sv_jtag_step(0, 0, 0, &tdo_bit);
+    jtag_step(0, 0, 0, &tdo_bit);
     
     printf("PASS: TAP state transition test PASSED\n");
     fflush(stdout);
     return 1;
 }
 
+// Test scan-program cache
+// Compiles an IDCODE read into a packed TMS/TDI program, stores it in the
+// on-disk cache and executes it from the memory-mapped file. A second lookup
+// must hit the cache and produce the same IDCODE, and the cached program
+// must be refused while the TAP is away from its start state.
+int test_scan_program_cache(int hif) {
+    printf("\n=== Testing Scan Program Cache ===\n");
+    fflush(stdout);
+    
+    ScanProgramCache cache(scan_cache_default_dir());
+    uint64_t key = scan_cache_key("test_scan_program_cache", "idcode_read");
+    
+    // Compile function: IDCODE instruction, 32-bit DR read, back to Run-Test-Idle
+    auto compile = [](ScanProgram& program) {
+        program.shift_ir(0x1, 4);
+        program.shift_dr((uint64_t)0, 32);
+        program.goto_state(RUN_TEST_IDLE);
+    };
+    
+    uint32_t idcodes[2] = { 0, 0 };
+    for (int pass = 0; pass < 2; pass++) {
+        MappedScanProgram program;
+        if (!cache.load_or_compile(key, compile, program)) {
+            printf("FAIL: Scan cache test FAILED - could not load or compile program\n");
+            fflush(stdout);
+            return 0;
+        }
+        
+        std::vector<uint8_t> tdo((program.bit_count() + 7) / 8);
+        if (!run_mapped_scan_program(hif, program, tdo.data())) {
+            printf("FAIL: Scan cache test FAILED - bulk transfer rejected\n");
+            fflush(stdout);
+            return 0;
+        }
+        const ScanField& field = program.field(1);
+        idcodes[pass] = (uint32_t)scan_extract_bits(tdo.data(), field.offset, field.length);
+        printf("Pass %d: %d-bit program, IDCODE = 0x%08X\n", pass, program.bit_count(), idcodes[pass]);
+        fflush(stdout);
+    }
+    
+    // A program compiled from Run-Test/Idle must not run from Select-DR-Scan;
+    // TMS 1, 1, 0 then returns through Test-Logic-Reset
+    MappedScanProgram cached;
+    uint8_t select_tms = 0x1, leave_tms = 0x3, zero_tdi = 0;
+    bool rejected = cache.load(key, cached) &&
+                    djtg_shift_bits(hif, &select_tms, &zero_tdi, nullptr, 1) &&
+                    !run_mapped_scan_program(hif, cached, nullptr) && jtag_tracked_state() == SELECT_DR_SCAN;
+    rejected = djtg_shift_bits(hif, &leave_tms, &zero_tdi, nullptr, 3) && rejected;
+    
+    printf("Scan Cache Analysis:\n");
+    printf("  Hits: %d, Misses: %d\n", cache.hits, cache.misses);
+    printf("  Wrong start state: %s\n", rejected ? "rejected" : "NOT REJECTED");
+    fflush(stdout);
+    
+    if (idcodes[0] == 0x12345678 && idcodes[1] == 0x12345678 && cache.hits >= 1 && rejected) {
+        printf("PASS: Scan cache test PASSED - Cached program executed correctly\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Scan cache test FAILED - Expected IDCODE 0x12345678 from both runs\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test steady-state allocations
+// Runs a BYPASS scan loop built in the session arena, plus the per-bit helper
+// path, and checks that no heap allocation happens once warmed up. The count
+// is only available in the allocation-check build (make alloc_check); other
+// builds verify the scans and skip the count.
+int test_steady_state_allocations(int hif) {
+    printf("\n=== Testing Steady-State Allocations ===\n");
+    fflush(stdout);
+    
+    SessionArena* arena = session_arena(hif);
+    if (!arena) {
+        printf("FAIL: Allocation test FAILED - no session arena for device %d\n", hif);
+        fflush(stdout);
+        return 0;
+    }
+    
+    const int iterations = 8;
+    long allocs_before = 0;
+    int scan_failures = 0;
+    
+    // Iteration 0 warms up the arena blocks and stdio buffers
+    for (int iter = 0; iter <= iterations; iter++) {
+        if (iter == 1) {
+            allocs_before = jtag_alloc_count();
+        }
+        
+        ArenaScope scope(arena);
+        ScanProgram program(RUN_TEST_IDLE, arena);
+        program.shift_ir(0xF, 4);   // BYPASS
+        int field = program.shift_dr((uint64_t)(0xA5 ^ iter), 8);
+        program.goto_state(RUN_TEST_IDLE);
+        
+        uint8_t* tdo = (uint8_t*)arena->allocate((program.bit_count + 7) / 8);
+        if (!djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo, program.bit_count)) {
+            scan_failures++;
+            continue;
+        }
+        
+        // BYPASS delays TDI by one bit: TDO bits 1..7 equal TDI bits 0..6
+        uint32_t tdo_bits = scan_extract_bits(tdo, program.fields[field].offset, 8);
+        if ((tdo_bits >> 1) != ((0xA5 ^ iter) & 0x7F)) {
+            scan_failures++;
+        }
+        
+        // Per-bit helper path on the same instruction
+        navigate_to_shift_dr();
+        shift_data_register(hif, 0x3, 2);
+        exit_to_run_test_idle();
+    }
+    
+    long allocs_after = jtag_alloc_count();
+    
+    printf("Allocation Analysis:\n");
+    printf("  Arena bytes reserved: %zu\n", arena->bytes_reserved());
+    printf("  Scan failures: %d\n", scan_failures);
+    if (allocs_before < 0) {
+        printf("  Heap allocation count: not compiled in (build with make alloc_check)\n");
+    } else {
+        printf("  Heap allocations on steady-state path: %ld\n", allocs_after - allocs_before);
+    }
+    fflush(stdout);
+    
+    if (scan_failures == 0 && allocs_after == allocs_before) {
+        printf("PASS: Allocation test PASSED - Steady-state shift path is allocation-free\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Allocation test FAILED - Steady-state shift path allocated or scans failed\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test pipelined scan execution
+// Runs a randomized BYPASS campaign through ScanPipeline: the worker thread
+// generates each 32-bit pattern and its expected TDO (input delayed by one
+// bit) while the simulator thread shifts the previous scan.
+int test_scan_pipeline(int hif) {
+    printf("\n=== Testing Pipelined Scan Execution ===\n");
+    fflush(stdout);
+    
+    const uint64_t scan_count = 32;
+    std::mt19937 pattern_gen(12345);
+    
+    auto generate = [&](uint64_t index, PipelinedScan& scan) -> bool {
+        if (index >= scan_count) {
+            return false;
+        }
+        ScanProgram& program = scan.program;
+        if (index == 0) {
+            program.shift_ir(0xF, 4);   // BYPASS, loaded once for the campaign
+        }
+        uint32_t pattern = pattern_gen();
+        int field = program.shift_dr((uint64_t)pattern, 32);
+        program.goto_state(RUN_TEST_IDLE);
+        
+        // Expect TDI delayed by one bit; bit 0 holds the previous scan's last bit
+        int bytes = (program.bit_count + 7) / 8;
+        scan.expected_tdo.assign(bytes, 0);
+        scan.tdo_mask.assign(bytes, 0);
+        for (int k = 1; k < 32; k++) {
+            int bit = program.fields[field].offset + k;
+            scan.tdo_mask[bit / 8] |= 1 << (bit % 8);
+            if ((pattern >> (k - 1)) & 1) {
+                scan.expected_tdo[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+        return true;
+    };
+    
+    ScanPipeline pipeline(hif, generate);
+    int result = pipeline.run();
+    
+    printf("Pipeline Analysis:\n");
+    printf("  Scans executed: %llu/%llu\n", (unsigned long long)pipeline.scans_executed,
+           (unsigned long long)scan_count);
+    printf("  Scans failed:   %llu\n", (unsigned long long)pipeline.scans_failed);
+    fflush(stdout);
+    
+    if (result && pipeline.scans_executed == scan_count) {
+        printf("PASS: Pipeline test PASSED - All pipelined scans verified\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Pipeline test FAILED - Pipelined scans did not verify\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test RUNTEST idle clocking
+// Clocks a long Run-Test/Idle period with djtg_clock_tck and checks that
+// simulated time advanced by exactly one TCK period (2.1 ns) per cycle and
+// that the TAP is still in Run-Test/Idle afterwards (IDCODE readable).
+int test_runtest_idle_clocking(int hif) {
+    printf("\n=== Testing RUNTEST Idle Clocking ===\n");
+    fflush(stdout);
+    
+    const int idle_cycles = 100000;
+    long long start_ps = jtag_sim_time_ps();
+    if (!djtg_clock_tck(hif, 0, 0, idle_cycles, 0)) {
+        printf("FAIL: RUNTEST test FAILED - djtg_clock_tck rejected\n");
+        fflush(stdout);
+        return 0;
+    }
+    long long elapsed_ps = jtag_sim_time_ps() - start_ps;
+    
+    // TAP must still be in Run-Test/Idle: IDCODE read without a reset
+    navigate_to_shift_ir();
+    shift_data_register(hif, 0x1, 4, true);
+    exit_to_run_test_idle();
+    navigate_to_shift_dr();
+    uint32_t idcode = shift_data_register(hif, 0, 32);
+    exit_to_run_test_idle();
+    
+    printf("RUNTEST Analysis:\n");
+    printf("  Idle cycles:   %d\n", idle_cycles);
+    printf("  Elapsed time:  %lld ps (expected %lld ps)\n", elapsed_ps, (long long)idle_cycles * 2100);
+    printf("  IDCODE after:  0x%08X\n", idcode);
+    fflush(stdout);
+    
+    if (elapsed_ps == (long long)idle_cycles * 2100 && idcode == 0x12345678) {
+        printf("PASS: RUNTEST test PASSED - Idle period timed correctly\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: RUNTEST test FAILED - Unexpected timing or TAP state\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Five TMS=1 cycles: the next access starts from Test-Logic-Reset, so its
+// program has to be compiled from the tracked state rather than assume
+// Run-Test/Idle
+static int enter_test_logic_reset(int hif) {
+    uint8_t tms = 0x1F, tdi = 0;
+    return djtg_shift_bits(hif, &tms, &tdi, nullptr, 5);
+}
+
+// Test RISC-V DMI access
+// Reads dtmcs (starting from Test-Logic-Reset), accesses debug module
+// registers and moves a block through System Bus Access with batched DMI
+// scans. The host starts without idle
+// cycles between scans, so the DTM must answer busy and the access layer has
+// to recover and settle on a gap that works.
+int test_riscv_dmi(int hif) {
+    printf("\n=== Testing RISC-V DMI Access ===\n");
+    fflush(stdout);
+    
+    RiscvDmi dmi(hif);
+    uint32_t dtmcs = 0;
+    uint32_t data0 = 0, dmstatus = 0;
+    bool ok = enter_test_logic_reset(hif) && dmi.read_dtmcs(&dtmcs) == TRUE;
+    ok = ok && dmi.write(DM_DMCONTROL, 0x1) && dmi.write(DM_DATA0, 0xDEADBEEF);
+    dmi.queue_read(DM_DATA0, &data0);
+    dmi.queue_read(DM_DMSTATUS, &dmstatus);
+    ok = ok && dmi.flush();
+    
+    const int words = 64;
+    const uint32_t base = 0x100;
+    uint32_t pattern[words], readback[words];
+    for (int i = 0; i < words; i++) {
+        pattern[i] = 0xA5000000u | (uint32_t)(i * 0x01010101u & 0x00FFFFFF);
+        readback[i] = 0;
+    }
+    ok = ok && dmi.write_memory(base, pattern, words) && dmi.read_memory(base, readback, words);
+    
+    int mismatches = 0;
+    for (int i = 0; i < words; i++) {
+        if (readback[i] != pattern[i]) {
+            mismatches++;
+        }
+    }
+    
+    printf("RISC-V DMI Analysis:\n");
+    printf("  dtmcs:         0x%08X (version %u, abits %u, idle %u)\n", dtmcs,
+           DTMCS_VERSION(dtmcs), DTMCS_ABITS(dtmcs), DTMCS_IDLE(dtmcs));
+    printf("  data0:         0x%08X (expected 0xDEADBEEF)\n", data0);
+    printf("  dmstatus:      0x%08X\n", dmstatus);
+    printf("  Memory words:  %d, mismatches %d\n", words, mismatches);
+    printf("  DMI scans:     %llu in %llu batches, %llu busy retries, idle cycles now %d\n",
+           (unsigned long long)dmi.scans, (unsigned long long)dmi.batches,
+           (unsigned long long)dmi.busy_retries, dmi.idle_cycles);
+    fflush(stdout);
+    
+    if (ok && DTMCS_VERSION(dtmcs) == 1 && DTMCS_ABITS(dtmcs) == 7 && data0 == 0xDEADBEEF &&
+        (dmstatus & 0xF) == 2 && mismatches == 0 && dmi.busy_retries > 0) {
+        printf("PASS: RISC-V DMI test PASSED - Batched access recovered from busy\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: RISC-V DMI test FAILED - Unexpected DTM response or data\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test ADIv5 DAP access
+// Reads IDCODE through the JTAG-DP encoding (starting from
+// Test-Logic-Reset), powers up the debug port and moves a block that
+// crosses a 1KB TAR auto-increment boundary through the MEM-AP with
+// pipelined APACC transactions. The host starts without idle
+// cycles, so the DP must answer WAIT and the transaction layer has to
+// recover.
+int test_adiv5_dap(int hif) {
+    printf("\n=== Testing ADIv5 DAP Access ===\n");
+    fflush(stdout);
+    
+    Adiv5Dap dap(hif);
+    uint32_t idcode = 0, idr = 0, ctrl_stat = 0;
+    bool ok = enter_test_logic_reset(hif) && dap.read_idcode(&idcode) == TRUE;
+    ok = ok && dap.power_up() && dap.ap_read(AP_IDR, &idr);
+    
+    const int words = 300;
+    const uint32_t base = 0x2F0;
+    std::vector<uint32_t> pattern(words), readback(words, 0);
+    for (int i = 0; i < words; i++) {
+        pattern[i] = 0x5A000000u ^ (uint32_t)(i * 2654435761u);
+    }
+    ok = ok && dap.write_block(base, pattern.data(), words) && dap.read_block(base, readback.data(), words);
+    ok = ok && dap.dp_read(DP_CTRL_STAT, &ctrl_stat);
+    
+    int mismatches = 0;
+    for (int i = 0; i < words; i++) {
+        if (readback[i] != pattern[i]) {
+            mismatches++;
+        }
+    }
+    
+    printf("ADIv5 DAP Analysis:\n");
+    printf("  IDCODE (0xE):  0x%08X\n", idcode);
+    printf("  MEM-AP IDR:    0x%08X\n", idr);
+    printf("  CTRL/STAT:     0x%08X\n", ctrl_stat);
+    printf("  Block:         %d words at 0x%03X, mismatches %d\n", words, base, mismatches);
+    printf("  DAP scans:     %llu in %llu batches, %llu WAIT retries, idle cycles now %d\n",
+           (unsigned long long)dap.scans, (unsigned long long)dap.batches,
+           (unsigned long long)dap.wait_retries, dap.idle_cycles);
+    fflush(stdout);
+    
+    if (ok && idcode == 0x12345678 && idr == 0x24770011 && !(ctrl_stat & CTRL_STAT_STICKYERR) &&
+        mismatches == 0 && dap.wait_retries > 0) {
+        printf("PASS: ADIv5 DAP test PASSED - Pipelined block transfer recovered from WAIT\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: ADIv5 DAP test FAILED - Unexpected DAP response or data\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test SPI flash programming through EXTEST
+// Bit-bangs the flash on the boundary-scan-only SPI pins, starting from
+// Test-Logic-Reset: reads the JEDEC ID, programs a block spanning several
+// pages (erase, program, verify) and reads it back. Each transaction runs
+// as one compiled scan program.
+int test_spi_flash(int hif) {
+    printf("\n=== Testing SPI Flash Programming via EXTEST ===\n");
+    fflush(stdout);
+    
+    SpiFlashProgrammer flash(hif);
+    uint32_t jedec_id = 0;
+    bool ok = enter_test_logic_reset(hif) && flash.begin() && flash.read_id(&jedec_id);
+    
+    const int length = 600;
+    const uint32_t base = 0x1F0;
+    std::vector<uint8_t> pattern(length), readback(length, 0);
+    for (int i = 0; i < length; i++) {
+        pattern[i] = (uint8_t)((i * 37) ^ 0xA5);
+    }
+    ok = ok && flash.program(base, pattern.data(), length);
+    ok = ok && flash.read(base, readback.data(), length);
+    ok = ok && flash.end();
+    
+    int mismatches = 0;
+    for (int i = 0; i < length; i++) {
+        if (readback[i] != pattern[i]) {
+            mismatches++;
+        }
+    }
+    
+    printf("SPI Flash Analysis:\n");
+    printf("  JEDEC ID:      0x%06X\n", jedec_id);
+    printf("  Block:         %d bytes at 0x%06X, mismatches %d\n", length, base, mismatches);
+    printf("  Transactions:  %llu, BSR scans %llu, busy polls %llu\n",
+           (unsigned long long)flash.transactions, (unsigned long long)flash.scans,
+           (unsigned long long)flash.busy_polls);
+    fflush(stdout);
+    
+    if (ok && jedec_id == 0xEF4016 && mismatches == 0 && flash.busy_polls > 0) {
+        printf("PASS: SPI flash test PASSED - Block programmed and verified through EXTEST\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: SPI flash test FAILED - Unexpected ID or data\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the BSR pin-protocol engine
+// Describes an SPI RDID transaction as a plain pin waveform (with a long CS
+// setup time, a redundant drive and a trailing sample) and checks that the
+// engine compiles it into fused update/capture scans that read the JEDEC ID.
+int test_pin_waveform(int hif) {
+    printf("\n=== Testing BSR Pin Waveform Engine ===\n");
+    fflush(stdout);
+    
+    uint32_t idle = (1u << BSR_UP_DOWN_CELL) | BSR_COUNT_OE_MASK | (1u << BSR_SPI_CS_N_CELL);
+    BsrPinEngine engine(hif, idle);
+    PinWaveform wave;
+    
+    const uint32_t cs_setup = 64;   // TCK cycles between CS low and the first SCK edge
+    const uint8_t out[4] = {SPI_FLASH_CMD_RDID, 0, 0, 0};
+    std::vector<int> miso_samples;
+    wave.drive(0, BSR_SPI_CS_N_CELL, false);
+    uint32_t t = cs_setup;
+    for (int byte = 0; byte < 4; byte++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            wave.drive(t, BSR_SPI_SCK_CELL, false);
+            wave.drive(t, BSR_SPI_MOSI_CELL, (out[byte] >> bit) & 1);
+            t++;
+            miso_samples.push_back(wave.sample(t, BSR_SPI_MISO_CELL));
+            wave.drive(t, BSR_SPI_SCK_CELL, true);
+            t++;
+        }
+    }
+    wave.drive(t++, BSR_SPI_SCK_CELL, false);
+    wave.drive(t++, BSR_SPI_CS_N_CELL, true);
+    wave.drive(t++, BSR_SPI_CS_N_CELL, true);               // Redundant: no update
+    int idle_miso = wave.sample(t, BSR_SPI_MISO_CELL);      // Pulled up while deselected
+    
+    bool ok = enter_test_logic_reset(hif) && engine.begin() && engine.run(wave);
+    int program_bits = engine.program().bit_count;
+    ok = ok && engine.end();
+    
+    uint32_t jedec_id = 0;
+    for (int i = 8; i < 32; i++) {
+        jedec_id = (jedec_id << 1) | engine.samples[miso_samples[i]];
+    }
+    
+    printf("Pin Waveform Analysis:\n");
+    printf("  JEDEC ID:      0x%06X, idle MISO %d\n", jedec_id, engine.samples[idle_miso]);
+    printf("  Events:        %d over %u TCK, %llu updates, %llu dropped slots\n",
+           (int)wave.events.size(), t, (unsigned long long)engine.updates,
+           (unsigned long long)engine.dropped_slots);
+    printf("  Captures:      %llu fused, %llu extra, %llu pad cycles, %d-bit program\n",
+           (unsigned long long)engine.fused_captures, (unsigned long long)engine.extra_captures,
+           (unsigned long long)engine.pad_cycles, program_bits);
+    fflush(stdout);
+    
+    if (ok && jedec_id == 0xEF4016 && engine.samples[idle_miso] == 1 && engine.updates == 67 &&
+        engine.dropped_slots == 1 && engine.fused_captures == 32 && engine.extra_captures == 1 &&
+        engine.pad_cycles > 0) {
+        printf("PASS: Pin waveform test PASSED - Waveform compiled to minimal fused scans\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Pin waveform test FAILED - Unexpected samples or scan count\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the STAPL player
+// Runs a script that checks the IDCODE with COMPARE, then loops 100 DR scans
+// through BYPASS capturing into one large array and verifies the echoed
+// bits in a second loop. The scan loop has no data dependency, so the
+// player drives it as a single bulk transfer.
+int test_stapl_player(int hif) {
+    printf("\n=== Testing STAPL Player ===\n");
+    fflush(stdout);
+    
+    static const char* script =
+        "NOTE \"DESIGN\" \"jtag_top\";\n"
+        "ACTION VERIFY \"Check IDCODE and BYPASS echo\" = CHECK_ID, BYPASS_LOOP;\n"
+        "BOOLEAN id[32];\n"
+        "BOOLEAN expected_id[32] = $12345678;\n"
+        "BOOLEAN ok;\n"
+        "BOOLEAN data[65] = $0123456789ABCDEF;\n"
+        "BOOLEAN echo[6500];\n"
+        "INTEGER i;\n"
+        "INTEGER j;\n"
+        "INTEGER errors = 0;\n"
+        "PROCEDURE CHECK_ID;\n"
+        "    IRSCAN 4, $1;\n"
+        "    DRSCAN 32, $00000000, CAPTURE id, COMPARE expected_id, $FFFFFFFF, ok;\n"
+        "    IF !ok THEN LET errors = errors + 1;\n"
+        "    EXPORT \"IDCODE\", id[31..0];\n"
+        "ENDPROC;\n"
+        "PROCEDURE BYPASS_LOOP;\n"
+        "    IRSCAN 4, #1111;\n"
+        "    FOR i = 0 TO 99;\n"
+        "        LET data[0] = i % 2;\n"
+        "        DRSCAN 65, data, CAPTURE echo[i * 65 + 64 .. i * 65];\n"
+        "    NEXT i;\n"
+        "    WAIT IDLE, 10 TCK;\n"
+        "    FOR i = 99 TO 0 STEP -1;\n"
+        "        IF echo[i * 65 + 1] != i % 2 THEN LET errors = errors + 1;\n"
+        "        FOR j = 1 TO 63;\n"
+        "            IF echo[i * 65 + j + 1] != data[j] THEN GOTO MISMATCH;\n"
+        "        NEXT j;\n"
+        "    NEXT i;\n"
+        "    GOTO DONE;\n"
+        "MISMATCH: LET errors = errors + 1;\n"
+        "DONE: PRINT \"BYPASS echo checked, errors \", errors;\n"
+        "    EXPORT \"ERRORS\", errors;\n"
+        "    IF errors != 0 THEN EXIT 1;\n"
+        "ENDPROC;\n";
+    
+    StaplPlayer player(hif);
+    bool compiled = player.compile(script) == TRUE;
+    if (!compiled) {
+        printf("STAPL compile error: %s\n", player.error.c_str());
+    }
+    bool ran = compiled && player.run("VERIFY") == TRUE;
+    
+    int32_t idcode = 0, errors = -1;
+    for (size_t i = 0; i < player.exports.size(); i++) {
+        if (player.exports[i].first == "IDCODE") {
+            idcode = player.exports[i].second;
+        } else if (player.exports[i].first == "ERRORS") {
+            errors = player.exports[i].second;
+        }
+    }
+    
+    printf("STAPL Player Analysis:\n");
+    printf("  Program:       %d statements, %d bytecode instructions\n",
+           player.program().statements, (int)player.program().code.size());
+    printf("  Execution:     %llu instructions, %llu scans in %llu transfers (%llu bits)\n",
+           (unsigned long long)player.instructions, (unsigned long long)player.scans,
+           (unsigned long long)player.transfers, (unsigned long long)player.bits);
+    printf("  Exports:       IDCODE 0x%08X, ERRORS %d, exit code %d\n", (uint32_t)idcode, errors,
+           player.exit_code);
+    fflush(stdout);
+    
+    if (ran && (uint32_t)idcode == 0x12345678 && errors == 0 && player.exit_code == 0 &&
+        player.scans == 103 && player.transfers == 2) {
+        printf("PASS: STAPL player test PASSED - Script ran with batched scans\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: STAPL player test FAILED - Unexpected result or transfer count\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// TDO hash test sequence: IDCODE reads, then BYPASS echoes. flip_scan
+// (0-7) changes one TDI bit in that BYPASS scan, which moves one TDO bit
+// but leaves the scan structure alone.
+static int run_tdo_hash_sequence(int hif, int flip_scan) {
+    ScanProgram program;
+    program.shift_ir(0x1, 4);   // IDCODE
+    for (int i = 0; i < 8; i++) {
+        program.shift_dr(0, 32);
+    }
+    program.shift_ir(0xF, 4);   // BYPASS
+    for (int i = 0; i < 8; i++) {
+        program.shift_dr(0x5A5A ^ (i == flip_scan ? 0x0100 : 0), 16);
+    }
+    program.goto_state(RUN_TEST_IDLE);
+    
+    std::vector<uint8_t> tdo((program.bit_count + 7) / 8);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count);
+}
+
+// Test TDO stream hashing
+// Hashes the same sequence twice and expects identical digests, then a
+// variant with one flipped bit in BYPASS scan 5 (scan 15 of the test). The
+// comparison must flag a data-only change, and the window scans recorded
+// during the flipped run must map the differing checkpoint window back to a
+// scan range containing scan 15.
+int test_tdo_hash(int hif) {
+    printf("\n=== Testing TDO Stream Hash ===\n");
+    fflush(stdout);
+    
+    const int flipped_scan = 15;
+    TdoStreamHasher hasher(64);
+    jtag_add_step_observer(&hasher);
+    
+    bool shifted = true;
+    hasher.begin_test("reference");
+    shifted = run_tdo_hash_sequence(hif, -1) && shifted;
+    hasher.end_test();
+    hasher.begin_test("repeat");
+    shifted = run_tdo_hash_sequence(hif, -1) && shifted;
+    hasher.end_test();
+    hasher.begin_test("flipped");
+    shifted = run_tdo_hash_sequence(hif, 5) && shifted;
+    hasher.end_test();
+    
+    TdoMismatch repeat_mismatch, mismatch;
+    bool repeat_equal = TdoStreamHasher::compare(hasher.digests[0], hasher.digests[1], hasher.checkpoint_bits,
+                                                 &repeat_mismatch) == TRUE;
+    bool flipped_equal = TdoStreamHasher::compare(hasher.digests[0], hasher.digests[2], hasher.checkpoint_bits,
+                                                  &mismatch) == TRUE;
+    bool located = !flipped_equal &&
+                   TdoStreamHasher::locate(hasher.digests[2], hasher.checkpoint_bits, &mismatch) == TRUE;
+    jtag_remove_step_observer(&hasher);
+    
+    const TdoDigest& reference = hasher.digests[0];
+    printf("TDO Hash Analysis:\n");
+    printf("  Reference:     %llu bits, %llu scans, %d checkpoints, hash 0x%016llX\n",
+           (unsigned long long)reference.bits, (unsigned long long)reference.scans,
+           (int)reference.checkpoints.size(), (unsigned long long)reference.tdo_hash);
+    printf("  Repeat:        %s\n", repeat_equal ? "identical" : "DIFFERENT");
+    printf("  Flipped:       %s, boundary %s\n", flipped_equal ? "identical" : "different",
+           mismatch.boundary ? "changed" : "unchanged");
+    if (located) {
+        printf("  Located:       window %d (bits %llu-%llu), scans %llu-%llu\n", mismatch.window,
+               (unsigned long long)mismatch.first_bit, (unsigned long long)mismatch.last_bit,
+               (unsigned long long)mismatch.first_scan.index, (unsigned long long)mismatch.last_scan.index);
+    }
+    fflush(stdout);
+    
+    if (shifted && repeat_equal && !flipped_equal && !mismatch.boundary && located && reference.scans == 18 &&
+        mismatch.first_scan.index <= flipped_scan && mismatch.last_scan.index >= flipped_scan &&
+        mismatch.first_scan.instruction == 0xF) {
+        printf("PASS: TDO hash test PASSED - Change detected and located\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: TDO hash test FAILED - Unexpected digest comparison\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Functional coverage test sequence: SAMPLE/PRELOAD of one BSR pattern,
+// then an IDCODE read
+static int run_coverage_sequence(int hif, uint32_t pattern) {
+    ScanProgram program;
+    program.shift_ir(0x2, 4);   // SAMPLE/PRELOAD
+    program.shift_dr(pattern, BSR_WIDTH);
+    program.shift_ir(0x1, 4);   // IDCODE
+    program.shift_dr(0, 32);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    std::vector<uint8_t> tdo((program.bit_count + 7) / 8);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count);
+}
+
+// Test functional coverage collection
+// Two collectors each see one BSR pattern (cs_n held high). Each must hold
+// exactly that pattern's driven-cell bins, one counter value and only the
+// states a plain scan passes through; merging the two fills every driven
+// bin except cs_n low, and the merged map must survive a save/load round
+// trip unchanged.
+int test_functional_coverage(int hif) {
+    printf("\n=== Testing Functional Coverage ===\n");
+    fflush(stdout);
+    
+    const uint32_t cells_mask = (1u << BSR_WIDTH) - 1;
+    const uint32_t cs_n = 1u << BSR_SPI_CS_N_CELL;
+    const uint32_t pattern_a = (0x0AAA & cells_mask) | cs_n;
+    const uint32_t pattern_b = (~pattern_a & cells_mask) | cs_n;
+    
+    JtagCoverage first, second;
+    jtag_add_step_observer(&first);
+    tap_reset();
+    bool shifted = run_coverage_sequence(hif, pattern_a) == TRUE;
+    jtag_remove_step_observer(&first);
+    jtag_add_step_observer(&second);
+    shifted = run_coverage_sequence(hif, pattern_b) == TRUE && shifted;
+    jtag_remove_step_observer(&second);
+    
+    bool exact_cells = true;
+    for (int cell = 0; cell < BSR_WIDTH; cell++) {
+        bool value = (pattern_a >> cell) & 1;
+        if (!first.map.test(coverage_bsr_bin(COV_BSR_DRIVEN, cell, value)) ||
+            first.map.test(coverage_bsr_bin(COV_BSR_DRIVEN, cell, !value))) {
+            exact_cells = false;
+        }
+    }
+    bool paths = first.map.test(coverage_state_bin(TEST_LOGIC_RESET)) &&
+                 first.map.test(coverage_state_bin(SHIFT_DR)) && !first.map.test(coverage_state_bin(PAUSE_DR)) &&
+                 !first.map.test(coverage_state_bin(EXIT2_IR));
+    bool instructions = first.map.test(coverage_instruction_bin(0x2)) &&
+                        first.map.test(coverage_instruction_bin(0x1)) && first.map.count(COV_INSTRUCTION) == 2;
+    
+    JtagCoverageMap merged = first.map;
+    int added = merged.merge(second.map);
+    bool saved = merged.save("build/coverage_test.bin") == TRUE;
+    JtagCoverageMap loaded;
+    bool round_trip = saved && loaded.load("build/coverage_test.bin") == TRUE &&
+                      memcmp(loaded.words, merged.words, sizeof(merged.words)) == 0;
+    remove("build/coverage_test.bin");
+    
+    first.print_summary("Coverage (pattern A)");
+    printf("Functional Coverage Analysis:\n");
+    printf("  Merge:         %d bins added, %d/%d driven bins, %d counter values\n", added,
+           merged.count(COV_BSR_DRIVEN), coverage_group_size(COV_BSR_DRIVEN), merged.count(COV_COUNTER));
+    printf("  Round trip:    %s\n", round_trip ? "identical" : "MISMATCH");
+    fflush(stdout);
+    
+    if (shifted && exact_cells && paths && instructions && first.map.count(COV_COUNTER) == 1 &&
+        merged.count(COV_BSR_DRIVEN) == 2 * BSR_WIDTH - 1 && added >= BSR_WIDTH - 1 && round_trip) {
+        printf("PASS: Functional coverage test PASSED - Bins collected, merged and saved\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Functional coverage test FAILED - Unexpected coverage bins\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test coverage-directed generation
+// Starts from the coverage of a single IDCODE read and lets the generator
+// close the holes the hand-written tests leave (Pause/Exit2 paths, unknown
+// opcodes, BSR cell values). It must saturate within its budget, reach every
+// state, edge and opcode, and never enter a DR-side state under DMI, ABORT,
+// DPACC or APACC. EXTEST DR scans are expected: the capture sweep issues
+// them with cs_n held high.
+int test_coverage_generation(int hif) {
+    printf("\n=== Testing Coverage-Directed Generation ===\n");
+    fflush(stdout);
+    
+    JtagCoverage coverage;
+    jtag_add_step_observer(&coverage);
+    tap_reset();
+    navigate_to_shift_ir();
+    shift_data_register(hif, 0x1, 4, true);
+    exit_to_run_test_idle();
+    navigate_to_shift_dr();
+    uint32_t idcode = shift_data_register(hif, 0, 32);
+    exit_to_run_test_idle();
+    jtag_remove_step_observer(&coverage);
+    int seed_bins = coverage.map.count();
+    
+    CoverageGenerator generator(hif, &coverage);
+    bool ran = generator.run() == TRUE;
+    
+    bool unsafe_entered = false;
+    for (int instruction = 0; instruction < 16; instruction++) {
+        for (int state = CAPTURE_DR; state <= UPDATE_DR; state++) {
+            if (instruction != 0x0 && ((generator.unsafe_dr_mask >> instruction) & 1) &&
+                coverage.map.test(coverage_instruction_state_bin(instruction, (TapState)state))) {
+                unsafe_entered = true;
+            }
+        }
+    }
+    bool pause_paths = coverage.map.test(coverage_instruction_state_bin(0xF, PAUSE_DR)) &&
+                       coverage.map.test(coverage_instruction_state_bin(0xF, EXIT2_DR)) &&
+                       coverage.map.test(coverage_instruction_state_bin(0xF, PAUSE_IR)) &&
+                       coverage.map.test(coverage_instruction_state_bin(0xF, EXIT2_IR));
+    
+    coverage.print_summary("Generated coverage");
+    printf("Coverage Generation Analysis:\n");
+    printf("  Seed:          IDCODE 0x%08X, %d bins\n", idcode, seed_bins);
+    printf("  Generator:     %d rounds, %d fragments, %llu bits, %d bins added\n", generator.rounds,
+           generator.fragments, (unsigned long long)generator.bits, generator.bins_added);
+    printf("  Remaining:     %d excluded as unsafe/impossible, %d unreachable, %s\n", generator.excluded,
+           generator.missed, generator.saturated ? "saturated" : "budget exhausted");
+    fflush(stdout);
+    
+    if (ran && idcode == 0x12345678 && generator.saturated && !unsafe_entered && pause_paths &&
+        coverage.map.count(COV_STATE) == coverage_group_size(COV_STATE) &&
+        coverage.map.count(COV_EDGE) == coverage_group_size(COV_EDGE) &&
+        coverage.map.count(COV_INSTRUCTION) == coverage_group_size(COV_INSTRUCTION) &&
+        coverage.map.count(COV_BSR_DRIVEN) == coverage_group_size(COV_BSR_DRIVEN) &&
+        coverage.map.count(COV_INSTRUCTION_STATE) + generator.excluded ==
+            coverage_group_size(COV_INSTRUCTION_STATE)) {
+        printf("PASS: Coverage generation test PASSED - Generator saturated safely\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Coverage generation test FAILED - Holes left or unsafe bins entered\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Scans for one TAP instance: reset, IDCODE read and a 32-bit BYPASS echo.
+// The reset makes the program independent of the state the TAP is in.
+static void build_tap_check_program(ScanProgram& program, uint32_t pattern, int* idcode_field, int* echo_field) {
+    program.clear(TEST_LOGIC_RESET);
+    for (int i = 0; i < 5; i++) {
+        program.append_bit(true, false);
+    }
+    program.shift_ir(0x1, 4);   // IDCODE
+    *idcode_field = program.shift_dr(0, 32);
+    program.shift_ir(0xF, 4);   // BYPASS
+    *echo_field = program.shift_dr(pattern, 33);
+    program.goto_state(RUN_TEST_IDLE);
+}
+
+static int enable_with_retry(int hif) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (djtg_enable(hif)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Test multiple TAP instances
+// Maps one HIF to each additional instance and interleaves their scan
+// programs 8 bits at a time. Every instance must return its own IDCODE
+// version and echo its BYPASS pattern, and the primary TAP must be left
+// exactly where it was.
+int test_multi_tap(int hif) {
+    printf("\n=== Testing Multiple TAP Instances ===\n");
+    fflush(stdout);
+    
+    int taps = jtag_tap_count();
+    TapState primary_before = jtag_tracked_state(0);
+    
+    std::vector<ScanProgram> programs(taps);
+    std::vector<std::vector<uint8_t>> tdo(taps);
+    std::vector<int> idcode_fields(taps), echo_fields(taps);
+    bool enabled = taps > 1;
+    for (int tap = 1; tap < taps; tap++) {
+        enabled = jtag_assign_tap(hif + tap, tap) && enable_with_retry(hif + tap) && enabled;
+        build_tap_check_program(programs[tap], 0xC0DE0000u | (uint32_t)tap, &idcode_fields[tap], &echo_fields[tap]);
+        tdo[tap].assign((programs[tap].bit_count + 7) / 8, 0);
+    }
+    
+    // Round-robin 8-bit chunks, so the instances' scans are interleaved
+    int chunks = 0;
+    bool shifted = enabled;
+    for (int offset = 0; shifted; offset += 8) {
+        bool any = false;
+        for (int tap = 1; tap < taps; tap++) {
+            int remaining = programs[tap].bit_count - offset;
+            if (remaining <= 0) {
+                continue;
+            }
+            int bits = remaining < 8 ? remaining : 8;
+            shifted = djtg_shift_bits(hif + tap, programs[tap].tms.data() + offset / 8,
+                                      programs[tap].tdi.data() + offset / 8, tdo[tap].data() + offset / 8, bits) &&
+                      shifted;
+            chunks++;
+            any = true;
+        }
+        if (!any) {
+            break;
+        }
+    }
+    
+    bool instances_ok = shifted;
+    printf("Multi-TAP Analysis:\n");
+    printf("  Instances:     %d (%d interleaved chunks)\n", taps, chunks);
+    for (int tap = 1; tap < taps; tap++) {
+        uint32_t idcode = (uint32_t)scan_extract_bits(tdo[tap].data(), programs[tap].fields[idcode_fields[tap]].offset, 32);
+        uint32_t echo = (uint32_t)(scan_extract_bits(tdo[tap].data(), programs[tap].fields[echo_fields[tap]].offset, 33) >> 1);
+        printf("  TAP %d:         IDCODE 0x%08X, echo 0x%08X\n", tap, idcode, echo);
+        instances_ok = instances_ok && idcode == 0x12345678u + ((uint32_t)tap << 28) &&
+                       echo == (0xC0DE0000u | (uint32_t)tap) && jtag_tracked_state(tap) == RUN_TEST_IDLE;
+        djtg_disable(hif + tap);
+    }
+    
+    // The primary TAP was not stepped: IDCODE reads back without a reset
+    TapState primary_after = jtag_tracked_state(0);
+    navigate_to_shift_ir();
+    shift_data_register(hif, 0x1, 4, true);
+    exit_to_run_test_idle();
+    navigate_to_shift_dr();
+    uint32_t primary_idcode = shift_data_register(hif, 0, 32);
+    exit_to_run_test_idle();
+    printf("  Primary:       %s -> %s, IDCODE 0x%08X\n", tap_state_name(primary_before),
+           tap_state_name(primary_after), primary_idcode);
+    fflush(stdout);
+    
+    if (taps > 1 && instances_ok && primary_before == primary_after && primary_idcode == 0x12345678) {
+        printf("PASS: Multi-TAP test PASSED - Instances are independent\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Multi-TAP test FAILED - Instance routing or isolation broken\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the adapter/USB cost model
+// Runs the same BYPASS scan as one call per 8 bits, as one bulk call, and
+// as one call with a small per-command limit. The per-byte pattern must map
+// to one command and one turnaround per call and be latency-bound; the bulk
+// call must be a single command; the limited call must split into commands
+// without adding calls.
+int test_usb_adapter_model(int hif) {
+    printf("\n=== Testing USB Adapter Model ===\n");
+    fflush(stdout);
+    
+    UsbAdapterModel& usb = djtg_usb_model();
+    ScanProgram program;
+    program.shift_ir(0xF, 4);   // BYPASS
+    int field = program.shift_dr(0x1234ABCDull << 1, 33);
+    program.goto_state(RUN_TEST_IDLE);
+    std::vector<uint8_t> tdo((program.bit_count + 7) / 8);
+    
+    // Pattern A: a call per byte
+    bool shifted = true;
+    UsbAdapterStats before = usb.stats;
+    for (int offset = 0; offset < program.bit_count; offset += 8) {
+        int bits = program.bit_count - offset < 8 ? program.bit_count - offset : 8;
+        shifted = djtg_shift_bits(hif, program.tms.data() + offset / 8, program.tdi.data() + offset / 8,
+                                  tdo.data() + offset / 8, bits) && shifted;
+    }
+    UsbAdapterStats per_byte = usb.stats.since(before);
+    uint32_t echo_a = (uint32_t)(scan_extract_bits(tdo.data(), program.fields[field].offset, 33) >> 2);
+    
+    // Pattern B: one bulk call
+    before = usb.stats;
+    shifted = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count) && shifted;
+    UsbAdapterStats bulk = usb.stats.since(before);
+    uint32_t echo_b = (uint32_t)(scan_extract_bits(tdo.data(), program.fields[field].offset, 33) >> 2);
+    
+    // Pattern C: bulk call against a 16-bit command limit
+    UsbAdapterConfig saved = usb.config;
+    usb.config.max_bits_per_command = 16;
+    before = usb.stats;
+    shifted = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count) && shifted;
+    UsbAdapterStats limited = usb.stats.since(before);
+    usb.config = saved;
+    
+    uint64_t expected_calls = (program.bit_count + 7) / 8;
+    uint64_t expected_split = (program.bit_count + 15) / 16;
+    usb.print_report("Per-byte calls", per_byte);
+    usb.print_report("Single bulk call", bulk);
+    printf("USB Adapter Analysis:\n");
+    printf("  Program:       %d bits, echo 0x%08X / 0x%08X\n", program.bit_count, echo_a, echo_b);
+    printf("  Split:         %llu commands for one call at 16 bits per command\n",
+           (unsigned long long)limited.commands);
+    printf("  Speedup:       %.1fx from batching\n", per_byte.total_us() / bulk.total_us());
+    fflush(stdout);
+    
+    if (shifted && echo_a == 0x1234ABCD && echo_b == 0x1234ABCD && per_byte.calls == expected_calls &&
+        per_byte.commands == expected_calls && per_byte.small_calls == expected_calls && bulk.calls == 1 &&
+        bulk.commands == 1 && bulk.out_transfers == 1 && limited.calls == 1 && limited.commands == expected_split &&
+        per_byte.total_us() > 5 * bulk.total_us()) {
+        printf("PASS: USB adapter test PASSED - Call patterns mapped to transfers\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: USB adapter test FAILED - Unexpected transfer accounting\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the transaction-level backend
+// Runs a long BYPASS scan, an IDCODE scan and an idle run once through the
+// bulk backend and once with per-TCK stepping. TDO and the simulated time
+// taken must be identical, and the long scan must have gone through the
+// word-level path. Without a bulk backend (simulator, JTAG_NATIVE_TLM=0)
+// both runs step per TCK, so the TDO stream is the same either way.
+int test_tlm_backend(int hif) {
+    printf("\n=== Testing Transaction-Level Backend ===\n");
+    fflush(stdout);
+    
+    JtagBulkBackend* backend = jtag_bulk_backend();
+    
+    const int scan_bits = 4096;
+    std::vector<uint8_t> data(scan_bits / 8);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 37 + 11);
+    }
+    ScanProgram program;
+    program.shift_ir(0xF, 4);   // BYPASS
+    int echo_field = program.shift_dr_bytes(data.data(), scan_bits + 1);
+    program.shift_ir(0x1, 4);   // IDCODE
+    int idcode_field = program.shift_dr(0, 32);
+    program.idle(500);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    std::vector<uint8_t> tdo_tlm((program.bit_count + 7) / 8), tdo_step((program.bit_count + 7) / 8);
+    uint64_t word_before = backend ? backend->word_bits : 0;
+    uint64_t idle_before = backend ? backend->idle_bits : 0;
+    long long start = sv_get_time_ps();
+    auto wall_start = std::chrono::steady_clock::now();
+    jtag_set_shift_path(JTAG_PATH_BULK);
+    bool shifted = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo_tlm.data(), program.bit_count);
+    auto wall_mid = std::chrono::steady_clock::now();
+    long long elapsed_tlm = sv_get_time_ps() - start;
+    uint64_t word_bits = backend ? backend->word_bits - word_before : 0;
+    uint64_t idle_bits = backend ? backend->idle_bits - idle_before : 0;
+    
+    jtag_set_bulk_backend(nullptr);
+    jtag_set_shift_path(JTAG_PATH_STEP);
+    start = sv_get_time_ps();
+    auto wall_step = std::chrono::steady_clock::now();
+    shifted = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo_step.data(), program.bit_count) &&
+              shifted;
+    auto wall_end = std::chrono::steady_clock::now();
+    long long elapsed_step = sv_get_time_ps() - start;
+    jtag_set_bulk_backend(backend);
+    jtag_set_shift_path(JTAG_PATH_AUTO);
+    
+    // The BYPASS register delays TDI by one bit
+    bool echo_ok = true;
+    for (int i = 0; i < scan_bits; i++) {
+        bool sent = (data[i / 8] >> (i % 8)) & 1;
+        int bit = program.fields[echo_field].offset + 1 + i;
+        echo_ok = echo_ok && ((tdo_tlm[bit / 8] >> (bit % 8)) & 1) == sent;
+    }
+    uint32_t idcode = (uint32_t)scan_extract_bits(tdo_tlm.data(), program.fields[idcode_field].offset, 32);
+    bool same_tdo = tdo_tlm == tdo_step;
+    double us_tlm = std::chrono::duration<double, std::micro>(wall_mid - wall_start).count();
+    double us_step = std::chrono::duration<double, std::micro>(wall_end - wall_step).count();
+    
+    printf("TLM Backend Analysis:\n");
+    printf("  Backend:       %s\n", backend ? "bulk" : "per-TCK stepping only");
+    printf("  Program:       %d bits, %llu word-level, %llu idle\n", program.bit_count,
+           (unsigned long long)word_bits, (unsigned long long)idle_bits);
+    printf("  TDO:           %s, echo %s, IDCODE 0x%08X\n", same_tdo ? "identical" : "DIFFERENT",
+           echo_ok ? "ok" : "wrong", idcode);
+    printf("  Sim time:      %lld ps / %lld ps (TLM / per-TCK)\n", elapsed_tlm, elapsed_step);
+    printf("  Wall time:     %.0f us / %.0f us\n", us_tlm, us_step);
+    fflush(stdout);
+    
+    if (shifted && same_tdo && echo_ok && idcode == 0x12345678 && elapsed_tlm == elapsed_step &&
+        (!backend || (word_bits >= (uint64_t)scan_bits + 32 && idle_bits >= 500))) {
+        printf("PASS: TLM backend test PASSED - Word-level scans match per-TCK stepping\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: TLM backend test FAILED - Word-level scans diverge from per-TCK stepping\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test hybrid execution
+// The setup runs on a native model: a few hundred SAMPLE/PRELOAD scans
+// ending with a pattern in the BSR update stage, then an IDCODE scan
+// paused after 12 bits. After the handoff the instance must read back the
+// same registers, the rest of the IDCODE scan must continue from Pause-DR,
+// and EXTEST must drive (and capture) the preloaded pin values.
+int test_hybrid_handoff(int hif) {
+    printf("\n=== Testing Hybrid Handoff ===\n");
+    fflush(stdout);
+    
+    const int setup_scans = 256;
+    const int first_bits = 12;
+    const uint32_t pattern = (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_SCK_CELL) | BSR_COUNT_OE_MASK;
+    
+    // Setup: Test-Logic-Reset -> ... -> Pause-DR inside the IDCODE scan
+    HybridSession session(hif);
+    ScanProgram setup(TEST_LOGIC_RESET);
+    setup.goto_state(RUN_TEST_IDLE);
+    setup.shift_ir(0x2, 4);   // SAMPLE/PRELOAD
+    for (int i = 0; i < setup_scans; i++) {
+        setup.shift_dr(i == setup_scans - 1 ? pattern : (uint32_t)(i * 0x9E5) & 0x1FFF, BSR_WIDTH);
+    }
+    setup.shift_ir(0x1, 4);   // IDCODE
+    setup.goto_state(SHIFT_DR);
+    int first_offset = setup.bit_count;
+    for (int i = 0; i < first_bits; i++) {
+        setup.append_bit(i == first_bits - 1, false);
+    }
+    setup.goto_state(PAUSE_DR);
+    std::vector<uint8_t> setup_tdo((setup.bit_count + 7) / 8);
+    session.shift(setup.tms.data(), setup.tdi.data(), setup_tdo.data(), setup.bit_count);
+    uint32_t low_bits = (uint32_t)scan_extract_bits(setup_tdo.data(), first_offset, first_bits);
+    
+    // Handoff and read-back
+    JtagTapSnapshot expected = session.setup.snapshot();
+    JtagTapSnapshot loaded;
+    bool handed_off = session.handoff() && jtag_backdoor_read(jtag_device_tap(hif), &loaded);
+    bool same = handed_off && loaded.current_state == expected.current_state &&
+                loaded.ir_shift_register == expected.ir_shift_register &&
+                loaded.instruction_reg == expected.instruction_reg &&
+                loaded.scan_register == expected.scan_register &&
+                loaded.update_register == expected.update_register &&
+                loaded.idcode_shift_reg == expected.idcode_shift_reg && loaded.bypass_reg == expected.bypass_reg &&
+                loaded.tdo_reg == expected.tdo_reg && loaded.count == expected.count;
+    
+    // Cycle-accurate continuation on the instance
+    ScanProgram rest(PAUSE_DR);
+    rest.goto_state(SHIFT_DR);
+    int rest_offset = rest.bit_count;
+    for (int i = first_bits; i < 32; i++) {
+        rest.append_bit(i == 31, false);
+    }
+    rest.goto_state(RUN_TEST_IDLE);
+    rest.shift_ir(0x0, 4);    // EXTEST: the preloaded pattern drives the pins
+    int capture_field = rest.shift_dr(pattern, BSR_WIDTH);
+    rest.shift_ir(0xF, 4);    // BYPASS
+    rest.goto_state(RUN_TEST_IDLE);
+    std::vector<uint8_t> rest_tdo((rest.bit_count + 7) / 8);
+    bool shifted = handed_off &&
+                   djtg_shift_bits(hif, rest.tms.data(), rest.tdi.data(), rest_tdo.data(), rest.bit_count);
+    uint32_t idcode = low_bits | ((uint32_t)scan_extract_bits(rest_tdo.data(), rest_offset, 32 - first_bits)
+                                  << first_bits);
+    uint32_t captured = (uint32_t)scan_extract_bits(rest_tdo.data(), rest.fields[capture_field].offset, BSR_WIDTH);
+    uint32_t pins_mask = (1u << BSR_UP_DOWN_CELL) | (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_SCK_CELL) |
+                         (1u << BSR_SPI_MOSI_CELL);
+    
+    printf("Hybrid Handoff Analysis:\n");
+    printf("  Setup:         %d scans, %llu TCK cycles on the native model\n", setup_scans + 3,
+           (unsigned long long)session.setup_bits);
+    printf("  Read-back:     %s (%s, IR 0x%X, update 0x%04X)\n", same ? "matches" : "DIFFERS",
+           tap_state_name(loaded.current_state), loaded.instruction_reg, loaded.update_register);
+    printf("  Continuation:  %d TCK cycles, IDCODE 0x%08X, EXTEST pins 0x%04X\n", rest.bit_count, idcode,
+           captured & pins_mask);
+    fflush(stdout);
+    
+    if (shifted && same && idcode == 0x12345678 && (captured & pins_mask) == (pattern & pins_mask) &&
+        jtag_tracked_state() == RUN_TEST_IDLE) {
+        printf("PASS: Hybrid handoff test PASSED - Session continued from transferred state\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Hybrid handoff test FAILED - State not transferred\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// One IDCODE read per call, with the instruction loaded through the cache
+static bool poll_idcode(int hif, bool force, uint32_t* idcode) {
+    static ScanProgram program;
+    if (!jtag_load_instruction(hif, 0x1, force)) {
+        return false;
+    }
+    program.clear(jtag_tracked_state());
+    int field = program.shift_dr(0, 32);
+    program.goto_state(RUN_TEST_IDLE);
+    uint8_t tdo[8] = { 0 };
+    if (!djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo, program.bit_count)) {
+        return false;
+    }
+    *idcode = (uint32_t)scan_extract_bits(tdo, program.fields[field].offset, 32);
+    return true;
+}
+
+// Test the instruction register cache
+// Polls IDCODE with forced IR loads and through the cache; the cached loop
+// must skip every reload after the first and save exactly those IR scans.
+// Also checks that per-bit IR loads are tracked and that Test-Logic-Reset
+// invalidates the cache.
+int test_ir_cache(int hif) {
+    printf("\n=== Testing Instruction Register Cache ===\n");
+    fflush(stdout);
+    
+    const int polls = 16;
+    int tap = jtag_device_tap(hif);
+    UsbAdapterModel& usb = djtg_usb_model();
+    JtagIrCacheStats start = jtag_ir_cache_stats();
+    bool reads_ok = true;
+    uint32_t idcode = 0;
+    
+    // Forced: one IR scan per poll
+    uint64_t tck_before = usb.stats.tck_cycles;
+    for (int i = 0; i < polls; i++) {
+        reads_ok = poll_idcode(hif, true, &idcode) && idcode == 0x12345678 && reads_ok;
+    }
+    uint64_t tck_forced = usb.stats.tck_cycles - tck_before;
+    
+    // Cached: the IDCODE loaded by the last forced poll stays selected
+    tck_before = usb.stats.tck_cycles;
+    for (int i = 0; i < polls; i++) {
+        reads_ok = poll_idcode(hif, false, &idcode) && idcode == 0x12345678 && reads_ok;
+    }
+    uint64_t tck_cached = usb.stats.tck_cycles - tck_before;
+    uint64_t loads = jtag_ir_cache_stats().loads - start.loads;
+    uint64_t skips = jtag_ir_cache_stats().skips - start.skips;
+    
+    // Per-bit load of SAMPLE, then Test-Logic-Reset
+    navigate_to_shift_ir();
+    shift_data_register(hif, 0x2, 4, true);
+    exit_to_run_test_idle();
+    int tracked_sample = jtag_loaded_instruction(tap);
+    tap_reset();
+    int after_reset = jtag_loaded_instruction(tap);
+    uint64_t loads_before = jtag_ir_cache_stats().loads;
+    reads_ok = poll_idcode(hif, false, &idcode) && idcode == 0x12345678 && reads_ok;
+    bool reloaded = jtag_ir_cache_stats().loads == loads_before + 1;
+    
+    uint64_t ir_scan_bits = (tck_forced - tck_cached) / polls;
+    printf("IR Cache Analysis:\n");
+    printf("  Polls:         %d forced, %d cached (%llu loads, %llu skipped)\n", polls, polls,
+           (unsigned long long)loads, (unsigned long long)skips);
+    printf("  TCK cycles:    %llu forced, %llu cached (%.0f%%)\n", (unsigned long long)tck_forced,
+           (unsigned long long)tck_cached, 100.0 * tck_cached / tck_forced);
+    printf("  Tracking:      per-bit load 0x%X, after reset %d, reloaded %s\n", tracked_sample, after_reset,
+           reloaded ? "yes" : "no");
+    fflush(stdout);
+    
+    if (reads_ok && loads == (uint64_t)polls && skips == (uint64_t)polls && ir_scan_bits > 0 &&
+        tck_forced - tck_cached == (uint64_t)polls * ir_scan_bits && tracked_sample == 0x2 &&
+        after_reset == -1 && reloaded) {
+        printf("PASS: IR cache test PASSED - Redundant IR scans skipped\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: IR cache test FAILED - Cache state or TCK accounting wrong\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the access reordering optimizer
+// Host code written access by access: eight rounds of an IDCODE read, a
+// SAMPLE capture and a BYPASS echo, then a PRELOAD, an EXTEST scan that
+// depends on it and a BYPASS scan that must follow the EXTEST scan. The
+// optimizer must group the rounds by instruction, keep the declared order
+// and return the same data as the host order would. A second batch checks
+// that the next instruction is the one with the longest runnable chain.
+int test_access_reordering(int hif) {
+    printf("\n=== Testing Access Reordering ===\n");
+    fflush(stdout);
+    
+    const int rounds = 8;
+    const uint32_t pattern = (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_SCK_CELL) | BSR_COUNT_OE_MASK | 1u;
+    AccessBatch batch;
+    std::vector<int> idcode_reads, echoes;
+    for (int i = 0; i < rounds; i++) {
+        idcode_reads.push_back(batch.add(0x1, 0, 32));
+        batch.add(0x2, 0, BSR_WIDTH);
+        echoes.push_back(batch.add(0xF, 0xA5 ^ i, 9));
+    }
+    int preload = batch.add(0x2, pattern, BSR_WIDTH);
+    int extest = batch.add(0x0, pattern, BSR_WIDTH, { preload });
+    int restore = batch.add(0xF, 0, 1, { extest });
+    
+    bool ran = batch.run(hif) == TRUE;
+    bool data_ok = ran;
+    for (int i = 0; i < rounds; i++) {
+        data_ok = data_ok && batch.accesses[idcode_reads[i]].result == 0x12345678 &&
+                  batch.accesses[echoes[i]].result >> 1 == (uint64_t)(0xA5 ^ i);
+    }
+    uint32_t pins_mask = (1u << BSR_UP_DOWN_CELL) | (1u << BSR_SPI_CS_N_CELL) | (1u << BSR_SPI_SCK_CELL) |
+                         (1u << BSR_SPI_MOSI_CELL);
+    uint32_t pins = (uint32_t)batch.accesses[extest].result & pins_mask;
+    bool order_ok = ran && batch.accesses[preload].order < batch.accesses[extest].order &&
+                    batch.accesses[extest].order < batch.accesses[restore].order;
+    
+    printf("Access Reordering Analysis:\n");
+    printf("  Accesses:      %d (%d rounds of IDCODE/SAMPLE/BYPASS + PRELOAD, EXTEST, BYPASS)\n",
+           (int)batch.accesses.size(), rounds);
+    printf("  Host order:    %d IR loads, %d TCK cycles\n", batch.in_order_ir_loads, batch.in_order_bits);
+    printf("  Reordered:     %d IR loads, %d TCK cycles (%.0f%%)\n", batch.ir_loads, batch.program_bits,
+           batch.in_order_bits ? 100.0 * batch.program_bits / batch.in_order_bits : 0.0);
+    printf("  Results:       %s, EXTEST pins 0x%04X, dependencies %s\n", data_ok ? "ok" : "WRONG", pins,
+           order_ok ? "kept" : "VIOLATED");
+    fflush(stdout);
+    
+    // IDCODE and SAMPLE each have one ready access, but only SAMPLE can run
+    // twice before the second IDCODE read is unblocked: loading SAMPLE first
+    // saves an IR load over taking the earliest access
+    AccessBatch chain;
+    int first_read = chain.add(0x1, 0, 32);
+    chain.add(0x2, 0, BSR_WIDTH);
+    int second_sample = chain.add(0x2, 0, BSR_WIDTH);
+    int second_read = chain.add(0x1, 0, 32, { second_sample });
+    bool chain_ok = chain.run(hif) == TRUE && chain.ir_loads == 2 &&
+                    chain.accesses[first_read].result == 0x12345678 &&
+                    chain.accesses[second_read].result == 0x12345678;
+    printf("  Chain choice:  %d IR loads (host order %d)%s\n", chain.ir_loads, chain.in_order_ir_loads,
+           chain_ok ? "" : ", WRONG");
+    fflush(stdout);
+    
+    if (data_ok && order_ok && chain_ok && pins == (pattern & pins_mask) && batch.ir_loads <= 5 &&
+        batch.program_bits < batch.in_order_bits && jtag_tracked_state() == RUN_TEST_IDLE) {
+        printf("PASS: Access reordering test PASSED - Accesses grouped by instruction\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Access reordering test FAILED - Schedule or results wrong\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the write-combining BSR shadow
+// Pin-by-pin host code sets up_down, each count and enable cell and SCK for
+// eight steps, committing once per step. Every commit must be one scan that
+// leaves the update register equal to the shadow (checked by backdoor
+// read); rewriting the committed values must not scan; a read with a
+// pending write must see that write. A shadow on a HIF wired to the second
+// instance must drive that instance from its own TAP state.
+int test_bsr_shadow(int hif) {
+    printf("\n=== Testing BSR Write-Combining Shadow ===\n");
+    fflush(stdout);
+    
+    const int steps = 8;
+    int tap = jtag_device_tap(hif);
+    BsrShadow shadow(hif, (1u << BSR_SPI_CS_N_CELL) | BSR_COUNT_OE_MASK | 1u);
+    bool ok = shadow.begin() == TRUE;
+    bool drive_ok = true, read_ok = true;
+    int step_scans = 0;
+    
+    for (int i = 0; i < steps; i++) {
+        uint64_t scans_before = shadow.scans;
+        shadow.write_cell(BSR_UP_DOWN_CELL, i & 1);
+        for (int b = 0; b < BSR_COUNTER_N; b++) {
+            shadow.write_cell(BSR_COUNT_DATA_CELL + b, (i >> b) & 1);
+            shadow.write_cell(BSR_COUNT_OE_CELL + b, b != (i & 3));
+        }
+        shadow.write_cell(BSR_SPI_SCK_CELL, (i >> 1) & 1);
+        ok = shadow.commit() && ok;
+        step_scans += (int)(shadow.scans - scans_before);
+        
+        JtagTapSnapshot snapshot;
+        drive_ok = jtag_backdoor_read(tap, &snapshot) && snapshot.update_register == shadow.value && drive_ok;
+        if (i & 1) {
+            uint32_t sck = 0;
+            ok = shadow.read(BSR_FIELD_SPI_SCK, &sck) && ok;
+            read_ok = sck == (uint32_t)((i >> 1) & 1) && read_ok;
+        }
+    }
+    
+    // Rewriting the committed values needs no scan
+    uint64_t scans_before = shadow.scans;
+    shadow.write(BSR_FIELD_UP_DOWN, shadow.value & 1);
+    shadow.write(BSR_FIELD_COUNT, (shadow.value & BSR_COUNT_MASK) >> BSR_COUNT_DATA_CELL);
+    ok = shadow.commit() && ok;
+    bool combined = shadow.scans == scans_before && shadow.empty_commits == 1;
+    
+    // Read barrier: the pending MOSI write is driven before the capture
+    uint32_t mosi = 0;
+    shadow.write_cell(BSR_SPI_MOSI_CELL, true);
+    ok = shadow.read(BSR_FIELD_SPI_MOSI, &mosi) && ok;
+    read_ok = mosi == 1 && !shadow.dirty() && read_ok;
+    ok = shadow.end() && ok;
+    
+    // A HIF wired to another instance compiles from that TAP's state: it is
+    // left in Test-Logic-Reset while the primary TAP is in Run-Test/Idle
+    bool other_ok = true;
+    if (jtag_tap_count() > 1) {
+        int other_hif = hif + 1;
+        uint8_t reset_tms = 0x1F, reset_tdi = 0;
+        other_ok = jtag_assign_tap(other_hif, 1) && enable_with_retry(other_hif) &&
+                   djtg_shift_bits(other_hif, &reset_tms, &reset_tdi, nullptr, 5);
+        BsrShadow other(other_hif, (1u << BSR_SPI_CS_N_CELL) | BSR_COUNT_OE_MASK);
+        other_ok = other_ok && other.begin();
+        other.write(BSR_FIELD_COUNT, 0xA);
+        other_ok = other_ok && other.commit();
+        JtagTapSnapshot snapshot;
+        other_ok = other_ok && jtag_backdoor_read(1, &snapshot) && snapshot.update_register == other.value &&
+                   other.end() && jtag_tracked_state(1) == RUN_TEST_IDLE;
+        djtg_disable(other_hif);
+    }
+    
+    printf("BSR Shadow Analysis:\n");
+    printf("  Writes:        %llu pin writes, %llu commits, %llu scans (%d for %d steps)\n",
+           (unsigned long long)shadow.writes, (unsigned long long)shadow.commits,
+           (unsigned long long)shadow.scans, step_scans, steps);
+    printf("  Update reg:    %s shadow after every commit\n", drive_ok ? "matched" : "DIFFERED from");
+    printf("  Reads:         %s, unchanged rewrite %s\n", read_ok ? "ok" : "WRONG",
+           combined ? "skipped" : "SCANNED");
+    printf("  Other TAP:     %s\n", jtag_tap_count() > 1 ? (other_ok ? "driven from its own state" : "WRONG") :
+                                                            "not present");
+    fflush(stdout);
+    
+    if (ok && drive_ok && read_ok && combined && other_ok && step_scans == steps) {
+        printf("PASS: BSR shadow test PASSED - Pin writes combined into one scan per step\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: BSR shadow test FAILED - Writes not combined or not driven\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// TDO handed to step observers per bit, -1 where they are told it is
+// unobserved
+class TdoRecorder : public JtagStepObserver {
+public:
+    std::vector<int> tdo;
+
+    void on_step(TapState state, bool tms, bool tdi, bool tdo_bit) override { tdo.push_back(tdo_bit); }
+    void on_unobserved(TapState state, bool tms, bool tdi) override { tdo.push_back(-1); }
+};
+
+// Test scans with expected TDO
+// A BYPASS echo and an IDCODE read are verified against a reference TDO
+// under a mask of those fields. The clean run must pass and return only
+// status bytes; two flipped expectations must report the first index, the
+// count and the actual TDO after it, and observers must get only real TDO,
+// with the bits after the window unobserved; with abort the scan must stop
+// at the end of the window, leaving Shift-DR for the caller to leave.
+int test_shift_expect(int hif) {
+    printf("\n=== Testing Scan With Expected TDO ===\n");
+    fflush(stdout);
+    
+    const int scan_bits = 4096;
+    const int window = 16;
+    std::vector<uint8_t> data(scan_bits / 8);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 53 + 7);
+    }
+    ScanProgram program;
+    program.shift_ir(0xF, 4);   // BYPASS
+    int echo_field = program.shift_dr_bytes(data.data(), scan_bits + 1);
+    program.shift_ir(0x1, 4);   // IDCODE
+    int idcode_field = program.shift_dr(0, 32);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    std::vector<uint8_t> expected((program.bit_count + 7) / 8), mask((program.bit_count + 7) / 8);
+    bool ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), expected.data(), program.bit_count);
+    scan_deposit_bits(mask.data(), program.fields[idcode_field].offset, 0xFFFFFFFF, 32);
+    for (int i = 0; i < scan_bits; i++) {
+        scan_deposit_bits(mask.data(), program.fields[echo_field].offset + 1 + i, 1, 1);
+    }
+    uint32_t idcode = (uint32_t)scan_extract_bits(expected.data(), program.fields[idcode_field].offset, 32);
+    
+    // Clean verify: status only over the adapter
+    UsbAdapterModel& usb = djtg_usb_model();
+    UsbAdapterStats before = usb.stats;
+    JtagExpectResult clean;
+    ok = djtg_shift_expect(hif, program.tms.data(), program.tdi.data(), expected.data(), mask.data(),
+                           program.bit_count, 0, 0, &clean) && ok;
+    UsbAdapterStats verify = usb.stats.since(before);
+    bool clean_ok = clean.pass && clean.first_mismatch == -1 && clean.bits_shifted == program.bit_count;
+    
+    // Two wrong expectations
+    int first = program.fields[echo_field].offset + 1 + 1000;
+    int second = first + 2000;
+    std::vector<uint8_t> wrong = expected;
+    wrong[first / 8] ^= 1 << (first % 8);
+    wrong[second / 8] ^= 1 << (second % 8);
+    JtagExpectResult full;
+    TdoRecorder recorder;
+    recorder.tdo.reserve(program.bit_count);
+    jtag_add_step_observer(&recorder);
+    ok = djtg_shift_expect(hif, program.tms.data(), program.tdi.data(), wrong.data(), mask.data(),
+                           program.bit_count, 0, window, &full) && ok;
+    jtag_remove_step_observer(&recorder);
+    bool full_ok = !full.pass && full.first_mismatch == first && full.mismatches == 2 &&
+                   full.bits_shifted == program.bit_count && full.window_bits == window &&
+                   full.window == scan_extract_bits(expected.data(), first, window);
+    
+    // Observers: real TDO wherever they get a value, the whole window, and
+    // nothing after it where the second mismatch is not located
+    int observed = 0, wrong_observed = 0;
+    for (int i = 0; i < (int)recorder.tdo.size(); i++) {
+        if (recorder.tdo[i] >= 0) {
+            observed++;
+            wrong_observed += recorder.tdo[i] != (int)((expected[i / 8] >> (i % 8)) & 1);
+        }
+    }
+    bool window_observed = (int)recorder.tdo.size() == program.bit_count;
+    for (int i = first; window_observed && i < first + window; i++) {
+        window_observed = recorder.tdo[i] >= 0;
+    }
+    bool observers_ok = window_observed && wrong_observed == 0 && recorder.tdo[second] < 0;
+    
+    // Abort at the end of the failure window
+    JtagExpectResult aborted;
+    ok = djtg_shift_expect(hif, program.tms.data(), program.tdi.data(), wrong.data(), mask.data(),
+                           program.bit_count, JTAG_EXPECT_ABORT, window, &aborted) && ok;
+    bool abort_ok = !aborted.pass && aborted.first_mismatch == first && aborted.mismatches == 1 &&
+                    aborted.bits_shifted == first + window && jtag_tracked_state() == SHIFT_DR;
+    ScanProgram recover(jtag_tracked_state());
+    recover.goto_state(RUN_TEST_IDLE);
+    ok = djtg_shift_bits(hif, recover.tms.data(), recover.tdi.data(), nullptr, recover.bit_count) && ok;
+    
+    printf("Expected TDO Analysis:\n");
+    printf("  Program:       %d bits, IDCODE 0x%08X\n", program.bit_count, idcode);
+    printf("  Clean verify:  %s, %llu bytes back (TDO read is %d)\n", clean_ok ? "pass" : "WRONG",
+           (unsigned long long)verify.bytes_in, (program.bit_count + 7) / 8);
+    printf("  Two flips:     first %d, %d mismatches, window 0x%04llX\n", full.first_mismatch, full.mismatches,
+           (unsigned long long)full.window);
+    printf("  Observers:     %d of %d bits observed, %d wrong, window %s\n", observed, program.bit_count,
+           wrong_observed, window_observed ? "observed" : "MISSING");
+    printf("  Abort:         %d of %d bits shifted, first %d\n", aborted.bits_shifted, program.bit_count,
+           aborted.first_mismatch);
+    fflush(stdout);
+    
+    if (ok && clean_ok && full_ok && observers_ok && abort_ok && idcode == 0x12345678 &&
+        verify.bytes_in < (uint64_t)program.bit_count / 8) {
+        printf("PASS: Expected TDO test PASSED - Compare done in the backend\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Expected TDO test FAILED - Wrong compare result\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test sparse TDO capture windows
+// The IDCODE and two short stretches of a long BYPASS echo are captured
+// through windows; the packed result must equal the same bits of a full TDO
+// read, observers must see those bits alone, and far fewer bytes must come
+// back.
+int test_sparse_capture(int hif) {
+    printf("\n=== Testing Sparse TDO Capture ===\n");
+    fflush(stdout);
+    
+    const int scan_bits = 4096;
+    std::vector<uint8_t> data(scan_bits / 8);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 29 + 3);
+    }
+    ScanProgram program;
+    program.shift_ir(0xF, 4);   // BYPASS
+    int echo_field = program.shift_dr_bytes(data.data(), scan_bits + 1);
+    program.shift_ir(0x1, 4);   // IDCODE
+    int idcode_field = program.shift_dr(0, 32);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    int echo = program.fields[echo_field].offset + 1;
+    const JtagCaptureWindow windows[] = {
+        { echo + 100, 8 }, { echo + 3000, 45 }, { program.fields[idcode_field].offset, 32 }
+    };
+    const int window_count = sizeof(windows) / sizeof(windows[0]);
+    
+    UsbAdapterModel& usb = djtg_usb_model();
+    std::vector<uint8_t> full((program.bit_count + 7) / 8), packed(16);
+    UsbAdapterStats before = usb.stats;
+    bool ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), full.data(), program.bit_count);
+    UsbAdapterStats full_read = usb.stats.since(before);
+    before = usb.stats;
+    TdoRecorder recorder;
+    recorder.tdo.reserve(program.bit_count);
+    jtag_add_step_observer(&recorder);
+    ok = djtg_shift_capture(hif, program.tms.data(), program.tdi.data(), program.bit_count, windows, window_count,
+                            packed.data()) && ok;
+    jtag_remove_step_observer(&recorder);
+    UsbAdapterStats sparse_read = usb.stats.since(before);
+    
+    // Observers get the full read's TDO inside the windows, nothing outside
+    int observed = 0;
+    bool observers_ok = (int)recorder.tdo.size() == program.bit_count;
+    for (int i = 0; observers_ok && i < program.bit_count; i++) {
+        if (recorder.tdo[i] >= 0) {
+            observed++;
+            observers_ok = recorder.tdo[i] == (int)((full[i / 8] >> (i % 8)) & 1);
+        }
+    }
+    
+    bool same = true;
+    int packed_offset = 0;
+    for (int w = 0; w < window_count; w++) {
+        for (int i = 0; i < windows[w].length; i++, packed_offset++) {
+            int bit = windows[w].offset + i;
+            bool captured = (packed[packed_offset / 8] >> (packed_offset % 8)) & 1;
+            same = same && ((full[bit / 8] >> (bit % 8)) & 1) == captured;
+        }
+    }
+    uint32_t idcode = (uint32_t)scan_extract_bits(packed.data(), 8 + 45, 32);
+    uint32_t echo_byte = (uint32_t)scan_extract_bits(packed.data(), 0, 8);
+    
+    // Overlapping windows are rejected
+    const JtagCaptureWindow overlapping[] = { { 10, 8 }, { 12, 4 } };
+    bool rejected = !djtg_shift_capture(hif, program.tms.data(), program.tdi.data(), program.bit_count, overlapping,
+                                        2, packed.data());
+    
+    printf("Sparse Capture Analysis:\n");
+    printf("  Program:       %d bits, %d windows, %d bits captured\n", program.bit_count, window_count, packed_offset);
+    printf("  Result:        %s full read, IDCODE 0x%08X, echo byte 0x%02X\n", same ? "matches" : "DIFFERS from",
+           idcode, echo_byte);
+    printf("  Observers:     %d bits observed, %s\n", observed, observers_ok ? "matching" : "WRONG");
+    printf("  Bytes back:    %llu sparse / %llu full\n", (unsigned long long)sparse_read.bytes_in,
+           (unsigned long long)full_read.bytes_in);
+    printf("  Overlap:       %s\n", rejected ? "rejected" : "ACCEPTED");
+    fflush(stdout);
+    
+    if (ok && same && observers_ok && observed == packed_offset && rejected && idcode == 0x12345678 &&
+        echo_byte == scan_extract_bits(data.data(), 100, 8) &&
+        sparse_read.bytes_in * 8 < full_read.bytes_in) {
+        printf("PASS: Sparse capture test PASSED - Windows packed and returned alone\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Sparse capture test FAILED - Packed windows differ from full TDO\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Stimulus byte k of the streaming test
+static uint8_t stream_tdi_byte(uint64_t k) {
+    return (uint8_t)(k * 131 + (k >> 8) * 7 + 1);
+}
+
+// BYPASS delays TDI by one bit behind the 0 shifted in on entry
+static uint8_t stream_echo_byte(uint64_t k) {
+    return (uint8_t)((stream_tdi_byte(k) << 1) | (k ? stream_tdi_byte(k - 1) >> 7 : 0));
+}
+
+// Enters Shift-DR with BYPASS selected. The bypass register keeps its last
+// bit through Capture-DR, so one 0 is shifted in before the stream starts.
+static bool stream_enter_bypass(int hif) {
+    ScanProgram program(jtag_tracked_state());
+    program.shift_ir(0xF, 4);
+    program.goto_state(SHIFT_DR);
+    program.append_bit(false, false);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), nullptr, program.bit_count);
+}
+
+static bool stream_leave(int hif) {
+    ScanProgram program(jtag_tracked_state());
+    program.goto_state(RUN_TEST_IDLE);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), nullptr, program.bit_count);
+}
+
+// Test streaming sources and sinks
+// A generated BYPASS stream much longer than the chunk buffers is checked
+// by a comparator sink and hashed by a hash sink against the digest of the
+// whole expected stream; a file-mapped stream goes to a file sink whose
+// output must hold the echo. Buffer memory must not depend on the stream
+// length.
+int test_streaming(int hif) {
+    printf("\n=== Testing Streaming Sources and Sinks ===\n");
+    fflush(stdout);
+    
+    const uint64_t stream_bits = 1u << 18;
+    const int chunk_bits = 1 << 14;
+    const uint64_t file_bytes = 4096;
+    const std::string tdi_path = "build/stream_tdi.bin";
+    const std::string tdo_path = "build/stream_tdo.bin";
+    
+    GeneratorSource::GenerateFn generate = [stream_bits](uint64_t offset, uint8_t* tms, uint8_t* tdi, int bits) {
+        for (int i = 0; i < (bits + 7) / 8; i++) {
+            tdi[i] = stream_tdi_byte(offset / 8 + i);
+        }
+        if (offset + bits == stream_bits) {
+            tms[(bits - 1) / 8] |= 1 << ((bits - 1) % 8);   // Exit1-DR
+        }
+    };
+    
+    // Generator into a comparator
+    JtagStreamer streamer(hif, chunk_bits);
+    GeneratorSource source(generate, stream_bits);
+    ComparatorSink comparator([](uint64_t offset, uint8_t* expected, uint8_t* mask, int bits) {
+        for (int i = 0; i < (bits + 7) / 8; i++) {
+            expected[i] = stream_echo_byte(offset / 8 + i);
+        }
+    });
+    bool ok = stream_enter_bypass(hif);
+    ok = streamer.run(source, comparator) && ok;
+    ok = stream_leave(hif) && ok;
+    bool compare_ok = comparator.bits == stream_bits && comparator.first_mismatch == -1;
+    size_t buffer_bytes = streamer.buffer_bytes();
+    
+    // Same stream into a hash sink
+    std::vector<uint8_t> echo(stream_bits / 8);
+    for (size_t k = 0; k < echo.size(); k++) {
+        echo[k] = stream_echo_byte(k);
+    }
+    GeneratorSource hash_source(generate, stream_bits);
+    HashSink hash;
+    ok = stream_enter_bypass(hif) && ok;
+    ok = streamer.run(hash_source, hash) && ok;
+    ok = stream_leave(hif) && ok;
+    bool hash_ok = hash.bits == stream_bits && hash.hash == HashSink::digest(echo.data(), stream_bits);
+    
+    // Mapped file into a file
+    bool file_ok = false;
+    FILE* f = fopen(tdi_path.c_str(), "wb");
+    if (f) {
+        for (uint64_t k = 0; k < file_bytes; k++) {
+            fputc(stream_tdi_byte(k), f);
+        }
+        fclose(f);
+        MappedFileSource file_source(tdi_path, "", true);
+        FileSink file_sink(tdo_path);
+        ok = file_source.ok() && file_sink.ok() && stream_enter_bypass(hif) && ok;
+        ok = streamer.run(file_source, file_sink) && ok;
+        ok = stream_leave(hif) && ok;
+        
+        std::vector<uint8_t> tdo(file_bytes);
+        f = fopen(tdo_path.c_str(), "rb");
+        file_ok = f && fread(tdo.data(), 1, file_bytes, f) == file_bytes &&
+                  memcmp(tdo.data(), echo.data(), file_bytes) == 0;
+        if (f) {
+            fclose(f);
+        }
+    }
+    remove(tdi_path.c_str());
+    remove(tdo_path.c_str());
+    
+    printf("Streaming Analysis:\n");
+    printf("  Stream:        %llu bits in %d-bit chunks, %zu buffer bytes\n", (unsigned long long)stream_bits,
+           chunk_bits, buffer_bytes);
+    printf("  Comparator:    %llu bits, %llu mismatches\n", (unsigned long long)comparator.bits,
+           (unsigned long long)comparator.mismatches);
+    printf("  Hash:          0x%016llX, %s\n", (unsigned long long)hash.hash, hash_ok ? "matches" : "DIFFERS");
+    printf("  File:          %llu bytes, echo %s\n", (unsigned long long)file_bytes, file_ok ? "ok" : "WRONG");
+    fflush(stdout);
+    
+    if (ok && compare_ok && hash_ok && file_ok && buffer_bytes * 8 < stream_bits) {
+        printf("PASS: Streaming test PASSED - Constant-memory chunks match the whole stream\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Streaming test FAILED - Streamed TDO differs from the expected echo\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test run-length execution of constant stretches
+// With per-TCK stepping, a program dominated by constant TDI (zero and
+// all-ones BYPASS scans, an IDCODE read, a long idle) runs once
+// with run detection off and once with it on. TDO and simulated time must
+// match and most cycles must go through runs.
+int test_run_length(int hif) {
+    printf("\n=== Testing Run-Length Execution ===\n");
+    fflush(stdout);
+    
+    const int scan_bits = 4096;
+    std::vector<uint8_t> zeros(scan_bits / 8, 0x00), ones(scan_bits / 32, 0xFF);
+    ScanProgram program;
+    program.shift_ir(0xF, 4);   // BYPASS
+    program.shift_dr_bytes(zeros.data(), scan_bits);
+    program.shift_ir(0x1, 4);   // IDCODE
+    int idcode_field = program.shift_dr(0, 32);
+    program.shift_ir(0xF, 4);
+    program.shift_dr_bytes(ones.data(), scan_bits / 4);
+    program.idle(500);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    JtagBulkBackend* backend = jtag_bulk_backend();
+    jtag_set_bulk_backend(nullptr);
+    jtag_set_shift_path(JTAG_PATH_STEP);
+    std::vector<uint8_t> tdo_step((program.bit_count + 7) / 8), tdo_run((program.bit_count + 7) / 8);
+    
+    // The bypass register keeps its last bit; a first pass makes both start
+    // from the state the program leaves
+    jtag_set_run_min_bits(0);
+    bool ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), nullptr, program.bit_count);
+    long long start = sv_get_time_ps();
+    auto wall_start = std::chrono::steady_clock::now();
+    ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo_step.data(), program.bit_count) && ok;
+    auto wall_mid = std::chrono::steady_clock::now();
+    long long elapsed_step = sv_get_time_ps() - start;
+    
+    jtag_set_run_min_bits(JTAG_RUN_MIN_BITS_DEFAULT);
+    JtagRunStats before = jtag_run_stats();
+    start = sv_get_time_ps();
+    auto wall_run = std::chrono::steady_clock::now();
+    ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo_run.data(), program.bit_count) && ok;
+    auto wall_end = std::chrono::steady_clock::now();
+    long long elapsed_run = sv_get_time_ps() - start;
+    uint64_t runs = jtag_run_stats().runs - before.runs;
+    uint64_t run_bits = jtag_run_stats().run_bits - before.run_bits;
+    jtag_set_bulk_backend(backend);
+    jtag_set_shift_path(JTAG_PATH_AUTO);
+    jtag_set_run_min_bits(-1);
+    
+    uint32_t idcode = (uint32_t)scan_extract_bits(tdo_run.data(), program.fields[idcode_field].offset, 32);
+    bool same_tdo = tdo_step == tdo_run;
+    double us_step = std::chrono::duration<double, std::micro>(wall_mid - wall_start).count();
+    double us_run = std::chrono::duration<double, std::micro>(wall_end - wall_run).count();
+    
+    printf("Run-Length Analysis:\n");
+    printf("  Program:       %d bits, %llu runs covering %llu\n", program.bit_count, (unsigned long long)runs,
+           (unsigned long long)run_bits);
+    printf("  TDO:           %s, IDCODE 0x%08X\n", same_tdo ? "identical" : "DIFFERENT", idcode);
+    printf("  Sim time:      %lld ps / %lld ps (runs / per-TCK)\n", elapsed_run, elapsed_step);
+    printf("  Wall time:     %.0f us / %.0f us\n", us_run, us_step);
+    fflush(stdout);
+    
+    if (ok && same_tdo && idcode == 0x12345678 && elapsed_run == elapsed_step &&
+        run_bits * 10 >= (uint64_t)program.bit_count * 9) {
+        printf("PASS: Run-length test PASSED - Constant stretches match per-TCK stepping\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Run-length test FAILED - Runs diverge from per-TCK stepping\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Test the adaptive path choice
+// A model fed synthetic costs must place the crossovers where the fits
+// cross and pick per transfer length accordingly. On the live session the
+// same program through each available path must give the same TDO and
+// simulated time, so the automatic choice can never change results.
+int test_path_crossover(int hif) {
+    printf("\n=== Testing Adaptive Path Crossover ===\n");
+    fflush(stdout);
+    
+    // Step 1 us/bit; vector 50 us/call + 0.1 us/bit; runs 20 us + 0.05 us/bit
+    JtagPathModel model;
+    model.explore_interval = 0;
+    for (int n = 8; n <= 4096; n *= 2) {
+        model.record(JTAG_PATH_STEP, n, 1.0 * n);
+        model.record(JTAG_PATH_VECTOR, n, 50.0 + 0.1 * n);
+        model.record(JTAG_PATH_RUN, n, 20.0 + 0.05 * n);
+    }
+    unsigned available = (1u << JTAG_PATH_STEP) | (1u << JTAG_PATH_VECTOR);
+    int vector_from = model.crossover(JTAG_PATH_VECTOR);
+    int run_from = model.run_threshold(-1);
+    bool model_ok = vector_from == 56 && run_from == 22 && model.crossover(JTAG_PATH_BULK) == -1 &&
+                    model.choose(40, available) == JTAG_PATH_STEP && model.choose(80, available) == JTAG_PATH_VECTOR;
+    
+    // Every available path on the live session
+    ScanProgram program;
+    program.shift_ir(0x1, 4);   // IDCODE
+    int idcode_field = program.shift_dr(0, 32);
+    program.shift_ir(0xF, 4);   // BYPASS
+    program.shift_dr(0xA5A5A5A5, 33);
+    program.idle(64);
+    program.goto_state(RUN_TEST_IDLE);
+    
+    // A first pass leaves the bypass register as every later pass will
+    JtagShiftPath paths[] = { JTAG_PATH_STEP, JTAG_PATH_VECTOR, JTAG_PATH_BULK };
+    std::vector<uint8_t> reference;
+    long long reference_ps = 0;
+    bool ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), nullptr, program.bit_count);
+    bool same = true;
+    int tried = 0;
+    for (JtagShiftPath path : paths) {
+        // Without a backend the bulk pass steps, so the TDO stream is the
+        // same with JTAG_NATIVE_TLM=0
+        bool live = path != JTAG_PATH_BULK || jtag_bulk_backend();
+        std::vector<uint8_t> tdo((program.bit_count + 7) / 8);
+        jtag_set_shift_path(live ? path : JTAG_PATH_STEP);
+        long long start = sv_get_time_ps();
+        ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count) && ok;
+        long long elapsed = sv_get_time_ps() - start;
+        if (tried == 0) {
+            reference = tdo;
+            reference_ps = elapsed;
+        }
+        tried += live;
+        same = same && tdo == reference && elapsed == reference_ps;
+    }
+    jtag_set_shift_path(JTAG_PATH_AUTO);
+    uint32_t idcode = (uint32_t)scan_extract_bits(reference.data(), program.fields[idcode_field].offset, 32);
+    
+    printf("Path Crossover Analysis:\n");
+    printf("  Synthetic:     vector from %d bits, runs from %d bits (expected 56, 22)\n", vector_from, run_from);
+    printf("  Live paths:    %d tried, TDO and time %s, IDCODE 0x%08X\n", tried, same ? "identical" : "DIFFERENT",
+           idcode);
+    fflush(stdout);
+    jtag_path_model().print_report("Session path model so far");
+    
+    if (ok && model_ok && same && tried >= 2 && idcode == 0x12345678) {
+        printf("PASS: Path crossover test PASSED - Crossovers from measured costs, paths interchangeable\n");
+        fflush(stdout);
+        return 1;
+    } else {
+        printf("FAIL: Path crossover test FAILED - Wrong crossover or paths disagree\n");
+        fflush(stdout);
+        return 0;
+    }
+}
+
+// Failed test count from the last run_counter_jtag_tests call
+static int failed_test_count = 0;
+
+int counter_jtag_tests_failed() {
+    return failed_test_count;
+}
+
 // Main test runner
 // Executes the complete JTAG test suite for the up-down counter.
 // This function:
 // 1. Initializes the JTAG interface and sets clock frequency
 // 2. Resets the TAP controller to a known state
-// 3. Runs all test cases (IDCODE, SAMPLE, EXTEST, BYPASS, PRELOAD, Unknown, IR Capture, Complex Sequence, TAP States)
+// 3. Runs all test cases (IDCODE, SAMPLE, EXTEST, BYPASS, PRELOAD, Unknown, IR Capture, Complex Sequence, TAP States, Scan Cache, Allocations, Pipeline, RUNTEST, RISC-V DMI, ADIv5 DAP, SPI Flash, Pin Waveform, STAPL, TDO Hash, Coverage, Coverage Generation, Multi-TAP, USB Model, TLM Backend, Hybrid Handoff, IR Cache, Access Reordering, BSR Shadow, Expected TDO, Sparse Capture, Streaming, Run-Length, Path Crossover)
 // 4. Reports the overall test results
 void run_counter_jtag_tests() {
     printf("\n");
@@ -770,31 +2648,181 @@ void run_counter_jtag_tests() {
     // Reset TAP controller
     tap_reset();
     
-    // Run all tests
+    // Run all tests. Each test's TDO stream is hashed; with
+    // JTAG_TDO_BASELINE set the digests are compared against that file, or
+    // saved to it when it does not exist yet.
+    static const struct {
+        const char* name;
+        int (*run)(int hif);
+    } tests[] = {
+        { "idcode", test_counter_idcode },
+        { "boundary_scan_sample", test_boundary_scan_sample },
+        { "boundary_scan_extest", test_boundary_scan_extest },
+        { "bypass", test_bypass },
+        { "preload_instruction", test_preload_instruction },
+        { "unknown_instruction", test_unknown_instruction },
+        { "instruction_register_capture", test_instruction_register_capture },
+        { "complex_instruction_sequence", test_complex_instruction_sequence },
+        { "tap_state_transitions", test_tap_state_transitions },
+        { "scan_program_cache", test_scan_program_cache },
+        { "steady_state_allocations", test_steady_state_allocations },
+        { "scan_pipeline", test_scan_pipeline },
+        { "runtest_idle_clocking", test_runtest_idle_clocking },
+        { "riscv_dmi", test_riscv_dmi },
+        { "adiv5_dap", test_adiv5_dap },
+        { "spi_flash", test_spi_flash },
+        { "pin_waveform", test_pin_waveform },
+        { "stapl_player", test_stapl_player },
+        { "tdo_hash", test_tdo_hash },
+        { "functional_coverage", test_functional_coverage },
+        { "coverage_generation", test_coverage_generation },
+        { "multi_tap", test_multi_tap },
+        { "usb_adapter_model", test_usb_adapter_model },
+        { "tlm_backend", test_tlm_backend },
+        { "hybrid_handoff", test_hybrid_handoff },
+        { "ir_cache", test_ir_cache },
+        { "access_reordering", test_access_reordering },
+        { "bsr_shadow", test_bsr_shadow },
+        { "shift_expect", test_shift_expect },
+        { "sparse_capture", test_sparse_capture },
+        { "streaming", test_streaming },
+        { "run_length", test_run_length },
+        { "path_crossover", test_path_crossover },
+    };
     int passed_tests = 0;
-    int total_tests = 9;  // Updated to include all new tests
+    int total_tests = (int)(sizeof(tests) / sizeof(tests[0]));
+    
+    const char* checkpoint_env = getenv("JTAG_TDO_CHECKPOINT_BITS");
+    TdoStreamHasher hasher(checkpoint_env ? strtoull(checkpoint_env, nullptr, 0) : 4096);
+    jtag_add_step_observer(&hasher);
+    JtagCoverage coverage;
+    jtag_add_step_observer(&coverage);
+    
+    // Adapter/USB cost of each test's djtg_* call pattern
+    UsbAdapterModel& usb = djtg_usb_model();
+    usb.config.load_env();
+    UsbAdapterStats usb_start = usb.stats;
+    std::vector<UsbAdapterStats> usb_per_test(total_tests);
     
     printf("Running JTAG tests...\n");
     fflush(stdout);
     
-    passed_tests += test_counter_idcode(hif);
-    passed_tests += test_boundary_scan_sample(hif);
-    passed_tests += test_boundary_scan_extest(hif);
-    passed_tests += test_bypass(hif);
-    passed_tests += test_preload_instruction(hif);
-    passed_tests += test_unknown_instruction(hif);
-    passed_tests += test_instruction_register_capture(hif);
-    passed_tests += test_complex_instruction_sequence(hif);
-    passed_tests += test_tap_state_transitions(hif);
+    for (int i = 0; i < total_tests; i++) {
+        UsbAdapterStats usb_before = usb.stats;
+        hasher.begin_test(tests[i].name);
+        passed_tests += tests[i].run(hif);
+        hasher.end_test();
+        usb_per_test[i] = usb.stats.since(usb_before);
+    }
+    
+    printf("\nTDO stream digests:\n");
+    for (size_t i = 0; i < hasher.digests.size(); i++) {
+        const TdoDigest& d = hasher.digests[i];
+        printf("  %-30s 0x%016llX 0x%016llX %8llu bits %5llu scans\n", d.test.c_str(),
+               (unsigned long long)d.tdo_hash, (unsigned long long)d.boundary_hash,
+               (unsigned long long)d.bits, (unsigned long long)d.scans);
+    }
+    fflush(stdout);
+    
+    printf("\nUSB adapter model (%d-byte transfers, %.0f us turnaround):\n", usb.config.max_transfer_bytes,
+           usb.config.turnaround_us);
+    for (int i = 0; i < total_tests; i++) {
+        const UsbAdapterStats& u = usb_per_test[i];
+        if (u.calls == 0) {
+            continue;
+        }
+        printf("  %-30s %6llu calls %6llu small %10.1f us %3.0f%% latency\n", tests[i].name,
+               (unsigned long long)u.calls, (unsigned long long)u.small_calls, u.total_us(),
+               100.0 * u.turnaround_us / u.total_us());
+    }
+    usb.print_report("USB adapter total", usb.stats.since(usb_start));
+    printf("\n");
+    jtag_path_model().print_report("Shift path model");
+    
+    int tdo_mismatches = 0;
+    const char* baseline_path = getenv("JTAG_TDO_BASELINE");
+    if (baseline_path) {
+        uint64_t baseline_checkpoint_bits = 0;
+        std::vector<TdoDigest> baseline;
+        if (!TdoStreamHasher::load_baseline(baseline_path, &baseline_checkpoint_bits, &baseline)) {
+            int saved = hasher.save_baseline(baseline_path);
+            printf("TDO baseline %s: %s\n", saved ? "saved to" : "could not be written to", baseline_path);
+        } else if (baseline_checkpoint_bits != hasher.checkpoint_bits) {
+            printf("TDO baseline %s uses %llu-bit checkpoints, run uses %llu: not compared\n", baseline_path,
+                   (unsigned long long)baseline_checkpoint_bits, (unsigned long long)hasher.checkpoint_bits);
+        } else {
+            for (int i = 0; i < total_tests && i < (int)hasher.digests.size(); i++) {
+                const TdoDigest* expected = nullptr;
+                for (size_t j = 0; j < baseline.size(); j++) {
+                    if (baseline[j].test == hasher.digests[i].test) {
+                        expected = &baseline[j];
+                    }
+                }
+                TdoMismatch mismatch;
+                if (!expected || TdoStreamHasher::compare(*expected, hasher.digests[i], hasher.checkpoint_bits,
+                                                          &mismatch)) {
+                    continue;
+                }
+                TdoStreamHasher::locate(hasher.digests[i], hasher.checkpoint_bits, &mismatch);
+                printf("TDO MISMATCH: %s window %d (bits %llu-%llu)%s\n", mismatch.test.c_str(), mismatch.window,
+                       (unsigned long long)mismatch.first_bit, (unsigned long long)mismatch.last_bit,
+                       mismatch.boundary ? ", scan structure changed" : "");
+                if (mismatch.located) {
+                    printf("  scans %llu-%llu, first is %s scan of %u bits under IR 0x%X\n",
+                           (unsigned long long)mismatch.first_scan.index,
+                           (unsigned long long)mismatch.last_scan.index, mismatch.first_scan.ir ? "an IR" : "a DR",
+                           mismatch.first_scan.length, mismatch.first_scan.instruction);
+                }
+                tdo_mismatches++;
+            }
+        }
+        fflush(stdout);
+    }
+    jtag_remove_step_observer(&hasher);
+    jtag_remove_step_observer(&coverage);
+    
+    // Functional coverage of the whole run. With JTAG_COVERAGE_FILE set the
+    // run is merged into that file, so shards accumulate into one map. With
+    // JTAG_COVERAGE_GENERATE set, generated scans then target the remaining
+    // holes of the merged map.
+    printf("\n");
+    coverage.print_summary("Functional coverage");
+    const char* coverage_path = getenv("JTAG_COVERAGE_FILE");
+    JtagCoverageMap accumulated;
+    bool existing = coverage_path && accumulated.load(coverage_path) == TRUE;
+    if (getenv("JTAG_COVERAGE_GENERATE")) {
+        coverage.map.merge(accumulated);
+        CoverageGenerator generator(hif, &coverage);
+        generator.run();
+        printf("Coverage generation: %d rounds, %d bins added, %d excluded, %d unreachable, %s\n",
+               generator.rounds, generator.bins_added, generator.excluded, generator.missed,
+               generator.saturated ? "saturated" : "budget exhausted");
+        fflush(stdout);
+    }
+    if (coverage_path) {
+        int added = accumulated.merge(coverage.map);
+        if (accumulated.save(coverage_path)) {
+            printf("Coverage %s %s: %d new bins, %d/%d total\n", existing ? "merged into" : "saved to",
+                   coverage_path, added, accumulated.count(), JTAG_COVERAGE_BINS);
+        } else {
+            printf("Coverage could not be written to %s\n", coverage_path);
+        }
+        fflush(stdout);
+    }
     
     // Disable device
     djtg_disable(hif);
     
+    failed_test_count = total_tests - passed_tests + tdo_mismatches;
+    
     // Print results
     printf("\n");
     printf("═══════════════════════════════════════════════════════════════\n");
     printf("Test Results: %d/%d passed\n", passed_tests, total_tests);
-    if (passed_tests == total_tests) {
+    if (tdo_mismatches > 0) {
+        printf("TDO baseline mismatches: %d\n", tdo_mismatches);
+    }
+    if (failed_test_count == 0) {
         printf("All tests passed!\n");
     } else {
         printf("Some tests failed\n");
@@ -803,3 +2831,47 @@ void run_counter_jtag_tests() {
     printf("=== All Tests Completed ===\n");
     fflush(stdout);
 }
+
+// Session on an additional TAP instance
+// The testbench forks one call per instance after the main suite; each
+// session owns its HIF, so the calls run concurrently in simulated time.
+// Whatever a shift keeps between simulated-time steps is per HIF or on the
+// stack; only instance 0's bulk-transfer slot is shared, and instance 0 is
+// never one of these sessions.
+static int tap_session_failures = 0;
+
+int tap_sessions_failed() {
+    return tap_session_failures;
+}
+
+void run_tap_session(int tap) {
+    int hif = 16 + tap;
+    printf("TAP %d: session starting at %lld ps\n", tap, jtag_sim_time_ps());
+    fflush(stdout);
+    
+    bool ok = jtag_assign_tap(hif, tap) && enable_with_retry(hif);
+    uint32_t idcode = 0, echo = 0, jedec_id = 0;
+    if (ok) {
+        ScanProgram program;
+        int idcode_field, echo_field;
+        build_tap_check_program(program, 0x5E550000u | (uint32_t)tap, &idcode_field, &echo_field);
+        std::vector<uint8_t> tdo((program.bit_count + 7) / 8);
+        ok = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count) == TRUE;
+        idcode = (uint32_t)scan_extract_bits(tdo.data(), program.fields[idcode_field].offset, 32);
+        echo = (uint32_t)(scan_extract_bits(tdo.data(), program.fields[echo_field].offset, 33) >> 1);
+        
+        // The instance's own flash behind its boundary scan cells
+        SpiFlashProgrammer flash(hif);
+        ok = ok && flash.begin() && flash.read_id(&jedec_id) && flash.end();
+        djtg_disable(hif);
+    }
+    
+    ok = ok && idcode == 0x12345678u + ((uint32_t)tap << 28) && echo == (0x5E550000u | (uint32_t)tap) &&
+         jedec_id == 0xEF4016;
+    if (!ok) {
+        tap_session_failures++;
+    }
+    printf("TAP %d: IDCODE 0x%08X, echo 0x%08X, flash ID 0x%06X - %s\n", tap, idcode, echo, jedec_id,
+           ok ? "PASS" : "FAIL");
+    fflush(stdout);
+}
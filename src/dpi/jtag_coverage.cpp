@@ -0,0 +1,195 @@
+// jtag_coverage.cpp
+// Host-side functional coverage bitmaps collected from the TCK step stream
+
+#include <cstdio>
+#include <cstring>
+#include "jtag_coverage.h"
+
+#define JTAG_COVERAGE_MAGIC    0x564F434Au   // "JCOV"
+#define JTAG_COVERAGE_VERSION  1u
+
+#define IR_EXTEST  0x0
+#define IR_IDCODE  0x1
+#define IR_SAMPLE  0x2
+
+// Value jtag_instruction_register.sv loads in Capture-IR
+#define IR_CAPTURE_PATTERN  0x5
+
+static const int group_sizes[COV_GROUP_COUNT] = { 16, 32, 16, 256, 2 * BSR_WIDTH, 2 * BSR_WIDTH, 16 };
+
+static const char* const group_names[COV_GROUP_COUNT] = {
+    "TAP states", "FSM edges", "Instructions", "Instruction x state",
+    "BSR cells driven", "BSR cells captured", "Counter values"
+};
+
+int coverage_group_offset(JtagCoverageGroup group) {
+    int offset = 0;
+    for (int g = 0; g < group; g++) {
+        offset += group_sizes[g];
+    }
+    return offset;
+}
+
+int coverage_group_size(JtagCoverageGroup group) {
+    return group_sizes[group];
+}
+
+const char* coverage_group_name(JtagCoverageGroup group) {
+    return group_names[group];
+}
+
+void JtagCoverageMap::clear() {
+    memset(words, 0, sizeof(words));
+}
+
+int JtagCoverageMap::merge(const JtagCoverageMap& other) {
+    int added = 0;
+    for (int i = 0; i < JTAG_COVERAGE_WORDS; i++) {
+        added += count_set_bits(other.words[i] & ~words[i]);
+        words[i] |= other.words[i];
+    }
+    return added;
+}
+
+int JtagCoverageMap::count(JtagCoverageGroup group) const {
+    int offset = coverage_group_offset(group);
+    int covered = 0;
+    for (int i = 0; i < group_sizes[group]; i++) {
+        covered += test(offset + i);
+    }
+    return covered;
+}
+
+int JtagCoverageMap::count() const {
+    int covered = 0;
+    for (int i = 0; i < JTAG_COVERAGE_WORDS; i++) {
+        covered += count_set_bits(words[i]);
+    }
+    return covered;
+}
+
+int JtagCoverageMap::save(const std::string& path) const {
+    std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        return FALSE;
+    }
+    uint32_t header[3] = { JTAG_COVERAGE_MAGIC, JTAG_COVERAGE_VERSION, JTAG_COVERAGE_BINS };
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1 && fwrite(words, sizeof(words), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Files from a different bin layout are rejected rather than misread
+int JtagCoverageMap::load(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return FALSE;
+    }
+    uint32_t header[3];
+    uint64_t loaded[JTAG_COVERAGE_WORDS];
+    bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == JTAG_COVERAGE_MAGIC &&
+              header[1] == JTAG_COVERAGE_VERSION && header[2] == JTAG_COVERAGE_BINS &&
+              fread(loaded, sizeof(loaded), 1, f) == 1;
+    fclose(f);
+    if (ok) {
+        memcpy(words, loaded, sizeof(words));
+    }
+    return ok ? TRUE : FALSE;
+}
+
+JtagCoverage::JtagCoverage()
+    : instruction(IR_IDCODE), ir_shift(0), shift_bits(0), tdi_window(0), tdo_capture(0) {
+}
+
+void JtagCoverage::on_step(TapState state, bool tms, bool tdi, bool tdo) {
+    map.set(coverage_state_bin(state));
+    map.set(coverage_edge_bin(state, tms));
+    map.set(coverage_instruction_state_bin(instruction, state));
+
+    if (state == SHIFT_IR) {
+        ir_shift = (ir_shift >> 1) | ((uint32_t)tdi << 3);
+    } else if (state == SHIFT_DR) {
+        tdi_window = (tdi_window >> 1) | ((uint32_t)tdi << (BSR_WIDTH - 1));
+        if (shift_bits >= 0 && shift_bits < BSR_WIDTH) {
+            tdo_capture |= (uint32_t)tdo << shift_bits;
+        }
+        shift_bits++;
+    }
+
+    TapState next = tap_next_state(state, tms);
+    switch (next) {
+    case TEST_LOGIC_RESET:
+        instruction = IR_IDCODE;
+        break;
+    case CAPTURE_IR:
+        ir_shift = IR_CAPTURE_PATTERN;
+        break;
+    case CAPTURE_DR:
+        shift_bits = 0;
+        tdi_window = 0;
+        tdo_capture = 0;
+        break;
+    case UPDATE_IR:
+        instruction = ir_shift & 0xF;
+        map.set(coverage_instruction_bin(instruction));
+        break;
+    case UPDATE_DR:
+        if ((instruction == IR_EXTEST || instruction == IR_SAMPLE) && shift_bits >= BSR_WIDTH) {
+            for (int cell = 0; cell < BSR_WIDTH; cell++) {
+                map.set(coverage_bsr_bin(COV_BSR_DRIVEN, cell, (tdi_window >> cell) & 1));
+                map.set(coverage_bsr_bin(COV_BSR_CAPTURED, cell, (tdo_capture >> cell) & 1));
+            }
+            map.set(coverage_counter_bin((tdo_capture & BSR_COUNT_MASK) >> BSR_COUNT_DATA_CELL));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Fixed-TMS runs settle in a self-looping state within a few cycles; the
+// repeats add no bins. TDO is not sampled, so a run that shifts the DR
+// leaves its scan out of the BSR bins.
+void JtagCoverage::on_clock(TapState state, bool tms, bool tdi, int count) {
+    for (int i = 0; i < count; i++) {
+        on_step(state, tms, tdi, false);
+        TapState next = tap_next_state(state, tms);
+        if (next == state) {
+            if (state == SHIFT_DR) {
+                shift_bits = -(1 << 30);
+            }
+            break;
+        }
+        state = next;
+    }
+}
+
+// A DR bit with unknown TDO leaves its scan out of the BSR bins, like a
+// clocked run
+void JtagCoverage::on_unobserved(TapState state, bool tms, bool tdi) {
+    on_step(state, tms, tdi, false);
+    if (state == SHIFT_DR) {
+        shift_bits = -(1 << 30);
+    }
+}
+
+// A DR scan continued after a handoff has no known start; leave it out of
+// the BSR bins like a clocked one
+void JtagCoverage::on_state_load(TapState state, uint32_t load_instruction) {
+    instruction = load_instruction;
+    shift_bits = -(1 << 30);
+}
+
+void JtagCoverage::print_summary(const char* title) const {
+    printf("%s: %d/%d bins\n", title, map.count(), JTAG_COVERAGE_BINS);
+    for (int g = 0; g < COV_GROUP_COUNT; g++) {
+        JtagCoverageGroup group = (JtagCoverageGroup)g;
+        printf("  %-22s %4d/%d\n", coverage_group_name(group), map.count(group), coverage_group_size(group));
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,98 @@
+// jtag_coverage.h
+// Host-side functional coverage bitmaps collected from the TCK step stream
+
+#ifndef JTAG_COVERAGE_H
+#define JTAG_COVERAGE_H
+
+#include <string>
+#include <cstdint>
+#include "digilent_jtag_mock.h"
+#include "jtag_bsr_layout.h"
+
+// Coverage groups, laid out back to back in one bitmap
+enum JtagCoverageGroup {
+    COV_STATE,               // TAP state a step was taken from (16)
+    COV_EDGE,                // (state, TMS) transitions (32)
+    COV_INSTRUCTION,         // Opcodes loaded through Update-IR (16)
+    COV_INSTRUCTION_STATE,   // (instruction in effect, state) pairs (256)
+    COV_BSR_DRIVEN,          // (cell, value) updated under SAMPLE/PRELOAD or EXTEST
+    COV_BSR_CAPTURED,        // (cell, value) captured under SAMPLE/PRELOAD or EXTEST
+    COV_COUNTER,             // Counter values seen in captured count cells (16)
+    COV_GROUP_COUNT
+};
+
+#define JTAG_COVERAGE_BINS   (16 + 32 + 16 + 256 + 4 * BSR_WIDTH + 16)
+#define JTAG_COVERAGE_WORDS  ((JTAG_COVERAGE_BINS + 63) / 64)
+
+int coverage_group_offset(JtagCoverageGroup group);
+int coverage_group_size(JtagCoverageGroup group);
+const char* coverage_group_name(JtagCoverageGroup group);
+
+// Bin index helpers
+inline int coverage_state_bin(TapState state) {
+    return coverage_group_offset(COV_STATE) + state;
+}
+inline int coverage_edge_bin(TapState state, bool tms) {
+    return coverage_group_offset(COV_EDGE) + state * 2 + tms;
+}
+inline int coverage_instruction_bin(uint32_t instruction) {
+    return coverage_group_offset(COV_INSTRUCTION) + (instruction & 0xF);
+}
+inline int coverage_instruction_state_bin(uint32_t instruction, TapState state) {
+    return coverage_group_offset(COV_INSTRUCTION_STATE) + (instruction & 0xF) * 16 + state;
+}
+inline int coverage_bsr_bin(JtagCoverageGroup group, int cell, bool value) {
+    return coverage_group_offset(group) + cell * 2 + value;
+}
+inline int coverage_counter_bin(uint32_t count) {
+    return coverage_group_offset(COV_COUNTER) + (count & 0xF);
+}
+
+// Fixed-size coverage bitmap. Shards merge with a bitwise OR.
+struct JtagCoverageMap {
+    uint64_t words[JTAG_COVERAGE_WORDS];
+
+    JtagCoverageMap() { clear(); }
+
+    void clear();
+    void set(int bin) { words[bin >> 6] |= 1ull << (bin & 63); }
+    bool test(int bin) const { return (words[bin >> 6] >> (bin & 63)) & 1; }
+
+    // Returns the number of bins newly covered by other
+    int merge(const JtagCoverageMap& other);
+    int count(JtagCoverageGroup group) const;
+    int count() const;
+
+    // Compact binary file: header plus the raw words, written atomically
+    int save(const std::string& path) const;
+    int load(const std::string& path);
+};
+
+// JtagCoverage class
+// Step observer that fills a JtagCoverageMap. Each step costs a few bit
+// operations; the IR and BSR contents are rebuilt from TDI/TDO as they are
+// shifted, so no backend support is needed and every backend gets the same
+// coverage.
+class JtagCoverage : public JtagStepObserver {
+public:
+    JtagCoverageMap map;
+
+    JtagCoverage();
+
+    void on_step(TapState state, bool tms, bool tdi, bool tdo) override;
+    void on_clock(TapState state, bool tms, bool tdi, int count) override;
+    void on_unobserved(TapState state, bool tms, bool tdi) override;
+    void on_state_load(TapState state, uint32_t instruction) override;
+
+    // Per-group covered/total summary
+    void print_summary(const char* title) const;
+
+private:
+    uint32_t instruction;    // In effect since the last Update-IR or reset
+    uint32_t ir_shift;
+    int shift_bits;
+    uint32_t tdi_window;     // Last BSR_WIDTH TDI bits of the current DR scan
+    uint32_t tdo_capture;    // First BSR_WIDTH TDO bits of the current DR scan
+};
+
+#endif // JTAG_COVERAGE_H
@@ -0,0 +1,204 @@
+// jtag_coverage_gen.cpp
+// Coverage-directed scan generation from the functional coverage bitmaps
+
+#include "jtag_coverage_gen.h"
+
+#define IR_EXTEST  0x0
+#define IR_IDCODE  0x1
+#define IR_SAMPLE  0x2
+#define IR_DMI     0x7
+#define IR_ABORT   0x8
+#define IR_DPACC   0xA
+#define IR_APACC   0xB
+#define IR_BYPASS  0xF
+
+#define IR_LENGTH  4
+
+// Idle gaps of the capture sweep; spread the samples over a counter loop
+#define SWEEP_SCANS  12
+
+CoverageGenerator::CoverageGenerator(int hif, JtagCoverage* coverage)
+    : hif(hif), coverage(coverage), batch_size(64), max_rounds(32), max_bits(1u << 20),
+      unsafe_dr_mask((1u << IR_EXTEST) | (1u << IR_DMI) | (1u << IR_ABORT) | (1u << IR_DPACC) | (1u << IR_APACC)),
+      rounds(0), fragments(0), bits(0), bins_added(0), excluded(0), missed(0), saturated(false) {
+}
+
+bool CoverageGenerator::dr_side(TapState state) const {
+    return state >= CAPTURE_DR && state <= UPDATE_DR;
+}
+
+// Pair bins that are unsafe to enter, or that cannot exist: Test-Logic-Reset
+// always runs with IDCODE selected
+bool CoverageGenerator::is_excluded(int bin) const {
+    int offset = coverage_group_offset(COV_INSTRUCTION_STATE);
+    if (bin < offset || bin >= offset + coverage_group_size(COV_INSTRUCTION_STATE)) {
+        return false;
+    }
+    uint32_t instruction = (bin - offset) / 16;
+    TapState state = (TapState)((bin - offset) % 16);
+    if (state == TEST_LOGIC_RESET) {
+        return instruction != IR_IDCODE;
+    }
+    return dr_side(state) && ((unsafe_dr_mask >> instruction) & 1);
+}
+
+// Leaves BYPASS selected and the TAP in Run-Test/Idle. Capture-IR loads the
+// safe 0101 pattern, so an IR-side excursion never selects an unsafe opcode.
+void CoverageGenerator::restore_instruction() {
+    program.shift_ir(IR_BYPASS, IR_LENGTH);
+    program.goto_state(RUN_TEST_IDLE);
+}
+
+void CoverageGenerator::emit_visit(TapState target) {
+    program.goto_state(target);
+}
+
+void CoverageGenerator::emit_bin(int bin) {
+    JtagCoverageGroup group = COV_STATE;
+    while (group + 1 < COV_GROUP_COUNT && bin >= coverage_group_offset((JtagCoverageGroup)(group + 1))) {
+        group = (JtagCoverageGroup)(group + 1);
+    }
+    int index = bin - coverage_group_offset(group);
+
+    switch (group) {
+    case COV_STATE:
+        emit_visit((TapState)index);
+        break;
+    case COV_EDGE:
+        emit_visit((TapState)(index / 2));
+        program.append_bit(index & 1, false);
+        break;
+    case COV_INSTRUCTION:
+        program.shift_ir(index, IR_LENGTH);
+        program.goto_state(RUN_TEST_IDLE);
+        break;
+    case COV_INSTRUCTION_STATE:
+        // Update-IR selects the instruction; the walk to the state follows
+        program.shift_ir(index / 16, IR_LENGTH);
+        program.goto_state(UPDATE_IR);
+        emit_visit((TapState)(index % 16));
+        break;
+    default:
+        break;
+    }
+}
+
+// A pattern and its complement under PRELOAD cover both values of every cell
+void CoverageGenerator::emit_preload_patterns() {
+    const uint32_t cells_mask = (1u << BSR_WIDTH) - 1;
+    uint32_t pattern = 0;
+    for (int cell = 0; cell < BSR_WIDTH; cell++) {
+        if (!coverage->map.test(coverage_bsr_bin(COV_BSR_DRIVEN, cell, true))) {
+            pattern |= 1u << cell;
+        }
+    }
+    program.shift_ir(IR_SAMPLE, IR_LENGTH);
+    program.shift_dr(pattern, BSR_WIDTH);
+    program.shift_dr(~pattern & cells_mask, BSR_WIDTH);
+}
+
+// Alternating EXTEST patterns move the observable pins, then SAMPLE scans
+// with growing idle gaps catch the counter at different phases. cs_n stays
+// high throughout.
+void CoverageGenerator::emit_capture_sweep() {
+    const uint32_t cells_mask = (1u << BSR_WIDTH) - 1;
+    const uint32_t cs_n = 1u << BSR_SPI_CS_N_CELL;
+    const uint32_t pattern_a = (0x0AAA & cells_mask) | cs_n;
+    const uint32_t pattern_b = (~pattern_a & cells_mask) | cs_n;
+
+    program.shift_ir(IR_SAMPLE, IR_LENGTH);
+    program.shift_dr(pattern_a, BSR_WIDTH);
+    program.shift_ir(IR_EXTEST, IR_LENGTH);
+    for (int i = 0; i < SWEEP_SCANS; i++) {
+        program.shift_dr((i & 1) ? pattern_b : pattern_a, BSR_WIDTH);
+        program.idle(i);
+    }
+    program.shift_ir(IR_SAMPLE, IR_LENGTH);
+    for (int i = 0; i < SWEEP_SCANS; i++) {
+        program.shift_dr(pattern_a, BSR_WIDTH);
+        program.idle(i + 1);
+    }
+}
+
+int CoverageGenerator::plan_round() {
+    targets.clear();
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    restore_instruction();
+
+    bool preload = false, sweep = false;
+    int planned = 0;
+    for (int bin = 0; bin < JTAG_COVERAGE_BINS && planned < batch_size; bin++) {
+        if (coverage->map.test(bin) || tried.test(bin) || is_excluded(bin)) {
+            continue;
+        }
+        if (bin >= coverage_group_offset(COV_BSR_DRIVEN) && bin < coverage_group_offset(COV_BSR_CAPTURED)) {
+            if (!preload) {
+                emit_preload_patterns();
+                restore_instruction();
+                preload = true;
+                planned++;
+            }
+        } else if (bin >= coverage_group_offset(COV_BSR_CAPTURED)) {
+            if (!sweep) {
+                emit_capture_sweep();
+                restore_instruction();
+                sweep = true;
+                planned++;
+            }
+        } else {
+            emit_bin(bin);
+            restore_instruction();
+            planned++;
+        }
+        targets.push_back(bin);
+    }
+    return planned;
+}
+
+int CoverageGenerator::run() {
+    rounds = 0;
+    fragments = 0;
+    bits = 0;
+    excluded = 0;
+    missed = 0;
+    saturated = false;
+    tried.clear();
+
+    int start = coverage->map.count();
+    bool ok = true;
+    jtag_add_step_observer(coverage);
+    while (rounds < max_rounds && bits < max_bits) {
+        int planned = plan_round();
+        if (planned == 0) {
+            saturated = true;
+            break;
+        }
+        tdo.assign((program.bit_count + 7) / 8, 0);
+        if (!djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count)) {
+            ok = false;
+            break;
+        }
+        rounds++;
+        fragments += planned;
+        bits += program.bit_count;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (!coverage->map.test(targets[i])) {
+                tried.set(targets[i]);
+            }
+        }
+    }
+    jtag_remove_step_observer(coverage);
+
+    bins_added = coverage->map.count() - start;
+    for (int bin = 0; bin < JTAG_COVERAGE_BINS; bin++) {
+        if (coverage->map.test(bin)) {
+            continue;
+        }
+        if (is_excluded(bin)) {
+            excluded++;
+        } else if (tried.test(bin)) {
+            missed++;
+        }
+    }
+    return ok ? TRUE : FALSE;
+}
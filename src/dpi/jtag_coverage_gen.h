@@ -0,0 +1,66 @@
+// jtag_coverage_gen.h
+// Coverage-directed scan generation from the functional coverage bitmaps
+
+#ifndef JTAG_COVERAGE_GEN_H
+#define JTAG_COVERAGE_GEN_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_coverage.h"
+#include "jtag_scan_program.h"
+
+// CoverageGenerator class
+// Reads a JtagCoverage map and compiles scan fragments aimed at its
+// uncovered bins: TAP walks for states and edges (including the Pause and
+// Exit2 paths), IR loads for instructions and (instruction, state) pairs,
+// PRELOAD patterns for driven BSR cells, and an EXTEST/SAMPLE sweep with
+// varying idle gaps for captured cells and counter values. Up to batch_size
+// fragments run as one bulk transfer per round; bins a round fails to hit
+// are marked tried so the next round moves on. Generation stops when no
+// untried bin is left (saturated) or the round/bit budget is spent.
+//
+// DR-side states are never entered under an instruction in unsafe_dr_mask
+// (EXTEST, DMI, ABORT, DPACC, APACC by default), since Update-DR would act
+// on the captured value; those pair bins are reported as excluded. The
+// EXTEST sweep keeps cs_n high so the SPI flash never sees a transaction.
+class CoverageGenerator {
+public:
+    int hif;
+    JtagCoverage* coverage;
+    int batch_size;              // Fragments per round
+    int max_rounds;
+    uint64_t max_bits;           // Total TCK budget across rounds
+    uint32_t unsafe_dr_mask;     // Opcodes whose DR-side states are not entered
+
+    // Statistics
+    int rounds;
+    int fragments;
+    uint64_t bits;
+    int bins_added;
+    int excluded;                // Uncovered bins never targeted
+    int missed;                  // Targeted but not hit (unreachable here)
+    bool saturated;
+
+    CoverageGenerator(int hif, JtagCoverage* coverage);
+
+    // Registers the coverage observer for the duration of the run
+    int run();
+
+    bool is_excluded(int bin) const;
+
+private:
+    ScanProgram program;
+    std::vector<uint8_t> tdo;
+    std::vector<int> targets;
+    JtagCoverageMap tried;
+
+    int plan_round();
+    void emit_bin(int bin);
+    void emit_visit(TapState target);
+    void emit_preload_patterns();
+    void emit_capture_sweep();
+    void restore_instruction();
+    bool dr_side(TapState state) const;
+};
+
+#endif // JTAG_COVERAGE_GEN_H
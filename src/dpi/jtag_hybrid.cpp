@@ -0,0 +1,122 @@
+// jtag_hybrid.cpp
+// Hybrid execution: native fast-forward with a backdoor handoff to the RTL
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "jtag_hybrid.h"
+
+HybridSession::HybridSession(int hif, uint32_t device_id)
+    : hif(hif), setup(4, 10, device_id), setup_bits(0), backend(&setup) {
+}
+
+void HybridSession::shift(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit) {
+    if (tdo) {
+        memset(tdo, 0, (cbit + 7) / 8);
+    }
+    backend.shift(tms, tdi, tdo, cbit);
+    setup_bits += cbit;
+}
+
+int HybridSession::handoff() {
+    int tap = jtag_device_tap(hif);
+    if (tap < 0) {
+        printf("HYBRID: Device %d not enabled\n", hif);
+        fflush(stdout);
+        return FALSE;
+    }
+    if (!setup.dtm.idle() || !setup.dap.idle()) {
+        printf("HYBRID: Debug port busy on the setup model, handoff refused\n");
+        fflush(stdout);
+        return FALSE;
+    }
+    JtagTapSnapshot snapshot = setup.snapshot();
+    if (!jtag_backdoor_load(tap, snapshot)) {
+        return FALSE;
+    }
+    jtag_load_tracked_state(tap, snapshot.current_state, snapshot.instruction_reg);
+    printf("HYBRID: Handoff to TAP %d after %llu setup cycles (%s, IR 0x%X, count %u)\n", tap,
+           (unsigned long long)setup_bits, tap_state_name(snapshot.current_state), snapshot.instruction_reg,
+           snapshot.count);
+    fflush(stdout);
+    return TRUE;
+}
+
+#ifndef JTAG_NATIVE_BUILD
+#include "vpi_user.h"
+
+// jtag_top instance of a TAP (jtag_testbench.sv)
+static std::string rtl_instance_path(int tap) {
+    if (tap == 0) {
+        return "jtag_testbench.dut";
+    }
+    return "jtag_testbench.tap[" + std::to_string(tap) + "].dut_x";
+}
+
+static vpiHandle rtl_signal(int tap, const char* name) {
+    std::string path = rtl_instance_path(tap) + "." + name;
+    vpiHandle handle = vpi_handle_by_name((PLI_BYTE8*)path.c_str(), nullptr);
+    if (!handle) {
+        printf("HYBRID: No RTL signal %s (compile with +acc)\n", path.c_str());
+        fflush(stdout);
+    }
+    return handle;
+}
+
+// Deposit: the value holds until the RTL next assigns the register
+static bool rtl_write(int tap, const char* name, uint32_t value) {
+    vpiHandle handle = rtl_signal(tap, name);
+    if (!handle) {
+        return false;
+    }
+    s_vpi_value v;
+    v.format = vpiIntVal;
+    v.value.integer = (PLI_INT32)value;
+    vpi_put_value(handle, &v, nullptr, vpiNoDelay);
+    vpi_release_handle(handle);
+    return true;
+}
+
+static bool rtl_read(int tap, const char* name, uint32_t* value) {
+    vpiHandle handle = rtl_signal(tap, name);
+    if (!handle) {
+        return false;
+    }
+    s_vpi_value v;
+    v.format = vpiIntVal;
+    vpi_get_value(handle, &v);
+    vpi_release_handle(handle);
+    *value = (uint32_t)v.value.integer;
+    return true;
+}
+
+int jtag_backdoor_load(int tap, const JtagTapSnapshot& snapshot) {
+    bool ok = rtl_write(tap, "tap_controller.current_state", snapshot.current_state) &&
+              rtl_write(tap, "instruction_register.shift_register", snapshot.ir_shift_register) &&
+              rtl_write(tap, "instruction_register.instruction_reg", snapshot.instruction_reg) &&
+              rtl_write(tap, "boundary_scan_register.scan_register", snapshot.scan_register) &&
+              rtl_write(tap, "boundary_scan_register.update_register", snapshot.update_register) &&
+              rtl_write(tap, "idcode_shift_reg", snapshot.idcode_shift_reg) &&
+              rtl_write(tap, "bypass_reg", snapshot.bypass_reg) &&
+              rtl_write(tap, "tdo_reg", snapshot.tdo_reg) &&
+              rtl_write(tap, "counter_dut.count", snapshot.count);
+    return ok ? TRUE : FALSE;
+}
+
+int jtag_backdoor_read(int tap, JtagTapSnapshot* snapshot) {
+    uint32_t state, bypass, tdo;
+    bool ok = rtl_read(tap, "tap_controller.current_state", &state) &&
+              rtl_read(tap, "instruction_register.shift_register", &snapshot->ir_shift_register) &&
+              rtl_read(tap, "instruction_register.instruction_reg", &snapshot->instruction_reg) &&
+              rtl_read(tap, "boundary_scan_register.scan_register", &snapshot->scan_register) &&
+              rtl_read(tap, "boundary_scan_register.update_register", &snapshot->update_register) &&
+              rtl_read(tap, "idcode_shift_reg", &snapshot->idcode_shift_reg) &&
+              rtl_read(tap, "bypass_reg", &bypass) &&
+              rtl_read(tap, "tdo_reg", &tdo) &&
+              rtl_read(tap, "counter_dut.count", &snapshot->count);
+    snapshot->current_state = (TapState)state;
+    snapshot->bypass_reg = bypass != 0;
+    snapshot->tdo_reg = tdo != 0;
+    return ok ? TRUE : FALSE;
+}
+#endif
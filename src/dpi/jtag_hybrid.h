@@ -0,0 +1,49 @@
+// jtag_hybrid.h
+// Hybrid execution: native fast-forward with a backdoor handoff to the RTL
+
+#ifndef JTAG_HYBRID_H
+#define JTAG_HYBRID_H
+
+#include <cstdint>
+#include "digilent_jtag_mock.h"
+#include "jtag_native_model.h"
+#include "jtag_native_tlm.h"
+
+// Backdoor access to the core registers of a TAP instance. Simulator builds
+// go through VPI into the RTL (jtag_hybrid.cpp): current_state,
+// instruction_reg, scan_register, update_register, count and the shift,
+// IDCODE, BYPASS and TDO registers. The native build copies into its model
+// (native_main.cpp). Both take effect immediately, without TCK activity.
+int jtag_backdoor_load(int tap, const JtagTapSnapshot& snapshot);
+int jtag_backdoor_read(int tap, JtagTapSnapshot* snapshot);
+
+// HybridSession class
+// Runs the setup part of a session on a private native model through the
+// transaction-level backend, then hands its register state to the HIF's TAP
+// instance so the rest of the session runs cycle-accurately there. Setup
+// scans are not seen by the adapter model or the step observers; the
+// observers get the handoff as a state load.
+//
+// The setup model starts in Test-Logic-Reset with the counter at zero and
+// its own simulated time. The debug ports are not transferred: the handoff
+// is refused while the setup model's DTM or DP is busy, and the instance's
+// DTM and DP keep their state.
+class HybridSession {
+public:
+    int hif;
+    NativeJtagModel setup;
+    uint64_t setup_bits;         // TCK cycles run on the setup model
+
+    explicit HybridSession(int hif, uint32_t device_id = 0x12345678);
+
+    // Bulk shift on the setup model; tdo (may be null) as in djtg_shift_bits
+    void shift(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit);
+
+    // TRUE once the instance holds the setup model's state
+    int handoff();
+
+private:
+    NativeTlmBackend backend;
+};
+
+#endif // JTAG_HYBRID_H
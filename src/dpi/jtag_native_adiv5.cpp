@@ -0,0 +1,149 @@
+// jtag_native_adiv5.cpp
+// Native C++ model of jtag_adiv5_dp for the native backend
+
+#include "jtag_native_adiv5.h"
+
+#define ACCESS_MASK ((1ull << ADIV5_ACCESS_BITS) - 1)
+
+NativeAdiv5Dp::NativeAdiv5Dp() : mem(MEM_WORDS, 0) {
+    tap_reset();
+    set_dap_reset(false);
+}
+
+void NativeAdiv5Dp::tap_reset() {
+    access_shift = 0;
+    busy_count = 0;
+    wait_pending = false;
+}
+
+void NativeAdiv5Dp::set_dap_reset(bool asserted) {
+    dap_in_reset = asserted;
+    if (asserted) {
+        cdbgpwrupreq = false;
+        csyspwrupreq = false;
+        stickyerr = false;
+        select_reg = 0;
+        read_result = 0;
+        csw_addrinc = 0;
+        tar = 0;
+    }
+}
+
+void NativeAdiv5Dp::dp_access(bool rnw, uint32_t a, uint32_t data) {
+    uint32_t addr = a << 2;
+    if (rnw) {
+        switch (addr) {
+            case DP_CTRL_STAT:
+                read_result = (csyspwrupreq ? CTRL_STAT_CSYSPWRUPACK | CTRL_STAT_CSYSPWRUPREQ : 0) |
+                              (cdbgpwrupreq ? CTRL_STAT_CDBGPWRUPACK | CTRL_STAT_CDBGPWRUPREQ : 0) |
+                              (stickyerr ? CTRL_STAT_STICKYERR : 0);
+                break;
+            case DP_SELECT: read_result = select_reg; break;
+            case DP_RDBUFF: break;
+            default:        read_result = 0; break;
+        }
+    } else {
+        if (addr == DP_CTRL_STAT) {
+            cdbgpwrupreq = data & CTRL_STAT_CDBGPWRUPREQ;
+            csyspwrupreq = data & CTRL_STAT_CSYSPWRUPREQ;
+            if (data & CTRL_STAT_STICKYERR) {
+                stickyerr = false;
+            }
+        } else if (addr == DP_SELECT) {
+            select_reg = data;
+        }
+    }
+}
+
+void NativeAdiv5Dp::ap_access(bool rnw, uint32_t a, uint32_t data) {
+    uint32_t ap_addr = (select_reg & 0xF0) | (a << 2);
+    bool ap_enabled = cdbgpwrupreq && !stickyerr && (select_reg >> 24) == 0;
+    bool mem_access = ap_addr == AP_DRW || (ap_addr & 0xF0) == AP_BD0;
+    uint32_t mem_addr = ap_addr == AP_DRW ? tar : (tar & ~0xFu) | (ap_addr & 0xF);
+
+    if (!ap_enabled) {
+        if (!stickyerr) {
+            stickyerr = !cdbgpwrupreq;
+        }
+        if (rnw) {
+            read_result = 0;
+        }
+    } else if (mem_access) {
+        if ((mem_addr >> 2) >= MEM_WORDS) {
+            stickyerr = true;
+            if (rnw) {
+                read_result = 0;
+            }
+        } else {
+            if (rnw) {
+                read_result = mem[mem_addr >> 2];
+            } else {
+                mem[mem_addr >> 2] = data;
+            }
+            if (ap_addr == AP_DRW && csw_addrinc == 1) {
+                tar = (tar & ~0x3FFu) | ((tar + 4) & 0x3FF);
+            }
+        }
+    } else if (rnw) {
+        switch (ap_addr) {
+            case AP_CSW: read_result = (1u << 6) | (csw_addrinc << 4) | CSW_SIZE_32; break;
+            case AP_TAR: read_result = tar; break;
+            case AP_IDR: read_result = IDR; break;
+            default:     read_result = 0; break;
+        }
+    } else {
+        if (ap_addr == AP_CSW) {
+            csw_addrinc = (data >> 4) & 0x3;
+        } else if (ap_addr == AP_TAR) {
+            tar = data;
+        }
+    }
+}
+
+// One rising TCK edge; DP/AP registers see the pre-edge chain contents
+void NativeAdiv5Dp::tck_posedge(TapState state, bool select_abort, bool select_dpacc, bool select_apacc, bool tdi) {
+    bool selected = select_abort || select_dpacc || select_apacc;
+    bool rnw = access_shift & 1;
+    uint32_t a = (access_shift >> 1) & 0x3;
+    uint32_t data = (uint32_t)(access_shift >> 3);
+    bool update = state == UPDATE_DR;
+    bool dp_req = update && select_dpacc && !wait_pending;
+    bool ap_req = update && select_apacc && !wait_pending;
+
+    // DP and AP registers
+    if (!dap_in_reset) {
+        if (update && select_abort) {
+            if (data & ABORT_STKERRCLR) {
+                stickyerr = false;
+            }
+        } else if (dp_req) {
+            dp_access(rnw, a, data);
+        } else if (ap_req) {
+            ap_access(rnw, a, data);
+        }
+    }
+
+    // Scan chain, ACK and WAIT tracking
+    uint32_t busy_before = busy_count;
+    if (busy_count != 0) {
+        busy_count--;
+    }
+    if (state == CAPTURE_DR && selected) {
+        if (busy_before != 0) {
+            access_shift = ADIV5_ACK_WAIT;
+            wait_pending = true;
+        } else {
+            access_shift = ((uint64_t)read_result << 3) | ADIV5_ACK_OK;
+            wait_pending = false;
+        }
+    } else if (state == SHIFT_DR && selected) {
+        access_shift = (((uint64_t)(tdi ? 1 : 0) << (ADIV5_ACCESS_BITS - 1)) | (access_shift >> 1)) & ACCESS_MASK;
+    } else if (update && select_abort) {
+        if (data & ABORT_DAPABORT) {
+            busy_count = 0;
+            wait_pending = false;
+        }
+    } else if (ap_req) {
+        busy_count = AP_BUSY_CYCLES;
+    }
+}
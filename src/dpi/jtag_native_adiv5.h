@@ -0,0 +1,57 @@
+// jtag_native_adiv5.h
+// Native C++ model of jtag_adiv5_dp for the native backend
+
+#ifndef JTAG_NATIVE_ADIV5_H
+#define JTAG_NATIVE_ADIV5_H
+
+#include <cstdint>
+#include <vector>
+#include "jtag_scan_program.h"
+#include "adiv5_dap.h"
+
+// NativeAdiv5Dp class
+// Register-level model of jtag_adiv5_dp.sv: the shared 35-bit ABORT/DPACC/
+// APACC chain, WAIT while an AP access is in progress, the DP registers and
+// the MEM-AP with its RAM. tck_posedge() is called by NativeJtagModel on
+// every rising TCK edge outside Test-Logic-Reset with the pre-edge TAP state.
+class NativeAdiv5Dp {
+public:
+    // jtag_adiv5_dp parameters
+    enum {
+        AP_BUSY_CYCLES = 3,
+        MEM_WORDS = 1024
+    };
+    static const uint32_t IDR = 0x24770011;
+
+    // Scan chain and transaction state
+    uint64_t access_shift;
+    uint32_t busy_count;
+    bool wait_pending;
+
+    // DP registers
+    bool cdbgpwrupreq, csyspwrupreq, stickyerr;
+    uint32_t select_reg;
+    uint32_t read_result;
+
+    // MEM-AP registers
+    uint32_t csw_addrinc;
+    uint32_t tar;
+    bool dap_in_reset;
+    std::vector<uint32_t> mem;
+
+    NativeAdiv5Dp();
+
+    void tap_reset();
+    void set_dap_reset(bool asserted);
+    void tck_posedge(TapState state, bool select_abort, bool select_dpacc, bool select_apacc, bool tdi);
+    bool tdo() const { return access_shift & 1; }
+
+    // No AP access in progress, so idle TCK edges change nothing
+    bool idle() const { return busy_count == 0; }
+
+private:
+    void dp_access(bool rnw, uint32_t a, uint32_t data);
+    void ap_access(bool rnw, uint32_t a, uint32_t data);
+};
+
+#endif // JTAG_NATIVE_ADIV5_H
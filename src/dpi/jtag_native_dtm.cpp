@@ -0,0 +1,156 @@
+// jtag_native_dtm.cpp
+// Native C++ model of jtag_riscv_dtm for the native backend
+
+#include "jtag_native_dtm.h"
+
+NativeRiscvDtm::NativeRiscvDtm() : mem(MEM_WORDS, 0) {
+    tap_reset();
+    set_dm_reset(false);
+}
+
+void NativeRiscvDtm::tap_reset() {
+    dtmcs_shift = 0;
+    dmi_shift = 0;
+    dmistat = DMI_OP_SUCCESS;
+    busy_count = 0;
+    last_addr = 0;
+}
+
+void NativeRiscvDtm::set_dm_reset(bool asserted) {
+    dm_in_reset = asserted;
+    if (asserted) {
+        data0 = 0;
+        data1 = 0;
+        dmcontrol = 0;
+        sb_readonaddr = false;
+        sb_autoincrement = false;
+        sb_readondata = false;
+        sb_error = 0;
+        sbaddress0 = 0;
+        sbdata0 = 0;
+        dm_rdata = 0;
+    }
+}
+
+bool NativeRiscvDtm::tdo(bool select_dtmcs) const {
+    return select_dtmcs ? (dtmcs_shift & 1) : (dmi_shift & 1);
+}
+
+// Debug module access on the Update-DR edge
+void NativeRiscvDtm::dm_access(uint32_t op, uint32_t addr, uint32_t data) {
+    if (dm_in_reset) {
+        return;
+    }
+    if (op == DMI_OP_WRITE) {
+        switch (addr) {
+            case DM_DATA0:     data0 = data; break;
+            case DM_DATA1:     data1 = data; break;
+            case DM_DMCONTROL: dmcontrol = data; break;
+            case DM_SBCS:
+                sb_readonaddr = (data >> 20) & 1;
+                sb_autoincrement = (data >> 16) & 1;
+                sb_readondata = (data >> 15) & 1;
+                sb_error &= ~((data >> 12) & 0x7);
+                break;
+            case DM_SBADDRESS0:
+                if (sb_readonaddr) {
+                    sbdata0 = mem[mem_index(data)];
+                    sbaddress0 = sb_autoincrement ? data + 4 : data;
+                } else {
+                    sbaddress0 = data;
+                }
+                break;
+            case DM_SBDATA0:
+                mem[mem_index(sbaddress0)] = data;
+                sbdata0 = data;
+                if (sb_autoincrement) {
+                    sbaddress0 += 4;
+                }
+                break;
+            default:
+                break;
+        }
+    } else if (op == DMI_OP_READ) {
+        switch (addr) {
+            case DM_DATA0:      dm_rdata = data0; break;
+            case DM_DATA1:      dm_rdata = data1; break;
+            case DM_DMCONTROL:  dm_rdata = dmcontrol; break;
+            case DM_DMSTATUS:   dm_rdata = 0x00000082; break;
+            case DM_ABSTRACTCS: dm_rdata = 0x00000002; break;
+            case DM_SBCS:
+                dm_rdata = (1u << 29) | ((sb_readonaddr ? 1u : 0u) << 20) | (2u << 17) |
+                           ((sb_autoincrement ? 1u : 0u) << 16) | ((sb_readondata ? 1u : 0u) << 15) |
+                           (sb_error << 12) | (32u << 5) | 0x4;
+                break;
+            case DM_SBADDRESS0: dm_rdata = sbaddress0; break;
+            case DM_SBDATA0:
+                dm_rdata = sbdata0;
+                if (sb_readondata) {
+                    sbdata0 = mem[mem_index(sbaddress0)];
+                    if (sb_autoincrement) {
+                        sbaddress0 += 4;
+                    }
+                }
+                break;
+            default:
+                dm_rdata = 0;
+                break;
+        }
+    }
+}
+
+// One rising TCK edge. Both always_ff blocks of the RTL see the pre-edge
+// request, so the debug module access is decided before the DTM registers
+// change.
+void NativeRiscvDtm::tck_posedge(TapState state, bool select_dtmcs, bool select_dmi, bool tdi) {
+    uint64_t dmi_mask = (1ull << DMI_WIDTH) - 1;
+    uint32_t req_op = dmi_shift & 0x3;
+    uint32_t req_data = (uint32_t)(dmi_shift >> 2);
+    uint32_t req_addr = (uint32_t)(dmi_shift >> 34);
+    bool dm_req = state == UPDATE_DR && select_dmi && dmistat == DMI_OP_SUCCESS && busy_count == 0 &&
+                  (req_op == DMI_OP_READ || req_op == DMI_OP_WRITE);
+
+    if (dm_req) {
+        dm_access(req_op, req_addr, req_data);
+    }
+
+    uint32_t busy_before = busy_count;
+    if (busy_count != 0) {
+        busy_count--;
+    }
+
+    if (select_dtmcs) {
+        if (state == CAPTURE_DR) {
+            dtmcs_shift = (IDLE_HINT << 12) | (dmistat << 10) | (ABITS << 4) | 1;
+        } else if (state == SHIFT_DR) {
+            dtmcs_shift = ((tdi ? 1u : 0u) << 31) | (dtmcs_shift >> 1);
+        } else if (state == UPDATE_DR) {
+            if (dtmcs_shift & (3u << 16)) {
+                dmistat = DMI_OP_SUCCESS;
+            }
+            if (dtmcs_shift & (1u << 17)) {
+                busy_count = 0;
+            }
+        }
+    }
+
+    if (select_dmi) {
+        if (state == CAPTURE_DR) {
+            uint32_t status = dmistat;
+            if (busy_before != 0) {
+                dmistat = DMI_OP_BUSY;
+                status = DMI_OP_BUSY;
+            }
+            dmi_shift = ((uint64_t)last_addr << 34) | ((uint64_t)dm_rdata << 2) | status;
+        } else if (state == SHIFT_DR) {
+            dmi_shift = (((uint64_t)(tdi ? 1 : 0) << (DMI_WIDTH - 1)) | (dmi_shift >> 1)) & dmi_mask;
+        } else if (state == UPDATE_DR) {
+            if (dm_req) {
+                busy_count = BUSY_CYCLES;
+                last_addr = req_addr;
+            } else if (busy_before != 0 && req_op != DMI_OP_NOP) {
+                dmistat = DMI_OP_BUSY;
+            }
+        }
+    }
+}
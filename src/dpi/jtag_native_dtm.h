@@ -0,0 +1,59 @@
+// jtag_native_dtm.h
+// Native C++ model of jtag_riscv_dtm for the native backend
+
+#ifndef JTAG_NATIVE_DTM_H
+#define JTAG_NATIVE_DTM_H
+
+#include <cstdint>
+#include <vector>
+#include "jtag_scan_program.h"
+#include "riscv_dmi.h"
+
+// NativeRiscvDtm class
+// Register-level model of jtag_riscv_dtm.sv: the dtmcs and dmi TDRs, the
+// busy window after each DMI operation and the debug module with its system
+// bus memory. tck_posedge() is called by NativeJtagModel on every rising TCK
+// edge outside Test-Logic-Reset with the pre-edge TAP state.
+class NativeRiscvDtm {
+public:
+    // jtag_riscv_dtm parameters
+    enum {
+        ABITS = 7,
+        BUSY_CYCLES = 4,
+        IDLE_HINT = 2,
+        MEM_WORDS = 256,
+        DMI_WIDTH = ABITS + 34
+    };
+
+    // DTM registers
+    uint32_t dtmcs_shift;
+    uint64_t dmi_shift;
+    uint32_t dmistat;
+    uint32_t busy_count;
+    uint32_t last_addr;
+
+    // Debug module state
+    uint32_t data0, data1, dmcontrol;
+    bool sb_readonaddr, sb_autoincrement, sb_readondata;
+    uint32_t sb_error;
+    uint32_t sbaddress0, sbdata0;
+    uint32_t dm_rdata;
+    bool dm_in_reset;
+    std::vector<uint32_t> mem;
+
+    NativeRiscvDtm();
+
+    void tap_reset();
+    void set_dm_reset(bool asserted);
+    void tck_posedge(TapState state, bool select_dtmcs, bool select_dmi, bool tdi);
+    bool tdo(bool select_dtmcs) const;
+
+    // No DMI operation in progress, so idle TCK edges change nothing
+    bool idle() const { return busy_count == 0; }
+
+private:
+    void dm_access(uint32_t op, uint32_t addr, uint32_t data);
+    uint32_t mem_index(uint32_t address) const { return (address >> 2) % MEM_WORDS; }
+};
+
+#endif // JTAG_NATIVE_DTM_H
@@ -0,0 +1,552 @@
+// jtag_native_model.cpp
+// Native C++ model of jtag_top for running sessions without a simulator
+
+#include "jtag_native_model.h"
+
+// Instruction encodings (jtag_instruction_register.sv)
+#define NATIVE_IR_EXTEST  0x0
+#define NATIVE_IR_IDCODE  0x1
+#define NATIVE_IR_SAMPLE  0x2
+#define NATIVE_IR_DTMCS   0x6
+#define NATIVE_IR_DMI     0x7
+#define NATIVE_IR_ABORT   0x8
+#define NATIVE_IR_DPACC   0xA
+#define NATIVE_IR_APACC   0xB
+#define NATIVE_IR_IDCODE_DP 0xE
+#define NATIVE_IR_BYPASS  0xF
+
+// sys_clk: 100 MHz, first rising edge at 5 ns (always #5 sys_clk = ~sys_clk)
+#define SYS_CLK_PERIOD_PS 10000
+#define SYS_CLK_FIRST_EDGE_PS 5000
+
+// Number of sys_clk rising edges strictly before time t
+static uint64_t sys_clk_edges_before(uint64_t t_ps) {
+    if (t_ps <= SYS_CLK_FIRST_EDGE_PS) {
+        return 0;
+    }
+    return (t_ps - SYS_CLK_FIRST_EDGE_PS - 1) / SYS_CLK_PERIOD_PS + 1;
+}
+
+// sv_jtag_step / sv_jtag_clock timing: TCK rises 0.5 ns into the step and
+// TDO is sampled 2.1 ns after the step starts
+#define TCK_RISE_PS 500
+#define TCK_STEP_PS 2100
+
+// NativeScheduler implementation
+NativeScheduler::NativeScheduler() : next_sequence(0) {}
+
+void NativeScheduler::schedule_at(uint64_t time_ps, const Action& action) {
+    Event e;
+    e.time_ps = time_ps;
+    e.sequence = next_sequence++;
+    e.action = action;
+    events.push(e);
+}
+
+uint64_t NativeScheduler::next_event_time() const {
+    return events.empty() ? UINT64_MAX : events.top().time_ps;
+}
+
+void NativeScheduler::run_next() {
+    if (events.empty()) {
+        return;
+    }
+    Event e = events.top();
+    events.pop();
+    e.action();
+}
+
+// NativeCounter implementation
+NativeCounter::NativeCounter(int n, uint32_t max_value)
+    : width(n), max_value(max_value), count(0), up_down(true), in_reset(false) {}
+
+void NativeCounter::reset() {
+    count = 0;
+}
+
+// The count loops over 0..MAX_VALUE in either direction, so advancing by
+// any number of cycles is one modular addition or subtraction.
+void NativeCounter::advance(uint64_t cycles) {
+    if (in_reset || cycles == 0) {
+        return;
+    }
+    uint64_t period = (uint64_t)max_value + 1;
+    uint64_t step = cycles % period;
+    if (up_down) {
+        count = (uint32_t)((count + step) % period);
+    } else {
+        count = (uint32_t)((count + period - step) % period);
+    }
+}
+
+// NativeJtagModel implementation
+NativeJtagModel::NativeJtagModel(int n, uint32_t max_value, uint32_t device_id)
+    : n(n), device_id(device_id), bsr_width(1 + 2 * n + 4), time_ps(0),
+      tck(false), tms(false), tdi(false), trst_n(true), sys_reset_n(true),
+      current_state(TEST_LOGIC_RESET), bypass_reg(false), tdo_reg(false),
+      counter(n, max_value), counter_time_ps(0) {
+    tap_reset_registers();
+}
+
+bool NativeJtagModel::select_bypass() const {
+    return !select_idcode() && !select_boundary_scan() && !select_dtmcs() && !select_dmi() &&
+           !select_abort() && !select_dpacc() && !select_apacc();
+}
+
+bool NativeJtagModel::select_idcode() const {
+    return instruction_reg == NATIVE_IR_IDCODE || instruction_reg == NATIVE_IR_IDCODE_DP;
+}
+
+bool NativeJtagModel::select_boundary_scan() const {
+    return instruction_reg == NATIVE_IR_SAMPLE || instruction_reg == NATIVE_IR_EXTEST;
+}
+
+bool NativeJtagModel::select_extest() const {
+    return instruction_reg == NATIVE_IR_EXTEST;
+}
+
+bool NativeJtagModel::select_dtmcs() const {
+    return instruction_reg == NATIVE_IR_DTMCS;
+}
+
+bool NativeJtagModel::select_dmi() const {
+    return instruction_reg == NATIVE_IR_DMI;
+}
+
+bool NativeJtagModel::select_abort() const {
+    return instruction_reg == NATIVE_IR_ABORT;
+}
+
+bool NativeJtagModel::select_dpacc() const {
+    return instruction_reg == NATIVE_IR_DPACC;
+}
+
+bool NativeJtagModel::select_apacc() const {
+    return instruction_reg == NATIVE_IR_APACC;
+}
+
+// TDO multiplexer (jtag_top.sv)
+bool NativeJtagModel::selected_tdo() const {
+    if (current_state == SHIFT_IR) {
+        return ir_shift_register & 1;
+    } else if (select_boundary_scan()) {
+        return scan_register & 1;
+    } else if (select_idcode()) {
+        return idcode_shift_reg & 1;
+    } else if (select_dtmcs() || select_dmi()) {
+        return dtm.tdo(select_dtmcs());
+    } else if (select_abort() || select_dpacc() || select_apacc()) {
+        return dap.tdo();
+    }
+    return bypass_reg;
+}
+
+// Counter direction: BSR cell 0 in EXTEST, otherwise the pulled-up pin
+bool NativeJtagModel::up_down_core() const {
+    if (select_extest()) {
+        return update_register & 1;
+    }
+    return true;
+}
+
+// SPI flash pins: BSR cells 2N+1..2N+3 in EXTEST, otherwise an idle bus
+void NativeJtagModel::spi_pins(bool* cs_n, bool* sck, bool* mosi) const {
+    if (select_extest()) {
+        *cs_n = (update_register >> (1 + 2 * n)) & 1;
+        *sck = (update_register >> (2 + 2 * n)) & 1;
+        *mosi = (update_register >> (3 + 2 * n)) & 1;
+    } else {
+        *cs_n = true;
+        *sck = false;
+        *mosi = false;
+    }
+}
+
+// Pass any change of the driven SPI pins to the flash
+void NativeJtagModel::update_spi_pins() {
+    bool cs_n, sck, mosi;
+    spi_pins(&cs_n, &sck, &mosi);
+    if (cs_n != flash.cs_n || sck != flash.sck || mosi != flash.mosi) {
+        flash.set_pins(cs_n, sck, mosi, time_ps);
+    }
+}
+
+uint32_t NativeJtagModel::count() {
+    sync_counter(time_ps);
+    return counter.count;
+}
+
+// Apply all sys_clk edges before until_ps with the current inputs
+void NativeJtagModel::sync_counter(uint64_t until_ps) {
+    if (until_ps <= counter_time_ps) {
+        return;
+    }
+    counter.advance(sys_clk_edges_before(until_ps) - sys_clk_edges_before(counter_time_ps));
+    counter_time_ps = until_ps;
+}
+
+// An input change at a TCK edge is seen by sys_clk edges after it; an edge
+// at the same instant still samples the old value.
+void NativeJtagModel::update_counter_direction(uint64_t edge_ps) {
+    bool new_up_down = up_down_core();
+    if (new_up_down != counter.up_down) {
+        sync_counter(edge_ps + 1);
+        counter.up_down = new_up_down;
+    }
+}
+
+// Asynchronous TDR reset while in Test-Logic-Reset or with TRST asserted
+void NativeJtagModel::tap_reset_registers() {
+    ir_shift_register = NATIVE_IR_IDCODE;
+    instruction_reg = NATIVE_IR_IDCODE;
+    scan_register = 0;
+    update_register = (((1u << n) - 1) << (1 + n)) |  // Output enables set
+                      (1u << (1 + 2 * n));             // Flash deselected
+    idcode_shift_reg = device_id;
+    bypass_reg = false;
+    dtm.tap_reset();
+    dap.tap_reset();
+}
+
+// One rising TCK edge at time_ps. All registers sample their pre-edge inputs,
+// as the RTL's nonblocking assignments do.
+void NativeJtagModel::tck_posedge() {
+    if (!trst_n) {
+        return;
+    }
+
+    bool tdo_next = selected_tdo();
+    bool bsr = select_boundary_scan();
+    uint32_t bsr_mask = (1u << bsr_width) - 1;
+
+    // Debug ports are held in reset while the TAP is in Test-Logic-Reset
+    if (current_state != TEST_LOGIC_RESET) {
+        dtm.tck_posedge(current_state, select_dtmcs(), select_dmi(), tdi);
+        dap.tck_posedge(current_state, select_abort(), select_dpacc(), select_apacc(), tdi);
+    }
+
+    switch (current_state) {
+        case CAPTURE_IR:
+            ir_shift_register = 0x5;   // Fixed 0101 capture pattern
+            break;
+        case SHIFT_IR:
+            ir_shift_register = ((tdi ? 1u : 0u) << 3) | (ir_shift_register >> 1);
+            break;
+        case UPDATE_IR:
+            instruction_reg = ir_shift_register;
+            break;
+        case CAPTURE_DR:
+            if (bsr) {
+                sync_counter(time_ps);
+                uint32_t up_down_pin = select_extest() ? (update_register & 1) : 1;
+                uint32_t enables = ((1u << n) - 1) << (1 + n);
+                bool cs_n, sck, mosi;
+                spi_pins(&cs_n, &sck, &mosi);
+                uint32_t spi = ((cs_n ? 1u : 0u) | (sck ? 2u : 0u) | (mosi ? 4u : 0u) |
+                                (flash.miso() ? 8u : 0u)) << (1 + 2 * n);
+                scan_register = up_down_pin | ((counter.count & ((1u << n) - 1)) << 1) | enables | spi;
+            }
+            if (select_idcode()) {
+                idcode_shift_reg = device_id;
+            }
+            break;
+        case SHIFT_DR:
+            if (bsr) {
+                scan_register = (((tdi ? 1u : 0u) << (bsr_width - 1)) | (scan_register >> 1)) & bsr_mask;
+            }
+            if (select_idcode()) {
+                idcode_shift_reg = ((tdi ? 1u : 0u) << 31) | (idcode_shift_reg >> 1);
+            }
+            if (select_bypass()) {
+                bypass_reg = tdi;
+            }
+            break;
+        case UPDATE_DR:
+            if (bsr) {
+                update_register = scan_register;
+            }
+            break;
+        default:
+            break;
+    }
+
+    tdo_reg = tdo_next;
+    current_state = tap_next_state(current_state, tms);
+    if (current_state == TEST_LOGIC_RESET) {
+        tap_reset_registers();
+    }
+    update_counter_direction(time_ps);
+    update_spi_pins();
+}
+
+// Jump to target_ps, running any scheduled events on the way at their own
+// timestamps
+void NativeJtagModel::advance_to(uint64_t target_ps) {
+    while (scheduler.next_event_time() <= target_ps) {
+        uint64_t event_time = scheduler.next_event_time();
+        if (event_time > time_ps) {
+            time_ps = event_time;
+        }
+        scheduler.run_next();
+    }
+    if (target_ps > time_ps) {
+        time_ps = target_ps;
+    }
+}
+
+// sv_jtag_step: inputs set, TCK high after 0.5 ns, low after 1 ns, TDO
+// sampled 0.6 ns later
+bool NativeJtagModel::jtag_step(bool tms_in, bool tdi_in) {
+    uint64_t start = time_ps;
+    tms = tms_in;
+    tdi = tdi_in;
+    tck = false;
+    advance_to(start + TCK_RISE_PS);
+    tck = true;
+    tck_posedge();
+    tck = false;
+    advance_to(start + TCK_STEP_PS);
+    return tdo_reg;
+}
+
+// States that TMS holds in place without touching any register
+bool NativeJtagModel::stable_state(bool tms_in) const {
+    switch (current_state) {
+        case TEST_LOGIC_RESET: return tms_in;
+        case RUN_TEST_IDLE:    return !tms_in;
+        case PAUSE_DR:         return !tms_in;
+        case PAUSE_IR:         return !tms_in;
+        default:               return false;
+    }
+}
+
+// sv_jtag_clock: count TCK cycles with fixed TMS/TDI. Once the TAP sits in a
+// stable state, every further cycle only moves time forward, so the rest of
+// the run is a single jump (split only at scheduled events, which may change
+// the state).
+bool NativeJtagModel::clock_tck(bool tms_in, bool tdi_in, uint64_t count) {
+    while (count > 0) {
+        if (trst_n && stable_state(tms_in) && tdo_reg == selected_tdo() && dtm.idle() && dap.idle()) {
+            uint64_t end = time_ps + count * TCK_STEP_PS;
+            uint64_t next_event = scheduler.next_event_time();
+            tms = tms_in;
+            tdi = tdi_in;
+            if (next_event >= end) {
+                advance_to(end);
+                return tdo_reg;
+            }
+            // Jump whole cycles up to the event, then step through it
+            uint64_t cycles = (next_event - time_ps) / TCK_STEP_PS;
+            if (cycles > 0) {
+                advance_to(time_ps + cycles * TCK_STEP_PS);
+                count -= cycles;
+                continue;
+            }
+        }
+        jtag_step(tms_in, tdi_in);
+        count--;
+    }
+    return tdo_reg;
+}
+
+// Bits start..start+length-1 (length <= 64) of a register shift: the
+// register contents first, then TDI delayed by the register width
+static uint64_t shift_stream_bits(uint64_t reg, int width, const uint8_t* tdi_buf, int offset, int start,
+                                  int length) {
+    if (start >= width) {
+        return scan_extract_bits(tdi_buf, offset + start - width, length);
+    }
+    int from_reg = width - start < length ? width - start : length;
+    uint64_t value = (reg >> start) & ((1ull << from_reg) - 1);
+    if (length > from_reg) {
+        value |= scan_extract_bits(tdi_buf, offset, length - from_reg) << from_reg;
+    }
+    return value;
+}
+
+// Register a word-level run shifts: the IR in Shift-IR, the DR selected by
+// the instruction in Shift-DR. False for debug port registers and outside
+// the shift states.
+bool NativeJtagModel::shift_register(uint64_t* reg, int* width) const {
+    if (current_state == SHIFT_IR) {
+        *reg = ir_shift_register;
+        *width = 4;
+    } else if (current_state != SHIFT_DR) {
+        return false;
+    } else if (select_boundary_scan()) {
+        *reg = scan_register;
+        *width = bsr_width;
+    } else if (select_idcode()) {
+        *reg = idcode_shift_reg;
+        *width = 32;
+    } else if (select_bypass()) {
+        *reg = bypass_reg;
+        *width = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void NativeJtagModel::load_shift_register(uint64_t value) {
+    if (current_state == SHIFT_IR) {
+        ir_shift_register = (uint32_t)value;
+    } else if (select_boundary_scan()) {
+        scan_register = (uint32_t)value;
+    } else if (select_idcode()) {
+        idcode_shift_reg = (uint32_t)value;
+    } else {
+        bypass_reg = value & 1;
+    }
+}
+
+// A width-bit shift register shifted count times ends up holding stream bits
+// count..count+width-1, and TDO (registered) shows stream bits 0..count-1.
+// The run is handled 64 bits at a time instead of one posedge per bit.
+bool NativeJtagModel::shift_run(const uint8_t* tdi_buf, int offset, uint8_t* tdo_buf, int count, bool exits) {
+    if (count <= 0 || !trst_n || !dtm.idle() || !dap.idle()) {
+        return false;
+    }
+    uint64_t end = time_ps + (uint64_t)count * TCK_STEP_PS;
+    uint64_t reg;
+    int width;
+    if (scheduler.next_event_time() < end || !shift_register(&reg, &width)) {
+        return false;
+    }
+
+    if (tdo_buf) {
+        for (int k = 0; k < count; k += 64) {
+            int length = count - k < 64 ? count - k : 64;
+            scan_deposit_bits(tdo_buf, offset + k, shift_stream_bits(reg, width, tdi_buf, offset, k, length), length);
+        }
+    }
+    load_shift_register(shift_stream_bits(reg, width, tdi_buf, offset, count, width));
+    tdo_reg = shift_stream_bits(reg, width, tdi_buf, offset, count - 1, 1) & 1;
+
+    tms = exits;
+    tdi = (tdi_buf[(offset + count - 1) / 8] >> ((offset + count - 1) % 8)) & 1;
+    tck = false;
+    if (exits) {
+        current_state = current_state == SHIFT_IR ? EXIT1_IR : EXIT1_DR;
+    }
+    advance_to(end);
+    return true;
+}
+
+// With TDI held the stream is the register contents followed by copies of
+// the TDI value, so no input bits are read at all
+bool NativeJtagModel::shift_run_constant(bool tdi_in, uint8_t* tdo_buf, int offset, int count) {
+    if (count <= 0 || !trst_n || !dtm.idle() || !dap.idle()) {
+        return false;
+    }
+    uint64_t end = time_ps + (uint64_t)count * TCK_STEP_PS;
+    uint64_t reg;
+    int width;
+    if (scheduler.next_event_time() < end || !shift_register(&reg, &width)) {
+        return false;
+    }
+
+    uint64_t fill = tdi_in ? ~0ull : 0;
+    int from_reg = count < width ? count : width;
+    if (tdo_buf) {
+        scan_deposit_bits(tdo_buf, offset, reg & ((1ull << from_reg) - 1), from_reg);
+        if (tdi_in) {
+            for (int k = from_reg; k < count; k += 64) {
+                int length = count - k < 64 ? count - k : 64;
+                scan_deposit_bits(tdo_buf, offset + k, fill, length);
+            }
+        }
+    }
+    uint64_t width_mask = (1ull << width) - 1;
+    uint64_t next = count >= width ? fill : (reg >> count) | (fill << (width - count));
+    load_shift_register(next & width_mask);
+    tdo_reg = count <= width ? (reg >> (count - 1)) & 1 : tdi_in;
+
+    tms = false;
+    tdi = tdi_in;
+    tck = false;
+    advance_to(end);
+    return true;
+}
+
+bool NativeJtagModel::idle_run(bool tdi_in, uint64_t count) {
+    uint64_t end = time_ps + count * TCK_STEP_PS;
+    if (!trst_n || !stable_state(false) || tdo_reg != selected_tdo() || !dtm.idle() || !dap.idle() ||
+        scheduler.next_event_time() < end) {
+        return false;
+    }
+    tms = false;
+    tdi = tdi_in;
+    tck = false;
+    advance_to(end);
+    return true;
+}
+
+JtagTapSnapshot NativeJtagModel::snapshot() {
+    JtagTapSnapshot snapshot;
+    snapshot.current_state = current_state;
+    snapshot.ir_shift_register = ir_shift_register;
+    snapshot.instruction_reg = instruction_reg;
+    snapshot.scan_register = scan_register;
+    snapshot.update_register = update_register;
+    snapshot.idcode_shift_reg = idcode_shift_reg;
+    snapshot.bypass_reg = bypass_reg;
+    snapshot.tdo_reg = tdo_reg;
+    snapshot.count = count();
+    return snapshot;
+}
+
+// The counter keeps running from the loaded count; a new EXTEST drive
+// reaches it and the flash like an Update-DR would
+void NativeJtagModel::load_snapshot(const JtagTapSnapshot& snapshot) {
+    sync_counter(time_ps);
+    current_state = snapshot.current_state;
+    ir_shift_register = snapshot.ir_shift_register;
+    instruction_reg = snapshot.instruction_reg;
+    scan_register = snapshot.scan_register;
+    update_register = snapshot.update_register;
+    idcode_shift_reg = snapshot.idcode_shift_reg;
+    bypass_reg = snapshot.bypass_reg;
+    tdo_reg = snapshot.tdo_reg;
+    counter.count = snapshot.count;
+    update_counter_direction(time_ps);
+    update_spi_pins();
+}
+
+// sv_drive_jtag_pins: zero-time pin drive, clocking on a rising TCK
+void NativeJtagModel::drive_pins(bool tck_val, bool tms_val, bool tdi_val) {
+    bool rising = tck_val && !tck;
+    tck = tck_val;
+    tms = tms_val;
+    tdi = tdi_val;
+    if (rising) {
+        tck_posedge();
+    }
+}
+
+// sv_wait_cycles: repeat (cycles) #1
+void NativeJtagModel::wait_ns(uint64_t ns) {
+    advance_to(time_ps + ns * 1000);
+}
+
+void NativeJtagModel::set_sys_reset_n(bool value) {
+    sync_counter(time_ps);
+    sys_reset_n = value;
+    counter.in_reset = !value;
+    dtm.set_dm_reset(!value);
+    dap.set_dap_reset(!value);
+    if (!value) {
+        counter.reset();
+    }
+}
+
+void NativeJtagModel::set_trst_n(bool value) {
+    trst_n = value;
+    if (!value) {
+        current_state = TEST_LOGIC_RESET;
+        tdo_reg = false;
+        tap_reset_registers();
+        update_counter_direction(time_ps);
+        update_spi_pins();
+    }
+}
@@ -0,0 +1,181 @@
+// jtag_native_model.h
+// Native C++ model of jtag_top for running sessions without a simulator
+
+#ifndef JTAG_NATIVE_MODEL_H
+#define JTAG_NATIVE_MODEL_H
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <functional>
+#include "jtag_scan_program.h"
+#include "jtag_native_dtm.h"
+#include "jtag_native_adiv5.h"
+#include "jtag_native_spi_flash.h"
+
+// NativeScheduler class
+// Timed events for the native backend. Simulated time jumps straight from
+// one event (or TCK edge) to the next instead of ticking at sys_clk rate;
+// events at equal times run in the order they were scheduled.
+class NativeScheduler {
+public:
+    typedef std::function<void()> Action;
+
+    NativeScheduler();
+
+    void schedule_at(uint64_t time_ps, const Action& action);
+    uint64_t next_event_time() const;
+
+    // Run the earliest pending event (the caller advances time to it first)
+    void run_next();
+
+private:
+    struct Event {
+        uint64_t time_ps;
+        uint64_t sequence;
+        Action action;
+        bool operator>(const Event& other) const {
+            return time_ps != other.time_ps ? time_ps > other.time_ps : sequence > other.sequence;
+        }
+    };
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint64_t next_sequence;
+};
+
+// NativeCounter class
+// Model of up_down_counter_loop. advance() covers any number of sys_clk
+// cycles in O(1) using arithmetic modulo MAX_VALUE + 1.
+class NativeCounter {
+public:
+    int width;
+    uint32_t max_value;
+    uint32_t count;
+    bool up_down;        // 1 for up, 0 for down
+    bool in_reset;
+
+    NativeCounter(int n = 4, uint32_t max_value = 10);
+
+    void reset();
+    void advance(uint64_t cycles);
+};
+
+// Core TAP register state of one jtag_top instance (RTL names), as moved
+// between backends by a hybrid handoff. The debug ports and the SPI flash
+// are not part of it.
+struct JtagTapSnapshot {
+    TapState current_state;
+    uint32_t ir_shift_register;
+    uint32_t instruction_reg;
+    uint32_t scan_register;
+    uint32_t update_register;
+    uint32_t idcode_shift_reg;
+    bool bypass_reg;
+    bool tdo_reg;
+    uint32_t count;
+};
+
+// NativeJtagModel class
+// Register-level model of jtag_top: TAP controller, instruction register,
+// boundary scan register, IDCODE and BYPASS registers, the RISC-V DTM, the
+// ADIv5 JTAG-DP, the registered TDO, the counter DUT and the SPI flash on
+// the boundary-scan-only pins. Time follows jtag_testbench.sv (1 ns units, 100 MHz
+// sys_clk with rising edges at 5 ns + 10 ns * k, 2.1 ns per sv_jtag_step).
+//
+// The counter is evaluated lazily: it only catches up with simulated time
+// when its count is observed or its up_down input is about to change. Waits
+// and stable TCK runs (Run-Test/Idle, Pause, Test-Logic-Reset) jump to the
+// next scheduled event, so they cost the same regardless of length.
+class NativeJtagModel {
+public:
+    // jtag_top parameters
+    int n;
+    uint32_t device_id;
+    int bsr_width;
+
+    // Simulated time in picoseconds
+    uint64_t time_ps;
+
+    // Pin levels
+    bool tck, tms, tdi, trst_n, sys_reset_n;
+
+    // TAP and register state (names follow the RTL)
+    TapState current_state;
+    uint32_t ir_shift_register;
+    uint32_t instruction_reg;
+    uint32_t scan_register;
+    uint32_t update_register;
+    uint32_t idcode_shift_reg;
+    bool bypass_reg;
+    bool tdo_reg;
+
+    NativeRiscvDtm dtm;
+    NativeAdiv5Dp dap;
+    NativeSpiFlash flash;
+
+    NativeCounter counter;
+    uint64_t counter_time_ps;   // sys_clk edges before this time are applied
+
+    NativeScheduler scheduler;
+
+    NativeJtagModel(int n = 4, uint32_t max_value = 10, uint32_t device_id = 0x12345678);
+
+    // Testbench-level operations (same timing as the SV exports)
+    bool jtag_step(bool tms_in, bool tdi_in);
+    bool clock_tck(bool tms_in, bool tdi_in, uint64_t count);
+
+    // Transaction-level runs for NativeTlmBackend. Each stands for count
+    // jtag_step calls and returns false, changing nothing, when the run is
+    // not a pure register operation: a debug port register selected or busy,
+    // TRST asserted, or a scheduled event inside the run.
+    //
+    // shift_run: Shift-IR/Shift-DR with TMS low, plus a final TMS=1 exit
+    // when exits is set. TDI comes from tdi_buf starting at bit offset; TDO
+    // bits are ORed into tdo_buf (may be null) at the same offset.
+    bool shift_run(const uint8_t* tdi_buf, int offset, uint8_t* tdo_buf, int count, bool exits);
+    // shift_run_constant: Shift-IR/Shift-DR with TMS low and TDI held for
+    // the whole run; TDO bits are ORed into tdo_buf (may be null) at offset
+    bool shift_run_constant(bool tdi_in, uint8_t* tdo_buf, int offset, int count);
+    // idle_run: TMS low in Run-Test/Idle or a Pause state; TDO holds steady
+    bool idle_run(bool tdi_in, uint64_t count);
+    void drive_pins(bool tck_val, bool tms_val, bool tdi_val);
+    bool get_tdo() const { return tdo_reg; }
+    void wait_ns(uint64_t ns);
+    void advance_to(uint64_t target_ps);
+    uint64_t time_ns() const { return time_ps / 1000; }
+    void set_sys_reset_n(bool value);
+    void set_trst_n(bool value);
+
+    // Register state at the current time; load_snapshot overwrites it as a
+    // backdoor write would, without any TCK activity
+    JtagTapSnapshot snapshot();
+    void load_snapshot(const JtagTapSnapshot& snapshot);
+
+    // Instruction decode (jtag_instruction_register.sv)
+    bool select_bypass() const;
+    bool select_idcode() const;
+    bool select_boundary_scan() const;
+    bool select_extest() const;
+    bool select_dtmcs() const;
+    bool select_dmi() const;
+    bool select_abort() const;
+    bool select_dpacc() const;
+    bool select_apacc() const;
+
+    // Combinational outputs
+    bool selected_tdo() const;
+    bool up_down_core() const;
+    void spi_pins(bool* cs_n, bool* sck, bool* mosi) const;
+    uint32_t count();
+
+private:
+    bool stable_state(bool tms_in) const;
+    bool shift_register(uint64_t* reg, int* width) const;
+    void load_shift_register(uint64_t value);
+    void tck_posedge();
+    void tap_reset_registers();
+    void sync_counter(uint64_t until_ps);
+    void update_counter_direction(uint64_t edge_ps);
+    void update_spi_pins();
+};
+
+#endif // JTAG_NATIVE_MODEL_H
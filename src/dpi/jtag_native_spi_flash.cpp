@@ -0,0 +1,135 @@
+// jtag_native_spi_flash.cpp
+// Native C++ model of spi_flash_model for the native backend
+
+#include <cstring>
+#include "jtag_native_spi_flash.h"
+#include "spi_flash_programmer.h"
+
+NativeSpiFlash::NativeSpiFlash()
+    : cs_n(true), sck(false), mosi(false), mem(MEM_BYTES, 0xFF),
+      in_shift(0), out_shift(0), command(0), bit_count(0), byte_count(0),
+      address(0), wel(false), busy_until_ps(0), miso_reg(false) {
+    memset(page_buf, 0, sizeof(page_buf));
+    memset(page_valid, 0, sizeof(page_valid));
+}
+
+uint8_t NativeSpiFlash::status(uint64_t time_ps) const {
+    return (wel ? SPI_FLASH_SR_WEL : 0) | (busy(time_ps) ? SPI_FLASH_SR_WIP : 0);
+}
+
+uint8_t NativeSpiFlash::next_output(int received, uint64_t time_ps) const {
+    switch (command) {
+        case SPI_FLASH_CMD_RDID:
+            return received <= 3 ? (uint8_t)(JEDEC_ID >> (8 * (3 - received))) : 0;
+        case SPI_FLASH_CMD_RDSR:
+            return status(time_ps);
+        case SPI_FLASH_CMD_READ:
+            return received >= 4 ? mem[mem_index(address)] : 0;
+        default:
+            return 0;
+    }
+}
+
+void NativeSpiFlash::select() {
+    bit_count = 0;
+    byte_count = 0;
+    command = 0;
+    out_shift = 0;
+    memset(page_valid, 0, sizeof(page_valid));
+}
+
+void NativeSpiFlash::sck_rise(uint64_t time_ps) {
+    in_shift = (uint8_t)((in_shift << 1) | (mosi ? 1 : 0));
+    bit_count = (bit_count + 1) & 0x7;
+    if (bit_count != 0) {
+        return;
+    }
+    byte_count++;
+    if (byte_count == 1) {
+        command = (busy(time_ps) && in_shift != SPI_FLASH_CMD_RDSR) ? 0 : in_shift;
+    } else if (byte_count <= 4 && (command == SPI_FLASH_CMD_READ || command == SPI_FLASH_CMD_PP ||
+                                   command == SPI_FLASH_CMD_SE)) {
+        address = ((address << 8) | in_shift) & 0xFFFFFF;
+    } else if (command == SPI_FLASH_CMD_PP) {
+        page_buf[address & 0xFF] = in_shift;
+        page_valid[address & 0xFF] = true;
+        address = (address & ~0xFFu) | ((address + 1) & 0xFF);
+    }
+    out_shift = next_output(byte_count, time_ps);
+    if (command == SPI_FLASH_CMD_READ && byte_count >= 4) {
+        address = (address + 1) & 0xFFFFFF;
+    }
+}
+
+void NativeSpiFlash::sck_fall() {
+    miso_reg = out_shift & 0x80;
+    out_shift = (uint8_t)(out_shift << 1);
+}
+
+void NativeSpiFlash::deselect(uint64_t time_ps) {
+    if (bit_count != 0 || byte_count == 0) {
+        return;
+    }
+    switch (command) {
+        case SPI_FLASH_CMD_WREN:
+            wel = true;
+            break;
+        case SPI_FLASH_CMD_WRDI:
+            wel = false;
+            break;
+        case SPI_FLASH_CMD_PP:
+            if (wel && byte_count > 4) {
+                uint32_t page = address & ~0xFFu;
+                for (int i = 0; i < 256; i++) {
+                    if (page_valid[i]) {
+                        mem[mem_index(page | i)] &= page_buf[i];
+                    }
+                }
+                busy_until_ps = time_ps + (uint64_t)PROGRAM_TIME_NS * 1000;
+            }
+            wel = false;
+            break;
+        case SPI_FLASH_CMD_SE:
+            if (wel && byte_count == 4) {
+                uint32_t sector = mem_index(address) & ~0xFFFu;
+                memset(&mem[sector], 0xFF, 4096);
+                busy_until_ps = time_ps + (uint64_t)ERASE_TIME_NS * 1000;
+            }
+            wel = false;
+            break;
+        case SPI_FLASH_CMD_CE:
+        case SPI_FLASH_CMD_CE_60:
+            if (wel && byte_count == 1) {
+                memset(mem.data(), 0xFF, mem.size());
+                busy_until_ps = time_ps + (uint64_t)ERASE_TIME_NS * 1000;
+            }
+            wel = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void NativeSpiFlash::set_pins(bool cs_n_val, bool sck_val, bool mosi_val, uint64_t time_ps) {
+    bool cs_fall = cs_n && !cs_n_val;
+    bool cs_rise = !cs_n && cs_n_val;
+    bool sck_rise_edge = !sck && sck_val;
+    bool sck_fall_edge = sck && !sck_val;
+
+    cs_n = cs_n_val;
+    sck = sck_val;
+    mosi = mosi_val;
+
+    if (cs_fall) {
+        select();
+    }
+    if (!cs_n && sck_rise_edge) {
+        sck_rise(time_ps);
+    }
+    if (!cs_n && sck_fall_edge) {
+        sck_fall();
+    }
+    if (cs_rise) {
+        deselect(time_ps);
+    }
+}
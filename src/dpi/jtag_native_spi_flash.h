@@ -0,0 +1,58 @@
+// jtag_native_spi_flash.h
+// Native C++ model of spi_flash_model for the native backend
+
+#ifndef JTAG_NATIVE_SPI_FLASH_H
+#define JTAG_NATIVE_SPI_FLASH_H
+
+#include <cstdint>
+#include <vector>
+
+// NativeSpiFlash class
+// Mirror of tb/spi_flash_model.sv. set_pins() receives the boundary-scan
+// driven CS/SCK/MOSI levels whenever they may have changed and reacts to
+// the edges in the same order as the SV processes (select, SCK, deselect).
+// Program/erase busy time is kept in simulated picoseconds.
+class NativeSpiFlash {
+public:
+    // spi_flash_model parameters
+    enum {
+        MEM_BYTES = 16384,
+        PROGRAM_TIME_NS = 5000,
+        ERASE_TIME_NS = 50000
+    };
+    static const uint32_t JEDEC_ID = 0xEF4016;
+
+    // Pin levels as last driven
+    bool cs_n, sck, mosi;
+
+    std::vector<uint8_t> mem;
+
+    NativeSpiFlash();
+
+    void set_pins(bool cs_n_val, bool sck_val, bool mosi_val, uint64_t time_ps);
+
+    // MISO with the testbench pull-up while deselected
+    bool miso() const { return cs_n ? true : miso_reg; }
+
+private:
+    uint8_t page_buf[256];
+    bool page_valid[256];
+    uint8_t in_shift, out_shift, command;
+    int bit_count;
+    int byte_count;
+    uint32_t address;
+    bool wel;
+    uint64_t busy_until_ps;
+    bool miso_reg;
+
+    bool busy(uint64_t time_ps) const { return time_ps < busy_until_ps; }
+    uint8_t status(uint64_t time_ps) const;
+    uint8_t next_output(int received, uint64_t time_ps) const;
+    uint32_t mem_index(uint32_t addr) const { return addr % MEM_BYTES; }
+    void select();
+    void sck_rise(uint64_t time_ps);
+    void sck_fall();
+    void deselect(uint64_t time_ps);
+};
+
+#endif // JTAG_NATIVE_SPI_FLASH_H
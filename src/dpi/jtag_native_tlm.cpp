@@ -0,0 +1,69 @@
+// jtag_native_tlm.cpp
+// Transaction-level backend executing whole scans on the native model
+
+#include "jtag_native_tlm.h"
+
+static bool buffer_bit(const uint8_t* buf, int bit) {
+    return (buf[bit / 8] >> (bit % 8)) & 1;
+}
+
+void NativeTlmBackend::step_bits_individually(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int start,
+                                              int end) {
+    for (int i = start; i < end; i++) {
+        bool tdo_bit = model->jtag_step(buffer_bit(tms, i), buffer_bit(tdi, i));
+        if (tdo && tdo_bit) {
+            tdo[i / 8] |= (uint8_t)(1u << (i % 8));
+        }
+    }
+    step_bits += end - start;
+}
+
+void NativeTlmBackend::shift(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit) {
+    int i = 0;
+    while (i < cbit) {
+        TapState state = model->current_state;
+        bool shifting = state == SHIFT_IR || state == SHIFT_DR;
+        bool holding = state == RUN_TEST_IDLE || state == PAUSE_DR || state == PAUSE_IR;
+        if (!shifting && !holding) {
+            step_bits_individually(tms, tdi, tdo, i, i + 1);
+            i++;
+            continue;
+        }
+
+        int run_end = i;
+        while (run_end < cbit && !buffer_bit(tms, run_end)) {
+            run_end++;
+        }
+        if (shifting) {
+            // The exit bit still shifts, so it belongs to the run
+            bool exits = run_end < cbit;
+            int count = run_end - i + (exits ? 1 : 0);
+            if (model->shift_run(tdi, i, tdo, count, exits)) {
+                word_bits += count;
+            } else {
+                step_bits_individually(tms, tdi, tdo, i, i + count);
+            }
+            i += count;
+            continue;
+        }
+
+        int count = run_end - i;
+        if (count == 0) {
+            step_bits_individually(tms, tdi, tdo, i, i + 1);
+            i++;
+            continue;
+        }
+        if (model->idle_run(buffer_bit(tdi, run_end - 1), count)) {
+            if (tdo && model->get_tdo()) {
+                for (int k = 0; k < count; k += 64) {
+                    int length = count - k < 64 ? count - k : 64;
+                    scan_deposit_bits(tdo, i + k, ~0ull, length);
+                }
+            }
+            idle_bits += count;
+        } else {
+            step_bits_individually(tms, tdi, tdo, i, run_end);
+        }
+        i = run_end;
+    }
+}
@@ -0,0 +1,30 @@
+// jtag_native_tlm.h
+// Transaction-level backend executing whole scans on the native model
+
+#ifndef JTAG_NATIVE_TLM_H
+#define JTAG_NATIVE_TLM_H
+
+#include "digilent_jtag_mock.h"
+#include "jtag_native_model.h"
+
+// NativeTlmBackend class
+// Executes djtg_shift_bits buffers on a NativeJtagModel as transactions.
+// Runs of TMS-low cycles in Shift-IR/Shift-DR (with their exit bit) become
+// word-level shifts of the selected register (instruction, BSR, IDCODE or
+// BYPASS) and runs in Run-Test/Idle or Pause become one time jump. Every
+// other cycle (TAP walks, Capture/Update, debug port scans) is stepped with
+// jtag_step, so the register state, TDO and simulated time match per-TCK
+// stepping exactly.
+class NativeTlmBackend : public JtagBulkBackend {
+public:
+    NativeJtagModel* model;
+
+    explicit NativeTlmBackend(NativeJtagModel* model) : model(model) {}
+
+    void shift(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int cbit) override;
+
+private:
+    void step_bits_individually(const uint8_t* tms, const uint8_t* tdi, uint8_t* tdo, int start, int end);
+};
+
+#endif // JTAG_NATIVE_TLM_H
@@ -0,0 +1,166 @@
+// jtag_path_model.cpp
+// Measured cost of each djtg_shift_bits execution path and the crossovers
+
+#include <cstdio>
+#include <cmath>
+#include "jtag_path_model.h"
+
+// Samples before a fit is trusted: fewer suffice once lengths differ
+#define PATH_MIN_SAMPLES         3
+#define PATH_MIN_SAMPLES_SINGLE  8
+
+static const char* const path_names[JTAG_PATH_COUNT] = { "step", "run", "vector", "bulk" };
+
+const char* jtag_path_name(JtagShiftPath path) {
+    return path < JTAG_PATH_COUNT ? path_names[path] : "auto";
+}
+
+static const char* format_bits(char* buf, size_t size, int bits) {
+    if (bits < 0) {
+        return "never";
+    }
+    snprintf(buf, size, "%d bits", bits);
+    return buf;
+}
+
+JtagPathCost::JtagPathCost()
+    : samples(0), bits(0), sum_n(0), sum_t(0), sum_nn(0), sum_nt(0), call_us(0), bit_us(0) {
+}
+
+// Negative intercepts or slopes from noisy samples are clamped to zero
+void JtagPathCost::add(int n, double us) {
+    samples++;
+    bits += n;
+    sum_n += n;
+    sum_t += us;
+    sum_nn += (double)n * n;
+    sum_nt += n * us;
+
+    double mean_n = sum_n / samples;
+    double mean_t = sum_t / samples;
+    double var = sum_nn / samples - mean_n * mean_n;
+    if (samples >= 2 && var > 1e-9 * mean_n * mean_n) {
+        bit_us = (sum_nt / samples - mean_n * mean_t) / var;
+        call_us = mean_t - bit_us * mean_n;
+    } else {
+        bit_us = mean_n > 0 ? mean_t / mean_n : 0;
+        call_us = 0;
+    }
+    if (bit_us < 0) {
+        bit_us = 0;
+        call_us = mean_t;
+    }
+    if (call_us < 0) {
+        call_us = 0;
+        bit_us = sum_nn > 0 ? sum_nt / sum_nn : 0;
+    }
+}
+
+bool JtagPathCost::fitted() const {
+    if (samples >= PATH_MIN_SAMPLES_SINGLE) {
+        return true;
+    }
+    double mean_n = samples ? sum_n / samples : 0;
+    return samples >= PATH_MIN_SAMPLES && sum_nn / samples - mean_n * mean_n > 1e-9 * mean_n * mean_n;
+}
+
+JtagPathModel::JtagPathModel() : explore_interval(64), min_run_bits(4) {
+    reset();
+}
+
+void JtagPathModel::reset() {
+    for (int p = 0; p < JTAG_PATH_COUNT; p++) {
+        cost[p] = JtagPathCost();
+        chosen[p] = 0;
+        last_chosen[p] = 0;
+    }
+    transfers = 0;
+}
+
+JtagShiftPath JtagPathModel::choose(int cbit, unsigned available) {
+    transfers++;
+    available &= ~(1u << JTAG_PATH_RUN);
+    JtagShiftPath pick = JTAG_PATH_COUNT;
+
+    // Unfitted paths first, the one with the fewest samples
+    for (int p = 0; p < JTAG_PATH_COUNT; p++) {
+        if (((available >> p) & 1) && !cost[p].fitted() &&
+            (pick == JTAG_PATH_COUNT || cost[p].samples < cost[pick].samples)) {
+            pick = (JtagShiftPath)p;
+        }
+    }
+    // Periodic re-exploration of the least recently chosen path
+    if (pick == JTAG_PATH_COUNT && explore_interval > 0 && transfers % explore_interval == 0) {
+        for (int p = 0; p < JTAG_PATH_COUNT; p++) {
+            if (((available >> p) & 1) && (pick == JTAG_PATH_COUNT || last_chosen[p] < last_chosen[pick])) {
+                pick = (JtagShiftPath)p;
+            }
+        }
+    }
+    if (pick == JTAG_PATH_COUNT) {
+        for (int p = 0; p < JTAG_PATH_COUNT; p++) {
+            if (((available >> p) & 1) &&
+                (pick == JTAG_PATH_COUNT || cost[p].predict(cbit) < cost[pick].predict(cbit))) {
+                pick = (JtagShiftPath)p;
+            }
+        }
+    }
+    if (pick == JTAG_PATH_COUNT) {
+        pick = JTAG_PATH_STEP;
+    }
+    chosen[pick]++;
+    last_chosen[pick] = transfers;
+    return pick;
+}
+
+int JtagPathModel::crossover(JtagShiftPath path) const {
+    const JtagPathCost& step = cost[JTAG_PATH_STEP];
+    const JtagPathCost& other = cost[path];
+    if (!step.fitted() || !other.fitted()) {
+        return -1;
+    }
+    if (other.call_us <= step.call_us) {
+        return other.bit_us <= step.bit_us ? 1 : -1;
+    }
+    if (other.bit_us >= step.bit_us) {
+        return -1;
+    }
+    return (int)ceil((other.call_us - step.call_us) / (step.bit_us - other.bit_us));
+}
+
+// A run replaces that many sv_jtag_step calls
+int JtagPathModel::run_threshold(int fallback) const {
+    const JtagPathCost& step = cost[JTAG_PATH_STEP];
+    const JtagPathCost& run = cost[JTAG_PATH_RUN];
+    if (!step.fitted() || !run.fitted()) {
+        return fallback;
+    }
+    if (run.bit_us >= step.bit_us) {
+        return 1 << 30;
+    }
+    int threshold = (int)ceil(run.call_us / (step.bit_us - run.bit_us));
+    return threshold > min_run_bits ? threshold : min_run_bits;
+}
+
+void JtagPathModel::print_report(const char* title) const {
+    printf("%s:\n", title);
+    for (int p = 0; p < JTAG_PATH_COUNT; p++) {
+        const JtagPathCost& c = cost[p];
+        if (!c.samples) {
+            continue;
+        }
+        printf("  %-8s %6llu samples  %8.2f us/call  %8.2f ns/bit", path_names[p], (unsigned long long)c.samples,
+               c.call_us, c.bit_us * 1000.0);
+        if (p != JTAG_PATH_RUN) {
+            printf("  %6llu transfers", (unsigned long long)chosen[p]);
+        }
+        printf("\n");
+    }
+    char vector[32], bulk[32], run[32];
+    int run_bits = run_threshold(-1);
+    printf("  Crossover:     vector from %s, bulk from %s, runs from %s\n",
+           format_bits(vector, sizeof(vector), crossover(JTAG_PATH_VECTOR)),
+           format_bits(bulk, sizeof(bulk), crossover(JTAG_PATH_BULK)),
+           run_bits < 0 ? "default" : format_bits(run, sizeof(run), run_bits < (1 << 30) ? run_bits : -1));
+    fflush(stdout);
+}
@@ -0,0 +1,81 @@
+// jtag_path_model.h
+// Measured cost of each djtg_shift_bits execution path and the crossovers
+
+#ifndef JTAG_PATH_MODEL_H
+#define JTAG_PATH_MODEL_H
+
+#include <cstdint>
+
+// Ways a transfer on instance 0 can reach the backend. STEP is one
+// sv_jtag_step per cycle, RUN one sv_jtag_run per constant stretch inside a
+// STEP transfer, VECTOR one sv_jtag_shift_capture call for the whole
+// transfer (stimulus fetched 32 bits per DPI call), BULK the
+// JtagBulkBackend when one is set.
+enum JtagShiftPath {
+    JTAG_PATH_STEP,
+    JTAG_PATH_RUN,
+    JTAG_PATH_VECTOR,
+    JTAG_PATH_BULK,
+    JTAG_PATH_COUNT,
+    JTAG_PATH_AUTO = JTAG_PATH_COUNT
+};
+
+// Least-squares fit of wall time = call_us + bit_us * bits over the
+// samples seen so far
+struct JtagPathCost {
+    uint64_t samples;
+    uint64_t bits;
+    double sum_n;
+    double sum_t;
+    double sum_nn;
+    double sum_nt;
+    double call_us;
+    double bit_us;
+
+    JtagPathCost();
+
+    void add(int n, double us);
+    bool fitted() const;
+    double predict(int n) const { return call_us + bit_us * n; }
+};
+
+// JtagPathModel class
+// Learns the per-call and per-bit cost of every path from the transfers
+// the session actually makes; no extra TCK cycles are spent on it, and
+// since every path produces the same TDO and simulated time, the choice
+// only affects wall time. A path with too few samples, or samples of only
+// one length, is explored before the fits are trusted, and every
+// explore_interval transfers the least recently chosen path is tried again
+// so the fits follow changing conditions.
+class JtagPathModel {
+public:
+    JtagPathCost cost[JTAG_PATH_COUNT];
+    uint64_t chosen[JTAG_PATH_COUNT];    // Transfers sent down each path
+    uint64_t transfers;
+    int explore_interval;
+    int min_run_bits;                    // Floor for the derived run threshold
+
+    JtagPathModel();
+
+    void reset();
+
+    // Path for a cbit-bit transfer; available is a mask of (1 << path) over
+    // STEP, VECTOR and BULK
+    JtagShiftPath choose(int cbit, unsigned available);
+    void record(JtagShiftPath path, int bits, double us) { cost[path].add(bits, us); }
+
+    // Shortest transfer for which the path beats STEP, -1 when it never
+    // does or is not fitted yet
+    int crossover(JtagShiftPath path) const;
+    // Shortest constant stretch worth an sv_jtag_run call
+    int run_threshold(int fallback) const;
+
+    void print_report(const char* title) const;
+
+private:
+    uint64_t last_chosen[JTAG_PATH_COUNT];
+};
+
+const char* jtag_path_name(JtagShiftPath path);
+
+#endif // JTAG_PATH_MODEL_H
@@ -0,0 +1,289 @@
+// jtag_scan_cache.cpp
+// On-disk cache of compiled scan programs, loaded zero-copy via mmap
+// (read into memory on Windows)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "jtag_scan_cache.h"
+#include "digilent_jtag_mock.h"
+
+static uint32_t align8(uint32_t offset) {
+    return (offset + 7) & ~7u;
+}
+
+// MappedScanProgram implementation
+MappedScanProgram::MappedScanProgram() : base(nullptr), size(0), header(nullptr) {}
+
+MappedScanProgram::~MappedScanProgram() {
+    unmap();
+}
+
+MappedScanProgram::MappedScanProgram(MappedScanProgram&& other)
+    : base(other.base), size(other.size), header(other.header) {
+    other.base = nullptr;
+    other.size = 0;
+    other.header = nullptr;
+}
+
+MappedScanProgram& MappedScanProgram::operator=(MappedScanProgram&& other) {
+    if (this != &other) {
+        unmap();
+        base = other.base;
+        size = other.size;
+        header = other.header;
+        other.base = nullptr;
+        other.size = 0;
+        other.header = nullptr;
+    }
+    return *this;
+}
+
+// Map a cache file read-only and validate its header. Any inconsistency
+// (stale version, hash collision, truncated file) is reported as a miss.
+bool MappedScanProgram::map_file(const std::string& path, uint64_t key) {
+    unmap();
+
+#ifdef _WIN32
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    long length = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+    if (length < (long)sizeof(ScanCacheHeader) || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return false;
+    }
+    uint8_t* buffer = new uint8_t[length];
+    bool read_ok = fread(buffer, 1, length, f) == (size_t)length;
+    fclose(f);
+    if (!read_ok) {
+        delete[] buffer;
+        return false;
+    }
+    base = buffer;
+    size = length;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ScanCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    base = (const uint8_t*)mapping;
+    size = st.st_size;
+#endif
+    header = (const ScanCacheHeader*)base;
+
+    int byte_count = (header->bit_count + 7) / 8;
+    bool ok = header->magic == SCAN_CACHE_MAGIC &&
+              header->version == SCAN_CACHE_VERSION &&
+              header->key == key &&
+              header->file_size == size &&
+              header->tms_offset + byte_count <= size &&
+              header->tdi_offset + byte_count <= size &&
+              header->fields_offset + header->field_count * sizeof(ScanField) <= size;
+    if (!ok) {
+        printf("SCAN_CACHE: Ignoring invalid cache file %s\n", path.c_str());
+        fflush(stdout);
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void MappedScanProgram::unmap() {
+    if (base) {
+#ifdef _WIN32
+        delete[] base;
+#else
+        munmap((void*)base, size);
+#endif
+    }
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+}
+
+const ScanField& MappedScanProgram::field(int index) const {
+    const ScanField* fields = (const ScanField*)(base + header->fields_offset);
+    return fields[index];
+}
+
+// ScanProgramCache implementation
+ScanProgramCache::ScanProgramCache(const std::string& dir) : directory(dir), hits(0), misses(0) {}
+
+std::string ScanProgramCache::path_for(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.jscp", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+bool ScanProgramCache::load(uint64_t key, MappedScanProgram& out) {
+    if (out.map_file(path_for(key), key)) {
+        hits++;
+        return true;
+    }
+    misses++;
+    return false;
+}
+
+bool ScanProgramCache::store(uint64_t key, const ScanProgram& program) {
+    // Create the cache directory (and parents) on first use
+    for (size_t pos = 1; pos <= directory.size(); pos++) {
+        if (pos == directory.size() || directory[pos] == '/') {
+            std::string part = directory.substr(0, pos);
+#ifdef _WIN32
+            int status = _mkdir(part.c_str());
+#else
+            int status = mkdir(part.c_str(), 0755);
+#endif
+            if (status != 0 && errno != EEXIST) {
+                printf("SCAN_CACHE: Cannot create directory %s\n", part.c_str());
+                fflush(stdout);
+                return false;
+            }
+        }
+    }
+
+    uint32_t byte_count = (program.bit_count + 7) / 8;
+    ScanCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCAN_CACHE_MAGIC;
+    header.version = SCAN_CACHE_VERSION;
+    header.key = key;
+    header.bit_count = program.bit_count;
+    header.field_count = program.fields.size();
+    header.start_state = program.start_state;
+    header.end_state = program.state;
+    header.tms_offset = align8(sizeof(ScanCacheHeader));
+    header.tdi_offset = align8(header.tms_offset + byte_count);
+    header.fields_offset = align8(header.tdi_offset + byte_count);
+    header.file_size = header.fields_offset + header.field_count * sizeof(ScanField);
+
+    std::vector<uint8_t> image(header.file_size, 0);
+    memcpy(&image[0], &header, sizeof(header));
+    if (byte_count > 0) {
+        memcpy(&image[header.tms_offset], program.tms.data(), byte_count);
+        memcpy(&image[header.tdi_offset], program.tdi.data(), byte_count);
+    }
+    if (header.field_count > 0) {
+        memcpy(&image[header.fields_offset], program.fields.data(),
+               header.field_count * sizeof(ScanField));
+    }
+
+    // Write to a per-process temporary name, then publish atomically
+    std::string path = path_for(key);
+#ifdef _WIN32
+    std::string tmp_path = path + ".tmp." + std::to_string(_getpid());
+#else
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+#endif
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        printf("SCAN_CACHE: Cannot write %s\n", tmp_path.c_str());
+        fflush(stdout);
+        return false;
+    }
+    bool ok = fwrite(image.data(), 1, image.size(), f) == image.size();
+    ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    ok = ok && MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) {
+        printf("SCAN_CACHE: Failed to publish %s\n", path.c_str());
+        fflush(stdout);
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    printf("SCAN_CACHE: Stored %d-bit program as %s\n", program.bit_count, path.c_str());
+    fflush(stdout);
+    return true;
+}
+
+bool ScanProgramCache::load_or_compile(uint64_t key,
+                                       const std::function<void(ScanProgram&)>& compile,
+                                       MappedScanProgram& out) {
+    if (load(key, out)) {
+        printf("SCAN_CACHE: Hit for key %016llx (%d bits)\n",
+               (unsigned long long)key, out.bit_count());
+        fflush(stdout);
+        return true;
+    }
+
+    printf("SCAN_CACHE: Miss for key %016llx, compiling\n", (unsigned long long)key);
+    fflush(stdout);
+    ScanProgram program;
+    compile(program);
+    if (!store(key, program)) {
+        return false;
+    }
+    return out.map_file(path_for(key), key);
+}
+
+// FNV-1a over each component, with a separator so ("ab","c") != ("a","bc")
+uint64_t scan_cache_key(const std::string& test_name, const std::string& params,
+                        const std::string& chain_config) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const std::string encoding = "encoding=" + std::to_string(SCAN_PROGRAM_ENCODING);
+    const std::string* parts[4] = { &test_name, &params, &chain_config, &encoding };
+    for (int p = 0; p < 4; p++) {
+        for (unsigned char c : *parts[p]) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        hash ^= 0xFF;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string scan_cache_default_dir() {
+    const char* env = getenv("JTAG_SCAN_CACHE_DIR");
+    if (env && env[0]) {
+        return env;
+    }
+    return "build/scan_cache";
+}
+
+int run_mapped_scan_program(int hif, const MappedScanProgram& program, uint8_t* tdo) {
+    if (!program.valid()) {
+        return FALSE;
+    }
+    int tap = jtag_device_tap(hif);
+    TapState state = jtag_tracked_state(tap);
+    if (tap >= 0 && state != program.start_state()) {
+        printf("SCAN_CACHE: Program starts in %s but the TAP is in %s\n", tap_state_name(program.start_state()),
+               tap_state_name(state));
+        fflush(stdout);
+        return FALSE;
+    }
+    return djtg_shift_bits(hif, program.tms(), program.tdi(), tdo, program.bit_count());
+}
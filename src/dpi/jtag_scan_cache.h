@@ -0,0 +1,91 @@
+// jtag_scan_cache.h
+// On-disk cache of compiled scan programs, loaded zero-copy via mmap
+
+#ifndef JTAG_SCAN_CACHE_H
+#define JTAG_SCAN_CACHE_H
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include "jtag_scan_program.h"
+
+#define SCAN_CACHE_MAGIC   0x5043534A  // "JSCP"
+#define SCAN_CACHE_VERSION 1
+
+// File layout: header, TMS bytes, TDI bytes, ScanField table.
+// Sections start on 8-byte boundaries so the mapping can be used in place.
+struct ScanCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t bit_count;
+    uint32_t field_count;
+    uint32_t start_state;
+    uint32_t end_state;
+    uint32_t tms_offset;
+    uint32_t tdi_offset;
+    uint32_t fields_offset;
+    uint32_t file_size;
+};
+
+// MappedScanProgram class
+// Read-only view of a cached program. The TMS/TDI pointers reference the
+// mapped file directly; nothing is copied on load (Windows builds read the
+// file into memory instead).
+class MappedScanProgram {
+public:
+    MappedScanProgram();
+    ~MappedScanProgram();
+    MappedScanProgram(MappedScanProgram&& other);
+    MappedScanProgram& operator=(MappedScanProgram&& other);
+    MappedScanProgram(const MappedScanProgram&) = delete;
+    MappedScanProgram& operator=(const MappedScanProgram&) = delete;
+
+    bool map_file(const std::string& path, uint64_t key);
+    void unmap();
+
+    bool valid() const { return header != nullptr; }
+    int bit_count() const { return header->bit_count; }
+    int field_count() const { return header->field_count; }
+    TapState start_state() const { return (TapState)header->start_state; }
+    const uint8_t* tms() const { return base + header->tms_offset; }
+    const uint8_t* tdi() const { return base + header->tdi_offset; }
+    const ScanField& field(int index) const;
+
+private:
+    const uint8_t* base;
+    size_t size;
+    const ScanCacheHeader* header;
+};
+
+// ScanProgramCache class
+// One file per program, named by the 64-bit source hash. Stores go through a
+// temporary file and rename() so parallel shards never see partial files.
+class ScanProgramCache {
+public:
+    std::string directory;
+    int hits;
+    int misses;
+
+    explicit ScanProgramCache(const std::string& dir);
+
+    std::string path_for(uint64_t key) const;
+    bool load(uint64_t key, MappedScanProgram& out);
+    bool store(uint64_t key, const ScanProgram& program);
+    bool load_or_compile(uint64_t key, const std::function<void(ScanProgram&)>& compile,
+                         MappedScanProgram& out);
+};
+
+// Cache key from the program source (test name, parameters, chain config)
+// and SCAN_PROGRAM_ENCODING
+uint64_t scan_cache_key(const std::string& test_name, const std::string& params,
+                        const std::string& chain_config = JTAG_CHAIN_CONFIG);
+
+// Cache directory: $JTAG_SCAN_CACHE_DIR or build/scan_cache
+std::string scan_cache_default_dir();
+
+// Execute a mapped program on a device in a single bulk transfer. Rejected
+// when the device's TAP is not in the state the program was compiled from.
+int run_mapped_scan_program(int hif, const MappedScanProgram& program, uint8_t* tdo);
+
+#endif // JTAG_SCAN_CACHE_H
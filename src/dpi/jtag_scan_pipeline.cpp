@@ -0,0 +1,134 @@
+// jtag_scan_pipeline.cpp
+// Host/simulator pipelined scan execution
+
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include "jtag_scan_pipeline.h"
+#include "digilent_jtag_mock.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ScanPipeline::ScanPipeline(int hif, GenerateFn generate, VerifyFn verify)
+    : hif(hif), scans_executed(0), scans_failed(0), bits_shifted(0),
+      sim_idle_ms(0), host_idle_ms(0), generate(generate), verify(verify) {}
+
+int ScanPipeline::run() {
+    std::thread worker(&ScanPipeline::worker_loop, this);
+
+    // Simulator side: execute prepared scans in order until the end marker
+    while (true) {
+        PipelinedScan* scan = nullptr;
+        if (!ready.try_pop(scan)) {
+            auto wait_start = std::chrono::steady_clock::now();
+            scan = ready.pop();
+            sim_idle_ms += elapsed_ms(wait_start);
+        }
+        if (!scan) {
+            break;
+        }
+
+        ScanProgram& program = scan->program;
+        scan->tdo.resize((program.bit_count + 7) / 8);
+        scan->executed = djtg_shift_bits(hif, program.tms.data(), program.tdi.data(),
+                                         scan->tdo.data(), program.bit_count);
+        bits_shifted += program.bit_count;
+        executed.push(scan);
+    }
+
+    worker.join();
+
+    printf("PIPELINE: %llu scans, %llu bits, %llu failed (sim idle %.3f ms, host idle %.3f ms)\n",
+           (unsigned long long)scans_executed, (unsigned long long)bits_shifted,
+           (unsigned long long)scans_failed, sim_idle_ms, host_idle_ms);
+    fflush(stdout);
+    return scans_failed == 0 ? TRUE : FALSE;
+}
+
+// Host worker: generate into free slots, verify slots coming back
+void ScanPipeline::worker_loop() {
+    PipelinedScan* free_slots[SCAN_PIPELINE_DEPTH];
+    int free_count = 0;
+    for (int i = 0; i < SCAN_PIPELINE_DEPTH; i++) {
+        free_slots[free_count++] = &slots[i];
+    }
+
+    uint64_t index = 0;
+    int in_flight = 0;
+    bool more = true;
+
+    while (more || in_flight > 0) {
+        // Verify completed scans first so their slots can be refilled
+        PipelinedScan* done = nullptr;
+        bool progressed = false;
+        while (executed.try_pop(done)) {
+            scans_executed++;
+            if (!check_scan(*done)) {
+                scans_failed++;
+            }
+            free_slots[free_count++] = done;
+            in_flight--;
+            progressed = true;
+        }
+
+        // Prepare the next scan while the simulator works on the current one
+        if (more && free_count > 0) {
+            PipelinedScan* scan = free_slots[--free_count];
+            scan->program.clear();
+            scan->expected_tdo.clear();
+            scan->tdo_mask.clear();
+            scan->tdo.clear();
+            scan->executed = FALSE;
+            scan->sequence = index;
+
+            more = generate(index, *scan);
+            if (more) {
+                index++;
+                in_flight++;
+                ready.push(scan);
+            } else {
+                free_slots[free_count++] = scan;
+                ready.push(nullptr);  // End of campaign
+            }
+            progressed = true;
+        }
+
+        if (!progressed) {
+            auto wait_start = std::chrono::steady_clock::now();
+            std::this_thread::yield();
+            host_idle_ms += elapsed_ms(wait_start);
+        }
+    }
+}
+
+bool ScanPipeline::check_scan(const PipelinedScan& scan) {
+    if (!scan.executed) {
+        printf("PIPELINE: Scan %llu was rejected by the device\n", (unsigned long long)scan.sequence);
+        fflush(stdout);
+        return false;
+    }
+
+    // Masked compare against the expected TDO, if one was supplied
+    size_t bytes = scan.expected_tdo.size();
+    if (bytes > scan.tdo.size()) {
+        bytes = scan.tdo.size();
+    }
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t mask = i < scan.tdo_mask.size() ? scan.tdo_mask[i] : 0xFF;
+        if ((scan.tdo[i] ^ scan.expected_tdo[i]) & mask) {
+            printf("PIPELINE: Scan %llu TDO mismatch in byte %zu: got 0x%02X, expected 0x%02X (mask 0x%02X)\n",
+                   (unsigned long long)scan.sequence, i, scan.tdo[i], scan.expected_tdo[i], mask);
+            fflush(stdout);
+            return false;
+        }
+    }
+
+    if (verify && !verify(scan)) {
+        printf("PIPELINE: Scan %llu failed verification\n", (unsigned long long)scan.sequence);
+        fflush(stdout);
+        return false;
+    }
+    return true;
+}
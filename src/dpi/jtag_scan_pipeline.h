@@ -0,0 +1,62 @@
+// jtag_scan_pipeline.h
+// Host/simulator pipelined scan execution
+
+#ifndef JTAG_SCAN_PIPELINE_H
+#define JTAG_SCAN_PIPELINE_H
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "jtag_scan_program.h"
+#include "jtag_spsc_queue.h"
+
+// Number of scans in flight between the worker and the simulator thread
+#define SCAN_PIPELINE_DEPTH 4
+
+// A scan prepared by the host worker. expected_tdo/tdo_mask are optional and
+// sized like the packed program; a set mask bit means the TDO bit is checked.
+struct PipelinedScan {
+    uint64_t sequence;
+    ScanProgram program;
+    std::vector<uint8_t> expected_tdo;
+    std::vector<uint8_t> tdo_mask;
+    std::vector<uint8_t> tdo;
+    int executed;
+};
+
+// ScanPipeline class
+// The worker thread builds and packs scan N+1 and verifies scan N-1 while the
+// simulator thread executes scan N. Only the thread calling run() touches the
+// simulator, so DPI calls stay on the simulator thread. Slots are recycled,
+// so buffers stop allocating once they reach their working size.
+class ScanPipeline {
+public:
+    // Fill the scan for the given index; return false when the campaign ends
+    typedef std::function<bool(uint64_t index, PipelinedScan& scan)> GenerateFn;
+    // Extra verification after the built-in masked compare
+    typedef std::function<bool(const PipelinedScan& scan)> VerifyFn;
+
+    int hif;
+    uint64_t scans_executed;
+    uint64_t scans_failed;
+    uint64_t bits_shifted;
+    double sim_idle_ms;     // Simulator thread waiting for the host
+    double host_idle_ms;    // Worker waiting for a free slot
+
+    ScanPipeline(int hif, GenerateFn generate, VerifyFn verify = VerifyFn());
+
+    // Run the whole campaign; returns TRUE if every scan executed and verified
+    int run();
+
+private:
+    GenerateFn generate;
+    VerifyFn verify;
+    PipelinedScan slots[SCAN_PIPELINE_DEPTH];
+    SpscQueue<PipelinedScan*, SCAN_PIPELINE_DEPTH> ready;     // worker -> simulator
+    SpscQueue<PipelinedScan*, SCAN_PIPELINE_DEPTH> executed;  // simulator -> worker
+
+    void worker_loop();
+    bool check_scan(const PipelinedScan& scan);
+};
+
+#endif // JTAG_SCAN_PIPELINE_H
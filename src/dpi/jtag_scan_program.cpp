@@ -0,0 +1,208 @@
+// jtag_scan_program.cpp
+// Compiled JTAG scan programs (packed TMS/TDI vectors)
+
+#include <cstdio>
+#include "jtag_scan_program.h"
+
+// TAP state machine helpers
+TapState tap_next_state(TapState state, bool tms) {
+    switch (state) {
+        case TEST_LOGIC_RESET: return tms ? TEST_LOGIC_RESET : RUN_TEST_IDLE;
+        case RUN_TEST_IDLE:    return tms ? SELECT_DR_SCAN   : RUN_TEST_IDLE;
+        case SELECT_DR_SCAN:   return tms ? SELECT_IR_SCAN   : CAPTURE_DR;
+        case CAPTURE_DR:       return tms ? EXIT1_DR         : SHIFT_DR;
+        case SHIFT_DR:         return tms ? EXIT1_DR         : SHIFT_DR;
+        case EXIT1_DR:         return tms ? UPDATE_DR        : PAUSE_DR;
+        case PAUSE_DR:         return tms ? EXIT2_DR         : PAUSE_DR;
+        case EXIT2_DR:         return tms ? UPDATE_DR        : SHIFT_DR;
+        case UPDATE_DR:        return tms ? SELECT_DR_SCAN   : RUN_TEST_IDLE;
+        case SELECT_IR_SCAN:   return tms ? TEST_LOGIC_RESET : CAPTURE_IR;
+        case CAPTURE_IR:       return tms ? EXIT1_IR         : SHIFT_IR;
+        case SHIFT_IR:         return tms ? EXIT1_IR         : SHIFT_IR;
+        case EXIT1_IR:         return tms ? UPDATE_IR        : PAUSE_IR;
+        case PAUSE_IR:         return tms ? EXIT2_IR         : PAUSE_IR;
+        case EXIT2_IR:         return tms ? UPDATE_IR        : SHIFT_IR;
+        case UPDATE_IR:        return tms ? SELECT_DR_SCAN   : RUN_TEST_IDLE;
+    }
+    return TEST_LOGIC_RESET;
+}
+
+// Shortest TMS sequence from one state to another (breadth-first search over
+// the 16-state graph). Returns the number of TCKs written to tms_out, which
+// must hold at least 16 entries.
+int tap_tms_path(TapState from, TapState to, bool* tms_out) {
+    if (from == to) {
+        return 0;
+    }
+
+    int prev[16];
+    bool prev_tms[16];
+    int queue[16];
+    for (int i = 0; i < 16; i++) {
+        prev[i] = -1;
+    }
+
+    int head = 0, tail = 0;
+    queue[tail++] = from;
+    prev[from] = from;
+    while (head < tail && prev[to] < 0) {
+        TapState s = (TapState)queue[head++];
+        for (int tms = 0; tms < 2; tms++) {
+            TapState n = tap_next_state(s, tms != 0);
+            if (prev[n] < 0) {
+                prev[n] = s;
+                prev_tms[n] = (tms != 0);
+                queue[tail++] = n;
+            }
+        }
+    }
+
+    // Walk back from the target, then reverse into tms_out
+    int len = 0;
+    bool reversed[16];
+    for (int s = to; s != from; s = prev[s]) {
+        reversed[len++] = prev_tms[s];
+    }
+    for (int i = 0; i < len; i++) {
+        tms_out[i] = reversed[len - 1 - i];
+    }
+    return len;
+}
+
+const char* tap_state_name(TapState state) {
+    static const char* names[16] = {
+        "Test-Logic-Reset", "Run-Test/Idle", "Select-DR-Scan", "Capture-DR",
+        "Shift-DR", "Exit1-DR", "Pause-DR", "Exit2-DR", "Update-DR",
+        "Select-IR-Scan", "Capture-IR", "Shift-IR", "Exit1-IR", "Pause-IR",
+        "Exit2-IR", "Update-IR"
+    };
+    return names[state & 0xF];
+}
+
+// ScanProgram implementation
+ScanProgram::ScanProgram(TapState start, SessionArena* arena)
+    : tms(ArenaAllocator<uint8_t>(arena)), tdi(ArenaAllocator<uint8_t>(arena)),
+      fields(ArenaAllocator<ScanField>(arena)),
+      bit_count(0), start_state(start), state(start) {}
+
+void ScanProgram::clear(TapState start) {
+    tms.clear();
+    tdi.clear();
+    fields.clear();
+    bit_count = 0;
+    start_state = start;
+    state = start;
+}
+
+void ScanProgram::append_bit(bool tms_val, bool tdi_val) {
+    if (bit_count % 8 == 0) {
+        tms.push_back(0);
+        tdi.push_back(0);
+    }
+    if (tms_val) {
+        tms[bit_count / 8] |= (1 << (bit_count % 8));
+    }
+    if (tdi_val) {
+        tdi[bit_count / 8] |= (1 << (bit_count % 8));
+    }
+    bit_count++;
+    state = tap_next_state(state, tms_val);
+}
+
+void ScanProgram::goto_state(TapState target) {
+    bool path[16];
+    int len = tap_tms_path(state, target, path);
+    for (int i = 0; i < len; i++) {
+        append_bit(path[i], false);
+    }
+}
+
+// Leave an IR or DR scan through Update-* so the shifted value takes effect.
+// goto_state() alone would take the shorter Pause/Exit2 path between two
+// scans of the same register and skip the update.
+void ScanProgram::complete_scan() {
+    switch (state) {
+        case EXIT1_DR: case PAUSE_DR: case EXIT2_DR:
+            goto_state(UPDATE_DR);
+            break;
+        case EXIT1_IR: case PAUSE_IR: case EXIT2_IR:
+            goto_state(UPDATE_IR);
+            break;
+        default:
+            break;
+    }
+}
+
+void ScanProgram::idle(int cycles) {
+    goto_state(RUN_TEST_IDLE);
+    for (int i = 0; i < cycles; i++) {
+        append_bit(false, false);
+    }
+}
+
+// Shift an instruction LSB-first, leaving the TAP in Exit1-IR.
+// Returns the index of the field holding the captured IR bits.
+int ScanProgram::shift_ir(uint32_t instruction, int bits) {
+    complete_scan();
+    goto_state(SHIFT_IR);
+    ScanField field = { bit_count, bits };
+    for (int i = 0; i < bits; i++) {
+        append_bit(i == bits - 1, (instruction >> i) & 1);
+    }
+    fields.push_back(field);
+    return (int)fields.size() - 1;
+}
+
+// Shift a data register LSB-first, leaving the TAP in Exit1-DR.
+// A null data pointer shifts zeros. Returns the captured field index.
+int ScanProgram::shift_dr_bytes(const uint8_t* data, int bits) {
+    complete_scan();
+    goto_state(SHIFT_DR);
+    ScanField field = { bit_count, bits };
+    for (int i = 0; i < bits; i++) {
+        bool bit_val = data ? ((data[i / 8] >> (i % 8)) & 1) : false;
+        append_bit(i == bits - 1, bit_val);
+    }
+    fields.push_back(field);
+    return (int)fields.size() - 1;
+}
+
+// Word-sized variant for registers up to 64 bits wide
+int ScanProgram::shift_dr(uint64_t value, int bits) {
+    uint8_t data[8];
+    if (bits > 64) {
+        bits = 64;
+    }
+    for (int i = 0; i < 8; i++) {
+        data[i] = (value >> (8 * i)) & 0xFF;
+    }
+    return shift_dr_bytes(data, bits);
+}
+
+uint64_t scan_extract_bits(const uint8_t* buf, int offset, int length) {
+    uint64_t value = 0;
+    int got = 0;
+    if (length > 64) {
+        length = 64;
+    }
+    // A byte (or the part of one inside the field) per iteration
+    while (got < length) {
+        int bit = offset + got;
+        int shift = bit % 8;
+        int take = 8 - shift < length - got ? 8 - shift : length - got;
+        value |= (uint64_t)((buf[bit / 8] >> shift) & ((1u << take) - 1)) << got;
+        got += take;
+    }
+    return value;
+}
+
+void scan_deposit_bits(uint8_t* buf, int offset, uint64_t value, int length) {
+    while (length > 0) {
+        int shift = offset % 8;
+        int take = 8 - shift < length ? 8 - shift : length;
+        buf[offset / 8] |= (uint8_t)((value & ((1u << take) - 1)) << shift);
+        value >>= take;
+        offset += take;
+        length -= take;
+    }
+}
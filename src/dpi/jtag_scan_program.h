@@ -0,0 +1,81 @@
+// jtag_scan_program.h
+// Compiled JTAG scan programs (packed TMS/TDI vectors)
+
+#ifndef JTAG_SCAN_PROGRAM_H
+#define JTAG_SCAN_PROGRAM_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_session_arena.h"
+
+// Description of the emulated scan chain. Part of every scan-cache key so
+// compiled programs are invalidated when the chain layout changes.
+#define JTAG_CHAIN_CONFIG "jtag_top ir=4 bsr=13 idcode=0x12345678"
+
+// Revision of the TMS/TDI streams ScanProgram emits for a given sequence of
+// calls. Also part of every scan-cache key; bump it whenever the encoding
+// changes (2: scans chained through complete_scan).
+#define SCAN_PROGRAM_ENCODING 2
+
+// TAP controller states (same encoding as jtag_tap_controller.sv)
+enum TapState {
+    TEST_LOGIC_RESET = 0x0,
+    RUN_TEST_IDLE    = 0x1,
+    SELECT_DR_SCAN   = 0x2,
+    CAPTURE_DR       = 0x3,
+    SHIFT_DR         = 0x4,
+    EXIT1_DR         = 0x5,
+    PAUSE_DR         = 0x6,
+    EXIT2_DR         = 0x7,
+    UPDATE_DR        = 0x8,
+    SELECT_IR_SCAN   = 0x9,
+    CAPTURE_IR       = 0xA,
+    SHIFT_IR         = 0xB,
+    EXIT1_IR         = 0xC,
+    PAUSE_IR         = 0xD,
+    EXIT2_IR         = 0xE,
+    UPDATE_IR        = 0xF
+};
+
+// TAP state machine helpers
+TapState tap_next_state(TapState state, bool tms);
+int tap_tms_path(TapState from, TapState to, bool* tms_out);
+const char* tap_state_name(TapState state);
+
+// Location of a captured register within a program's TDO stream
+struct ScanField {
+    int32_t offset;   // First TDO bit of the field
+    int32_t length;   // Field width in bits (LSB first)
+};
+
+// ScanProgram class
+// Builds a packed TMS/TDI bit stream while tracking the TAP state, so IR and
+// DR accesses can be compiled once and executed with a single bulk transfer.
+// Buffers come from the given session arena (heap when null).
+class ScanProgram {
+public:
+    ArenaVector<uint8_t> tms;
+    ArenaVector<uint8_t> tdi;
+    ArenaVector<ScanField> fields;
+    int bit_count;
+    TapState start_state;
+    TapState state;
+
+    explicit ScanProgram(TapState start = RUN_TEST_IDLE, SessionArena* arena = nullptr);
+
+    void clear(TapState start = RUN_TEST_IDLE);
+    void append_bit(bool tms_val, bool tdi_val);
+    void goto_state(TapState target);
+    void complete_scan();
+    void idle(int cycles);
+    int shift_ir(uint32_t instruction, int bits);
+    int shift_dr_bytes(const uint8_t* data, int bits);
+    int shift_dr(uint64_t value, int bits);
+};
+
+// Bit extraction from packed buffers (LSB-first, up to 64 bits)
+uint64_t scan_extract_bits(const uint8_t* buf, int offset, int length);
+// ORs the low length bits of value into buf at bit offset
+void scan_deposit_bits(uint8_t* buf, int offset, uint64_t value, int length);
+
+#endif // JTAG_SCAN_PROGRAM_H
@@ -0,0 +1,117 @@
+// jtag_session_arena.cpp
+// Per-session bump allocator and optional heap allocation counter
+
+#include <cstdlib>
+#include <atomic>
+#include "jtag_session_arena.h"
+
+// SessionArena implementation
+SessionArena::SessionArena(size_t block_size) : current(0), block_size(block_size) {}
+
+SessionArena::~SessionArena() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        delete[] blocks[i].data;
+    }
+}
+
+void* SessionArena::allocate(size_t bytes, size_t align) {
+    // Try the current block, then any later (already reserved) block
+    for (; current < blocks.size(); current++) {
+        Block& b = blocks[current];
+        size_t start = (b.used + align - 1) & ~(align - 1);
+        if (start + bytes <= b.size) {
+            b.used = start + bytes;
+            return b.data + start;
+        }
+        if (current + 1 < blocks.size()) {
+            blocks[current + 1].used = 0;
+        }
+    }
+
+    // Out of reserved memory: add a block large enough for this request
+    size_t size = bytes + align > block_size ? bytes + align : block_size;
+    Block b;
+    b.data = new uint8_t[size];
+    b.size = size;
+    b.used = 0;
+    blocks.push_back(b);
+    current = blocks.size() - 1;
+    return allocate(bytes, align);
+}
+
+SessionArena::Mark SessionArena::mark() const {
+    Mark m;
+    m.block = current;
+    m.used = current < blocks.size() ? blocks[current].used : 0;
+    return m;
+}
+
+void SessionArena::rewind(const Mark& m) {
+    current = m.block;
+    if (current < blocks.size()) {
+        blocks[current].used = m.used;
+    }
+}
+
+void SessionArena::reset() {
+    current = 0;
+    if (!blocks.empty()) {
+        blocks[0].used = 0;
+    }
+}
+
+size_t SessionArena::bytes_in_use() const {
+    size_t total = 0;
+    for (size_t i = 0; i < blocks.size() && i <= current; i++) {
+        total += blocks[i].used;
+    }
+    return total;
+}
+
+size_t SessionArena::bytes_reserved() const {
+    size_t total = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        total += blocks[i].size;
+    }
+    return total;
+}
+
+// Heap allocation counter (test mode only)
+#ifdef JTAG_ALLOC_CHECK
+
+static std::atomic<long> heap_allocations(0);
+
+void* operator new(size_t size) {
+    heap_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    heap_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+long jtag_alloc_count() {
+    return heap_allocations.load();
+}
+
+#else
+
+long jtag_alloc_count() {
+    return -1;
+}
+
+#endif
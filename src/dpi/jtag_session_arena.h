@@ -0,0 +1,116 @@
+// jtag_session_arena.h
+// Per-session bump allocator for scan buffers and command objects
+
+#ifndef JTAG_SESSION_ARENA_H
+#define JTAG_SESSION_ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// SessionArena class
+// Hands out memory from a list of large blocks. Individual frees are no-ops;
+// reset() or rewind() makes the memory reusable while keeping the blocks, so
+// once a session has warmed up, building and running scans never touches the
+// heap.
+class SessionArena {
+public:
+    explicit SessionArena(size_t block_size = 64 * 1024);
+    ~SessionArena();
+    SessionArena(const SessionArena&) = delete;
+    SessionArena& operator=(const SessionArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    // Position marks for nested scopes
+    struct Mark {
+        size_t block;
+        size_t used;
+    };
+    Mark mark() const;
+    void rewind(const Mark& m);
+    void reset();
+
+    size_t bytes_in_use() const;
+    size_t bytes_reserved() const;
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t size;
+        size_t used;
+    };
+    std::vector<Block> blocks;
+    size_t current;
+    size_t block_size;
+};
+
+// ArenaScope class
+// Rewinds the arena to its position at construction when the scope ends.
+// Objects allocated inside the scope must not outlive it.
+class ArenaScope {
+public:
+    explicit ArenaScope(SessionArena* arena) : arena(arena) {
+        if (arena) {
+            saved = arena->mark();
+        }
+    }
+    ~ArenaScope() {
+        if (arena) {
+            arena->rewind(saved);
+        }
+    }
+
+private:
+    SessionArena* arena;
+    SessionArena::Mark saved;
+};
+
+// ArenaAllocator class
+// Standard allocator backed by a SessionArena. A null arena falls back to the
+// global heap, so arena-aware containers work unchanged outside a session.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    SessionArena* arena;
+
+    ArenaAllocator(SessionArena* a = nullptr) : arena(a) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena) {
+            return (T*)arena->allocate(n * sizeof(T), alignof(T));
+        }
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t) {
+        if (!arena) {
+            ::operator delete(p);
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Heap allocation counter. Returns -1 unless the library was built with
+// -DJTAG_ALLOC_CHECK (make alloc_check), which installs a counting global
+// operator new.
+long jtag_alloc_count();
+
+#endif // JTAG_SESSION_ARENA_H
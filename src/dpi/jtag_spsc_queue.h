@@ -0,0 +1,67 @@
+// jtag_spsc_queue.h
+// Bounded single-producer/single-consumer queue for host worker handoff
+
+#ifndef JTAG_SPSC_QUEUE_H
+#define JTAG_SPSC_QUEUE_H
+
+#include <atomic>
+#include <thread>
+#include <cstddef>
+
+// SpscQueue class
+// Lock-free ring buffer with one slot kept empty to tell full from empty.
+// Exactly one thread may push and exactly one other thread may pop.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool try_push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % (Capacity + 1);
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;  // Full
+        }
+        slots[t] = value;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;  // Empty
+        }
+        value = slots[h];
+        head.store((h + 1) % (Capacity + 1), std::memory_order_release);
+        return true;
+    }
+
+    // Blocking variants spin with yield; handoffs are short and frequent
+    void push(const T& value) {
+        while (!try_push(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    T pop() {
+        T value;
+        while (!try_pop(value)) {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots[Capacity + 1];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+#endif // JTAG_SPSC_QUEUE_H
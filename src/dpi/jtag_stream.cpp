@@ -0,0 +1,311 @@
+// jtag_stream.cpp
+// Streaming bulk transfers: TMS/TDI pulled from sources, TDO pushed to sinks
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "jtag_stream.h"
+#include "digilent_jtag_mock.h"
+
+#define STREAM_HASH_SEED  0x3C6EF372FE94F82Bull
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static inline uint64_t stream_mix(uint64_t h, uint64_t value) {
+    h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 31);
+}
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0) {
+    if (path.empty()) {
+        return;
+    }
+#ifdef _WIN32
+    // No mmap: read the whole file into memory
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return;
+    }
+    long length = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+    if (length > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        uint8_t* buffer = new uint8_t[length];
+        if (fread(buffer, 1, length, f) == (size_t)length) {
+            data = buffer;
+            size = length;
+        } else {
+            delete[] buffer;
+        }
+    }
+    fclose(f);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            data = (const uint8_t*)map;
+            size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+#ifdef _WIN32
+        delete[] data;
+#else
+        munmap((void*)data, size);
+#endif
+    }
+}
+
+MappedFileSource::MappedFileSource(const std::string& tdi_path, const std::string& tms_path, bool exit_on_last)
+    : tdi_file(tdi_path), tms_file(tms_path), has_tms(!tms_path.empty()), exit_on_last(exit_on_last),
+      total_bits(tdi_file.size * 8), position(0) {
+}
+
+bool MappedFileSource::ok() const {
+    return tdi_file.ok() && (!has_tms || (tms_file.ok() && tms_file.size == tdi_file.size));
+}
+
+int MappedFileSource::read(uint8_t* tms, uint8_t* tdi, int max_bits) {
+    if (!ok() || position >= total_bits) {
+        return 0;
+    }
+    uint64_t left = total_bits - position;
+    int bits = left < (uint64_t)max_bits ? (int)left : max_bits;
+    size_t bytes = (bits + 7) / 8;
+    memcpy(tdi, tdi_file.data + position / 8, bytes);
+    if (has_tms) {
+        memcpy(tms, tms_file.data + position / 8, bytes);
+    } else {
+        memset(tms, 0, bytes);
+    }
+    position += bits;
+    if (exit_on_last && position == total_bits) {
+        tms[(bits - 1) / 8] |= 1 << ((bits - 1) % 8);
+    }
+    return bits;
+}
+
+GeneratorSource::GeneratorSource(GenerateFn generate, uint64_t total_bits)
+    : generate(generate), total_bits(total_bits), position(0) {
+}
+
+int GeneratorSource::read(uint8_t* tms, uint8_t* tdi, int max_bits) {
+    if (position >= total_bits) {
+        return 0;
+    }
+    uint64_t left = total_bits - position;
+    int bits = left < (uint64_t)max_bits ? (int)left : max_bits;
+    memset(tms, 0, (bits + 7) / 8);
+    memset(tdi, 0, (bits + 7) / 8);
+    generate(position, tms, tdi, bits);
+    position += bits;
+    return bits;
+}
+
+FileSink::FileSink(const std::string& path) : file(fopen(path.c_str(), "wb")), failed(false) {
+}
+
+FileSink::~FileSink() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool FileSink::write(const uint8_t* tdo, int bits) {
+    size_t bytes = (bits + 7) / 8;
+    failed = failed || !file || fwrite(tdo, 1, bytes, file) != bytes;
+    return !failed;
+}
+
+bool FileSink::finish() {
+    if (file) {
+        failed = fclose(file) != 0 || failed;
+        file = nullptr;
+    }
+    return !failed;
+}
+
+HashSink::HashSink() : hash(STREAM_HASH_SEED), bits(0), word(0), word_bits(0) {
+}
+
+// Chunks are whole bytes except the last, so bytes can be folded into the
+// pending word without realigning
+bool HashSink::write(const uint8_t* tdo, int chunk_bits) {
+    for (int i = 0; i < chunk_bits; i += 8) {
+        int n = chunk_bits - i < 8 ? chunk_bits - i : 8;
+        word |= (uint64_t)(tdo[i / 8] & ((1u << n) - 1)) << word_bits;
+        word_bits += n;
+        if (word_bits == 64) {
+            hash = stream_mix(hash, word);
+            word = 0;
+            word_bits = 0;
+        }
+    }
+    bits += chunk_bits;
+    return true;
+}
+
+bool HashSink::finish() {
+    hash = stream_mix(stream_mix(hash, word), bits);
+    word = 0;
+    word_bits = 0;
+    return true;
+}
+
+uint64_t HashSink::digest(const uint8_t* tdo, uint64_t bits) {
+    HashSink sink;
+    for (uint64_t offset = 0; offset < bits; offset += 1u << 20) {
+        uint64_t n = bits - offset < (1u << 20) ? bits - offset : (1u << 20);
+        sink.write(tdo + offset / 8, (int)n);
+    }
+    sink.finish();
+    return sink.hash;
+}
+
+ComparatorSink::ComparatorSink(ExpectFn expect)
+    : first_mismatch(-1), mismatches(0), bits(0), expect(expect) {
+}
+
+bool ComparatorSink::write(const uint8_t* tdo, int chunk_bits) {
+    size_t bytes = (chunk_bits + 7) / 8;
+    expected.assign(bytes, 0);
+    mask.assign(bytes, 0xFF);
+    expect(bits, expected.data(), mask.data(), chunk_bits);
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t valid = i + 1 < bytes || chunk_bits % 8 == 0 ? 0xFF : (uint8_t)((1u << (chunk_bits % 8)) - 1);
+        uint8_t diff = (tdo[i] ^ expected[i]) & mask[i] & valid;
+        if (diff) {
+            if (first_mismatch < 0) {
+                first_mismatch = (int64_t)(bits + i * 8 + lowest_set_bit(diff));
+            }
+            mismatches += count_set_bits(diff);
+        }
+    }
+    bits += chunk_bits;
+    return true;
+}
+
+JtagStreamer::JtagStreamer(int hif, int chunk_bits)
+    : hif(hif), chunk_bits((chunk_bits + 7) / 8 * 8), chunks(0), bits_shifted(0), sim_idle_ms(0),
+      host_idle_ms(0), sink_ok(true) {
+}
+
+size_t JtagStreamer::buffer_bytes() const {
+    size_t bytes = 0;
+    for (int i = 0; i < STREAM_DEPTH; i++) {
+        bytes += slots[i].tms.capacity() + slots[i].tdi.capacity() + slots[i].tdo.capacity();
+    }
+    return bytes;
+}
+
+int JtagStreamer::run(JtagStreamSource& source, JtagStreamSink& sink) {
+    chunks = 0;
+    bits_shifted = 0;
+    sim_idle_ms = 0;
+    host_idle_ms = 0;
+    sink_ok = true;
+    for (int i = 0; i < STREAM_DEPTH; i++) {
+        slots[i].tms.resize(chunk_bits / 8);
+        slots[i].tdi.resize(chunk_bits / 8);
+        slots[i].tdo.resize(chunk_bits / 8);
+    }
+    std::thread worker(&JtagStreamer::worker_loop, this, std::ref(source), std::ref(sink));
+
+    // Simulator side: shift chunks in order until the end marker
+    bool shifted = true;
+    while (true) {
+        StreamChunk* chunk = nullptr;
+        if (!ready.try_pop(chunk)) {
+            auto wait_start = std::chrono::steady_clock::now();
+            chunk = ready.pop();
+            sim_idle_ms += elapsed_ms(wait_start);
+        }
+        if (!chunk) {
+            break;
+        }
+        // After a failed chunk the rest are drained without shifting
+        chunk->executed = shifted && djtg_shift_bits(hif, chunk->tms.data(), chunk->tdi.data(), chunk->tdo.data(),
+                                                     chunk->bits);
+        shifted = shifted && chunk->executed;
+        if (chunk->executed) {
+            bits_shifted += chunk->bits;
+        }
+        executed.push(chunk);
+    }
+
+    worker.join();
+    sink_ok = sink.finish() && sink_ok;
+
+    printf("STREAM: %llu chunks, %llu bits, %zu buffer bytes (sim idle %.3f ms, host idle %.3f ms)\n",
+           (unsigned long long)chunks, (unsigned long long)bits_shifted, buffer_bytes(), sim_idle_ms, host_idle_ms);
+    fflush(stdout);
+    return shifted && sink_ok ? TRUE : FALSE;
+}
+
+// Host worker: fill free chunks from the source, drain shifted ones into
+// the sink in order
+void JtagStreamer::worker_loop(JtagStreamSource& source, JtagStreamSink& sink) {
+    StreamChunk* free_slots[STREAM_DEPTH];
+    int free_count = 0;
+    for (int i = 0; i < STREAM_DEPTH; i++) {
+        free_slots[free_count++] = &slots[i];
+    }
+
+    int in_flight = 0;
+    bool more = true;
+    while (more || in_flight > 0) {
+        StreamChunk* done = nullptr;
+        bool progressed = false;
+        while (executed.try_pop(done)) {
+            chunks++;
+            if (done->executed) {
+                sink_ok = sink.write(done->tdo.data(), done->bits) && sink_ok;
+            } else {
+                sink_ok = false;
+            }
+            free_slots[free_count++] = done;
+            in_flight--;
+            progressed = true;
+        }
+
+        if (more && free_count > 0) {
+            StreamChunk* chunk = free_slots[--free_count];
+            chunk->bits = source.read(chunk->tms.data(), chunk->tdi.data(), chunk_bits);
+            chunk->executed = FALSE;
+            if (chunk->bits > 0) {
+                in_flight++;
+                ready.push(chunk);
+            } else {
+                more = false;
+                free_slots[free_count++] = chunk;
+                ready.push(nullptr);  // End of stream
+            }
+            progressed = true;
+        }
+
+        if (!progressed) {
+            auto wait_start = std::chrono::steady_clock::now();
+            std::this_thread::yield();
+            host_idle_ms += elapsed_ms(wait_start);
+        }
+    }
+}
@@ -0,0 +1,187 @@
+// jtag_stream.h
+// Streaming bulk transfers: TMS/TDI pulled from sources, TDO pushed to sinks
+
+#ifndef JTAG_STREAM_H
+#define JTAG_STREAM_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include "jtag_spsc_queue.h"
+
+// Chunks in flight between the worker and the simulator thread
+#define STREAM_DEPTH 4
+
+// Producer of TMS/TDI. read() fills up to max_bits (a multiple of 8) and
+// returns the bits written, 0 at the end of the stream. Called on the
+// streamer's worker thread.
+class JtagStreamSource {
+public:
+    virtual ~JtagStreamSource() {}
+    virtual int read(uint8_t* tms, uint8_t* tdi, int max_bits) = 0;
+};
+
+// Consumer of TDO, chunk by chunk in stream order. Every chunk but the last
+// is a whole number of bytes. Called on the streamer's worker thread.
+class JtagStreamSink {
+public:
+    virtual ~JtagStreamSink() {}
+    virtual bool write(const uint8_t* tdo, int bits) = 0;
+    virtual bool finish() { return true; }
+};
+
+// MappedFile class
+// Read-only memory map of a whole file; pages are faulted in on the worker
+// thread as the stream reaches them. Windows builds read the file into memory.
+class MappedFile {
+public:
+    const uint8_t* data;
+    uint64_t size;
+
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return data != nullptr; }
+};
+
+// TDI from a mapped file (bits LSB-first). TMS comes from a second file of
+// the same length, or is 0 throughout so the stream stays in Shift-DR/IR;
+// exit_on_last sets TMS on the final bit to leave through Exit1.
+class MappedFileSource : public JtagStreamSource {
+public:
+    MappedFileSource(const std::string& tdi_path, const std::string& tms_path = "", bool exit_on_last = false);
+
+    bool ok() const;
+    uint64_t bit_count() const { return total_bits; }
+    int read(uint8_t* tms, uint8_t* tdi, int max_bits) override;
+
+private:
+    MappedFile tdi_file;
+    MappedFile tms_file;
+    bool has_tms;
+    bool exit_on_last;
+    uint64_t total_bits;
+    uint64_t position;
+};
+
+// TMS/TDI computed on demand for [offset, offset + bits)
+class GeneratorSource : public JtagStreamSource {
+public:
+    typedef std::function<void(uint64_t offset, uint8_t* tms, uint8_t* tdi, int bits)> GenerateFn;
+
+    GeneratorSource(GenerateFn generate, uint64_t total_bits);
+
+    int read(uint8_t* tms, uint8_t* tdi, int max_bits) override;
+
+private:
+    GenerateFn generate;
+    uint64_t total_bits;
+    uint64_t position;
+};
+
+// TDO appended to a file, packed LSB-first
+class FileSink : public JtagStreamSink {
+public:
+    explicit FileSink(const std::string& path);
+    ~FileSink();
+
+    bool ok() const { return file != nullptr; }
+    bool write(const uint8_t* tdo, int bits) override;
+    bool finish() override;
+
+private:
+    FILE* file;
+    bool failed;
+};
+
+// 64-bit digest of the TDO stream. Independent of the chunk size, so a
+// streamed run can be checked against a digest of the same bits taken
+// another way.
+class HashSink : public JtagStreamSink {
+public:
+    uint64_t hash;
+    uint64_t bits;
+
+    HashSink();
+
+    bool write(const uint8_t* tdo, int bits) override;
+    bool finish() override;
+
+    static uint64_t digest(const uint8_t* tdo, uint64_t bits);
+
+private:
+    uint64_t word;
+    int word_bits;
+};
+
+// Masked compare against expected TDO computed on demand for
+// [offset, offset + bits). The mask arrives all ones; the callback clears
+// the bits that are not checked.
+class ComparatorSink : public JtagStreamSink {
+public:
+    typedef std::function<void(uint64_t offset, uint8_t* expected, uint8_t* mask, int bits)> ExpectFn;
+
+    int64_t first_mismatch;      // -1 when none
+    uint64_t mismatches;
+    uint64_t bits;
+
+    explicit ComparatorSink(ExpectFn expect);
+
+    bool write(const uint8_t* tdo, int bits) override;
+    bool finish() override { return mismatches == 0; }
+
+private:
+    ExpectFn expect;
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> mask;
+};
+
+// One chunk: stimulus on the way in, TDO on the way back
+struct StreamChunk {
+    std::vector<uint8_t> tms;
+    std::vector<uint8_t> tdi;
+    std::vector<uint8_t> tdo;
+    int bits;
+    int executed;
+};
+
+// JtagStreamer class
+// Shifts a source of any length through djtg_shift_bits in fixed-size
+// chunks, with STREAM_DEPTH chunk buffers recycled between the simulator
+// thread (shifting) and a worker thread (reading the source and writing the
+// sink), so memory stays constant and disk I/O overlaps the shifting. The
+// TAP sees one continuous bit stream; the caller brings it to the state the
+// stream starts in and takes it from where the stream ends.
+class JtagStreamer {
+public:
+    int hif;
+    int chunk_bits;              // Rounded up to a whole number of bytes
+
+    // Statistics
+    uint64_t chunks;
+    uint64_t bits_shifted;
+    double sim_idle_ms;          // Simulator thread waiting for the source
+    double host_idle_ms;         // Worker waiting for a free chunk
+
+    JtagStreamer(int hif, int chunk_bits = 65536);
+
+    // Returns TRUE if every chunk shifted and the sink accepted the stream
+    int run(JtagStreamSource& source, JtagStreamSink& sink);
+
+    // Bytes held in chunk buffers, independent of the stream length
+    size_t buffer_bytes() const;
+
+private:
+    StreamChunk slots[STREAM_DEPTH];
+    SpscQueue<StreamChunk*, STREAM_DEPTH> ready;      // worker -> simulator
+    SpscQueue<StreamChunk*, STREAM_DEPTH> executed;   // simulator -> worker
+    bool sink_ok;
+
+    void worker_loop(JtagStreamSource& source, JtagStreamSink& sink);
+};
+
+#endif // JTAG_STREAM_H
@@ -0,0 +1,267 @@
+// jtag_tdo_hash.cpp
+// Rolling TDO stream hashes for hash-only differential regression
+
+#include <algorithm>
+#include <cstdio>
+#include "jtag_tdo_hash.h"
+
+#define TDO_HASH_MAGIC    0x484F4454u   // "TDOH"
+#define TDO_HASH_VERSION  2u           // 2: unobserved bits hash apart from 0
+
+// Checkpoints reserved per test (4M bits at the default interval)
+#define TDO_HASH_RESERVED_CHECKPOINTS 1024
+
+#define TDO_HASH_SEED      0x6A09E667F3BCC908ull
+#define TDO_BOUNDARY_SEED  0xBB67AE8584CAA73Bull
+#define TDO_RESET_MARKER   0x7FFFFFFFFFFFFFFFull
+#define TDO_LOAD_MARKER    0x7FFFFFFFFFFFFFFEull
+#define TDO_UNOBSERVED_MARKER 0x7FFFFFFFFFFFFFFDull
+
+static inline uint64_t tdo_mix(uint64_t h, uint64_t value) {
+    h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+    return h;
+}
+
+// Unobserved bits are 0 in word and set in the mask
+static inline uint64_t tdo_mix_word(uint64_t h, uint64_t word, uint64_t unobserved) {
+    h = tdo_mix(h, word);
+    return unobserved ? tdo_mix(tdo_mix(h, TDO_UNOBSERVED_MARKER), unobserved) : h;
+}
+
+TdoStreamHasher::TdoStreamHasher(uint64_t checkpoint_bits)
+    : checkpoint_bits(checkpoint_bits ? checkpoint_bits : 4096), active(false), word(0), unobserved(0), word_bits(0),
+      next_checkpoint(0), in_scan(false), instruction(0x1), ir_shift(0) {
+    current.tdo_hash = 0;
+    current.boundary_hash = 0;
+    current.bits = 0;
+    current.scans = 0;
+}
+
+void TdoStreamHasher::begin_test(const std::string& name) {
+    current.test = name;
+    current.tdo_hash = TDO_HASH_SEED;
+    current.boundary_hash = TDO_BOUNDARY_SEED;
+    current.bits = 0;
+    current.scans = 0;
+    current.checkpoints.clear();
+    current.checkpoints.reserve(TDO_HASH_RESERVED_CHECKPOINTS);
+    current.windows.clear();
+    current.windows.reserve(TDO_HASH_RESERVED_CHECKPOINTS + 1);
+    word = 0;
+    unobserved = 0;
+    word_bits = 0;
+    next_checkpoint = checkpoint_bits;
+    in_scan = false;
+    active = true;
+}
+
+void TdoStreamHasher::end_test() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    TdoDigest digest = current;
+    digest.tdo_hash = fold();
+    digests.push_back(digest);
+}
+
+// Running hash with the partial word and the bit count folded in
+uint64_t TdoStreamHasher::fold() const {
+    return tdo_mix(tdo_mix_word(current.tdo_hash, word, unobserved), current.bits);
+}
+
+void TdoStreamHasher::end_scan() {
+    current.boundary_hash = tdo_mix(current.boundary_hash, ((uint64_t)scan.ir << 63) | scan.length);
+    current.scans++;
+    in_scan = false;
+    if (scan.length == 0) {
+        return;
+    }
+    uint64_t first_window = scan.first_bit / checkpoint_bits;
+    uint64_t last_window = (scan.first_bit + scan.length - 1) / checkpoint_bits;
+    if (current.windows.size() <= last_window) {
+        current.windows.resize(last_window + 1);
+    }
+    for (uint64_t k = first_window; k <= last_window; k++) {
+        if (!current.windows[k].first.length) {
+            current.windows[k].first = scan;
+        }
+        current.windows[k].last = scan;
+    }
+}
+
+void TdoStreamHasher::on_step(TapState state, bool tms, bool tdi, bool tdo) {
+    add_bit(state, tms, tdi, tdo, true);
+}
+
+void TdoStreamHasher::on_unobserved(TapState state, bool tms, bool tdi) {
+    add_bit(state, tms, tdi, false, false);
+}
+
+void TdoStreamHasher::add_bit(TapState state, bool tms, bool tdi, bool tdo, bool observed) {
+    if (!active) {
+        return;
+    }
+    uint64_t bit_index = current.bits;
+    word |= (uint64_t)tdo << word_bits;
+    unobserved |= (uint64_t)!observed << word_bits;
+    if (++word_bits == 64) {
+        current.tdo_hash = tdo_mix_word(current.tdo_hash, word, unobserved);
+        word = 0;
+        unobserved = 0;
+        word_bits = 0;
+    }
+    current.bits++;
+    if (current.bits == next_checkpoint) {
+        current.checkpoints.push_back(fold());
+        next_checkpoint += checkpoint_bits;
+    }
+
+    if (state == SHIFT_DR || state == SHIFT_IR) {
+        if (!in_scan) {
+            in_scan = true;
+            scan.index = current.scans;
+            scan.ir = state == SHIFT_IR;
+            scan.first_bit = bit_index;
+            scan.length = 0;
+            scan.instruction = instruction;
+            ir_shift = 0;
+        }
+        if (scan.ir && scan.length < 32 && tdi) {
+            ir_shift |= 1u << scan.length;
+        }
+        scan.length++;
+    }
+
+    TapState next = tap_next_state(state, tms);
+    if (next == UPDATE_IR || next == UPDATE_DR) {
+        if (in_scan) {
+            if (next == UPDATE_IR) {
+                instruction = ir_shift;
+            }
+            end_scan();
+        }
+    } else if (next == TEST_LOGIC_RESET && state != TEST_LOGIC_RESET) {
+        current.boundary_hash = tdo_mix(current.boundary_hash, TDO_RESET_MARKER);
+        in_scan = false;
+        instruction = 0x1;          // IDCODE is selected in Test-Logic-Reset
+    }
+}
+
+// A backdoor load ends the structure like a reset does; the loaded
+// instruction is in effect from here
+void TdoStreamHasher::on_state_load(TapState state, uint32_t load_instruction) {
+    if (!active) {
+        return;
+    }
+    current.boundary_hash = tdo_mix(current.boundary_hash, TDO_LOAD_MARKER);
+    in_scan = false;
+    instruction = load_instruction;
+}
+
+int TdoStreamHasher::save_baseline(const std::string& path) const {
+    std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        return FALSE;
+    }
+    uint32_t header[3] = { TDO_HASH_MAGIC, TDO_HASH_VERSION, (uint32_t)digests.size() };
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1 && fwrite(&checkpoint_bits, 8, 1, f) == 1;
+    for (size_t i = 0; ok && i < digests.size(); i++) {
+        const TdoDigest& d = digests[i];
+        uint32_t name_len = (uint32_t)d.test.size();
+        uint64_t values[4] = { d.tdo_hash, d.boundary_hash, d.bits, d.scans };
+        uint32_t count = (uint32_t)d.checkpoints.size();
+        ok = fwrite(&name_len, 4, 1, f) == 1 && fwrite(d.test.data(), 1, name_len, f) == name_len &&
+             fwrite(values, sizeof(values), 1, f) == 1 && fwrite(&count, 4, 1, f) == 1 &&
+             (count == 0 || fwrite(d.checkpoints.data(), 8, count, f) == count);
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+int TdoStreamHasher::load_baseline(const std::string& path, uint64_t* checkpoint_bits,
+                                   std::vector<TdoDigest>* digests) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return FALSE;
+    }
+    uint32_t header[3];
+    bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == TDO_HASH_MAGIC &&
+              header[1] == TDO_HASH_VERSION && fread(checkpoint_bits, 8, 1, f) == 1;
+    digests->clear();
+    for (uint32_t i = 0; ok && i < header[2]; i++) {
+        TdoDigest d;
+        uint32_t name_len = 0, count = 0;
+        uint64_t values[4];
+        ok = fread(&name_len, 4, 1, f) == 1 && name_len < 4096;
+        if (ok) {
+            d.test.resize(name_len);
+            ok = fread(&d.test[0], 1, name_len, f) == name_len && fread(values, sizeof(values), 1, f) == 1 &&
+                 fread(&count, 4, 1, f) == 1 && count < (1u << 28);
+        }
+        if (ok) {
+            d.tdo_hash = values[0];
+            d.boundary_hash = values[1];
+            d.bits = values[2];
+            d.scans = values[3];
+            d.checkpoints.resize(count);
+            ok = count == 0 || fread(d.checkpoints.data(), 8, count, f) == count;
+            digests->push_back(d);
+        }
+    }
+    fclose(f);
+    return ok ? TRUE : FALSE;
+}
+
+int TdoStreamHasher::compare(const TdoDigest& baseline, const TdoDigest& current, uint64_t checkpoint_bits,
+                             TdoMismatch* mismatch) {
+    mismatch->test = current.test;
+    mismatch->boundary = baseline.boundary_hash != current.boundary_hash;
+    mismatch->located = false;
+    if (!mismatch->boundary && baseline.tdo_hash == current.tdo_hash && baseline.bits == current.bits) {
+        return TRUE;
+    }
+
+    // Checkpoints are chained, so the first differing one bounds the change
+    size_t common = std::min(baseline.checkpoints.size(), current.checkpoints.size());
+    size_t k = 0;
+    while (k < common && baseline.checkpoints[k] == current.checkpoints[k]) {
+        k++;
+    }
+    uint64_t total = std::max(baseline.bits, current.bits);
+    mismatch->window = (int)k;
+    mismatch->first_bit = k * checkpoint_bits;
+    mismatch->last_bit = std::min((k + 1) * checkpoint_bits, total) - 1;
+    if (total == 0 || mismatch->first_bit > mismatch->last_bit) {
+        mismatch->first_bit = 0;     // Structure-only change: search the whole stream
+        mismatch->last_bit = total ? total - 1 : 0;
+    }
+    return FALSE;
+}
+
+// The windows were filled in by the run itself, so the scans are the ones
+// that produced the differing bits
+int TdoStreamHasher::locate(const TdoDigest& current, uint64_t checkpoint_bits, TdoMismatch* mismatch) {
+    mismatch->located = false;
+    uint64_t first_window = mismatch->first_bit / checkpoint_bits;
+    uint64_t last_window = mismatch->last_bit / checkpoint_bits;
+    for (uint64_t k = first_window; k <= last_window && k < current.windows.size(); k++) {
+        const TdoWindowScans& window = current.windows[k];
+        if (!window.first.length) {
+            continue;
+        }
+        if (!mismatch->located) {
+            mismatch->first_scan = window.first;
+            mismatch->located = true;
+        }
+        mismatch->last_scan = window.last;
+    }
+    return mismatch->located ? TRUE : FALSE;
+}
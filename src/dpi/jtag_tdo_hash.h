@@ -0,0 +1,107 @@
+// jtag_tdo_hash.h
+// Rolling TDO stream hashes for hash-only differential regression
+
+#ifndef JTAG_TDO_HASH_H
+#define JTAG_TDO_HASH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "digilent_jtag_mock.h"
+
+// One IR or DR scan as seen by the tracker
+struct TdoScanRecord {
+    uint64_t index;          // Scan number within the test
+    bool ir;
+    uint64_t first_bit;      // TDO bit index of the first Shift step
+    uint32_t length;
+    uint32_t instruction;    // Instruction in effect (last Update-IR)
+};
+
+// First and last completed scan overlapping one checkpoint window; length
+// 0 when no scan does
+struct TdoWindowScans {
+    TdoScanRecord first;
+    TdoScanRecord last;
+};
+
+// Per-test digest. tdo_hash covers every TDO bit in order; boundary_hash
+// covers the scan structure (IR/DR, shift length, resets) independent of
+// data. checkpoints[k] is the TDO hash after (k + 1) * checkpoint_bits bits.
+// windows[k] holds the scans of window k as recorded during the run; it is
+// not part of the baseline file.
+struct TdoDigest {
+    std::string test;
+    uint64_t tdo_hash;
+    uint64_t boundary_hash;
+    uint64_t bits;
+    uint64_t scans;
+    std::vector<uint64_t> checkpoints;
+    std::vector<TdoWindowScans> windows;
+};
+
+// Result of comparing a test against its baseline
+struct TdoMismatch {
+    std::string test;
+    bool boundary;           // Scan structure differs too
+    int window;              // First checkpoint window that differs
+    uint64_t first_bit;
+    uint64_t last_bit;
+    bool located;            // first_scan/last_scan filled in by locate()
+    TdoScanRecord first_scan;
+    TdoScanRecord last_scan;
+};
+
+// TdoStreamHasher class
+// Step observer that hashes each test's TDO stream. Bits are packed into
+// 64-bit words and mixed a word at a time; a word with unobserved bits also
+// mixes in their mask, so an unknown bit never hashes like a 0. Checkpoints
+// fold in the partial word without disturbing the running state. Checkpoint storage is
+// reserved up front so the shift path stays allocation-free.
+class TdoStreamHasher : public JtagStepObserver {
+public:
+    uint64_t checkpoint_bits;
+    std::vector<TdoDigest> digests;      // One per completed test
+
+    explicit TdoStreamHasher(uint64_t checkpoint_bits = 4096);
+
+    void begin_test(const std::string& name);
+    void end_test();
+
+    void on_step(TapState state, bool tms, bool tdi, bool tdo) override;
+    void on_state_load(TapState state, uint32_t instruction) override;
+    void on_unobserved(TapState state, bool tms, bool tdi) override;
+
+    // Baseline file: digests with their checkpoints, written atomically
+    int save_baseline(const std::string& path) const;
+    static int load_baseline(const std::string& path, uint64_t* checkpoint_bits, std::vector<TdoDigest>* digests);
+
+    // TRUE when the digests match; otherwise mismatch describes the first
+    // differing checkpoint window
+    static int compare(const TdoDigest& baseline, const TdoDigest& current, uint64_t checkpoint_bits,
+                       TdoMismatch* mismatch);
+
+    // Fill in the scans the mismatch window covers from the window scans
+    // recorded while the current digest was taken
+    static int locate(const TdoDigest& current, uint64_t checkpoint_bits, TdoMismatch* mismatch);
+
+private:
+    bool active;
+    TdoDigest current;
+    uint64_t word;
+    uint64_t unobserved;                 // Bits of word with no TDO
+    int word_bits;
+    uint64_t next_checkpoint;
+
+    // Scan tracking
+    bool in_scan;
+    TdoScanRecord scan;
+    uint32_t instruction;
+    uint32_t ir_shift;
+
+    uint64_t fold() const;
+    void add_bit(TapState state, bool tms, bool tdi, bool tdo, bool observed);
+    void end_scan();
+};
+
+#endif // JTAG_TDO_HASH_H
@@ -0,0 +1,120 @@
+// jtag_usb_model.cpp
+// Digilent adapter command framing and USB bulk transfer cost model
+
+#include <cstdio>
+#include <cstdlib>
+#include "jtag_usb_model.h"
+
+UsbAdapterConfig::UsbAdapterConfig()
+    : max_transfer_bytes(512), max_bits_per_command(32768), command_header_bytes(4), status_bytes(2),
+      turnaround_us(125.0), bytes_per_us(30.0), small_call_bits(64) {
+}
+
+void UsbAdapterConfig::load_env() {
+    const char* value;
+    if ((value = getenv("JTAG_USB_MAX_TRANSFER")) && atoi(value) > 0) {
+        max_transfer_bytes = atoi(value);
+    }
+    if ((value = getenv("JTAG_USB_MAX_COMMAND_BITS")) && atoi(value) > 0) {
+        max_bits_per_command = atoi(value);
+    }
+    if ((value = getenv("JTAG_USB_TURNAROUND_US")) && atof(value) >= 0) {
+        turnaround_us = atof(value);
+    }
+}
+
+UsbAdapterStats::UsbAdapterStats()
+    : calls(0), small_calls(0), commands(0), out_transfers(0), in_transfers(0), bytes_out(0), bytes_in(0),
+      tck_cycles(0), turnaround_us(0), transfer_us(0), tck_us(0) {
+}
+
+UsbAdapterStats UsbAdapterStats::since(const UsbAdapterStats& earlier) const {
+    UsbAdapterStats delta;
+    delta.calls = calls - earlier.calls;
+    delta.small_calls = small_calls - earlier.small_calls;
+    delta.commands = commands - earlier.commands;
+    delta.out_transfers = out_transfers - earlier.out_transfers;
+    delta.in_transfers = in_transfers - earlier.in_transfers;
+    delta.bytes_out = bytes_out - earlier.bytes_out;
+    delta.bytes_in = bytes_in - earlier.bytes_in;
+    delta.tck_cycles = tck_cycles - earlier.tck_cycles;
+    delta.turnaround_us = turnaround_us - earlier.turnaround_us;
+    delta.transfer_us = transfer_us - earlier.transfer_us;
+    delta.tck_us = tck_us - earlier.tck_us;
+    return delta;
+}
+
+// One synchronous command: OUT data, IN reply, one turnaround
+void UsbAdapterModel::command(uint64_t out_bytes, uint64_t in_bytes) {
+    uint64_t max_transfer = config.max_transfer_bytes;
+    stats.commands++;
+    stats.out_transfers += (out_bytes + max_transfer - 1) / max_transfer;
+    stats.in_transfers += (in_bytes + max_transfer - 1) / max_transfer;
+    stats.bytes_out += out_bytes;
+    stats.bytes_in += in_bytes;
+    stats.turnaround_us += config.turnaround_us;
+    stats.transfer_us += (out_bytes + in_bytes) / config.bytes_per_us;
+}
+
+void UsbAdapterModel::shift(int cbit, bool read_tdo, int tck_hz) {
+    stats.calls++;
+    if (cbit < config.small_call_bits) {
+        stats.small_calls++;
+    }
+    int remaining = cbit;
+    do {
+        int bits = remaining < config.max_bits_per_command ? remaining : config.max_bits_per_command;
+        uint64_t out_bytes = config.command_header_bytes + (2 * (uint64_t)bits + 7) / 8;
+        uint64_t in_bytes = read_tdo ? ((uint64_t)bits + 7) / 8 : config.status_bytes;
+        command(out_bytes, in_bytes);
+        remaining -= bits;
+    } while (remaining > 0);
+    stats.tck_cycles += cbit;
+    stats.tck_us += cbit * 1e6 / tck_hz;
+}
+
+void UsbAdapterModel::shift_sparse(int cbit, int tdo_bits, int tck_hz) {
+    stats.calls++;
+    if (cbit < config.small_call_bits) {
+        stats.small_calls++;
+    }
+    int remaining = cbit;
+    do {
+        int bits = remaining < config.max_bits_per_command ? remaining : config.max_bits_per_command;
+        uint64_t out_bytes = config.command_header_bytes + (2 * (uint64_t)bits + 7) / 8;
+        uint64_t in_bytes = config.status_bytes;
+        if (remaining == bits && ((uint64_t)tdo_bits + 7) / 8 > in_bytes) {
+            in_bytes = ((uint64_t)tdo_bits + 7) / 8;
+        }
+        command(out_bytes, in_bytes);
+        remaining -= bits;
+    } while (remaining > 0);
+    stats.tck_cycles += cbit;
+    stats.tck_us += cbit * 1e6 / tck_hz;
+}
+
+void UsbAdapterModel::clock(int cycles, int tck_hz) {
+    stats.calls++;
+    command(config.command_header_bytes + 4, config.status_bytes);
+    stats.tck_cycles += cycles;
+    stats.tck_us += cycles * 1e6 / tck_hz;
+}
+
+// Single pin set/get: a full round trip for at most one TCK edge
+void UsbAdapterModel::pin_access() {
+    stats.calls++;
+    stats.small_calls++;
+    command(config.command_header_bytes + 1, config.status_bytes);
+}
+
+void UsbAdapterModel::print_report(const char* title, const UsbAdapterStats& s) const {
+    double total = s.total_us();
+    printf("%s:\n", title);
+    printf("  Calls:         %llu (%llu under %d bits), %llu commands\n", (unsigned long long)s.calls,
+           (unsigned long long)s.small_calls, config.small_call_bits, (unsigned long long)s.commands);
+    printf("  Transfers:     %llu OUT (%llu bytes), %llu IN (%llu bytes)\n", (unsigned long long)s.out_transfers,
+           (unsigned long long)s.bytes_out, (unsigned long long)s.in_transfers, (unsigned long long)s.bytes_in);
+    printf("  Estimated:     %.1f us = %.1f turnaround + %.1f transfer + %.1f TCK (%.0f%% latency)\n", total,
+           s.turnaround_us, s.transfer_us, s.tck_us, total > 0 ? 100.0 * s.turnaround_us / total : 0.0);
+    fflush(stdout);
+}
@@ -0,0 +1,73 @@
+// jtag_usb_model.h
+// Digilent adapter command framing and USB bulk transfer cost model
+
+#ifndef JTAG_USB_MODEL_H
+#define JTAG_USB_MODEL_H
+
+#include <cstdint>
+
+// Adapter and bus parameters. Defaults approximate a high-speed USB 2.0
+// adapter issuing synchronous commands (each call waits for its reply).
+struct UsbAdapterConfig {
+    int max_transfer_bytes;      // Bulk transfer size limit per direction
+    int max_bits_per_command;    // Longer shifts are split into several commands
+    int command_header_bytes;
+    int status_bytes;            // Reply when no TDO is returned
+    double turnaround_us;        // Host -> adapter -> host latency per command
+    double bytes_per_us;         // Sustained bulk throughput
+    int small_call_bits;         // Calls below this are flagged as small
+
+    UsbAdapterConfig();
+
+    // Overrides from JTAG_USB_MAX_TRANSFER, JTAG_USB_MAX_COMMAND_BITS and
+    // JTAG_USB_TURNAROUND_US
+    void load_env();
+};
+
+struct UsbAdapterStats {
+    uint64_t calls;              // API calls that reach the adapter
+    uint64_t small_calls;
+    uint64_t commands;
+    uint64_t out_transfers;
+    uint64_t in_transfers;
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    uint64_t tck_cycles;
+    double turnaround_us;
+    double transfer_us;
+    double tck_us;
+
+    UsbAdapterStats();
+
+    double total_us() const { return turnaround_us + transfer_us + tck_us; }
+
+    // Activity since an earlier snapshot of the same counters
+    UsbAdapterStats since(const UsbAdapterStats& earlier) const;
+};
+
+// UsbAdapterModel class
+// Maps each djtg_* call onto adapter commands and USB bulk transfers:
+// TMS/TDI go out two bits per TCK behind a command header, TDO (or a status
+// word) comes back, and every command pays one turnaround because the calls
+// are synchronous. The estimated time shows which host call patterns would
+// be latency-bound on hardware even though they are cheap in simulation.
+class UsbAdapterModel {
+public:
+    UsbAdapterConfig config;
+    UsbAdapterStats stats;
+
+    void reset() { stats = UsbAdapterStats(); }
+
+    void shift(int cbit, bool read_tdo, int tck_hz);
+    // TDO reduced to tdo_bits packed bits, returned with the last command
+    void shift_sparse(int cbit, int tdo_bits, int tck_hz);
+    void clock(int cycles, int tck_hz);
+    void pin_access();
+
+    void print_report(const char* title, const UsbAdapterStats& stats) const;
+
+private:
+    void command(uint64_t out_bytes, uint64_t in_bytes);
+};
+
+#endif // JTAG_USB_MODEL_H
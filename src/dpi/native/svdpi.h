@@ -0,0 +1,32 @@
+// svdpi.h (native build)
+// Minimal subset of the IEEE 1800 DPI-C header for building the DPI-C layer
+// without a simulator. Only the types and calls used by dpi/ are provided;
+// the open-array accessors are implemented in native_main.cpp.
+
+#ifndef INCLUDED_SVDPI
+#define INCLUDED_SVDPI
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t svBit;
+typedef void* svOpenArrayHandle;
+typedef void* svScope;
+
+// Open array backed by a flat buffer in the native build
+typedef struct {
+    void* data;
+    int size;
+} svNativeOpenArray;
+
+void* svGetArrayPtr(const svOpenArrayHandle h);
+int svSize(const svOpenArrayHandle h, int d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INCLUDED_SVDPI
@@ -0,0 +1,188 @@
+// native_main.cpp
+// Standalone driver for the native backend
+//
+// Links the DPI-C layer against NativeJtagModel instead of a simulator. The
+// SV exports used by the C++ side (sv_jtag_step, sv_get_tdo, ...) are
+// implemented here on top of the model, and main() replays the initial block
+// of jtag_testbench.sv, so the test suite runs unchanged and reports the same
+// simulated timestamps. The additional TAP instances of the testbench are
+// separate models with their own simulated time.
+//
+// Bulk shifts on instance 0 run through the transaction-level backend
+// unless JTAG_NATIVE_TLM=0, which keeps per-TCK stepping for comparison.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "digilent_jtag_mock.h"
+#include "jtag_native_model.h"
+#include "jtag_native_tlm.h"
+#include "jtag_hybrid.h"
+
+// Same count and IDCODE versions as NUM_TAPS in jtag_testbench.sv
+#define NATIVE_TAP_COUNT 4
+
+static NativeJtagModel native_model;
+static NativeJtagModel* native_taps[NATIVE_TAP_COUNT] = { &native_model };
+static NativeTlmBackend tlm_backend(&native_model);
+
+// Open-array accessors for the native svdpi.h
+extern "C" void* svGetArrayPtr(const svOpenArrayHandle h) {
+    return h ? ((svNativeOpenArray*)h)->data : nullptr;
+}
+
+extern "C" int svSize(const svOpenArrayHandle h, int d) {
+    return h ? ((svNativeOpenArray*)h)->size : 0;
+}
+
+// SV-exported tasks/functions, implemented on the native model
+extern "C" {
+
+void sv_drive_jtag_pins(svBit tck_val, svBit tms_val, svBit tdi_val) {
+    native_model.drive_pins(tck_val, tms_val, tdi_val);
+}
+
+svBit sv_get_tdo() {
+    return native_model.get_tdo();
+}
+
+void sv_wait_cycles(int cycles) {
+    native_model.wait_ns(cycles);
+}
+
+void sv_jtag_step(svBit tms, svBit tdi, svBit is_last, svBit* tdo_out) {
+    *tdo_out = native_model.jtag_step(tms, tdi);
+}
+
+void sv_jtag_clock(svBit tms, svBit tdi, int count) {
+    native_model.clock_tck(tms, tdi, count > 0 ? count : 0);
+}
+
+void sv_jtag_shift_expect(int cbit, svBit abort_on_mismatch, int window_bits, int* first_mismatch,
+                          int* mismatches, int* steps) {
+    jtag_expect_run([](bool tms, bool tdi) { return native_model.jtag_step(tms, tdi) != 0; }, cbit,
+                    abort_on_mismatch != 0, window_bits, first_mismatch, mismatches, steps);
+}
+
+void sv_jtag_shift_capture(int cbit) {
+    jtag_capture_run([](bool tms, bool tdi) { return native_model.jtag_step(tms, tdi) != 0; }, cbit);
+}
+
+// Constant stretches: word-level shifts or a time jump where the model
+// allows, per-TCK steps otherwise; TDO goes back 32 bits per call
+void sv_jtag_run(svBit tms, svBit tdi, int count, svBit sample_tdo) {
+    static std::vector<uint8_t> tdo;
+    tdo.assign((count + 7) / 8, 0);
+    bool done = !tms && native_model.shift_run_constant(tdi, tdo.data(), 0, count);
+    if (!done && !tms && native_model.idle_run(tdi, count)) {
+        if (native_model.get_tdo()) {
+            tdo.assign(tdo.size(), 0xFF);
+        }
+        done = true;
+    }
+    if (!done) {
+        for (int i = 0; i < count; i++) {
+            if (native_model.jtag_step(tms, tdi)) {
+                tdo[i / 8] |= (uint8_t)(1u << (i % 8));
+            }
+        }
+    }
+    if (sample_tdo) {
+        for (int k = 0; k < count; k += 32) {
+            int length = count - k < 32 ? count - k : 32;
+            jtag_capture_word(k / 32, (int)scan_extract_bits(tdo.data(), k, length));
+        }
+    }
+}
+
+long long sv_get_time_ps() {
+    return native_model.time_ps;
+}
+
+int sv_get_tap_count() {
+    return NATIVE_TAP_COUNT;
+}
+
+svBit sv_get_tdo_idx(int tap) {
+    return native_taps[tap]->get_tdo();
+}
+
+void sv_drive_jtag_pins_idx(int tap, svBit tck_val, svBit tms_val, svBit tdi_val) {
+    native_taps[tap]->drive_pins(tck_val, tms_val, tdi_val);
+}
+
+void sv_jtag_step_idx(int tap, svBit tms, svBit tdi, svBit is_last, svBit* tdo_out) {
+    *tdo_out = native_taps[tap]->jtag_step(tms, tdi);
+}
+
+void sv_jtag_clock_idx(int tap, svBit tms, svBit tdi, int count) {
+    native_taps[tap]->clock_tck(tms, tdi, count > 0 ? count : 0);
+}
+
+} // extern "C"
+
+// Hybrid handoff target: the instance's model stands in for the RTL
+int jtag_backdoor_load(int tap, const JtagTapSnapshot& snapshot) {
+    native_taps[tap]->load_snapshot(snapshot);
+    return TRUE;
+}
+
+int jtag_backdoor_read(int tap, JtagTapSnapshot* snapshot) {
+    *snapshot = native_taps[tap]->snapshot();
+    return TRUE;
+}
+
+// Testbench initial block
+int main() {
+    printf("Starting native simulation...\n");
+    fflush(stdout);
+
+    for (int tap = 1; tap < NATIVE_TAP_COUNT; tap++) {
+        native_taps[tap] = new NativeJtagModel(4, 10, 0x12345678u + ((uint32_t)tap << 28));
+    }
+
+    // Reset sequence: assert now, release at 100 ns as a scheduled event
+    for (int tap = 0; tap < NATIVE_TAP_COUNT; tap++) {
+        NativeJtagModel* model = native_taps[tap];
+        model->set_sys_reset_n(false);
+        model->scheduler.schedule_at(100000, [model]() { model->set_sys_reset_n(true); });
+
+        // #100 after release, then wait for a bit (#1000)
+        model->wait_ns(1200);
+    }
+
+    const char* tlm = getenv("JTAG_NATIVE_TLM");
+    if (!tlm || strcmp(tlm, "0") != 0) {
+        jtag_set_bulk_backend(&tlm_backend);
+    }
+
+    printf("Calling run_counter_jtag_tests at time %llu\n",
+           (unsigned long long)native_model.time_ns());
+    fflush(stdout);
+    run_counter_jtag_tests();
+    printf("Returned from run_counter_jtag_tests at time %llu\n",
+           (unsigned long long)native_model.time_ns());
+
+    // The testbench forks one session per additional instance. The models
+    // share no state, so running them one after another from the same start
+    // time gives the same per-instance results and timestamps.
+    uint64_t fork_ps = native_model.time_ps;
+    for (int tap = 1; tap < NATIVE_TAP_COUNT; tap++) {
+        native_taps[tap]->wait_ns((fork_ps - native_taps[tap]->time_ps) / 1000);
+        run_tap_session(tap);
+    }
+    uint64_t join_ps = fork_ps;
+    for (int tap = 1; tap < NATIVE_TAP_COUNT; tap++) {
+        if (native_taps[tap]->time_ps > join_ps) {
+            join_ps = native_taps[tap]->time_ps;
+        }
+    }
+    native_model.wait_ns((join_ps - native_model.time_ps) / 1000);
+    printf("TAP sessions completed at time %llu\n", (unsigned long long)native_model.time_ns());
+
+    native_model.wait_ns(1000);
+    printf("Simulation completed\n");
+    fflush(stdout);
+
+    return counter_jtag_tests_failed() || tap_sessions_failed() ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+// riscv_dmi.cpp
+// Batched RISC-V Debug Module Interface access over the JTAG DTM
+
+#include <cstdio>
+#include "riscv_dmi.h"
+#include "digilent_jtag_mock.h"
+
+// Clean ops after which one fewer idle cycle is tried again
+#define DMI_IDLE_DECAY_OPS 256
+
+RiscvDmi::RiscvDmi(int hif, int initial_idle_cycles)
+    : hif(hif), abits(7), idle_cycles(initial_idle_cycles), max_idle_cycles(64),
+      scans(0), busy_retries(0), batches(0), clean_ops(0) {}
+
+// Execute the compiled program; it starts from the TAP's tracked state and
+// ends in Run-Test/Idle
+int RiscvDmi::run_program() {
+    program.goto_state(RUN_TEST_IDLE);
+    tdo.assign((program.bit_count + 7) / 8, 0);
+    return djtg_shift_bits(hif, program.tms.data(), program.tdi.data(), tdo.data(), program.bit_count);
+}
+
+int RiscvDmi::read_dtmcs(uint32_t* dtmcs) {
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program.shift_ir(RISCV_IR_DTMCS, RISCV_IR_WIDTH);
+    int field = program.shift_dr((uint64_t)0, 32);
+    if (!run_program()) {
+        return FALSE;
+    }
+    const ScanField& f = program.fields[field];
+    *dtmcs = (uint32_t)scan_extract_bits(tdo.data(), f.offset, f.length);
+    abits = DTMCS_ABITS(*dtmcs);
+    return TRUE;
+}
+
+// Clear a sticky busy/failed status
+int RiscvDmi::dmi_reset() {
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program.shift_ir(RISCV_IR_DTMCS, RISCV_IR_WIDTH);
+    program.shift_dr((uint64_t)DTMCS_DMIRESET, 32);
+    return run_program();
+}
+
+void RiscvDmi::queue_read(uint32_t addr, uint32_t* result) {
+    DmiOp op = {DMI_OP_READ, addr, 0, result};
+    queue.push_back(op);
+}
+
+void RiscvDmi::queue_write(uint32_t addr, uint32_t data) {
+    DmiOp op = {DMI_OP_WRITE, addr, data, nullptr};
+    queue.push_back(op);
+}
+
+// Start one program with ops [first, first + DMI_BATCH_MAX) and a trailing
+// NOP that collects the last result. Scan k captures the response to op
+// first + k - 1; on busy, *stopped is the first op whose result is unknown
+// (it has executed, every later op was ignored).
+DmiBatchStatus RiscvDmi::run_batch(size_t first, size_t* stopped) {
+    size_t end = first + DMI_BATCH_MAX;
+    if (end > queue.size()) {
+        end = queue.size();
+    }
+    int width = abits + 34;
+
+    program.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    response_fields.clear();
+    program.shift_ir(RISCV_IR_DMI, RISCV_IR_WIDTH);
+    for (size_t i = first; i <= end; i++) {
+        uint64_t request = DMI_OP_NOP;
+        if (i < end) {
+            const DmiOp& op = queue[i];
+            request = ((uint64_t)op.addr << 34) | ((uint64_t)op.data << 2) | op.op;
+        }
+        if (i > first && idle_cycles > 0) {
+            program.idle(idle_cycles);
+        }
+        response_fields.push_back(program.shift_dr(request, width));
+    }
+
+    batches++;
+    scans += response_fields.size();
+    if (!run_program()) {
+        *stopped = first;
+        return DMI_BATCH_ERROR;
+    }
+
+    for (size_t k = 0; k < response_fields.size(); k++) {
+        const ScanField& f = program.fields[response_fields[k]];
+        uint64_t response = scan_extract_bits(tdo.data(), f.offset, f.length);
+        uint32_t status = response & 0x3;
+        // Scan 0 only reports a sticky error left from before this batch
+        size_t op_index = k == 0 ? first : first + k - 1;
+        if (status == DMI_OP_BUSY) {
+            *stopped = op_index;
+            return DMI_BATCH_BUSY;
+        }
+        if (status != DMI_OP_SUCCESS) {
+            *stopped = op_index;
+            return DMI_BATCH_FAILED;
+        }
+        if (k > 0 && queue[op_index].result) {
+            *queue[op_index].result = (uint32_t)(response >> 2);
+        }
+    }
+    *stopped = end;
+    return DMI_BATCH_OK;
+}
+
+void RiscvDmi::adapt_after_busy() {
+    busy_retries++;
+    clean_ops = 0;
+    idle_cycles = idle_cycles == 0 ? 1 : idle_cycles * 2;
+    if (idle_cycles > max_idle_cycles) {
+        idle_cycles = max_idle_cycles;
+    }
+}
+
+// After a long clean run, probe whether a shorter gap is enough again
+void RiscvDmi::adapt_after_success(size_t ops) {
+    clean_ops += ops;
+    if (clean_ops >= DMI_IDLE_DECAY_OPS && idle_cycles > 0) {
+        idle_cycles--;
+        clean_ops = 0;
+    }
+}
+
+// Execute the whole queue. Ops whose result was lost to a busy response are
+// issued again, so the queue should only hold ops that are safe to repeat
+// (block transfers use read_memory/write_memory instead).
+int RiscvDmi::flush() {
+    size_t next = 0;
+    while (next < queue.size()) {
+        size_t stopped = next;
+        DmiBatchStatus status = run_batch(next, &stopped);
+        if (status == DMI_BATCH_OK) {
+            adapt_after_success(stopped - next);
+            next = stopped;
+        } else if (status == DMI_BATCH_BUSY) {
+            adapt_after_busy();
+            if (!dmi_reset()) {
+                queue.clear();
+                return FALSE;
+            }
+            next = stopped;
+        } else {
+            printf("MOCK: DMI op %zu (addr 0x%02X) failed\n", stopped, queue[stopped].addr);
+            fflush(stdout);
+            dmi_reset();
+            queue.clear();
+            return FALSE;
+        }
+    }
+    queue.clear();
+    return TRUE;
+}
+
+int RiscvDmi::read(uint32_t addr, uint32_t* value) {
+    queue_read(addr, value);
+    return flush();
+}
+
+int RiscvDmi::write(uint32_t addr, uint32_t data) {
+    queue_write(addr, data);
+    return flush();
+}
+
+// sbdata0 writes auto-increment sbaddress0 and must not be repeated, so
+// after a busy response the transfer resumes from the address the bus has
+// actually reached.
+int RiscvDmi::write_memory(uint32_t address, const uint32_t* words, int count) {
+    if (!write(DM_SBCS, SBCS_SBACCESS_32 | SBCS_SBAUTOINCREMENT) || !write(DM_SBADDRESS0, address)) {
+        return FALSE;
+    }
+
+    int done = 0;
+    while (done < count) {
+        for (int i = done; i < count; i++) {
+            queue_write(DM_SBDATA0, words[i]);
+        }
+        size_t next = 0;
+        DmiBatchStatus status = DMI_BATCH_OK;
+        while (next < queue.size() && status == DMI_BATCH_OK) {
+            size_t stopped = next;
+            status = run_batch(next, &stopped);
+            if (status == DMI_BATCH_OK) {
+                adapt_after_success(stopped - next);
+            }
+            next = stopped;
+        }
+        queue.clear();
+
+        if (status == DMI_BATCH_OK) {
+            done = count;
+        } else if (status == DMI_BATCH_BUSY) {
+            adapt_after_busy();
+            uint32_t reached = 0;
+            if (!dmi_reset() || !read(DM_SBADDRESS0, &reached)) {
+                return FALSE;
+            }
+            done = (int)((reached - address) / 4);
+        } else {
+            dmi_reset();
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Each sbdata0 read returns the current word and starts the read of the
+// next one. After a busy response the read restarts at the first word that
+// was not returned by writing sbaddress0 again.
+int RiscvDmi::read_memory(uint32_t address, uint32_t* words, int count) {
+    if (!write(DM_SBCS, SBCS_SBACCESS_32 | SBCS_SBAUTOINCREMENT | SBCS_SBREADONADDR | SBCS_SBREADONDATA)) {
+        return FALSE;
+    }
+
+    int done = 0;
+    while (done < count) {
+        queue_write(DM_SBADDRESS0, address + 4 * done);
+        for (int i = done; i < count; i++) {
+            queue_read(DM_SBDATA0, &words[i]);
+        }
+        size_t next = 0;
+        DmiBatchStatus status = DMI_BATCH_OK;
+        while (next < queue.size() && status == DMI_BATCH_OK) {
+            size_t stopped = next;
+            status = run_batch(next, &stopped);
+            if (status == DMI_BATCH_OK) {
+                adapt_after_success(stopped - next);
+            }
+            next = stopped;
+        }
+        queue.clear();
+
+        if (status == DMI_BATCH_OK) {
+            done = count;
+        } else if (status == DMI_BATCH_BUSY) {
+            adapt_after_busy();
+            if (!dmi_reset()) {
+                return FALSE;
+            }
+            // Op 0 is the address write; ops before the stop index returned data
+            if (next > 1) {
+                done += (int)(next - 1);
+            }
+        } else {
+            dmi_reset();
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
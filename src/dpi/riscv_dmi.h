@@ -0,0 +1,114 @@
+// riscv_dmi.h
+// Batched RISC-V Debug Module Interface access over the JTAG DTM
+
+#ifndef RISCV_DMI_H
+#define RISCV_DMI_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_scan_program.h"
+
+// DTM instructions (jtag_instruction_register.sv)
+#define RISCV_IR_WIDTH  4
+#define RISCV_IR_DTMCS  0x6
+#define RISCV_IR_DMI    0x7
+
+// DMI op field: request encodings and response status
+#define DMI_OP_NOP      0
+#define DMI_OP_READ     1
+#define DMI_OP_WRITE    2
+#define DMI_OP_SUCCESS  0
+#define DMI_OP_FAILED   2
+#define DMI_OP_BUSY     3
+
+// dtmcs fields
+#define DTMCS_VERSION(v)    ((v) & 0xF)
+#define DTMCS_ABITS(v)      (((v) >> 4) & 0x3F)
+#define DTMCS_DMISTAT(v)    (((v) >> 10) & 0x3)
+#define DTMCS_IDLE(v)       (((v) >> 12) & 0x7)
+#define DTMCS_DMIRESET      (1u << 16)
+
+// Debug module registers
+#define DM_DATA0       0x04
+#define DM_DATA1       0x05
+#define DM_DMCONTROL   0x10
+#define DM_DMSTATUS    0x11
+#define DM_ABSTRACTCS  0x16
+#define DM_SBCS        0x38
+#define DM_SBADDRESS0  0x39
+#define DM_SBDATA0     0x3C
+
+// sbcs fields
+#define SBCS_SBREADONADDR     (1u << 20)
+#define SBCS_SBACCESS_32      (2u << 17)
+#define SBCS_SBAUTOINCREMENT  (1u << 16)
+#define SBCS_SBREADONDATA     (1u << 15)
+
+// Ops per compiled DMI program
+#define DMI_BATCH_MAX 64
+
+// One queued DMI operation; result receives the data of a read
+struct DmiOp {
+    uint32_t op;
+    uint32_t addr;
+    uint32_t data;
+    uint32_t* result;
+};
+
+enum DmiBatchStatus {
+    DMI_BATCH_OK,
+    DMI_BATCH_BUSY,     // An op was still in progress; see the stop index
+    DMI_BATCH_FAILED,   // The debug module reported a failed op
+    DMI_BATCH_ERROR     // The scan itself could not be executed
+};
+
+// RiscvDmi class
+// Queues DMI reads and writes and executes them as one scan program per
+// batch: DMI is selected once and consecutive DR scans chain Update-DR ->
+// Select-DR -> Capture-DR, so each scan also captures the previous op's
+// result. When the DTM answers busy, the sticky error is cleared with
+// dtmcs.dmireset, the number of Run-Test/Idle cycles between scans is
+// raised and the batch resumes from the op whose result was lost.
+class RiscvDmi {
+public:
+    int hif;
+    int abits;
+    int idle_cycles;        // Run-Test/Idle cycles between scans; 0 chains directly
+    int max_idle_cycles;
+    uint64_t scans;
+    uint64_t busy_retries;
+    uint64_t batches;
+
+    explicit RiscvDmi(int hif, int initial_idle_cycles = 0);
+
+    // dtmcs access
+    int read_dtmcs(uint32_t* dtmcs);
+    int dmi_reset();
+
+    // Queued access; results are valid after flush() returns TRUE
+    void queue_read(uint32_t addr, uint32_t* result);
+    void queue_write(uint32_t addr, uint32_t data);
+    int flush();
+
+    // Single access (queue + flush)
+    int read(uint32_t addr, uint32_t* value);
+    int write(uint32_t addr, uint32_t data);
+
+    // Block transfers through System Bus Access with auto-increment
+    int read_memory(uint32_t address, uint32_t* words, int count);
+    int write_memory(uint32_t address, const uint32_t* words, int count);
+
+private:
+    std::vector<DmiOp> queue;
+    ScanProgram program;
+    std::vector<uint8_t> tdo;
+    std::vector<int> response_fields;
+    uint64_t clean_ops;
+
+    DmiBatchStatus run_batch(size_t first, size_t* stopped);
+    void adapt_after_busy();
+    void adapt_after_success(size_t ops);
+    int run_program();
+};
+
+#endif // RISCV_DMI_H
@@ -0,0 +1,205 @@
+// spi_flash_programmer.cpp
+// SPI flash programming through boundary-scan EXTEST
+
+#include <cstdio>
+#include <cstring>
+#include "spi_flash_programmer.h"
+#include "jtag_bsr_layout.h"
+#include "digilent_jtag_mock.h"
+
+// Instructions (jtag_instruction_register.sv)
+#define SPI_IR_EXTEST  0x0
+#define SPI_IR_SAMPLE  0x2
+#define SPI_IR_WIDTH   4
+
+// Non-SPI cells while programming: counter direction up, outputs enabled
+#define SPI_BSR_BASE   ((1u << BSR_UP_DOWN_CELL) | BSR_COUNT_OE_MASK)
+
+SpiFlashProgrammer::SpiFlashProgrammer(int hif)
+    : hif(hif), transactions(0), scans(0), busy_polls(0) {}
+
+int SpiFlashProgrammer::run_program() {
+    program_.goto_state(RUN_TEST_IDLE);
+    tdo.assign((program_.bit_count + 7) / 8, 0);
+    return djtg_shift_bits(hif, program_.tms.data(), program_.tdi.data(), tdo.data(), program_.bit_count);
+}
+
+// One DR scan that drives the given pin levels at its Update-DR
+void SpiFlashProgrammer::pin_scan(bool cs_n, bool sck, bool mosi, bool sample_miso) {
+    uint32_t value = SPI_BSR_BASE | ((cs_n ? 1u : 0u) << BSR_SPI_CS_N_CELL) |
+                     ((sck ? 1u : 0u) << BSR_SPI_SCK_CELL) | ((mosi ? 1u : 0u) << BSR_SPI_MOSI_CELL);
+    int field = program_.shift_dr((uint64_t)value, BSR_WIDTH);
+    if (sample_miso) {
+        miso_fields.push_back(field);
+    }
+    scans++;
+}
+
+// PRELOAD an idle bus (flash deselected) before EXTEST drives the pins
+int SpiFlashProgrammer::begin() {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program_.shift_ir(SPI_IR_SAMPLE, SPI_IR_WIDTH);
+    pin_scan(true, false, false, false);
+    program_.shift_ir(SPI_IR_EXTEST, SPI_IR_WIDTH);
+    return run_program();
+}
+
+int SpiFlashProgrammer::end() {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    program_.shift_ir(SPI_IR_SAMPLE, SPI_IR_WIDTH);
+    return run_program();
+}
+
+// Mode 0, MSB first. Per bit: a scan that drops SCK and sets MOSI, then a
+// scan that raises SCK and whose capture samples MISO.
+int SpiFlashProgrammer::transfer(const uint8_t* out, uint8_t* in, int len) {
+    program_.clear(jtag_tracked_state(jtag_device_tap(hif)));
+    miso_fields.clear();
+
+    bool first_mosi = len > 0 && (out[0] & 0x80);
+    pin_scan(false, false, first_mosi, false);   // Select with the first MOSI bit set up
+    for (int byte = 0; byte < len; byte++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            bool mosi = (out[byte] >> bit) & 1;
+            if (byte > 0 || bit < 7) {
+                pin_scan(false, false, mosi, false);
+            }
+            pin_scan(false, true, mosi, true);
+        }
+    }
+    pin_scan(false, false, false, false);
+    pin_scan(true, false, false, false);         // Deselect
+
+    transactions++;
+    if (!run_program()) {
+        return FALSE;
+    }
+
+    if (in) {
+        for (int byte = 0; byte < len; byte++) {
+            uint8_t value = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                const ScanField& f = program_.fields[miso_fields[byte * 8 + bit]];
+                value = (uint8_t)((value << 1) | ((scan_extract_bits(tdo.data(), f.offset, f.length) >> BSR_SPI_MISO_CELL) & 1));
+            }
+            in[byte] = value;
+        }
+    }
+    return TRUE;
+}
+
+int SpiFlashProgrammer::read_id(uint32_t* jedec_id) {
+    uint8_t out[4] = {SPI_FLASH_CMD_RDID, 0, 0, 0};
+    uint8_t in[4];
+    if (!transfer(out, in, 4)) {
+        return FALSE;
+    }
+    *jedec_id = ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+    return TRUE;
+}
+
+int SpiFlashProgrammer::read_status(uint8_t* status) {
+    uint8_t out[2] = {SPI_FLASH_CMD_RDSR, 0};
+    uint8_t in[2];
+    if (!transfer(out, in, 2)) {
+        return FALSE;
+    }
+    *status = in[1];
+    return TRUE;
+}
+
+int SpiFlashProgrammer::write_enable() {
+    uint8_t cmd = SPI_FLASH_CMD_WREN;
+    uint8_t status = 0;
+    if (!transfer(&cmd, nullptr, 1) || !read_status(&status)) {
+        return FALSE;
+    }
+    return (status & SPI_FLASH_SR_WEL) ? TRUE : FALSE;
+}
+
+int SpiFlashProgrammer::wait_ready(int max_polls) {
+    for (int i = 0; i < max_polls; i++) {
+        uint8_t status = 0;
+        if (!read_status(&status)) {
+            return FALSE;
+        }
+        if (!(status & SPI_FLASH_SR_WIP)) {
+            return TRUE;
+        }
+        busy_polls++;
+    }
+    printf("MOCK: SPI flash still busy after %d polls\n", max_polls);
+    fflush(stdout);
+    return FALSE;
+}
+
+int SpiFlashProgrammer::read(uint32_t address, uint8_t* data, int len) {
+    std::vector<uint8_t> out(4 + len, 0), in(4 + len);
+    out[0] = SPI_FLASH_CMD_READ;
+    out[1] = (address >> 16) & 0xFF;
+    out[2] = (address >> 8) & 0xFF;
+    out[3] = address & 0xFF;
+    if (!transfer(out.data(), in.data(), 4 + len)) {
+        return FALSE;
+    }
+    memcpy(data, in.data() + 4, len);
+    return TRUE;
+}
+
+int SpiFlashProgrammer::sector_erase(uint32_t address) {
+    uint8_t out[4] = {SPI_FLASH_CMD_SE, (uint8_t)(address >> 16), (uint8_t)(address >> 8), (uint8_t)address};
+    if (!write_enable() || !transfer(out, nullptr, 4)) {
+        return FALSE;
+    }
+    return wait_ready(1000);
+}
+
+// len must not cross a page boundary
+int SpiFlashProgrammer::page_program(uint32_t address, const uint8_t* data, int len) {
+    std::vector<uint8_t> out(4 + len);
+    out[0] = SPI_FLASH_CMD_PP;
+    out[1] = (address >> 16) & 0xFF;
+    out[2] = (address >> 8) & 0xFF;
+    out[3] = address & 0xFF;
+    memcpy(out.data() + 4, data, len);
+    if (!write_enable() || !transfer(out.data(), nullptr, 4 + len)) {
+        return FALSE;
+    }
+    return wait_ready(1000);
+}
+
+int SpiFlashProgrammer::program(uint32_t address, const uint8_t* data, int len) {
+    uint32_t first_sector = address & ~(uint32_t)(SPI_FLASH_SECTOR_SIZE - 1);
+    for (uint32_t sector = first_sector; sector < address + len; sector += SPI_FLASH_SECTOR_SIZE) {
+        if (!sector_erase(sector)) {
+            return FALSE;
+        }
+    }
+
+    int done = 0;
+    while (done < len) {
+        uint32_t page_address = address + done;
+        int chunk = SPI_FLASH_PAGE_SIZE - (int)(page_address % SPI_FLASH_PAGE_SIZE);
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        if (!page_program(page_address, data + done, chunk)) {
+            return FALSE;
+        }
+        done += chunk;
+    }
+
+    verify_buf.resize(len);
+    if (!read(address, verify_buf.data(), len)) {
+        return FALSE;
+    }
+    for (int i = 0; i < len; i++) {
+        if (verify_buf[i] != data[i]) {
+            printf("MOCK: SPI flash verify failed at 0x%06X: got 0x%02X, expected 0x%02X\n",
+                   address + i, verify_buf[i], data[i]);
+            fflush(stdout);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
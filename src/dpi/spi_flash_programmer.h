@@ -0,0 +1,73 @@
+// spi_flash_programmer.h
+// SPI flash programming through boundary-scan EXTEST
+
+#ifndef SPI_FLASH_PROGRAMMER_H
+#define SPI_FLASH_PROGRAMMER_H
+
+#include <vector>
+#include <cstdint>
+#include "jtag_scan_program.h"
+
+// SPI NOR commands (tb/spi_flash_model.sv)
+#define SPI_FLASH_CMD_RDID   0x9F
+#define SPI_FLASH_CMD_RDSR   0x05
+#define SPI_FLASH_CMD_WREN   0x06
+#define SPI_FLASH_CMD_WRDI   0x04
+#define SPI_FLASH_CMD_READ   0x03
+#define SPI_FLASH_CMD_PP     0x02
+#define SPI_FLASH_CMD_SE     0x20
+#define SPI_FLASH_CMD_CE     0xC7
+#define SPI_FLASH_CMD_CE_60  0x60
+
+// Status register bits
+#define SPI_FLASH_SR_WIP     0x01
+#define SPI_FLASH_SR_WEL     0x02
+
+#define SPI_FLASH_PAGE_SIZE    256
+#define SPI_FLASH_SECTOR_SIZE  4096
+
+// SpiFlashProgrammer class
+// Bit-bangs SPI mode 0 on the flash cells of the boundary scan register.
+// Every pin change is one EXTEST DR scan, and consecutive scans chain
+// Update-DR -> Select-DR -> Capture-DR, so a scan's capture samples MISO
+// as left by the previous scan's update (the falling SCK edge) while its
+// update drives the next edge. A whole CS-framed transaction is compiled
+// into one program and executed with a single bulk transfer.
+class SpiFlashProgrammer {
+public:
+    int hif;
+    uint64_t transactions;
+    uint64_t scans;
+    uint64_t busy_polls;
+
+    explicit SpiFlashProgrammer(int hif);
+
+    // Preload an idle bus and switch to EXTEST; end() returns to SAMPLE
+    int begin();
+    int end();
+
+    // One transaction: out is sent, in (optional) receives MISO per byte
+    int transfer(const uint8_t* out, uint8_t* in, int len);
+
+    int read_id(uint32_t* jedec_id);
+    int read_status(uint8_t* status);
+    int write_enable();
+    int wait_ready(int max_polls);
+    int read(uint32_t address, uint8_t* data, int len);
+    int sector_erase(uint32_t address);
+    int page_program(uint32_t address, const uint8_t* data, int len);
+
+    // Erase the covered sectors, program page by page and verify
+    int program(uint32_t address, const uint8_t* data, int len);
+
+private:
+    ScanProgram program_;
+    std::vector<uint8_t> tdo;
+    std::vector<int> miso_fields;
+    std::vector<uint8_t> verify_buf;
+
+    void pin_scan(bool cs_n, bool sck, bool mosi, bool sample_miso);
+    int run_program();
+};
+
+#endif // SPI_FLASH_PROGRAMMER_H
@@ -0,0 +1,1272 @@
+// stapl_player.cpp
+// STAPL (JESD71) player: bytecode compiler and VM with batched scans
+
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include "stapl_player.h"
+#include "digilent_jtag_mock.h"
+
+// WAITs longer than this go to djtg_clock_tck instead of the scan program
+#define STAPL_LONG_WAIT_CYCLES 256
+
+namespace {
+
+enum StaplTokenType { TOK_END, TOK_IDENT, TOK_NUMBER, TOK_HEX, TOK_BINARY, TOK_STRING, TOK_PUNCT };
+
+struct StaplToken {
+    StaplTokenType type;
+    std::string text;    // Upper-case identifier, literal digits, string or punctuation
+    int64_t number;
+    int line;
+};
+
+const char* const stapl_state_names[16] = {
+    "RESET", "IDLE", "DRSELECT", "DRCAPTURE", "DRSHIFT", "DREXIT1", "DRPAUSE", "DREXIT2", "DRUPDATE",
+    "IRSELECT", "IRCAPTURE", "IRSHIFT", "IREXIT1", "IRPAUSE", "IREXIT2", "IRUPDATE"
+};
+
+int stapl_state(const std::string& name) {
+    for (int i = 0; i < 16; i++) {
+        if (name == stapl_state_names[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool stapl_stable_state(int state) {
+    return state == TEST_LOGIC_RESET || state == RUN_TEST_IDLE || state == PAUSE_DR || state == PAUSE_IR;
+}
+
+// Split source into tokens; ' starts a comment that runs to the end of the line
+bool stapl_tokenize(const std::string& src, std::vector<StaplToken>& out, std::string& error) {
+    static const char* const two_char[] = { "==", "!=", "<=", ">=", "<<", ">>", "&&", "||", ".." };
+    int line = 1;
+    size_t i = 0;
+    while (i < src.size()) {
+        char c = src[i];
+        if (c == '\n') {
+            line++;
+            i++;
+            continue;
+        }
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        if (c == '\'') {
+            while (i < src.size() && src[i] != '\n') {
+                i++;
+            }
+            continue;
+        }
+
+        StaplToken tok;
+        tok.line = line;
+        tok.number = 0;
+        if (isalpha((unsigned char)c) || c == '_') {
+            while (i < src.size() && (isalnum((unsigned char)src[i]) || src[i] == '_')) {
+                tok.text += (char)toupper((unsigned char)src[i]);
+                i++;
+            }
+            tok.type = TOK_IDENT;
+        } else if (isdigit((unsigned char)c)) {
+            while (i < src.size() && isdigit((unsigned char)src[i])) {
+                tok.number = tok.number * 10 + (src[i] - '0');
+                i++;
+            }
+            tok.type = TOK_NUMBER;
+        } else if (c == '$' || c == '#') {
+            i++;
+            while (i < src.size() && (c == '$' ? isxdigit((unsigned char)src[i]) : (src[i] == '0' || src[i] == '1'))) {
+                tok.text += (char)toupper((unsigned char)src[i]);
+                i++;
+            }
+            if (tok.text.empty()) {
+                error = "line " + std::to_string(line) + ": empty literal";
+                return false;
+            }
+            tok.type = c == '$' ? TOK_HEX : TOK_BINARY;
+        } else if (c == '"') {
+            i++;
+            while (i < src.size() && src[i] != '"' && src[i] != '\n') {
+                tok.text += src[i++];
+            }
+            if (i >= src.size() || src[i] != '"') {
+                error = "line " + std::to_string(line) + ": unterminated string";
+                return false;
+            }
+            i++;
+            tok.type = TOK_STRING;
+        } else {
+            tok.type = TOK_PUNCT;
+            for (const char* p : two_char) {
+                if (src.compare(i, 2, p) == 0) {
+                    tok.text = p;
+                    i += 2;
+                    break;
+                }
+            }
+            if (tok.text.empty()) {
+                if (!strchr(";,=<>+-*/%&|^~!()[]:", c)) {
+                    error = "line " + std::to_string(line) + ": unexpected character '" + std::string(1, c) + "'";
+                    return false;
+                }
+                tok.text = std::string(1, c);
+                i++;
+            }
+        }
+        out.push_back(tok);
+    }
+    StaplToken end_tok;
+    end_tok.type = TOK_END;
+    end_tok.number = 0;
+    end_tok.line = line;
+    out.push_back(end_tok);
+    return true;
+}
+
+// Recursive-descent compiler from tokens to StaplProgram bytecode
+class StaplCompiler {
+public:
+    std::string error;
+
+    StaplCompiler(StaplProgram& prog, const std::vector<StaplToken>& toks)
+        : prog(prog), toks(toks), pos(0), proc_skip(-1) {}
+
+    bool compile_all();
+
+private:
+    struct Fixup {
+        int instr;
+        std::string name;
+        int line;
+    };
+    struct Loop {
+        int var;
+        int end_var;
+        int step_var;
+        int top;
+        int exit_jump;
+    };
+
+    StaplProgram& prog;
+    const std::vector<StaplToken>& toks;
+    size_t pos;
+    std::map<std::string, int> var_index;
+    std::map<std::string, int> labels;
+    std::vector<Fixup> goto_fixups;
+    std::vector<Fixup> call_fixups;
+    std::vector<Loop> loops;
+    std::vector<std::pair<std::string, std::vector<Fixup>>> action_lists;
+    int proc_skip;
+
+    const StaplToken& cur() const { return toks[pos]; }
+    bool is(const char* punct) const { return cur().type == TOK_PUNCT && cur().text == punct; }
+    bool is_kw(const char* kw) const { return cur().type == TOK_IDENT && cur().text == kw; }
+    bool accept(const char* punct) {
+        if (is(punct)) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    bool accept_kw(const char* kw) {
+        if (is_kw(kw)) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    bool fail(const std::string& message) {
+        if (error.empty()) {
+            error = "line " + std::to_string(cur().line) + ": " + message;
+        }
+        return false;
+    }
+    bool expect(const char* punct) {
+        return accept(punct) || fail(std::string("expected '") + punct + "'");
+    }
+    int emit(int op, int32_t a = 0, int32_t b = 0) {
+        StaplInstr instr = { (uint8_t)op, a, b, cur().line };
+        prog.code.push_back(instr);
+        return (int)prog.code.size() - 1;
+    }
+
+    int add_var(const std::string& name, bool boolean, int size);
+    int lookup(const std::string& name);
+    bool identifier(std::string* name);
+    bool statement();
+    bool declaration(bool boolean);
+    bool let_statement();
+    bool scan_statement(bool ir);
+    bool for_statement();
+    bool next_statement();
+    bool wait_statement();
+    bool print_statement(bool is_export);
+    bool action_statement();
+    bool array_operand(int* var);
+    bool expression() { return binary(0); }
+    bool binary(int level);
+    bool unary();
+    bool primary();
+};
+
+int StaplCompiler::add_var(const std::string& name, bool boolean, int size) {
+    StaplVariable var;
+    var.name = name;
+    var.boolean = boolean;
+    var.size = size;
+    var.value = 0;
+    var.pending = 0;
+    if (size > 0) {
+        if (boolean) {
+            var.bits.assign(size, 0);
+        } else {
+            var.ints.assign(size, 0);
+        }
+    }
+    prog.vars.push_back(var);
+    int index = (int)prog.vars.size() - 1;
+    if (!name.empty()) {
+        var_index[name] = index;
+    }
+    return index;
+}
+
+int StaplCompiler::lookup(const std::string& name) {
+    auto it = var_index.find(name);
+    return it == var_index.end() ? -1 : it->second;
+}
+
+bool StaplCompiler::identifier(std::string* name) {
+    if (cur().type != TOK_IDENT) {
+        return fail("expected identifier");
+    }
+    *name = cur().text;
+    pos++;
+    return true;
+}
+
+bool StaplCompiler::compile_all() {
+    while (cur().type != TOK_END) {
+        if (!statement()) {
+            return false;
+        }
+    }
+    if (!loops.empty()) {
+        return fail("FOR without NEXT");
+    }
+    if (proc_skip >= 0) {
+        return fail("PROCEDURE without ENDPROC");
+    }
+
+    // Top-level code returns into the selected action; each action is a
+    // list of calls followed by HALT
+    emit(STAPL_RET);
+    for (size_t i = 0; i < action_lists.size(); i++) {
+        prog.actions[action_lists[i].first] = (int)prog.code.size();
+        for (size_t j = 0; j < action_lists[i].second.size(); j++) {
+            Fixup fix = action_lists[i].second[j];
+            fix.instr = emit(STAPL_CALL);
+            call_fixups.push_back(fix);
+        }
+        emit(STAPL_HALT);
+    }
+    emit(STAPL_HALT);
+
+    for (size_t i = 0; i < goto_fixups.size(); i++) {
+        auto it = labels.find(goto_fixups[i].name);
+        if (it == labels.end()) {
+            error = "line " + std::to_string(goto_fixups[i].line) + ": unknown label " + goto_fixups[i].name;
+            return false;
+        }
+        prog.code[goto_fixups[i].instr].a = it->second;
+    }
+    for (size_t i = 0; i < call_fixups.size(); i++) {
+        auto it = prog.procedures.find(call_fixups[i].name);
+        if (it == prog.procedures.end()) {
+            error = "line " + std::to_string(call_fixups[i].line) + ": unknown procedure " + call_fixups[i].name;
+            return false;
+        }
+        prog.code[call_fixups[i].instr].a = it->second;
+    }
+    return true;
+}
+
+bool StaplCompiler::statement() {
+    // Optional label
+    if (cur().type == TOK_IDENT && toks[pos + 1].type == TOK_PUNCT && toks[pos + 1].text == ":") {
+        if (labels.count(cur().text)) {
+            return fail("duplicate label " + cur().text);
+        }
+        labels[cur().text] = (int)prog.code.size();
+        pos += 2;
+    }
+    if (cur().type != TOK_IDENT) {
+        return fail("expected statement");
+    }
+    prog.statements++;
+
+    std::string kw = cur().text;
+    pos++;
+    if (kw == "BOOLEAN" || kw == "INTEGER") {
+        return declaration(kw == "BOOLEAN");
+    } else if (kw == "LET") {
+        return let_statement();
+    } else if (kw == "IRSCAN" || kw == "DRSCAN") {
+        return scan_statement(kw == "IRSCAN");
+    } else if (kw == "FOR") {
+        return for_statement();
+    } else if (kw == "NEXT") {
+        return next_statement();
+    } else if (kw == "IF") {
+        if (!expression() || !(accept_kw("THEN") || fail("expected THEN"))) {
+            return false;
+        }
+        int skip = emit(STAPL_JZ);
+        if (!statement()) {
+            return false;
+        }
+        prog.code[skip].a = (int)prog.code.size();
+        return true;
+    } else if (kw == "GOTO" || kw == "CALL") {
+        Fixup fix;
+        fix.line = cur().line;
+        if (!identifier(&fix.name)) {
+            return false;
+        }
+        fix.instr = emit(kw == "GOTO" ? STAPL_JMP : STAPL_CALL);
+        (kw == "GOTO" ? goto_fixups : call_fixups).push_back(fix);
+        return expect(";");
+    } else if (kw == "PROCEDURE") {
+        std::string name;
+        if (proc_skip >= 0) {
+            return fail("nested PROCEDURE");
+        }
+        if (!identifier(&name)) {
+            return false;
+        }
+        while (cur().type != TOK_END && !is(";")) {    // USES list
+            pos++;
+        }
+        proc_skip = emit(STAPL_JMP);
+        prog.procedures[name] = (int)prog.code.size();
+        return expect(";");
+    } else if (kw == "ENDPROC") {
+        if (proc_skip < 0) {
+            return fail("ENDPROC without PROCEDURE");
+        }
+        emit(STAPL_RET);
+        prog.code[proc_skip].a = (int)prog.code.size();
+        proc_skip = -1;
+        return expect(";");
+    } else if (kw == "ACTION") {
+        return action_statement();
+    } else if (kw == "IRSTOP" || kw == "DRSTOP") {
+        int state = cur().type == TOK_IDENT ? stapl_state(cur().text) : -1;
+        if (state < 0 || !stapl_stable_state(state)) {
+            return fail("expected a stable state");
+        }
+        pos++;
+        emit(STAPL_STOP, kw == "IRSTOP", state);
+        return expect(";");
+    } else if (kw == "STATE") {
+        while (!is(";")) {
+            int state = cur().type == TOK_IDENT ? stapl_state(cur().text) : -1;
+            if (state < 0) {
+                return fail("expected a TAP state");
+            }
+            pos++;
+            emit(STAPL_STATE, state);
+        }
+        return expect(";");
+    } else if (kw == "WAIT") {
+        return wait_statement();
+    } else if (kw == "PRINT" || kw == "EXPORT") {
+        return print_statement(kw == "EXPORT");
+    } else if (kw == "EXIT") {
+        if (!expression()) {
+            return false;
+        }
+        emit(STAPL_EXIT);
+        return expect(";");
+    } else if (kw == "NOTE" || kw == "CRC" || kw == "ALIGN" || kw == "FREQUENCY" || kw == "PREIR" ||
+               kw == "POSTIR" || kw == "PREDR" || kw == "POSTDR" || kw == "VECTOR") {
+        while (cur().type != TOK_END && !is(";")) {
+            pos++;
+        }
+        return expect(";");
+    }
+    pos--;
+    return fail("unsupported statement " + kw);
+}
+
+bool StaplCompiler::declaration(bool boolean) {
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    if (lookup(name) >= 0) {
+        return fail("redeclaration of " + name);
+    }
+    int size = 0;
+    if (accept("[")) {
+        if (cur().type != TOK_NUMBER || cur().number <= 0 || cur().number > (1 << 26)) {
+            return fail("array size must be a positive constant");
+        }
+        size = (int)cur().number;
+        pos++;
+        if (!expect("]")) {
+            return false;
+        }
+    }
+    int var = add_var(name, boolean, size);
+
+    if (accept("=")) {
+        StaplVariable& v = prog.vars[var];
+        if (size == 0) {
+            if (!expression()) {
+                return false;
+            }
+            emit(STAPL_STORE, var);
+        } else if (boolean && (cur().type == TOK_HEX || cur().type == TOK_BINARY)) {
+            // Literal digits are most significant first; element 0 is the LSB
+            const std::string& digits = cur().text;
+            int bits_per_digit = cur().type == TOK_HEX ? 4 : 1;
+            int bit = 0;
+            for (int d = (int)digits.size() - 1; d >= 0 && bit < size; d--) {
+                int value = isdigit((unsigned char)digits[d]) ? digits[d] - '0' : digits[d] - 'A' + 10;
+                for (int k = 0; k < bits_per_digit && bit < size; k++, bit++) {
+                    v.bits[bit] = (value >> k) & 1;
+                }
+            }
+            pos++;
+        } else {
+            for (int i = 0; ; i++) {
+                bool negative = accept("-");
+                if (cur().type != TOK_NUMBER || i >= size) {
+                    return fail("expected up to " + std::to_string(size) + " constant values");
+                }
+                int32_t value = (int32_t)(negative ? -cur().number : cur().number);
+                if (boolean) {
+                    v.bits[i] = value != 0;
+                } else {
+                    v.ints[i] = value;
+                }
+                pos++;
+                if (!accept(",")) {
+                    break;
+                }
+            }
+        }
+    }
+    return expect(";");
+}
+
+// Array operand: literal, whole array, a[i] or a[hi..lo]; pushes hi, lo
+bool StaplCompiler::array_operand(int* var) {
+    if (cur().type == TOK_HEX || cur().type == TOK_BINARY) {
+        int bits_per_digit = cur().type == TOK_HEX ? 4 : 1;
+        const std::string& digits = cur().text;
+        int size = (int)digits.size() * bits_per_digit;
+        *var = add_var("", true, size);
+        StaplVariable& v = prog.vars[*var];
+        int bit = 0;
+        for (int d = (int)digits.size() - 1; d >= 0; d--) {
+            int value = isdigit((unsigned char)digits[d]) ? digits[d] - '0' : digits[d] - 'A' + 10;
+            for (int k = 0; k < bits_per_digit; k++, bit++) {
+                v.bits[bit] = (value >> k) & 1;
+            }
+        }
+        pos++;
+        emit(STAPL_PUSH, size - 1);
+        emit(STAPL_PUSH, 0);
+        return true;
+    }
+
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    *var = lookup(name);
+    if (*var < 0 || prog.vars[*var].size == 0 || !prog.vars[*var].boolean) {
+        return fail(name + " is not a BOOLEAN array");
+    }
+    if (!accept("[")) {
+        emit(STAPL_PUSH, prog.vars[*var].size - 1);
+        emit(STAPL_PUSH, 0);
+        return true;
+    }
+    size_t index_pos = pos;
+    if (!expression()) {
+        return false;
+    }
+    if (accept("..")) {
+        if (!expression()) {
+            return false;
+        }
+    } else {
+        // Single element: evaluate the index again as the low bound
+        size_t end_pos = pos;
+        pos = index_pos;
+        expression();
+        pos = end_pos;
+    }
+    return expect("]");
+}
+
+bool StaplCompiler::let_statement() {
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    int var = lookup(name);
+    if (var < 0) {
+        return fail("unknown variable " + name);
+    }
+    if (prog.vars[var].size == 0) {
+        if (!expect("=") || !expression()) {
+            return false;
+        }
+        emit(STAPL_STORE, var);
+        return expect(";");
+    }
+
+    if (!expect("[") || !expression()) {
+        return false;
+    }
+    if (accept("..")) {
+        // Slice copy between Boolean arrays
+        int source = -1;
+        if (!prog.vars[var].boolean) {
+            return fail("slices need a BOOLEAN array");
+        }
+        if (!expression() || !expect("]") || !expect("=") || !array_operand(&source)) {
+            return false;
+        }
+        emit(STAPL_COPY_SLICE, var, source);
+        return expect(";");
+    }
+    if (!expect("]") || !expect("=") || !expression()) {
+        return false;
+    }
+    emit(STAPL_STORE_ELEM, var);
+    return expect(";");
+}
+
+bool StaplCompiler::scan_statement(bool ir) {
+    StaplScanOp op = { ir, -1, -1, -1, -1, -1 };
+    if (!expression() || !expect(",") || !array_operand(&op.data_var)) {
+        return false;
+    }
+    while (accept(",")) {
+        if (accept_kw("CAPTURE")) {
+            if (op.expect_var >= 0) {
+                return fail("CAPTURE must come before COMPARE");
+            }
+            if (!array_operand(&op.capture_var)) {
+                return false;
+            }
+        } else if (accept_kw("COMPARE")) {
+            std::string result;
+            if (!array_operand(&op.expect_var) || !expect(",") || !array_operand(&op.mask_var) ||
+                !expect(",") || !identifier(&result)) {
+                return false;
+            }
+            op.result_var = lookup(result);
+            if (op.result_var < 0 || prog.vars[op.result_var].size != 0 || !prog.vars[op.result_var].boolean) {
+                return fail(result + " is not a BOOLEAN scalar");
+            }
+        } else {
+            return fail("expected CAPTURE or COMPARE");
+        }
+    }
+    prog.scans.push_back(op);
+    emit(STAPL_SCAN, (int)prog.scans.size() - 1);
+    return expect(";");
+}
+
+bool StaplCompiler::for_statement() {
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    Loop loop;
+    loop.var = lookup(name);
+    if (loop.var < 0 || prog.vars[loop.var].size != 0 || prog.vars[loop.var].boolean) {
+        return fail(name + " is not an INTEGER scalar");
+    }
+    if (!expect("=") || !expression()) {
+        return false;
+    }
+    emit(STAPL_STORE, loop.var);
+    if (!(accept_kw("TO") || fail("expected TO")) || !expression()) {
+        return false;
+    }
+    loop.end_var = add_var("", false, 0);
+    loop.step_var = add_var("", false, 0);
+    emit(STAPL_STORE, loop.end_var);
+    if (accept_kw("STEP")) {
+        if (!expression()) {
+            return false;
+        }
+    } else {
+        emit(STAPL_PUSH, 1);
+    }
+    emit(STAPL_STORE, loop.step_var);
+
+    loop.top = emit(STAPL_LOAD, loop.var);
+    emit(STAPL_LOAD, loop.end_var);
+    emit(STAPL_LOAD, loop.step_var);
+    emit(STAPL_FOR_TEST);
+    loop.exit_jump = emit(STAPL_JZ);
+    loops.push_back(loop);
+    return expect(";");
+}
+
+bool StaplCompiler::next_statement() {
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    if (loops.empty() || prog.vars[loops.back().var].name != name) {
+        return fail("NEXT " + name + " does not match the innermost FOR");
+    }
+    Loop loop = loops.back();
+    loops.pop_back();
+    emit(STAPL_LOAD, loop.var);
+    emit(STAPL_LOAD, loop.step_var);
+    emit(STAPL_ADD);
+    emit(STAPL_STORE, loop.var);
+    emit(STAPL_JMP, loop.top);
+    prog.code[loop.exit_jump].a = (int)prog.code.size();
+    return expect(";");
+}
+
+// WAIT [state,] count TCK|USEC [, count TCK|USEC]
+bool StaplCompiler::wait_statement() {
+    int state = RUN_TEST_IDLE;
+    if (cur().type == TOK_IDENT && stapl_state(cur().text) >= 0 && lookup(cur().text) < 0) {
+        state = stapl_state(cur().text);
+        if (!stapl_stable_state(state)) {
+            return fail("WAIT needs a stable state");
+        }
+        pos++;
+        if (!expect(",")) {
+            return false;
+        }
+    }
+    do {
+        if (!expression()) {
+            return false;
+        }
+        if (accept_kw("TCK")) {
+            emit(STAPL_WAIT, state, 0);
+        } else if (accept_kw("USEC")) {
+            emit(STAPL_WAIT, state, 1);
+        } else {
+            return fail("expected TCK or USEC");
+        }
+    } while (accept(","));
+    return expect(";");
+}
+
+bool StaplCompiler::print_statement(bool is_export) {
+    StaplPrintOp op;
+    op.text.push_back("");
+    op.has_expr.push_back(0);
+    if (is_export) {
+        if (cur().type != TOK_STRING) {
+            return fail("expected export key");
+        }
+        op.text[0] = cur().text;
+        pos++;
+        if (!expect(",") || !expression()) {
+            return false;
+        }
+        op.has_expr[0] = 1;
+    } else {
+        do {
+            if (cur().type == TOK_STRING) {
+                op.text.back() += cur().text;
+                pos++;
+            } else {
+                if (!expression()) {
+                    return false;
+                }
+                op.has_expr.back() = 1;
+                op.text.push_back("");
+                op.has_expr.push_back(0);
+            }
+        } while (accept(","));
+    }
+    prog.prints.push_back(op);
+    emit(is_export ? STAPL_EXPORT : STAPL_PRINT, (int)prog.prints.size() - 1);
+    return expect(";");
+}
+
+// ACTION name ["description"] = proc [OPTIONAL|RECOMMENDED], ...
+bool StaplCompiler::action_statement() {
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    if (cur().type == TOK_STRING) {
+        pos++;
+    }
+    if (!expect("=")) {
+        return false;
+    }
+    std::vector<Fixup> calls;
+    do {
+        Fixup fix;
+        fix.instr = -1;
+        fix.line = cur().line;
+        if (!identifier(&fix.name)) {
+            return false;
+        }
+        accept_kw("OPTIONAL") || accept_kw("RECOMMENDED");
+        calls.push_back(fix);
+    } while (accept(","));
+    action_lists.push_back(std::make_pair(name, calls));
+    return expect(";");
+}
+
+bool StaplCompiler::binary(int level) {
+    static const struct {
+        const char* token;
+        int op;
+        int level;
+    } ops[] = {
+        { "||", STAPL_LOR, 0 }, { "&&", STAPL_LAND, 1 }, { "|", STAPL_OR, 2 }, { "^", STAPL_XOR, 3 },
+        { "&", STAPL_AND, 4 }, { "==", STAPL_EQ, 5 }, { "!=", STAPL_NE, 5 }, { "<", STAPL_LT, 6 },
+        { "<=", STAPL_LE, 6 }, { ">", STAPL_GT, 6 }, { ">=", STAPL_GE, 6 }, { "<<", STAPL_SHL, 7 },
+        { ">>", STAPL_SHR, 7 }, { "+", STAPL_ADD, 8 }, { "-", STAPL_SUB, 8 }, { "*", STAPL_MUL, 9 },
+        { "/", STAPL_DIV, 9 }, { "%", STAPL_MOD, 9 }
+    };
+    if (level > 9) {
+        return unary();
+    }
+    if (!binary(level + 1)) {
+        return false;
+    }
+    for (;;) {
+        int op = -1;
+        for (const auto& entry : ops) {
+            if (entry.level == level && is(entry.token)) {
+                op = entry.op;
+                break;
+            }
+        }
+        if (op < 0) {
+            return true;
+        }
+        pos++;
+        if (!binary(level + 1)) {
+            return false;
+        }
+        emit(op);
+    }
+}
+
+bool StaplCompiler::unary() {
+    if (accept("-")) {
+        if (!unary()) {
+            return false;
+        }
+        emit(STAPL_NEG);
+        return true;
+    }
+    if (accept("!")) {
+        if (!unary()) {
+            return false;
+        }
+        emit(STAPL_NOT);
+        return true;
+    }
+    if (accept("~")) {
+        if (!unary()) {
+            return false;
+        }
+        emit(STAPL_BNOT);
+        return true;
+    }
+    return primary();
+}
+
+bool StaplCompiler::primary() {
+    const StaplToken& tok = cur();
+    if (tok.type == TOK_NUMBER) {
+        emit(STAPL_PUSH, (int32_t)tok.number);
+        pos++;
+        return true;
+    }
+    if (tok.type == TOK_HEX || tok.type == TOK_BINARY) {
+        uint32_t value = 0;
+        for (char d : tok.text) {
+            int digit = isdigit((unsigned char)d) ? d - '0' : d - 'A' + 10;
+            value = tok.type == TOK_HEX ? (value << 4) | digit : (value << 1) | digit;
+        }
+        emit(STAPL_PUSH, (int32_t)value);
+        pos++;
+        return true;
+    }
+    if (accept("(")) {
+        return expression() && expect(")");
+    }
+    std::string name;
+    if (!identifier(&name)) {
+        return false;
+    }
+    int var = lookup(name);
+    if (var < 0) {
+        return fail("unknown variable " + name);
+    }
+    if (prog.vars[var].size == 0) {
+        emit(STAPL_LOAD, var);
+        return true;
+    }
+    if (!expect("[") || !expression()) {
+        return false;
+    }
+    if (accept("..")) {
+        if (!prog.vars[var].boolean) {
+            return fail("slices need a BOOLEAN array");
+        }
+        if (!expression()) {
+            return false;
+        }
+        emit(STAPL_LOAD_SLICE, var);
+    } else {
+        emit(STAPL_LOAD_ELEM, var);
+    }
+    return expect("]");
+}
+
+} // namespace
+
+// StaplPlayer implementation
+StaplPlayer::StaplPlayer(int hif)
+    : hif(hif), tck_hz(10000000), max_program_bits(1 << 20), exit_code(0),
+      instructions(0), scans(0), transfers(0), bits(0),
+      ir_stop(RUN_TEST_IDLE), dr_stop(RUN_TEST_IDLE) {}
+
+int StaplPlayer::compile(const std::string& source) {
+    prog = StaplProgram();
+    error.clear();
+    std::vector<StaplToken> toks;
+    if (!stapl_tokenize(source, toks, error)) {
+        return FALSE;
+    }
+    StaplCompiler compiler(prog, toks);
+    if (!compiler.compile_all()) {
+        error = compiler.error;
+        return FALSE;
+    }
+    initial_vars = prog.vars;
+    return TRUE;
+}
+
+int StaplPlayer::fail(int line, const std::string& message) {
+    error = "line " + std::to_string(line) + ": " + message;
+    printf("MOCK: STAPL error at %s\n", error.c_str());
+    fflush(stdout);
+    return FALSE;
+}
+
+// Drive the accumulated scans and collect every pending capture and compare
+int StaplPlayer::flush() {
+    if (scan_program.bit_count == 0) {
+        return TRUE;
+    }
+    tdo.assign((scan_program.bit_count + 7) / 8, 0);
+    if (!djtg_shift_bits(hif, scan_program.tms.data(), scan_program.tdi.data(), tdo.data(),
+                         scan_program.bit_count)) {
+        return FALSE;
+    }
+    transfers++;
+    bits += scan_program.bit_count;
+
+    for (size_t i = 0; i < captures.size(); i++) {
+        const PendingCapture& c = captures[i];
+        int offset = scan_program.fields[c.field].offset;
+        StaplVariable& var = prog.vars[c.var];
+        for (int b = 0; b < c.length; b++) {
+            int bit = offset + b;
+            var.bits[c.lo + b] = (tdo[bit / 8] >> (bit % 8)) & 1;
+        }
+        var.pending = 0;
+    }
+    for (size_t i = 0; i < compares.size(); i++) {
+        const PendingCompare& c = compares[i];
+        int offset = scan_program.fields[c.field].offset;
+        const uint8_t* expected = &compare_data[c.data_offset];
+        const uint8_t* mask = expected + c.length;
+        bool match = true;
+        for (int b = 0; b < c.length && match; b++) {
+            int bit = offset + b;
+            match = !mask[b] || (((tdo[bit / 8] >> (bit % 8)) & 1) == expected[b]);
+        }
+        prog.vars[c.result_var].value = match ? 1 : 0;
+        prog.vars[c.result_var].pending = 0;
+    }
+    captures.clear();
+    compares.clear();
+    compare_data.clear();
+    scan_program.clear(scan_program.state);
+    return TRUE;
+}
+
+int StaplPlayer::execute_scan(const StaplScanOp& op, std::vector<int32_t>& stack, int line) {
+    const int vars[4] = { op.data_var, op.capture_var, op.expect_var, op.mask_var };
+    int lo[4] = { 0, 0, 0, 0 };
+    for (int k = 3; k >= 0; k--) {
+        if (vars[k] < 0) {
+            continue;
+        }
+        lo[k] = stack.back();
+        stack.pop_back();
+        int hi = stack.back();
+        stack.pop_back();
+        if (hi < lo[k]) {
+            std::swap(hi, lo[k]);
+        }
+        if (lo[k] < 0 || hi >= prog.vars[vars[k]].size) {
+            return fail(line, "scan operand out of range");
+        }
+    }
+    int length = stack.back();
+    stack.pop_back();
+    for (int k = 0; k < 4; k++) {
+        if (vars[k] >= 0 && lo[k] + length > prog.vars[vars[k]].size) {
+            return fail(line, "scan operand shorter than the scan length");
+        }
+    }
+    if (length <= 0 || (op.ir && length > 32)) {
+        return fail(line, "bad scan length " + std::to_string(length));
+    }
+
+    // Operands that still wait for captured data need the chain first
+    for (int k = 0; k < 4; k++) {
+        if (k != 1 && vars[k] >= 0 && prog.vars[vars[k]].pending && !flush()) {
+            return FALSE;
+        }
+    }
+
+    const std::vector<uint8_t>& data = prog.vars[op.data_var].bits;
+    packed.assign((length + 7) / 8, 0);
+    for (int i = 0; i < length; i++) {
+        if (data[lo[0] + i]) {
+            packed[i / 8] |= 1 << (i % 8);
+        }
+    }
+    int field;
+    if (op.ir) {
+        uint32_t value = 0;
+        for (int i = 0; i < length; i++) {
+            value |= (uint32_t)data[lo[0] + i] << i;
+        }
+        field = scan_program.shift_ir(value, length);
+        scan_program.goto_state(ir_stop);
+    } else {
+        field = scan_program.shift_dr_bytes(packed.data(), length);
+        scan_program.goto_state(dr_stop);
+    }
+    scans++;
+
+    if (op.capture_var >= 0) {
+        PendingCapture capture = { field, op.capture_var, lo[1], length };
+        captures.push_back(capture);
+        prog.vars[op.capture_var].pending++;
+    }
+    if (op.result_var >= 0) {
+        PendingCompare compare = { field, length, (int)compare_data.size(), op.result_var };
+        const std::vector<uint8_t>& expected = prog.vars[op.expect_var].bits;
+        const std::vector<uint8_t>& mask = prog.vars[op.mask_var].bits;
+        compare_data.insert(compare_data.end(), expected.begin() + lo[2], expected.begin() + lo[2] + length);
+        compare_data.insert(compare_data.end(), mask.begin() + lo[3], mask.begin() + lo[3] + length);
+        compares.push_back(compare);
+        prog.vars[op.result_var].pending++;
+    }
+    if (scan_program.bit_count >= max_program_bits) {
+        return flush();
+    }
+    return TRUE;
+}
+
+int StaplPlayer::run(const std::string& action) {
+    error.clear();
+    exports.clear();
+    exit_code = 0;
+    if (prog.code.empty()) {
+        return fail(0, "no program compiled");
+    }
+    prog.vars = initial_vars;
+    scan_program.clear(RUN_TEST_IDLE);
+    ir_stop = RUN_TEST_IDLE;
+    dr_stop = RUN_TEST_IDLE;
+    captures.clear();
+    compares.clear();
+    compare_data.clear();
+
+    std::vector<int> call_stack;
+    call_stack.push_back((int)prog.code.size() - 1);    // Final HALT
+    if (!action.empty()) {
+        auto it = prog.actions.find(action);
+        if (it == prog.actions.end()) {
+            it = prog.procedures.find(action);
+            if (it == prog.procedures.end()) {
+                return fail(0, "unknown action " + action);
+            }
+        }
+        call_stack.push_back(it->second);
+    }
+
+    std::vector<int32_t> stack;
+    stack.reserve(64);
+    int pc = 0;
+    for (;;) {
+        const StaplInstr& in = prog.code[pc++];
+        instructions++;
+        switch (in.op) {
+            case STAPL_PUSH:
+                stack.push_back(in.a);
+                break;
+            case STAPL_LOAD: {
+                StaplVariable& var = prog.vars[in.a];
+                if (var.pending && !flush()) {
+                    return FALSE;
+                }
+                stack.push_back(var.value);
+                break;
+            }
+            case STAPL_LOAD_ELEM: {
+                StaplVariable& var = prog.vars[in.a];
+                int32_t index = stack.back();
+                if (index < 0 || index >= var.size) {
+                    return fail(in.line, var.name + " index out of range");
+                }
+                if (var.pending && !flush()) {
+                    return FALSE;
+                }
+                stack.back() = var.boolean ? var.bits[index] : var.ints[index];
+                break;
+            }
+            case STAPL_LOAD_SLICE: {
+                StaplVariable& var = prog.vars[in.a];
+                int32_t lo = stack.back();
+                stack.pop_back();
+                int32_t hi = stack.back();
+                if (hi < lo) {
+                    std::swap(hi, lo);
+                }
+                if (lo < 0 || hi >= var.size || hi - lo >= 32) {
+                    return fail(in.line, var.name + " slice out of range");
+                }
+                if (var.pending && !flush()) {
+                    return FALSE;
+                }
+                uint32_t value = 0;
+                for (int32_t i = hi; i >= lo; i--) {
+                    value = (value << 1) | var.bits[i];
+                }
+                stack.back() = (int32_t)value;
+                break;
+            }
+            case STAPL_STORE: {
+                StaplVariable& var = prog.vars[in.a];
+                if (var.pending && !flush()) {
+                    return FALSE;
+                }
+                var.value = var.boolean ? (stack.back() != 0) : stack.back();
+                stack.pop_back();
+                break;
+            }
+            case STAPL_STORE_ELEM: {
+                StaplVariable& var = prog.vars[in.a];
+                int32_t value = stack.back();
+                stack.pop_back();
+                int32_t index = stack.back();
+                stack.pop_back();
+                if (index < 0 || index >= var.size) {
+                    return fail(in.line, var.name + " index out of range");
+                }
+                if (var.pending && !flush()) {
+                    return FALSE;
+                }
+                if (var.boolean) {
+                    var.bits[index] = value != 0;
+                } else {
+                    var.ints[index] = value;
+                }
+                break;
+            }
+            case STAPL_COPY_SLICE: {
+                StaplVariable& dst = prog.vars[in.a];
+                StaplVariable& src = prog.vars[in.b];
+                int32_t range[4];                        // dst hi, dst lo, src hi, src lo
+                for (int k = 3; k >= 0; k--) {
+                    range[k] = stack.back();
+                    stack.pop_back();
+                }
+                for (int k = 0; k < 4; k += 2) {
+                    if (range[k] < range[k + 1]) {
+                        std::swap(range[k], range[k + 1]);
+                    }
+                }
+                int32_t length = range[0] - range[1] + 1;
+                if (range[1] < 0 || range[0] >= dst.size || range[3] < 0 || range[2] >= src.size ||
+                    range[2] - range[3] + 1 != length) {
+                    return fail(in.line, "slice copy out of range");
+                }
+                if ((dst.pending || src.pending) && !flush()) {
+                    return FALSE;
+                }
+                for (int32_t i = 0; i < length; i++) {
+                    dst.bits[range[1] + i] = src.bits[range[3] + i];
+                }
+                break;
+            }
+            case STAPL_NEG:
+                stack.back() = -stack.back();
+                break;
+            case STAPL_NOT:
+                stack.back() = !stack.back();
+                break;
+            case STAPL_BNOT:
+                stack.back() = ~stack.back();
+                break;
+            case STAPL_ADD: case STAPL_SUB: case STAPL_MUL: case STAPL_DIV: case STAPL_MOD:
+            case STAPL_AND: case STAPL_OR: case STAPL_XOR: case STAPL_SHL: case STAPL_SHR:
+            case STAPL_EQ: case STAPL_NE: case STAPL_LT: case STAPL_LE: case STAPL_GT: case STAPL_GE:
+            case STAPL_LAND: case STAPL_LOR: {
+                int32_t r = stack.back();
+                stack.pop_back();
+                int32_t l = stack.back();
+                int32_t v = 0;
+                switch (in.op) {
+                    case STAPL_ADD: v = (int32_t)((uint32_t)l + (uint32_t)r); break;
+                    case STAPL_SUB: v = (int32_t)((uint32_t)l - (uint32_t)r); break;
+                    case STAPL_MUL: v = (int32_t)((uint32_t)l * (uint32_t)r); break;
+                    case STAPL_DIV: case STAPL_MOD:
+                        if (r == 0) {
+                            return fail(in.line, "division by zero");
+                        }
+                        v = in.op == STAPL_DIV ? l / r : l % r;
+                        break;
+                    case STAPL_AND: v = l & r; break;
+                    case STAPL_OR:  v = l | r; break;
+                    case STAPL_XOR: v = l ^ r; break;
+                    case STAPL_SHL: v = (int32_t)((uint32_t)l << (r & 31)); break;
+                    case STAPL_SHR: v = (int32_t)((uint32_t)l >> (r & 31)); break;
+                    case STAPL_EQ:  v = l == r; break;
+                    case STAPL_NE:  v = l != r; break;
+                    case STAPL_LT:  v = l < r; break;
+                    case STAPL_LE:  v = l <= r; break;
+                    case STAPL_GT:  v = l > r; break;
+                    case STAPL_GE:  v = l >= r; break;
+                    case STAPL_LAND: v = l && r; break;
+                    case STAPL_LOR:  v = l || r; break;
+                }
+                stack.back() = v;
+                break;
+            }
+            case STAPL_FOR_TEST: {
+                int32_t step = stack.back();
+                stack.pop_back();
+                int32_t end = stack.back();
+                stack.pop_back();
+                int32_t counter = stack.back();
+                stack.back() = step >= 0 ? counter <= end : counter >= end;
+                break;
+            }
+            case STAPL_JMP:
+                pc = in.a;
+                break;
+            case STAPL_JZ: {
+                int32_t cond = stack.back();
+                stack.pop_back();
+                if (!cond) {
+                    pc = in.a;
+                }
+                break;
+            }
+            case STAPL_CALL:
+                if (call_stack.size() > 256) {
+                    return fail(in.line, "call stack overflow");
+                }
+                call_stack.push_back(pc);
+                pc = in.a;
+                break;
+            case STAPL_RET:
+                pc = call_stack.back();
+                call_stack.pop_back();
+                break;
+            case STAPL_SCAN:
+                if (!execute_scan(prog.scans[in.a], stack, in.line)) {
+                    return FALSE;
+                }
+                break;
+            case STAPL_STATE:
+                scan_program.goto_state((TapState)in.a);
+                break;
+            case STAPL_WAIT: {
+                int64_t cycles = stack.back();
+                stack.pop_back();
+                if (in.b) {
+                    cycles = (cycles * tck_hz + 999999) / 1000000;
+                }
+                scan_program.goto_state((TapState)in.a);
+                bool tms = in.a == TEST_LOGIC_RESET;
+                if (cycles > STAPL_LONG_WAIT_CYCLES) {
+                    if (!flush() || !djtg_clock_tck(hif, tms, 0, (int)cycles, 0)) {
+                        return FALSE;
+                    }
+                } else {
+                    for (int64_t i = 0; i < cycles; i++) {
+                        scan_program.append_bit(tms, false);
+                    }
+                }
+                break;
+            }
+            case STAPL_STOP:
+                (in.a ? ir_stop : dr_stop) = (TapState)in.b;
+                break;
+            case STAPL_PRINT: case STAPL_EXPORT: {
+                const StaplPrintOp& print = prog.prints[in.a];
+                int count = 0;
+                for (size_t i = 0; i < print.has_expr.size(); i++) {
+                    count += print.has_expr[i];
+                }
+                std::vector<int32_t> values(stack.end() - count, stack.end());
+                stack.resize(stack.size() - count);
+                if (in.op == STAPL_EXPORT) {
+                    exports.push_back(std::make_pair(print.text[0], values[0]));
+                    printf("STAPL: EXPORT %s = %d\n", print.text[0].c_str(), values[0]);
+                } else {
+                    std::string line;
+                    for (size_t i = 0, v = 0; i < print.text.size(); i++) {
+                        line += print.text[i];
+                        if (print.has_expr[i]) {
+                            line += std::to_string(values[v++]);
+                        }
+                    }
+                    printf("STAPL: %s\n", line.c_str());
+                }
+                fflush(stdout);
+                break;
+            }
+            case STAPL_EXIT:
+                exit_code = stack.back();
+                scan_program.goto_state(RUN_TEST_IDLE);
+                return flush();
+            case STAPL_HALT:
+                scan_program.goto_state(RUN_TEST_IDLE);
+                return flush();
+            default:
+                return fail(in.line, "bad opcode");
+        }
+    }
+}
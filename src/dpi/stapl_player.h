@@ -0,0 +1,161 @@
+// stapl_player.h
+// STAPL (JESD71) player: bytecode compiler and VM with batched scans
+
+#ifndef STAPL_PLAYER_H
+#define STAPL_PLAYER_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include "jtag_scan_program.h"
+
+// Bytecode operations. Operands a and b are variable, descriptor or code
+// indices; expression operands are taken from the value stack.
+enum StaplOp {
+    STAPL_PUSH,          // a = value
+    STAPL_LOAD,          // a = variable
+    STAPL_LOAD_ELEM,     // a = array; pops index
+    STAPL_LOAD_SLICE,    // a = Boolean array; pops hi, lo (up to 32 bits, lo = LSB)
+    STAPL_STORE,         // a = variable; pops value
+    STAPL_STORE_ELEM,    // a = array; pops index, value
+    STAPL_COPY_SLICE,    // a = dest, b = source; pops dest hi/lo, source hi/lo
+    STAPL_NEG, STAPL_NOT, STAPL_BNOT,
+    STAPL_ADD, STAPL_SUB, STAPL_MUL, STAPL_DIV, STAPL_MOD,
+    STAPL_AND, STAPL_OR, STAPL_XOR, STAPL_SHL, STAPL_SHR,
+    STAPL_EQ, STAPL_NE, STAPL_LT, STAPL_LE, STAPL_GT, STAPL_GE,
+    STAPL_LAND, STAPL_LOR,
+    STAPL_FOR_TEST,      // Pops counter, end, step; pushes whether to continue
+    STAPL_JMP,           // a = target
+    STAPL_JZ,            // a = target; pops condition
+    STAPL_CALL,          // a = target
+    STAPL_RET,
+    STAPL_HALT,
+    STAPL_SCAN,          // a = scan descriptor; pops its operands
+    STAPL_STATE,         // a = TapState
+    STAPL_WAIT,          // a = TapState, b = 1 for microseconds; pops count
+    STAPL_STOP,          // a = 1 for IRSTOP, b = TapState
+    STAPL_PRINT,         // a = print descriptor; pops its expressions
+    STAPL_EXPORT,        // a = print descriptor (key); pops value
+    STAPL_EXIT           // Pops exit code
+};
+
+struct StaplInstr {
+    uint8_t op;
+    int32_t a;
+    int32_t b;
+    int32_t line;
+};
+
+// Scalars use value; arrays use ints (INTEGER) or bits (BOOLEAN, one per byte)
+struct StaplVariable {
+    std::string name;
+    bool boolean;
+    int size;                    // 0 for scalars
+    int32_t value;
+    std::vector<int32_t> ints;
+    std::vector<uint8_t> bits;
+    int pending;                 // Captures not yet collected from the chain
+};
+
+// Array operands push hi and lo, after the scan length, in this order:
+// data, capture, expected, mask. Absent operands are -1.
+struct StaplScanOp {
+    bool ir;
+    int data_var;
+    int capture_var;
+    int expect_var;
+    int mask_var;
+    int result_var;
+};
+
+// Text pieces with an expression after each piece flagged in has_expr
+struct StaplPrintOp {
+    std::vector<std::string> text;
+    std::vector<uint8_t> has_expr;
+};
+
+struct StaplProgram {
+    std::vector<StaplInstr> code;
+    std::vector<StaplVariable> vars;
+    std::vector<StaplScanOp> scans;
+    std::vector<StaplPrintOp> prints;
+    std::map<std::string, int> procedures;   // Entry addresses
+    std::map<std::string, int> actions;      // Entry addresses of the generated call lists
+    int statements;
+
+    StaplProgram() : statements(0) {}
+};
+
+// StaplPlayer class
+// Compiles a STAPL subset once into bytecode, then runs it on a small stack
+// VM. IRSCAN/DRSCAN, STATE and WAIT only append to a ScanProgram; the chain
+// is driven with one djtg_shift_bits call when the script reads a captured
+// variable, prints, exits or the program grows past max_program_bits, so a
+// loop of scans with no data dependency becomes a single bulk transfer.
+//
+// Supported: BOOLEAN/INTEGER scalars and arrays with $hex, #binary or list
+// initializers, LET (element and slice copies), FOR/NEXT with STEP, IF ...
+// THEN, GOTO, labels, PROCEDURE/ENDPROC, CALL, ACTION, IRSCAN/DRSCAN with
+// CAPTURE and COMPARE, IRSTOP/DRSTOP, STATE, WAIT (TCK and USEC), PRINT,
+// EXPORT and EXIT. NOTE, CRC and other statements are skipped. A Boolean
+// slice of up to 32 bits reads as an integer in expressions.
+class StaplPlayer {
+public:
+    int hif;
+    int tck_hz;                  // Converts WAIT ... USEC into TCK cycles
+    int max_program_bits;
+    int32_t exit_code;
+    std::string error;
+    std::vector<std::pair<std::string, int32_t>> exports;
+
+    // Statistics
+    uint64_t instructions;
+    uint64_t scans;
+    uint64_t transfers;
+    uint64_t bits;
+
+    explicit StaplPlayer(int hif);
+
+    // Compile source text; on failure error holds "line N: message"
+    int compile(const std::string& source);
+
+    // Run the top-level statements, then the named ACTION or PROCEDURE
+    // (empty runs the top-level statements only). The TAP starts and ends
+    // in Run-Test/Idle.
+    int run(const std::string& action);
+
+    const StaplProgram& program() const { return prog; }
+
+private:
+    struct PendingCapture {
+        int field;
+        int var;
+        int lo;
+        int length;
+    };
+    struct PendingCompare {
+        int field;
+        int length;
+        int data_offset;         // Expected and mask bits in compare_data
+        int result_var;
+    };
+
+    StaplProgram prog;
+    std::vector<StaplVariable> initial_vars;
+    ScanProgram scan_program;
+    TapState ir_stop;
+    TapState dr_stop;
+    std::vector<uint8_t> tdo;
+    std::vector<uint8_t> packed;
+    std::vector<PendingCapture> captures;
+    std::vector<PendingCompare> compares;
+    std::vector<uint8_t> compare_data;
+
+    int fail(int line, const std::string& message);
+    int flush();
+    int execute_scan(const StaplScanOp& op, std::vector<int32_t>& stack, int line);
+};
+
+#endif // STAPL_PLAYER_H
@@ -23,19 +23,95 @@
 
 
 
+DPI_LINK_DECL DPI_DLLESPEC
+void
+jtag_capture_word(
+    int index,
+    int word);
+
+DPI_LINK_DECL DPI_DLLESPEC
+void
+jtag_expect_chunk(
+    int index,
+    int* tms_w,
+    int* tdi_w,
+    int* expected_w,
+    int* mask_w);
+
+DPI_LINK_DECL DPI_DLLESPEC
+void
+jtag_expect_window_bit(
+    int offset,
+    char tdo_bit);
+
 DPI_LINK_DECL DPI_DLLESPEC
 int
 run_counter_jtag_tests();
 
+DPI_LINK_DECL DPI_DLLESPEC
+int
+run_tap_session(
+    int tap);
+
 DPI_LINK_DECL int
 sv_drive_jtag_pins(
     char tck_val,
     char tms_val,
     char tdi_val);
 
+DPI_LINK_DECL int
+sv_drive_jtag_pins_idx(
+    int tap,
+    char tck_val,
+    char tms_val,
+    char tdi_val);
+
+DPI_LINK_DECL int
+sv_get_tap_count();
+
 DPI_LINK_DECL char
 sv_get_tdo();
 
+DPI_LINK_DECL char
+sv_get_tdo_idx(
+    int tap);
+
+DPI_LINK_DECL int64_t
+sv_get_time_ps();
+
+DPI_LINK_DECL int
+sv_jtag_clock(
+    char tms_in,
+    char tdi_in,
+    int count);
+
+DPI_LINK_DECL int
+sv_jtag_clock_idx(
+    int tap,
+    char tms_in,
+    char tdi_in,
+    int count);
+
+DPI_LINK_DECL int
+sv_jtag_run(
+    char tms_in,
+    char tdi_in,
+    int count,
+    char sample_tdo);
+
+DPI_LINK_DECL int
+sv_jtag_shift_capture(
+    int cbit);
+
+DPI_LINK_DECL int
+sv_jtag_shift_expect(
+    int cbit,
+    char abort_on_mismatch,
+    int window_bits,
+    int* first_mismatch,
+    int* mismatches,
+    int* steps);
+
 DPI_LINK_DECL int
 sv_jtag_step(
     char tms_in,
@@ -43,6 +119,14 @@ sv_jtag_step(
     char is_last,
     char* tdo_out);
 
+DPI_LINK_DECL int
+sv_jtag_step_idx(
+    int tap,
+    char tms_in,
+    char tdi_in,
+    char is_last,
+    char* tdo_out);
+
 DPI_LINK_DECL int
 sv_wait_cycles(
     int cycles);
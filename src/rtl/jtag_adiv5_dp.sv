@@ -0,0 +1,213 @@
+// jtag_adiv5_dp.sv
+// ARM ADIv5 JTAG Debug Port with a MEM-AP over an internal RAM
+//
+// ABORT, DPACC and APACC share one 35-bit scan chain:
+// - shifted in:  {DATAIN[31:0], A[3:2], RnW}, LSB first
+// - captured:    {ReadResult[31:0], ACK[2:0]}
+//
+// Read results are returned one transaction behind: the scan after a read
+// captures its data. An AP access takes AP_BUSY_CYCLES TCK edges; a DPACC or
+// APACC Capture-DR while it is still running returns ACK = WAIT and the
+// request shifted in by that scan is dropped, so the debugger must repeat it.
+// DP registers: CTRL/STAT (power-up handshake, STICKYERR), SELECT (APSEL,
+// APBANKSEL) and RDBUFF. MEM-AP (APSEL 0): CSW, TAR, DRW, BD0-BD3 and IDR,
+// 32-bit accesses only, TAR auto-increment wrapping at 1KB boundaries.
+
+module jtag_adiv5_dp #(
+    parameter AP_BUSY_CYCLES = 3,        // TCK edges an AP access takes
+    parameter MEM_WORDS = 1024,          // MEM-AP RAM size (32-bit words)
+    parameter AP_IDR = 32'h24770011      // MEM-AP identification register
+) (
+    input  logic tck,
+    input  logic reset_n,                // TAP reset (TRST or Test-Logic-Reset)
+    input  logic dap_reset_n,            // DP/AP register reset (system reset)
+    input  logic capture_dr,
+    input  logic shift_dr,
+    input  logic update_dr,
+    input  logic select_abort,
+    input  logic select_dpacc,
+    input  logic select_apacc,
+    input  logic tdi,
+    output logic tdo
+);
+
+    localparam MEM_ABITS = $clog2(MEM_WORDS);
+
+    // Acknowledge codes
+    localparam [2:0] ACK_OK_FAULT = 3'b010;
+    localparam [2:0] ACK_WAIT     = 3'b001;
+
+    // DP register addresses (A[3:2])
+    localparam [1:0] DP_CTRL_STAT = 2'd1;
+    localparam [1:0] DP_SELECT    = 2'd2;
+    localparam [1:0] DP_RDBUFF    = 2'd3;
+
+    // MEM-AP register addresses
+    localparam [7:0] AP_CSW = 8'h00;
+    localparam [7:0] AP_TAR = 8'h04;
+    localparam [7:0] AP_DRW = 8'h0C;
+    localparam [7:0] AP_IDR = 8'hFC;
+
+    // Scan chain and transaction state
+    logic [34:0] access_shift;
+    logic [7:0] busy_count;              // Remaining TCK edges of the AP access
+    logic wait_pending;                  // Last capture answered WAIT
+
+    // DP registers
+    logic cdbgpwrupreq, csyspwrupreq, stickyerr;
+    logic [31:0] select_reg;
+    logic [31:0] read_result;
+
+    // MEM-AP registers
+    logic [1:0] csw_addrinc;
+    logic [31:0] tar;
+    logic [31:0] mem [0:MEM_WORDS-1];
+
+    initial begin
+        for (int i = 0; i < MEM_WORDS; i++) begin
+            mem[i] = 32'h0;
+        end
+    end
+
+    // Request decode. A request is dropped when its own capture said WAIT.
+    logic req_rnw;
+    logic [1:0] req_a;
+    logic [31:0] req_data;
+    logic dp_req, ap_req;
+    logic [7:0] ap_addr;
+    logic [31:0] mem_addr;
+    logic mem_access, mem_in_range, ap_enabled;
+
+    assign req_rnw  = access_shift[0];
+    assign req_a    = access_shift[2:1];
+    assign req_data = access_shift[34:3];
+    assign dp_req   = update_dr & select_dpacc & ~wait_pending;
+    assign ap_req   = update_dr & select_apacc & ~wait_pending;
+
+    assign ap_addr    = {select_reg[7:4], req_a, 2'b00};
+    assign ap_enabled = cdbgpwrupreq & ~stickyerr & (select_reg[31:24] == 8'h00);
+    // DRW goes through TAR; BD0-BD3 address the 16-byte block TAR points into
+    assign mem_access = (ap_addr == AP_DRW) | (ap_addr[7:4] == 4'h1);
+    assign mem_addr   = (ap_addr == AP_DRW) ? tar : {tar[31:4], ap_addr[3:0]};
+    assign mem_in_range = (mem_addr[31:2] < MEM_WORDS);
+
+    // Scan chain, ACK and WAIT tracking
+    always_ff @(posedge tck or negedge reset_n) begin
+        if (!reset_n) begin
+            access_shift <= 35'h0;
+            busy_count   <= 8'h0;
+            wait_pending <= 1'b0;
+        end else begin
+            if (busy_count != 0) begin
+                busy_count <= busy_count - 1;
+            end
+
+            if (capture_dr & (select_dpacc | select_apacc | select_abort)) begin
+                if (busy_count != 0) begin
+                    access_shift <= {32'h0, ACK_WAIT};
+                    wait_pending <= 1'b1;
+                end else begin
+                    access_shift <= {read_result, ACK_OK_FAULT};
+                    wait_pending <= 1'b0;
+                end
+            end else if (shift_dr & (select_dpacc | select_apacc | select_abort)) begin
+                access_shift <= {tdi, access_shift[34:1]};
+            end else if (update_dr & select_abort) begin
+                if (access_shift[3]) begin
+                    busy_count   <= 8'h0;        // DAPABORT
+                    wait_pending <= 1'b0;
+                end
+            end else if (ap_req) begin
+                busy_count <= AP_BUSY_CYCLES;
+            end
+        end
+    end
+
+    assign tdo = access_shift[0];
+
+    // MEM-AP RAM write (a plain always block, since the initial block above
+    // also assigns mem)
+    always @(posedge tck) begin
+        if (dap_reset_n && ap_req && !req_rnw && ap_enabled && mem_access && mem_in_range) begin
+            mem[mem_addr[MEM_ABITS+1:2]] <= req_data;
+        end
+    end
+
+    // DP and AP registers, accessed on the Update-DR edge
+    always_ff @(posedge tck or negedge dap_reset_n) begin
+        if (!dap_reset_n) begin
+            cdbgpwrupreq <= 1'b0;
+            csyspwrupreq <= 1'b0;
+            stickyerr    <= 1'b0;
+            select_reg   <= 32'h0;
+            read_result  <= 32'h0;
+            csw_addrinc  <= 2'b00;
+            tar          <= 32'h0;
+        end else if (update_dr & select_abort) begin
+            if (access_shift[5]) begin
+                stickyerr <= 1'b0;           // STKERRCLR
+            end
+        end else if (dp_req) begin
+            if (req_rnw) begin
+                case (req_a)
+                    DP_CTRL_STAT: read_result <= {csyspwrupreq, csyspwrupreq, cdbgpwrupreq, cdbgpwrupreq,
+                                                  22'h0, stickyerr, 5'h0};
+                    DP_SELECT:    read_result <= select_reg;
+                    DP_RDBUFF:    read_result <= read_result;
+                    default:      read_result <= 32'h0;
+                endcase
+            end else begin
+                case (req_a)
+                    DP_CTRL_STAT: begin
+                        cdbgpwrupreq <= req_data[28];
+                        csyspwrupreq <= req_data[30];
+                        if (req_data[5]) begin
+                            stickyerr <= 1'b0;
+                        end
+                    end
+                    DP_SELECT:    select_reg <= req_data;
+                    default: ;
+                endcase
+            end
+        end else if (ap_req) begin
+            if (!ap_enabled) begin
+                // Powered down, other APSEL or sticky error: the access is
+                // discarded, and an access while powered down sets STICKYERR
+                if (!stickyerr) begin
+                    stickyerr <= ~cdbgpwrupreq;
+                end
+                if (req_rnw) begin
+                    read_result <= 32'h0;
+                end
+            end else if (mem_access) begin
+                if (!mem_in_range) begin
+                    stickyerr <= 1'b1;
+                    if (req_rnw) begin
+                        read_result <= 32'h0;
+                    end
+                end else begin
+                    if (req_rnw) begin
+                        read_result <= mem[mem_addr[MEM_ABITS+1:2]];
+                    end
+                    if (ap_addr == AP_DRW && csw_addrinc == 2'b01) begin
+                        tar <= {tar[31:10], tar[9:0] + 10'd4};
+                    end
+                end
+            end else if (req_rnw) begin
+                case (ap_addr)
+                    AP_CSW:  read_result <= {25'h0, 1'b1, csw_addrinc, 1'b0, 3'b010};
+                    AP_TAR:  read_result <= tar;
+                    AP_IDR:  read_result <= AP_IDR;
+                    default: read_result <= 32'h0;
+                endcase
+            end else begin
+                case (ap_addr)
+                    AP_CSW:  csw_addrinc <= req_data[5:4];
+                    AP_TAR:  tar <= req_data;
+                    default: ;
+                endcase
+            end
+        end
+    end
+
+endmodule
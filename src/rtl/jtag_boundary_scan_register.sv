@@ -1,5 +1,6 @@
 // jtag_boundary_scan_register.sv
 // Boundary scan register implementation for up_down_counter_loop
+// plus four boundary-only cells for an external SPI flash
 
 module jtag_boundary_scan_register #(
     parameter N = 4  // Counter width - matches up_down_counter_loop
@@ -19,6 +20,12 @@ module jtag_boundary_scan_register #(
     output logic [N-1:0] count_pin,      // To external pins
     output logic [N-1:0] count_oe,       // Output enable control
     
+    // SPI flash pins (no core logic behind them; idle in normal mode)
+    output logic spi_cs_n_pin,
+    output logic spi_sck_pin,
+    output logic spi_mosi_pin,
+    input  logic spi_miso_pin,
+    
     // Control signals
     input  logic boundary_scan_mode      // 1 = boundary scan, 0 = normal operation
 );
@@ -26,8 +33,9 @@ module jtag_boundary_scan_register #(
     // Boundary scan register width calculation:
     // - up_down input: 1 cell
     // - count outputs: 2 cells each (data + enable) = 2*N cells  
-    // Total: 1 + 2*N cells
-    localparam BSR_WIDTH = 1 + (2 * N);
+    // - SPI flash: cs_n, sck, mosi outputs and miso input = 4 cells
+    // Total: 1 + 2*N + 4 cells
+    localparam BSR_WIDTH = 1 + (2 * N) + 4;
     
     // Boundary scan register
     logic [BSR_WIDTH-1:0] scan_register;
@@ -42,6 +50,12 @@ module jtag_boundary_scan_register #(
     
     // Cells N+1 to 2*N: count output enable cells
     localparam COUNT_ENABLE_START = 1 + N;
+    
+    // Cells 2*N+1 to 2*N+4: SPI flash pins
+    localparam SPI_CS_N_CELL = 1 + (2 * N);
+    localparam SPI_SCK_CELL  = SPI_CS_N_CELL + 1;
+    localparam SPI_MOSI_CELL = SPI_CS_N_CELL + 2;
+    localparam SPI_MISO_CELL = SPI_CS_N_CELL + 3;
 
     // Boundary scan register shift operation
     always_ff @(posedge tck or negedge reset_n) begin
@@ -61,6 +75,12 @@ module jtag_boundary_scan_register #(
             for (int i = 0; i < N; i++) begin
                 scan_register[COUNT_ENABLE_START + i] <= 1'b1;
             end
+            
+            // Capture the driven SPI outputs and the flash's MISO
+            scan_register[SPI_CS_N_CELL] <= spi_cs_n_pin;
+            scan_register[SPI_SCK_CELL]  <= spi_sck_pin;
+            scan_register[SPI_MOSI_CELL] <= spi_mosi_pin;
+            scan_register[SPI_MISO_CELL] <= spi_miso_pin;
         end else if (shift_dr) begin
             // Shift operation: TDI -> scan_register -> TDO (MSB-first)
             scan_register <= {tdi, scan_register[BSR_WIDTH-1:1]};
@@ -73,6 +93,7 @@ module jtag_boundary_scan_register #(
             // Initialize with default pattern: all zeros with output enables active
             update_register <= '0;
             update_register[COUNT_ENABLE_START +: N] <= {N{1'b1}};  // Set all enable bits to 1
+            update_register[SPI_CS_N_CELL] <= 1'b1;                  // Flash deselected
         end else if (update_dr) begin
             update_register <= scan_register;
             // $display("Time=%0t: BSR_UPDATE - scan_reg=%09b, new_update_reg=%09b", $time, scan_register, scan_register);
@@ -97,11 +118,20 @@ module jtag_boundary_scan_register #(
                 count_pin[i] = update_register[COUNT_DATA_START + i];
                 count_oe[i]  = update_register[COUNT_ENABLE_START + i];
             end
+            
+            spi_cs_n_pin = update_register[SPI_CS_N_CELL];
+            spi_sck_pin  = update_register[SPI_SCK_CELL];
+            spi_mosi_pin = update_register[SPI_MOSI_CELL];
         end else begin
             // Normal operation mode - pass through core signals
             up_down_pin = up_down_core;
             count_pin   = count_core;
             count_oe    = '1;  // Always drive in normal mode
+            
+            // No SPI master in the core: flash deselected, bus idle
+            spi_cs_n_pin = 1'b1;
+            spi_sck_pin  = 1'b0;
+            spi_mosi_pin = 1'b0;
         end
     end
 
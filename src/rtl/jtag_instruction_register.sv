@@ -21,7 +21,12 @@ module jtag_instruction_register #(
     output logic select_idcode, 
     output logic select_sample_preload,
     output logic select_extest,
-    output logic select_boundary_scan
+    output logic select_boundary_scan,
+    output logic select_dtmcs,
+    output logic select_dmi,
+    output logic select_abort,
+    output logic select_dpacc,
+    output logic select_apacc
 );
 
     // Standard IEEE 1149.1 instructions (4-bit encoding)
@@ -30,6 +35,14 @@ module jtag_instruction_register #(
     localparam [IR_WIDTH-1:0] SAMPLE        = 4'b0010;  // Sample/Preload
     localparam [IR_WIDTH-1:0] PRELOAD       = 4'b0010;  // Same as SAMPLE
     localparam [IR_WIDTH-1:0] EXTEST        = 4'b0000;  // External test
+    // RISC-V debug transport (jtag_riscv_dtm.sv)
+    localparam [IR_WIDTH-1:0] DTMCS         = 4'b0110;  // DTM control and status
+    localparam [IR_WIDTH-1:0] DMI           = 4'b0111;  // Debug module interface access
+    // ARM ADIv5 JTAG-DP (jtag_adiv5_dp.sv)
+    localparam [IR_WIDTH-1:0] ABORT         = 4'b1000;  // DP abort register
+    localparam [IR_WIDTH-1:0] DPACC         = 4'b1010;  // Debug port access
+    localparam [IR_WIDTH-1:0] APACC         = 4'b1011;  // Access port access
+    localparam [IR_WIDTH-1:0] IDCODE_DP     = 4'b1110;  // JTAG-DP IDCODE encoding
     
     // Instruction register shift chain
     logic [IR_WIDTH-1:0] shift_register;
@@ -82,6 +95,11 @@ module jtag_instruction_register #(
         select_sample_preload = 1'b0;
         select_extest         = 1'b0;
         select_boundary_scan  = 1'b0;
+        select_dtmcs          = 1'b0;
+        select_dmi            = 1'b0;
+        select_abort          = 1'b0;
+        select_dpacc          = 1'b0;
+        select_apacc          = 1'b0;
         
         case (instruction_reg)
             BYPASS: begin
@@ -89,7 +107,7 @@ module jtag_instruction_register #(
                 $display("Time=%0t: BYPASS selected - instruction_reg=%h", $time, instruction_reg);
             end
             
-            IDCODE: begin
+            IDCODE, IDCODE_DP: begin
                 select_idcode = 1'b1;
             end
             
@@ -103,6 +121,26 @@ module jtag_instruction_register #(
                 select_boundary_scan = 1'b1;
             end
             
+            DTMCS: begin
+                select_dtmcs = 1'b1;
+            end
+            
+            DMI: begin
+                select_dmi = 1'b1;
+            end
+            
+            ABORT: begin
+                select_abort = 1'b1;
+            end
+            
+            DPACC: begin
+                select_dpacc = 1'b1;
+            end
+            
+            APACC: begin
+                select_apacc = 1'b1;
+            end
+            
             default: begin
                 // Unknown instruction defaults to BYPASS
                 select_bypass = 1'b1;
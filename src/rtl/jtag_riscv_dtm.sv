@@ -0,0 +1,209 @@
+// jtag_riscv_dtm.sv
+// RISC-V Debug Transport Module (JTAG DTM) with a minimal Debug Module
+//
+// Implements the two debug-spec TDRs behind the TAP:
+// - dtmcs: version (1 = 0.13), abits, dmistat, idle hint, dmireset and
+//   dmihardreset
+// - dmi:   {address[ABITS-1:0], data[31:0], op[1:0]}, LSB first
+//
+// A DMI read or write starts at Update-DR and stays in progress for
+// BUSY_CYCLES TCK edges. A Capture-DR while it is still in progress reports
+// busy (op = 3) and makes the error sticky: later operations are ignored
+// until the debugger writes dtmcs.dmireset. The debug module behind it has
+// data0/data1, dmcontrol, dmstatus, abstractcs and a System Bus Access block
+// (sbcs, sbaddress0, sbdata0) in front of a small word-addressed memory.
+
+module jtag_riscv_dtm #(
+    parameter ABITS = 7,
+    parameter BUSY_CYCLES = 4,       // TCK edges a DMI operation takes
+    parameter IDLE_HINT = 2,         // dtmcs.idle
+    parameter MEM_WORDS = 256        // System bus memory size (32-bit words)
+) (
+    input  logic tck,
+    input  logic reset_n,            // TAP reset (TRST or Test-Logic-Reset)
+    input  logic dm_reset_n,         // Debug module reset (system reset)
+    input  logic capture_dr,
+    input  logic shift_dr,
+    input  logic update_dr,
+    input  logic select_dtmcs,
+    input  logic select_dmi,
+    input  logic tdi,
+    output logic tdo
+);
+
+    localparam DMI_WIDTH = ABITS + 34;
+    localparam MEM_ABITS = $clog2(MEM_WORDS);
+
+    // DMI op field: request encodings and response status
+    localparam [1:0] OP_NOP     = 2'd0;
+    localparam [1:0] OP_READ    = 2'd1;
+    localparam [1:0] OP_WRITE   = 2'd2;
+    localparam [1:0] OP_SUCCESS = 2'd0;
+    localparam [1:0] OP_FAILED  = 2'd2;
+    localparam [1:0] OP_BUSY    = 2'd3;
+
+    // Debug module register addresses
+    localparam [ABITS-1:0] DM_DATA0      = 7'h04;
+    localparam [ABITS-1:0] DM_DATA1      = 7'h05;
+    localparam [ABITS-1:0] DM_DMCONTROL  = 7'h10;
+    localparam [ABITS-1:0] DM_DMSTATUS   = 7'h11;
+    localparam [ABITS-1:0] DM_ABSTRACTCS = 7'h16;
+    localparam [ABITS-1:0] DM_SBCS       = 7'h38;
+    localparam [ABITS-1:0] DM_SBADDRESS0 = 7'h39;
+    localparam [ABITS-1:0] DM_SBDATA0    = 7'h3C;
+
+    // DTM registers
+    logic [31:0] dtmcs_shift;
+    logic [DMI_WIDTH-1:0] dmi_shift;
+    logic [1:0] dmistat;             // Sticky error, cleared by dmireset
+    logic [7:0] busy_count;          // Remaining TCK edges of the current op
+    logic [ABITS-1:0] last_addr;
+
+    // Debug module state
+    logic [31:0] data0, data1, dmcontrol;
+    logic sb_readonaddr, sb_autoincrement, sb_readondata;
+    logic [2:0] sb_error;
+    logic [31:0] sbaddress0, sbdata0;
+    logic [31:0] dm_rdata;           // Result of the last DMI read
+    logic [31:0] mem [0:MEM_WORDS-1];
+
+    initial begin
+        for (int i = 0; i < MEM_WORDS; i++) begin
+            mem[i] = 32'h0;
+        end
+    end
+
+    // A request reaches the debug module only when nothing is in progress
+    // and no error is pending
+    logic [ABITS-1:0] req_addr;
+    logic [31:0] req_data;
+    logic [1:0] req_op;
+    logic dm_req;
+
+    assign req_op   = dmi_shift[1:0];
+    assign req_data = dmi_shift[33:2];
+    assign req_addr = dmi_shift[DMI_WIDTH-1:34];
+    assign dm_req   = update_dr & select_dmi & (dmistat == OP_SUCCESS) & (busy_count == 0) &
+                      (req_op == OP_READ || req_op == OP_WRITE);
+
+    // dtmcs and dmi shift registers
+    always_ff @(posedge tck or negedge reset_n) begin
+        if (!reset_n) begin
+            dtmcs_shift <= 32'h0;
+            dmi_shift   <= '0;
+            dmistat     <= OP_SUCCESS;
+            busy_count  <= 8'h0;
+            last_addr   <= '0;
+        end else begin
+            if (busy_count != 0) begin
+                busy_count <= busy_count - 1;
+            end
+
+            if (capture_dr & select_dtmcs) begin
+                dtmcs_shift <= {14'b0, 2'b00, 1'b0, 3'(IDLE_HINT), dmistat, 6'(ABITS), 4'd1};
+            end else if (shift_dr & select_dtmcs) begin
+                dtmcs_shift <= {tdi, dtmcs_shift[31:1]};
+            end else if (update_dr & select_dtmcs) begin
+                if (dtmcs_shift[16] | dtmcs_shift[17]) begin
+                    dmistat <= OP_SUCCESS;       // dmireset / dmihardreset
+                end
+                if (dtmcs_shift[17]) begin
+                    busy_count <= 8'h0;          // dmihardreset cancels the op
+                end
+            end
+
+            if (capture_dr & select_dmi) begin
+                if (busy_count != 0) begin
+                    dmistat   <= OP_BUSY;
+                    dmi_shift <= {last_addr, dm_rdata, OP_BUSY};
+                end else begin
+                    dmi_shift <= {last_addr, dm_rdata, dmistat};
+                end
+            end else if (shift_dr & select_dmi) begin
+                dmi_shift <= {tdi, dmi_shift[DMI_WIDTH-1:1]};
+            end else if (update_dr & select_dmi) begin
+                if (dm_req) begin
+                    busy_count <= BUSY_CYCLES;
+                    last_addr  <= req_addr;
+                end else if (busy_count != 0 && req_op != OP_NOP) begin
+                    dmistat <= OP_BUSY;
+                end
+            end
+        end
+    end
+
+    assign tdo = select_dtmcs ? dtmcs_shift[0] : dmi_shift[0];
+
+    // System bus memory write (a plain always block, since the initial
+    // block above also assigns mem)
+    always @(posedge tck) begin
+        if (dm_reset_n && dm_req && req_op == OP_WRITE && req_addr == DM_SBDATA0) begin
+            mem[sbaddress0[MEM_ABITS+1:2]] <= req_data;
+        end
+    end
+
+    // Debug module: performs the access on the Update-DR edge
+    always_ff @(posedge tck or negedge dm_reset_n) begin
+        if (!dm_reset_n) begin
+            data0            <= 32'h0;
+            data1            <= 32'h0;
+            dmcontrol        <= 32'h0;
+            sb_readonaddr    <= 1'b0;
+            sb_autoincrement <= 1'b0;
+            sb_readondata    <= 1'b0;
+            sb_error         <= 3'h0;
+            sbaddress0       <= 32'h0;
+            sbdata0          <= 32'h0;
+            dm_rdata         <= 32'h0;
+        end else if (dm_req && req_op == OP_WRITE) begin
+            case (req_addr)
+                DM_DATA0:     data0 <= req_data;
+                DM_DATA1:     data1 <= req_data;
+                DM_DMCONTROL: dmcontrol <= req_data;
+                DM_SBCS: begin
+                    sb_readonaddr    <= req_data[20];
+                    sb_autoincrement <= req_data[16];
+                    sb_readondata    <= req_data[15];
+                    sb_error         <= sb_error & ~req_data[14:12];   // W1C
+                end
+                DM_SBADDRESS0: begin
+                    if (sb_readonaddr) begin
+                        sbdata0    <= mem[req_data[MEM_ABITS+1:2]];
+                        sbaddress0 <= sb_autoincrement ? req_data + 32'd4 : req_data;
+                    end else begin
+                        sbaddress0 <= req_data;
+                    end
+                end
+                DM_SBDATA0: begin
+                    sbdata0 <= req_data;
+                    if (sb_autoincrement) begin
+                        sbaddress0 <= sbaddress0 + 32'd4;
+                    end
+                end
+                default: ;
+            endcase
+        end else if (dm_req && req_op == OP_READ) begin
+            case (req_addr)
+                DM_DATA0:      dm_rdata <= data0;
+                DM_DATA1:      dm_rdata <= data1;
+                DM_DMCONTROL:  dm_rdata <= dmcontrol;
+                DM_DMSTATUS:   dm_rdata <= 32'h0000_0082;   // authenticated, version 0.13
+                DM_ABSTRACTCS: dm_rdata <= 32'h0000_0002;   // datacount = 2
+                DM_SBCS:       dm_rdata <= {3'd1, 8'b0, sb_readonaddr, 3'd2, sb_autoincrement,
+                                            sb_readondata, sb_error, 7'd32, 5'b00100};
+                DM_SBADDRESS0: dm_rdata <= sbaddress0;
+                DM_SBDATA0: begin
+                    dm_rdata <= sbdata0;
+                    if (sb_readondata) begin
+                        sbdata0 <= mem[sbaddress0[MEM_ABITS+1:2]];
+                        if (sb_autoincrement) begin
+                            sbaddress0 <= sbaddress0 + 32'd4;
+                        end
+                    end
+                end
+                default:       dm_rdata <= 32'h0;
+            endcase
+        end
+    end
+
+endmodule
@@ -5,15 +5,22 @@
 // boundary scan capabilities for testing an up-down counter. It includes:
 // - TAP state machine for JTAG protocol compliance
 // - Instruction register for command decoding
-// - Boundary scan register for pin testing
+// - Boundary scan register for pin testing, including the pins of an
+//   external SPI flash
 // - IDCODE register for device identification
 // - BYPASS register for minimal delay path
+// - RISC-V debug transport module (dtmcs/dmi) with a minimal debug module
+// - ARM ADIv5 JTAG-DP with a MEM-AP over an internal RAM
 // - Integration with the up_down_counter_loop DUT
 //
 // The module supports standard JTAG instructions:
 // - IDCODE (0x1): Device identification
 // - SAMPLE (0x2): Capture current pin states
 // - EXTEST (0x3): Drive pins for external testing
+// - DTMCS (0x6): RISC-V DTM control and status
+// - DMI (0x7): RISC-V debug module interface access
+// - ABORT (0x8), DPACC (0xA), APACC (0xB): ADIv5 JTAG-DP access
+// - IDCODE (0xE): JTAG-DP encoding of IDCODE
 // - BYPASS (0xF): 1-bit bypass register
 
 module jtag_top #(
@@ -35,7 +42,13 @@ module jtag_top #(
     // External interface (after boundary scan)  
     inout  logic up_down_ext,           // Bidirectional: input in normal mode, output in EXTEST
     output logic [N-1:0] count_ext,
-    output logic [N-1:0] count_oe_ext
+    output logic [N-1:0] count_oe_ext,
+    
+    // SPI flash pins, driven only through boundary scan (EXTEST)
+    output logic spi_cs_n,
+    output logic spi_sck,
+    output logic spi_mosi,
+    input  logic spi_miso
 );
 
     // TAP Controller signals
@@ -48,9 +61,11 @@ module jtag_top #(
     logic [3:0] instruction;
     logic ir_tdo;
     logic select_bypass, select_idcode, select_sample_preload, select_extest, select_boundary_scan;
+    logic select_dtmcs, select_dmi;
+    logic select_abort, select_dpacc, select_apacc;
     
     // Test Data Register signals
-    logic bypass_tdo, idcode_tdo, bsr_tdo;
+    logic bypass_tdo, idcode_tdo, bsr_tdo, dtm_tdo, dap_tdo;
     logic boundary_scan_mode;
     
     // Core logic signals (internal)
@@ -105,7 +120,12 @@ module jtag_top #(
         .select_idcode(select_idcode),
         .select_sample_preload(select_sample_preload),
         .select_extest(select_extest),
-        .select_boundary_scan(select_boundary_scan)
+        .select_boundary_scan(select_boundary_scan),
+        .select_dtmcs(select_dtmcs),
+        .select_dmi(select_dmi),
+        .select_abort(select_abort),
+        .select_dpacc(select_dpacc),
+        .select_apacc(select_apacc)
     );
 
     // Boundary scan mode control
@@ -127,6 +147,10 @@ module jtag_top #(
         .count_core(count_core),
         .count_pin(count_pin),
         .count_oe(count_oe),
+        .spi_cs_n_pin(spi_cs_n),
+        .spi_sck_pin(spi_sck),
+        .spi_mosi_pin(spi_mosi),
+        .spi_miso_pin(spi_miso),
         .boundary_scan_mode(boundary_scan_mode)
     );
 
@@ -159,6 +183,35 @@ module jtag_top #(
     // Bypass register outputs the previous value (1-cycle delay)
     assign bypass_tdo = bypass_reg;
 
+    // Instantiate RISC-V Debug Transport Module
+    jtag_riscv_dtm riscv_dtm (
+        .tck(tck),
+        .reset_n(tap_reset_n),
+        .dm_reset_n(sys_reset_n),
+        .capture_dr(capture_dr),
+        .shift_dr(shift_dr),
+        .update_dr(update_dr),
+        .select_dtmcs(select_dtmcs),
+        .select_dmi(select_dmi),
+        .tdi(tdi),
+        .tdo(dtm_tdo)
+    );
+
+    // Instantiate ADIv5 JTAG Debug Port
+    jtag_adiv5_dp adiv5_dp (
+        .tck(tck),
+        .reset_n(tap_reset_n),
+        .dap_reset_n(sys_reset_n),
+        .capture_dr(capture_dr),
+        .shift_dr(shift_dr),
+        .update_dr(update_dr),
+        .select_abort(select_abort),
+        .select_dpacc(select_dpacc),
+        .select_apacc(select_apacc),
+        .tdi(tdi),
+        .tdo(dap_tdo)
+    );
+
     // TDO Multiplexer
     always_comb begin
         if (shift_ir) begin
@@ -167,6 +220,10 @@ module jtag_top #(
             selected_tdo = bsr_tdo;
         end else if (select_idcode) begin
             selected_tdo = idcode_tdo;
+        end else if (select_dtmcs | select_dmi) begin
+            selected_tdo = dtm_tdo;
+        end else if (select_abort | select_dpacc | select_apacc) begin
+            selected_tdo = dap_tdo;
         end else if (select_bypass) begin
             selected_tdo = bypass_tdo;
         end else begin
@@ -6,6 +6,8 @@
 // - Clock generation for both system and JTAG domains
 // - DPI-C integration for C++ based test execution
 // - Reset sequences
+// - A behavioral SPI flash on the boundary-scan-only pins
+// - Additional independent jtag_top instances for concurrent sessions
 //
 // The testbench instantiates the jtag_top module and provides the necessary
 // infrastructure for running the complete JTAG test suite via DPI-C.
@@ -31,8 +33,13 @@ module jtag_testbench;
     wire [3:0] count_ext;               // External count output
     wire [3:0] count_oe_ext;            // External count output enable
     
+    // SPI flash on the boundary-scan-only pins
+    wire spi_cs_n, spi_sck, spi_mosi, spi_miso;
+    
     // Pull-up for up_down_ext to ensure it's not floating
     pullup(up_down_ext);
+    // MISO floats while the flash is deselected
+    pullup(spi_miso);
     
     // JTAG top-level instance
     jtag_top dut (
@@ -45,9 +52,72 @@ module jtag_testbench;
         .trst_n(trst_n),
         .up_down_ext(up_down_ext),
         .count_ext(count_ext),
-        .count_oe_ext(count_oe_ext)
+        .count_oe_ext(count_oe_ext),
+        .spi_cs_n(spi_cs_n),
+        .spi_sck(spi_sck),
+        .spi_mosi(spi_mosi),
+        .spi_miso(spi_miso)
+    );
+    
+    spi_flash_model flash (
+        .cs_n(spi_cs_n),
+        .sck(spi_sck),
+        .mosi(spi_mosi),
+        .miso(spi_miso)
     );
     
+    // Additional TAP instances 1..NUM_TAPS-1, each with its own JTAG pins,
+    // SPI flash and IDCODE version (DEVICE_ID + (i << 28)). Instance 0 is
+    // dut above. The C++ side maps HIFs to instances and drives them through
+    // the *_idx exports.
+    localparam int NUM_TAPS = 4;
+    logic tck_x [1:NUM_TAPS-1];
+    logic tms_x [1:NUM_TAPS-1];
+    logic tdi_x [1:NUM_TAPS-1];
+    wire  tdo_x [1:NUM_TAPS-1];
+    
+    initial begin
+        for (int i = 1; i < NUM_TAPS; i++) begin
+            tck_x[i] = 0;
+            tms_x[i] = 0;
+            tdi_x[i] = 0;
+        end
+    end
+    
+    generate
+        for (genvar i = 1; i < NUM_TAPS; i++) begin : tap
+            wire up_down_x;
+            wire [3:0] count_x, count_oe_x;
+            wire cs_n_x, sck_x, mosi_x, miso_x;
+            pullup(up_down_x);
+            pullup(miso_x);
+            
+            jtag_top #(.DEVICE_ID(32'h12345678 + (i << 28))) dut_x (
+                .sys_clk(sys_clk),
+                .sys_reset_n(sys_reset_n),
+                .tck(tck_x[i]),
+                .tms(tms_x[i]),
+                .tdi(tdi_x[i]),
+                .tdo(tdo_x[i]),
+                .trst_n(trst_n),
+                .up_down_ext(up_down_x),
+                .count_ext(count_x),
+                .count_oe_ext(count_oe_x),
+                .spi_cs_n(cs_n_x),
+                .spi_sck(sck_x),
+                .spi_mosi(mosi_x),
+                .spi_miso(miso_x)
+            );
+            
+            spi_flash_model flash_x (
+                .cs_n(cs_n_x),
+                .sck(sck_x),
+                .mosi(mosi_x),
+                .miso(miso_x)
+            );
+        end
+    endgenerate
+    
     // Test stimulus
     initial begin
         $display("Starting simulation...");
@@ -67,6 +137,18 @@ module jtag_testbench;
         run_counter_jtag_tests();
         $display("Returned from run_counter_jtag_tests at time %0t", $time);
         
+        // One session per additional instance, all running concurrently.
+        // Instance 0 stays with the main suite: its bulk-transfer callbacks
+        // carry no instance index, so it must only have one session at a time.
+        for (int i = 1; i < NUM_TAPS; i++) begin
+            fork
+                automatic int t = i;
+                run_tap_session(t);
+            join_none
+        end
+        wait fork;
+        $display("TAP sessions completed at time %0t", $time);
+        
         // Wait a bit more
         #1000;
         
@@ -76,12 +158,27 @@ module jtag_testbench;
     
     // Import the test function
     import "DPI-C" context task run_counter_jtag_tests();
+    import "DPI-C" context task run_tap_session(input int tap);
+    import "DPI-C" function void jtag_expect_chunk(input int index, output int tms_w, output int tdi_w,
+                                                   output int expected_w, output int mask_w);
+    import "DPI-C" function void jtag_expect_window_bit(input int offset, input byte tdo_bit);
+    import "DPI-C" function void jtag_capture_word(input int index, input int word);
 
     // Exported helpers for C++ to drive and sample pins
     export "DPI-C" task sv_wait_cycles;
     export "DPI-C" function sv_get_tdo;
     export "DPI-C" task sv_drive_jtag_pins;
     export "DPI-C" task sv_jtag_step;
+    export "DPI-C" task sv_jtag_clock;
+    export "DPI-C" task sv_jtag_shift_expect;
+    export "DPI-C" task sv_jtag_shift_capture;
+    export "DPI-C" task sv_jtag_run;
+    export "DPI-C" function sv_get_time_ps;
+    export "DPI-C" function sv_get_tap_count;
+    export "DPI-C" function sv_get_tdo_idx;
+    export "DPI-C" task sv_drive_jtag_pins_idx;
+    export "DPI-C" task sv_jtag_step_idx;
+    export "DPI-C" task sv_jtag_clock_idx;
 
     task sv_wait_cycles(input int cycles);
         repeat (cycles) #1;
@@ -111,5 +208,171 @@ module jtag_testbench;
         tdo_out = tdo;
     endtask
 
+    // Clock TCK count times with fixed TMS/TDI (RUNTEST-style idle clocking),
+    // same per-cycle timing as sv_jtag_step without a DPI call per cycle
+    task sv_jtag_clock(input byte tms_in, input byte tdi_in, input int count);
+        tms = tms_in;
+        tdi = tdi_in;
+        repeat (count) begin
+            tck = 0; #0.5;
+            tck = 1; #1;
+            tck = 0; #0.5;
+            #0.1;
+        end
+    endtask
+
+    // Bulk shift with the TDO compare done here (djtg_shift_expect). Stimulus,
+    // expected and mask words are fetched 32 bits at a time; only the first
+    // mismatch, the mismatch count and the TDO window after it go back to C.
+    // With abort_on_mismatch the shift ends window_bits (at least one) after
+    // the first mismatch.
+    task sv_jtag_shift_expect(input int cbit, input byte abort_on_mismatch, input int window_bits,
+                              output int first_mismatch, output int mismatches, output int steps);
+        int tms_w, tdi_w, expected_w, mask_w;
+        int stop;
+        first_mismatch = -1;
+        mismatches = 0;
+        stop = cbit;
+        for (int i = 0; i < stop; i++) begin
+            if (i % 32 == 0) begin
+                jtag_expect_chunk(i / 32, tms_w, tdi_w, expected_w, mask_w);
+            end
+            tms = tms_w[i % 32];
+            tdi = tdi_w[i % 32];
+            tck = 0; #0.5;
+            tck = 1; #1;
+            tck = 0; #0.5;
+            #0.1;
+            if (mask_w[i % 32] && tdo !== expected_w[i % 32]) begin
+                if (first_mismatch < 0) begin
+                    first_mismatch = i;
+                    if (abort_on_mismatch && i + (window_bits > 0 ? window_bits : 1) < stop) begin
+                        stop = i + (window_bits > 0 ? window_bits : 1);
+                    end
+                end
+                mismatches++;
+            end
+            if (first_mismatch >= 0 && i < first_mismatch + window_bits) begin
+                jtag_expect_window_bit(i - first_mismatch, tdo);
+            end
+        end
+        steps = stop;
+    endtask
+
+    // Bulk shift sampling TDO only where the capture mask (built from the
+    // windows of djtg_shift_capture) is set; the samples go back packed,
+    // 32 per DPI call
+    task sv_jtag_shift_capture(input int cbit);
+        int tms_w, tdi_w, expected_w, mask_w;
+        int packed_w;
+        int captured;
+        packed_w = 0;
+        captured = 0;
+        for (int i = 0; i < cbit; i++) begin
+            if (i % 32 == 0) begin
+                jtag_expect_chunk(i / 32, tms_w, tdi_w, expected_w, mask_w);
+            end
+            tms = tms_w[i % 32];
+            tdi = tdi_w[i % 32];
+            tck = 0; #0.5;
+            tck = 1; #1;
+            tck = 0; #0.5;
+            #0.1;
+            if (mask_w[i % 32]) begin
+                packed_w[captured % 32] = tdo;
+                captured++;
+                if (captured % 32 == 0) begin
+                    jtag_capture_word(captured / 32 - 1, packed_w);
+                    packed_w = 0;
+                end
+            end
+        end
+        if (captured % 32 != 0) begin
+            jtag_capture_word(captured / 32, packed_w);
+        end
+    endtask
+
+    // Constant TMS/TDI stretch found by the run-length detection: clocked
+    // like sv_jtag_clock, with TDO optionally sampled and returned packed,
+    // 32 bits per DPI call
+    task sv_jtag_run(input byte tms_in, input byte tdi_in, input int count, input byte sample_tdo);
+        int packed_w;
+        tms = tms_in;
+        tdi = tdi_in;
+        packed_w = 0;
+        for (int i = 0; i < count; i++) begin
+            tck = 0; #0.5;
+            tck = 1; #1;
+            tck = 0; #0.5;
+            #0.1;
+            if (sample_tdo) begin
+                packed_w[i % 32] = tdo;
+                if (i % 32 == 31) begin
+                    jtag_capture_word(i / 32, packed_w);
+                    packed_w = 0;
+                end
+            end
+        end
+        if (sample_tdo && count % 32 != 0) begin
+            jtag_capture_word(count / 32, packed_w);
+        end
+    endtask
+
+    // Current simulation time in picoseconds
+    function longint sv_get_time_ps();
+        sv_get_time_ps = longint'($realtime * 1000.0);
+    endfunction
+
+    // Instance-indexed variants. Tap 0 forwards to the tasks above; the
+    // others are automatic so concurrent sessions on different instances do
+    // not share arguments.
+    function int sv_get_tap_count();
+        sv_get_tap_count = NUM_TAPS;
+    endfunction
+
+    function automatic byte sv_get_tdo_idx(input int tap);
+        sv_get_tdo_idx = (tap == 0) ? tdo : tdo_x[tap];
+    endfunction
+
+    task automatic sv_drive_jtag_pins_idx(input int tap, input byte tck_val, input byte tms_val, input byte tdi_val);
+        if (tap == 0) begin
+            sv_drive_jtag_pins(tck_val, tms_val, tdi_val);
+        end else begin
+            tck_x[tap] = tck_val;
+            tms_x[tap] = tms_val;
+            tdi_x[tap] = tdi_val;
+        end
+    endtask
+
+    task automatic sv_jtag_step_idx(input int tap, input byte tms_in, input byte tdi_in, input byte is_last,
+                                    output byte tdo_out);
+        if (tap == 0) begin
+            sv_jtag_step(tms_in, tdi_in, is_last, tdo_out);
+        end else begin
+            tms_x[tap] = tms_in;
+            tdi_x[tap] = tdi_in;
+            tck_x[tap] = 0; #0.5;
+            tck_x[tap] = 1; #1;
+            tck_x[tap] = 0; #0.5;
+            #0.1;
+            tdo_out = tdo_x[tap];
+        end
+    endtask
+
+    task automatic sv_jtag_clock_idx(input int tap, input byte tms_in, input byte tdi_in, input int count);
+        if (tap == 0) begin
+            sv_jtag_clock(tms_in, tdi_in, count);
+        end else begin
+            tms_x[tap] = tms_in;
+            tdi_x[tap] = tdi_in;
+            repeat (count) begin
+                tck_x[tap] = 0; #0.5;
+                tck_x[tap] = 1; #1;
+                tck_x[tap] = 0; #0.5;
+                #0.1;
+            end
+        end
+    endtask
+
 
 endmodule
@@ -0,0 +1,168 @@
+// spi_flash_model.sv
+// Behavioral SPI NOR flash (mode 0) for boundary-scan programming tests
+//
+// Supports the usual single-I/O command subset:
+// - 0x9F RDID, 0x05 RDSR, 0x06 WREN, 0x04 WRDI
+// - 0x03 READ (24-bit address, streams until CS rises)
+// - 0x02 PP (page program, wraps within the 256-byte page, bits only clear)
+// - 0x20 SE (4KB sector erase), 0xC7/0x60 CE (chip erase)
+// WREN/WRDI, PP and erases execute when CS rises. Program and erase keep
+// WIP set for PROGRAM_TIME_NS / ERASE_TIME_NS; only RDSR is accepted
+// meanwhile. MOSI is sampled on rising SCK, MISO changes on falling SCK.
+
+`timescale 1ns/1ps
+
+module spi_flash_model #(
+    parameter MEM_BYTES = 16384,
+    parameter JEDEC_ID = 24'hEF4016,
+    parameter PROGRAM_TIME_NS = 5000,
+    parameter ERASE_TIME_NS = 50000
+) (
+    input  logic cs_n,
+    input  logic sck,
+    input  logic mosi,
+    output wire  miso
+);
+
+    localparam ADDR_BITS = $clog2(MEM_BYTES);
+
+    // Commands
+    localparam [7:0] CMD_RDID  = 8'h9F;
+    localparam [7:0] CMD_RDSR  = 8'h05;
+    localparam [7:0] CMD_WREN  = 8'h06;
+    localparam [7:0] CMD_WRDI  = 8'h04;
+    localparam [7:0] CMD_READ  = 8'h03;
+    localparam [7:0] CMD_PP    = 8'h02;
+    localparam [7:0] CMD_SE    = 8'h20;
+    localparam [7:0] CMD_CE    = 8'hC7;
+    localparam [7:0] CMD_CE_60 = 8'h60;
+
+    logic [7:0] mem [0:MEM_BYTES-1];
+    logic [7:0] page_buf [0:255];
+    logic page_valid [0:255];
+
+    logic [7:0] in_shift, out_shift, command;
+    logic [2:0] bit_count;
+    int byte_count;                  // Bytes received in this transaction
+    logic [23:0] address;
+    logic wel;
+    realtime busy_until;
+    logic miso_reg;
+
+    initial begin
+        for (int i = 0; i < MEM_BYTES; i++) begin
+            mem[i] = 8'hFF;
+        end
+        wel = 1'b0;
+        busy_until = 0;
+        miso_reg = 1'b0;
+        bit_count = 3'd0;
+        byte_count = 0;
+    end
+
+    function automatic logic busy();
+        return $realtime < busy_until;
+    endfunction
+
+    function automatic logic [7:0] status();
+        return {6'b0, wel, busy()};
+    endfunction
+
+    // Output byte for the next byte slot after byte_count bytes
+    function automatic logic [7:0] next_output(input int received);
+        case (command)
+            CMD_RDID: return received <= 3 ? JEDEC_ID[23 - 8 * (received - 1) -: 8] : 8'h00;
+            CMD_RDSR: return status();
+            CMD_READ: return received >= 4 ? mem[address[ADDR_BITS-1:0]] : 8'h00;
+            default:  return 8'h00;
+        endcase
+    endfunction
+
+    // Select: start a new transaction
+    always @(negedge cs_n) begin
+        bit_count  = 3'd0;
+        byte_count = 0;
+        command    = 8'h00;
+        out_shift  = 8'h00;
+        for (int i = 0; i < 256; i++) begin
+            page_valid[i] = 1'b0;
+        end
+    end
+
+    // Sample MOSI; act on each complete byte
+    always @(posedge sck) begin
+        if (!cs_n) begin
+            in_shift = {in_shift[6:0], mosi};
+            bit_count = bit_count + 3'd1;
+            if (bit_count == 3'd0) begin
+                byte_count = byte_count + 1;
+                if (byte_count == 1) begin
+                    // Only RDSR is accepted while a program or erase runs
+                    command = (busy() && in_shift != CMD_RDSR) ? 8'h00 : in_shift;
+                end else if (byte_count <= 4 && (command == CMD_READ || command == CMD_PP || command == CMD_SE)) begin
+                    address = {address[15:0], in_shift};
+                end else if (command == CMD_PP) begin
+                    page_buf[address[7:0]] = in_shift;
+                    page_valid[address[7:0]] = 1'b1;
+                    address[7:0] = address[7:0] + 8'd1;
+                end
+                // READ streams from the address, one byte per slot
+                out_shift = next_output(byte_count);
+                if (command == CMD_READ && byte_count >= 4) begin
+                    address = address + 24'd1;
+                end
+            end
+        end
+    end
+
+    // Shift out on the falling edge
+    always @(negedge sck) begin
+        if (!cs_n) begin
+            miso_reg = out_shift[7];
+            out_shift = {out_shift[6:0], 1'b0};
+        end
+    end
+
+    // Deselect: commands that execute on CS rising
+    always @(posedge cs_n) begin
+        if (bit_count == 3'd0 && byte_count > 0) begin
+            case (command)
+                CMD_WREN: wel = 1'b1;
+                CMD_WRDI: wel = 1'b0;
+                CMD_PP: begin
+                    if (wel && byte_count > 4) begin
+                        for (int i = 0; i < 256; i++) begin
+                            if (page_valid[i]) begin
+                                mem[{address[ADDR_BITS-1:8], 8'(i)}] = mem[{address[ADDR_BITS-1:8], 8'(i)}] & page_buf[i];
+                            end
+                        end
+                        busy_until = $realtime + PROGRAM_TIME_NS;
+                    end
+                    wel = 1'b0;
+                end
+                CMD_SE: begin
+                    if (wel && byte_count == 4) begin
+                        for (int i = 0; i < 4096; i++) begin
+                            mem[{address[ADDR_BITS-1:12], 12'(i)}] = 8'hFF;
+                        end
+                        busy_until = $realtime + ERASE_TIME_NS;
+                    end
+                    wel = 1'b0;
+                end
+                CMD_CE, CMD_CE_60: begin
+                    if (wel && byte_count == 1) begin
+                        for (int i = 0; i < MEM_BYTES; i++) begin
+                            mem[i] = 8'hFF;
+                        end
+                        busy_until = $realtime + ERASE_TIME_NS;
+                    end
+                    wel = 1'b0;
+                end
+                default: ;
+            endcase
+        end
+    end
+
+    assign miso = cs_n ? 1'bz : miso_reg;
+
+endmodule